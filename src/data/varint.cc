@@ -0,0 +1,37 @@
+#include "varint.h"
+
+namespace data {
+
+int VarintBytesize(uint64_t value) {
+    int bytesize = 1;
+    for (; value >= 0x80; value >>= 7)
+        bytesize++;
+    return bytesize;
+}
+
+ResultV<uint64_t> ReadVarint(const std::vector<uint8_t> &bytes, int &offset) {
+    if (offset < 0)
+        return Error("data::ReadVarint() offset should be fit the size.");
+    uint64_t value = 0;
+    for (int i = 0; i < kMaxVarintBytesize; i++) {
+        if (offset + i >= bytes.size())
+            return Error("data::ReadVarint() the varint is truncated.");
+        const uint8_t byte = bytes[offset + i];
+        value |= uint64_t(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            offset += i + 1;
+            return Ok(value);
+        }
+    }
+    return Error("data::ReadVarint() the varint is too long.");
+}
+
+void WriteVarintNoFail(std::vector<uint8_t> &bytes, const size_t offset,
+                       uint64_t value) {
+    const size_t end = offset + VarintBytesize(value);
+    if (end > bytes.size()) bytes.resize(end);
+    for (size_t i = offset; i < end; i++, value >>= 7)
+        bytes[i] = (value & 0x7f) | (i + 1 < end ? 0x80 : 0);
+}
+
+} // namespace data
@@ -0,0 +1,30 @@
+#ifndef _DATA_VARINT_H
+#define _DATA_VARINT_H
+
+#include "result.h"
+#include <cstdint>
+#include <vector>
+
+namespace data {
+
+using namespace result;
+
+// The maximum bytes size of a varint, which holds a uint64_t.
+constexpr int kMaxVarintBytesize = 10;
+
+// Returns the bytes size of `value` written as a varint.
+int VarintBytesize(uint64_t value);
+
+// Reads a varint with the `offset`. A varint has 7 bits of the value in each
+// byte from the lowest bits, and the highest bit of a byte is set when the
+// next byte follows. `offset` is advanced to the end of the varint.
+ResultV<uint64_t> ReadVarint(const std::vector<uint8_t> &bytes, int &offset);
+
+// Writes `value` as a varint with the `offset`. `bytes` is extended when the
+// varint does not fit `bytes`.
+void WriteVarintNoFail(std::vector<uint8_t> &bytes, const size_t offset,
+                       uint64_t value);
+
+} // namespace data
+
+#endif // _DATA_VARINT_H
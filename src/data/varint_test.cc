@@ -0,0 +1,52 @@
+#include "varint.h"
+#include <gtest/gtest.h>
+
+TEST(DataVarint, CorrectlyReadVarint) {
+    std::vector<uint8_t> bytes = {'\0', 0b10101100, 0b00000010, 0b01111111};
+
+    int offset       = 1;
+    auto expect_uint = data::ReadVarint(bytes, offset);
+    ASSERT_TRUE(expect_uint.IsOk());
+    EXPECT_EQ(expect_uint.Get(), /*0b100101100=*/300);
+    EXPECT_EQ(offset, 3);
+
+    expect_uint = data::ReadVarint(bytes, offset);
+    ASSERT_TRUE(expect_uint.IsOk());
+    EXPECT_EQ(expect_uint.Get(), 127);
+    EXPECT_EQ(offset, 4);
+}
+
+TEST(DataVarint, ReadVarintWithOutsideIndex) {
+    std::vector<uint8_t> bytes = {0b10000001, 0b10000001};
+
+    int offset = -1;
+    EXPECT_TRUE(data::ReadVarint(bytes, offset).IsError());
+    offset = 2;
+    EXPECT_TRUE(data::ReadVarint(bytes, offset).IsError());
+    offset = 0;
+    EXPECT_TRUE(data::ReadVarint(bytes, offset).IsError());
+
+    std::vector<uint8_t> too_long(data::kMaxVarintBytesize + 1, 0b10000000);
+    too_long.back() = 0;
+    offset          = 0;
+    EXPECT_TRUE(data::ReadVarint(too_long, offset).IsError());
+}
+
+TEST(DataVarint, WriteVarintNoFailSuccess) {
+    std::vector<uint8_t> bytes(2);
+
+    for (const uint64_t value :
+         {uint64_t(0), uint64_t(127), uint64_t(128), uint64_t(1) << 32,
+          UINT64_MAX}) {
+        data::WriteVarintNoFail(bytes, 1, value);
+        EXPECT_EQ(bytes.size(),
+                  std::max<size_t>(2, 1 + data::VarintBytesize(value)));
+
+        int offset       = 1;
+        auto expect_uint = data::ReadVarint(bytes, offset);
+        ASSERT_TRUE(expect_uint.IsOk());
+        EXPECT_EQ(expect_uint.Get(), value);
+        EXPECT_EQ(offset, 1 + data::VarintBytesize(value));
+    }
+    EXPECT_EQ(data::VarintBytesize(UINT64_MAX), data::kMaxVarintBytesize);
+}
@@ -34,9 +34,9 @@ class ExecuteTest : public ::testing::TestWithParam<ExecuteTestParam> {
           buffer_manager(/*buffer_size=*/16, data_disk_manager, log_manager),
           lock_table(/*wait_time_sec=*/0.1),
           transaction(data_disk_manager, buffer_manager, log_manager,
-                      lock_table),
+                      lock_table, version_store, free_space_map),
           transaction_for_check(data_disk_manager, buffer_manager, log_manager,
-                                lock_table) {
+                                lock_table, version_store, free_space_map) {
         if (!std::filesystem::exists(data_directory_path)) {
             std::filesystem::create_directories(data_directory_path);
         }
@@ -59,7 +59,8 @@ class ExecuteTest : public ::testing::TestWithParam<ExecuteTestParam> {
 
     Result CreateAndInsertTableData() {
         transaction::Transaction insert_transaction(
-            data_disk_manager, buffer_manager, log_manager, lock_table);
+            data_disk_manager, buffer_manager, log_manager, lock_table,
+            version_store, free_space_map);
 
         // Create the table
         FIRST_TRY(environment.GetTableManager().CreateTable(
@@ -103,6 +104,8 @@ class ExecuteTest : public ::testing::TestWithParam<ExecuteTestParam> {
     dblog::LogManager log_manager;
     buffer::SimpleBufferManager buffer_manager;
     dbconcurrency::LockTable lock_table;
+    dbconcurrency::VersionStore version_store;
+    disk::FreeSpaceMap free_space_map;
     execute::Environment environment;
 
     transaction::Transaction transaction;
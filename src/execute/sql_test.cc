@@ -68,9 +68,9 @@ class SqlTest : public ::testing::Test {
           buffer_manager(/*buffer_size=*/16, data_disk_manager, log_manager),
           lock_table(/*wait_time_sec=*/0.1),
           transaction(data_disk_manager, buffer_manager, log_manager,
-                      lock_table),
+                      lock_table, version_store, free_space_map),
           transaction_for_check(data_disk_manager, buffer_manager, log_manager,
-                                lock_table) {
+                                lock_table, version_store, free_space_map) {
         if (!std::filesystem::exists(data_directory_path)) {
             std::filesystem::create_directories(data_directory_path);
         }
@@ -93,7 +93,8 @@ class SqlTest : public ::testing::Test {
 
     Result CreateAndInsertTableData() {
         transaction::Transaction insert_transaction(
-            data_disk_manager, buffer_manager, log_manager, lock_table);
+            data_disk_manager, buffer_manager, log_manager, lock_table,
+            version_store, free_space_map);
 
         // Create the table
         FIRST_TRY(environment.GetTableManager().CreateTable(
@@ -135,6 +136,8 @@ class SqlTest : public ::testing::Test {
     dblog::LogManager log_manager;
     buffer::SimpleBufferManager buffer_manager;
     dbconcurrency::LockTable lock_table;
+    dbconcurrency::VersionStore version_store;
+    disk::FreeSpaceMap free_space_map;
     execute::Environment environment;
 
     transaction::Transaction transaction;
@@ -235,6 +238,39 @@ TEST_F(SqlTest, SelectSuccessWithWhereCondition) {
     EXPECT_EQ(result, expect_result);
 }
 
+TEST_F(SqlTest, SelectReadsSnapshotWithoutWaitingForWriters) {
+    // A writer updates the first row and holds the write lock.
+    transaction::Transaction writer(data_disk_manager, buffer_manager,
+                                    log_manager, lock_table, version_store,
+                                    free_space_map);
+    ResultV<schema::Layout> layout =
+        environment.GetTableManager().GetLayout(table_name, writer);
+    ASSERT_TRUE(layout.IsOk()) << layout.Error();
+    scan::TableScan table_scan(writer, table_name, layout.Get());
+    ASSERT_TRUE(table_scan.Init().IsOk());
+    ASSERT_TRUE(table_scan.Update("field1", data::Int(100)).IsOk());
+
+    transaction.BeginSnapshot();
+    sql::Columns *columns                = new sql::Columns(true);
+    sql::BooleanPrimary *where_condition = new sql::BooleanPrimary(
+        new sql::Column("field1"), sql::ComparisonOperator::Equal,
+        new sql::Column(0));
+    sql::SelectStatement select_statement(
+        columns, new sql::Table(tablename.c_str()), where_condition);
+    execute::QueryResult result = execute::DefaultResult();
+    Result execute_result =
+        select_statement.Execute(transaction, result, environment);
+
+    EXPECT_TRUE(execute_result.IsOk()) << execute_result.Error();
+    execute::QueryResult expect_result = execute::SelectResult(
+        {"field1", "field2"}, {
+                                  {data::Int(0), data::Int(0)},
+                              });
+    EXPECT_EQ(result, expect_result);
+    EXPECT_TRUE(transaction.Commit().IsOk());
+    EXPECT_TRUE(writer.Rollback().IsOk());
+}
+
 TEST_F(SqlTest, SelectFailWithWhereConditionWithInvalidColumn) {
     sql::Columns *columns                = new sql::Columns(true);
     sql::BooleanPrimary *where_condition = new sql::BooleanPrimary(
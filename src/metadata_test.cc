@@ -11,7 +11,8 @@ TEST_F(MetadataManagerTest, CreateTableSuccess) {
     schema::Schema schema({schema::Field("field0", data::TypeInt()),
                            schema::Field("field1", data::TypeChar(10))});
     transaction::Transaction transaction(data_disk_manager, buffer_manager,
-                                         log_manager, lock_table);
+                                         log_manager, lock_table,
+                                         version_store, free_space_map);
 
     auto res = manager.CreateTable("table0", schema, transaction);
 
@@ -23,7 +24,8 @@ TEST_F(MetadataManagerTest, GetLayoutSuucess) {
     schema::Schema schema({schema::Field("field0", data::TypeInt()),
                            schema::Field("field1", data::TypeChar(10))});
     transaction::Transaction transaction(data_disk_manager, buffer_manager,
-                                         log_manager, lock_table);
+                                         log_manager, lock_table,
+                                         version_store, free_space_map);
     auto res = manager.CreateTable("table0", schema, transaction);
     ASSERT_TRUE(res.IsOk()) << res.Error();
 
@@ -31,7 +33,7 @@ TEST_F(MetadataManagerTest, GetLayoutSuucess) {
 
     EXPECT_TRUE(layout_res.IsOk()) << layout_res.Error();
     auto layout = layout_res.Get();
-    EXPECT_EQ(layout.Length(), 15);
+    EXPECT_EQ(layout.Length(), 14);
 
     ResultV<int> length_res = layout.Length("field0");
     EXPECT_TRUE(length_res.IsOk()) << length_res.Error();
@@ -43,9 +45,9 @@ TEST_F(MetadataManagerTest, GetLayoutSuucess) {
 
     ResultV<int> offset_res = layout.Offset("field0");
     EXPECT_TRUE(offset_res.IsOk()) << offset_res.Error();
-    EXPECT_EQ(offset_res.Get(), 1);
+    EXPECT_EQ(offset_res.Get(), 0);
 
     offset_res = layout.Offset("field1");
     EXPECT_TRUE(offset_res.IsOk()) << offset_res.Error();
-    EXPECT_EQ(offset_res.Get(), 5);
+    EXPECT_EQ(offset_res.Get(), 4);
 }
\ No newline at end of file
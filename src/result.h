@@ -3,6 +3,7 @@
 
 #include <exception>
 #include <iostream>
+#include <new>
 #include <stdexcept>
 #include <string>
 
@@ -63,12 +64,14 @@ template <typename T, typename E> class ResultVE {
     explicit ResultVE(const E &error) : tag_(Tag::Error), error_(error) {}
 
     ResultVE(const ResultVE &result) : tag_(result.tag_) {
+        // The members of the union are not constructed yet, so they are
+        // constructed in place instead of being assigned.
         switch (tag_) {
         case Tag::Ok:
-            ok_ = result.ok_;
+            new (&ok_) T(result.ok_);
             break;
         case Tag::Error:
-            error_ = result.error_;
+            new (&error_) E(result.error_);
             break;
         }
     }
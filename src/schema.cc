@@ -3,12 +3,10 @@
 
 namespace schema {
 
-// The first byte is used for the used/unused flag.
-constexpr int kUsedFlagOffset = 0;
-constexpr int kUsedFlagLength = 1;
-
 Layout::Layout(const Schema &schema) {
-    int offset = kUsedFlagLength;
+    // Whether the row is used is told by the occupancy bitmap of the block,
+    // so the fields start at the beginning of the row.
+    int offset = 0;
     for (const auto &field : schema.Fields()) {
         field_lengths_[field.FieldName()] = field.Length();
         field_types_[field.FieldName()]   = field.Type();
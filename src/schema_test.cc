@@ -17,15 +17,15 @@ TEST(Layout, ComputeOffset) {
 
     ResultV<int> offset_a = layout.Offset("a");
     EXPECT_TRUE(offset_a.IsOk());
-    EXPECT_EQ(offset_a.Get(), 1);
+    EXPECT_EQ(offset_a.Get(), 0);
 
     ResultV<int> offset_b = layout.Offset("b");
     EXPECT_TRUE(offset_b.IsOk());
-    EXPECT_EQ(offset_b.Get(), 5);
+    EXPECT_EQ(offset_b.Get(), 4);
 
     ResultV<int> offset_c = layout.Offset("c");
     EXPECT_TRUE(offset_c.IsOk());
-    EXPECT_EQ(offset_c.Get(), 12);
+    EXPECT_EQ(offset_c.Get(), 11);
 
     ResultV<int> length_a = layout.Length("a");
     EXPECT_TRUE(length_a.IsOk());
@@ -39,7 +39,7 @@ TEST(Layout, ComputeOffset) {
     EXPECT_TRUE(length_c.IsOk());
     EXPECT_EQ(length_c.Get(), 4);
 
-    EXPECT_EQ(layout.Length(), 16);
+    EXPECT_EQ(layout.Length(), 15);
 }
 
 TEST(Layout, OffsetFailWithInvalidField) {
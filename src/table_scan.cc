@@ -1,5 +1,4 @@
 #include "table_scan.h"
-#include "data/byte.h"
 #include "data/char.h"
 #include "data/int.h"
 #include "disk.h"
@@ -13,23 +12,65 @@ std::string TableFileName(const std::string &table_name) {
     return table_name + ".table";
 }
 
-constexpr uint8_t kUnusedFlag = 0x00;
-constexpr uint8_t kUsedFlag   = 0x01;
+// The number of blocks appended at once when the table has no free slot.
+constexpr int kAppendedBlockCount = 8;
+
+// Returned by `FindSlot()` when there is no such slot.
+constexpr int kNoSlot = -1;
+
+// Returns the number of the slots of `slot_size` in a block of `block_size`,
+// which has a bit of the occupancy bitmap for each slot.
+int SlotCount(const int block_size, const int slot_size) {
+    return 8 * block_size / (8 * slot_size + 1);
+}
+
+// Returns the first slot from `from` whose bit in `bitmap` is `value`. The
+// bitmap is searched by 64 bits at once. If there is no such slot, returns
+// `kNoSlot`.
+int FindSlot(const std::vector<uint8_t> &bitmap, const int from,
+             const int slot_count, const bool value) {
+    for (int base = from - from % 64; base < slot_count; base += 64) {
+        uint64_t word = 0;
+        for (int i = 0; i < 8 && base / 8 + i < bitmap.size(); i++) {
+            word |= uint64_t(bitmap[base / 8 + i]) << (8 * i);
+        }
+        if (!value) word = ~word;
+        if (base < from) word &= ~uint64_t(0) << (from - base);
+        if (word == 0) continue;
+
+        const int slot = base + __builtin_ctzll(word);
+        return slot < slot_count ? slot : kNoSlot;
+    }
+    return kNoSlot;
+}
+
+// Returns the number of the rows, whose bits are set in `bitmap`.
+int CountRows(const std::vector<uint8_t> &bitmap) {
+    int row_count = 0;
+    for (const uint8_t byte : bitmap) {
+        row_count += __builtin_popcount(byte);
+    }
+    return row_count;
+}
 
 TableScan::TableScan(transaction::Transaction &transaction,
                      std::string table_name, schema::Layout layout)
-    : transaction_(transaction), table_name_(table_name), layout_(layout) {}
+    : transaction_(transaction), table_name_(table_name), layout_(layout),
+      slot_count_(SlotCount(transaction.BlockSize(), layout.Length())),
+      bitmap_length_((slot_count_ + 7) / 8) {}
 
 Result TableScan::Init() {
     SetBlockNumber(0);
-    slot_ = 0;
+    slot_               = 0;
+    bitmap_block_index_ = -1;
 
     ResultV<size_t> size = transaction_.Size(TableFileName(table_name_));
     if (size.IsError()) {
         return size +
                Error("TableScan::Init() failed to get the size of the file");
     }
-    if (size.Get() == 0) {
+    file_size_ = size.Get();
+    if (file_size_ == 0) {
         Result result = CreateFirstBlock();
         if (result.IsError())
             return result +
@@ -49,7 +90,9 @@ Result TableScan::Init() {
         return next + Error("TableScan::Init() failed to get the next slot");
     }
 
-    if (next.Get()) { return Ok(); }
+    // A snapshot cannot write, so the scan of a table without rows stays on
+    // the last slot.
+    if (next.Get() || transaction_.IsSnapshot()) { return Ok(); }
     return Insert();
 }
 
@@ -80,10 +123,10 @@ ResultV<data::DataItemWithType> TableScan::Get(const std::string &fieldname) {
     TRY_VALUE(field_offset, layout_.Offset(fieldname));
 
     disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length() +
-                                    field_offset.Get());
+                                /*offset=*/SlotOffset() + field_offset.Get());
     data::DataItem item;
-    FIRST_TRY(transaction_.Read(position, field_length.Get(), item));
+    FIRST_TRY(
+        transaction_.ReadRecord(slot_, position, field_length.Get(), item));
     return Ok(
         data::DataItemWithType(item, field_type.Get(), field_length.Get()));
 }
@@ -93,10 +136,10 @@ ResultV<int> TableScan::GetInt(const std::string &fieldname) {
     TRY_VALUE(field_offset, layout_.Offset(fieldname));
 
     disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length() +
-                                    field_offset.Get());
+                                /*offset=*/SlotOffset() + field_offset.Get());
     data::DataItem item;
-    FIRST_TRY(transaction_.Read(position, data::kTypeInt.ValueLength(), item));
+    FIRST_TRY(transaction_.ReadRecord(slot_, position,
+                                      data::kTypeInt.ValueLength(), item));
     return Ok(data::ReadInt(item));
 }
 
@@ -105,10 +148,10 @@ ResultV<std::string> TableScan::GetChar(const std::string &fieldname) {
     TRY_VALUE(field_offset, layout_.Offset(fieldname));
 
     disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length() +
-                                    field_offset.Get());
+                                /*offset=*/SlotOffset() + field_offset.Get());
     data::DataItem item;
-    FIRST_TRY(transaction_.Read(position, field_length.Get(), item));
+    FIRST_TRY(
+        transaction_.ReadRecord(slot_, position, field_length.Get(), item));
     std::string value = data::ReadChar(item, field_length.Get());
     data::RightTrim(value);
     return Ok(value);
@@ -120,101 +163,155 @@ Result TableScan::Update(const std::string &fieldname,
     TRY_VALUE(field_offset, layout_.Offset(fieldname));
 
     disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length() +
-                                    field_offset.Get());
-    FIRST_TRY(transaction_.Write(position, field_length.Get(), item.Item()));
+                                /*offset=*/SlotOffset() + field_offset.Get());
+    FIRST_TRY(transaction_.WriteRecord(slot_, position, field_length.Get(),
+                                       item.Item()));
     return Ok();
 }
 
 Result TableScan::Insert() {
+    const std::string filename         = TableFileName(table_name_);
+    disk::FreeSpaceMap &free_space_map = transaction_.FreeSpace();
+    ResultV<size_t> size               = transaction_.Size(filename);
+    if (size.IsError()) {
+        return size +
+               Error("TableScan::Insert() failed to get the size of the file");
+    }
+    int block_count = size.Get();
+
     while (true) {
-        ResultV<bool> is_used = IsUsed();
-        if (is_used.IsError()) {
-            return is_used + Error("TableScan::Insert() failed to check if the "
-                                   "slot is used");
+        int block_index = free_space_map.Find(filename, block_count);
+        if (block_index == disk::kNoFreeBlock) {
+            ResultV<int> first_block_index =
+                transaction_.AppendNewBlocks(filename, kAppendedBlockCount);
+            if (first_block_index.IsError()) {
+                return first_block_index +
+                       Error("TableScan::Insert() failed to append new blocks");
+            }
+            block_count = first_block_index.Get() + kAppendedBlockCount;
+            free_space_map.Add(filename, first_block_index.Get(),
+                               block_count - 1);
+            continue;
         }
 
-        if (!is_used.Get()) { return SetUsed(); }
-
-        ResultV<bool> next = NextSlot();
-        if (next.IsError()) {
-            return next +
-                   Error("TableScan::Insert() failed to get the next slot");
+        ResultV<bool> found = MoveToFreeSlot(block_index);
+        if (found.IsError()) {
+            return found + Error("TableScan::Insert() failed to find a free "
+                                 "slot in the block");
+        }
+        if (!found.Get()) {
+            free_space_map.Remove(filename, block_index);
+            continue;
         }
 
-        if (!next.Get()) { break; }
-    }
-
-    Result allocate = transaction_.AllocateNewBlocks(block_id_ + 1);
-    if (allocate.IsError()) {
-        return allocate +
-               Error("TableScan::Insert() failed to allocate new blocks");
+        // The block may have other free slots.
+        free_space_map.Add(filename, block_index, block_index);
+        if (file_size_ < block_index + 1) file_size_ = block_index + 1;
+        return SetUsed();
     }
-
-    SetBlockNumber(block_id_.BlockIndex() + 1);
-    slot_ = 0;
-    return SetUsed();
 }
 
 Result TableScan::Delete() {
-    disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length());
-    return transaction_.Write(position, data::kTypeByte.ValueLength(),
-                              data::Byte(kUnusedFlag).Item());
+    // The deleted row is left as a ghost in the occupancy bitmap until the
+    // transaction commits, so that the scans reading the bitmap without locks
+    // wait for the lock of the row instead of skipping it.
+    FIRST_TRY(transaction_.ClearRecordBitsOnCommit(slot_, BitmapPosition(),
+                                                   SlotMask()));
+    return Ok();
 }
 
 Result TableScan::Close() { return Ok(); }
 
-bool DoesNextSlotExist(int slot, int slot_size, int whole_size) {
-    return (slot + 2) * slot_size <= whole_size;
-}
-
 Result TableScan::CreateFirstBlock() {
-    // Here, `block_id_` must be the first block of the database file.
-    Result allocate = transaction_.AllocateNewBlocks(block_id_);
-    if (allocate.IsError()) {
-        return allocate +
-               Error("TableScan::CreateFirstBlock() failed to allocate new "
-                     "blocks");
+    // Here, `block_id_` must be the first block of the database file. When
+    // another transaction creates the first block at the same time, the
+    // appended block is the next one, which is left empty.
+    ResultV<int> block_index =
+        transaction_.AppendNewBlocks(TableFileName(table_name_), 1);
+    if (block_index.IsError()) {
+        return block_index + Error("TableScan::CreateFirstBlock() failed to "
+                                   "append a new block");
     }
+    file_size_ = block_index.Get() + 1;
     return Ok();
 }
 
 ResultV<bool> TableScan::NextSlot() {
-    if (DoesNextSlotExist(slot_, layout_.Length(), transaction_.BlockSize())) {
-        slot_++;
-        return Ok(true);
-    }
+    int from = slot_ + 1;
+    while (true) {
+        if (bitmap_block_index_ != block_id_.BlockIndex()) {
+            Result read_result = ReadBitmap();
+            if (read_result.IsError()) {
+                return read_result + Error("TableScan::NextSlot() failed to "
+                                           "read the occupancy bitmap");
+            }
+        }
 
-    ResultV<size_t> size = transaction_.Size(TableFileName(table_name_));
-    if (size.IsError()) {
-        return size +
-               Error("TableScan::Next() failed to get the size of the file");
-    }
+        // The blocks without rows are skipped by the search of the bitmap.
+        const int slot = FindSlot(bitmap_, from, slot_count_, /*value=*/true);
+        if (slot != kNoSlot) {
+            slot_ = slot;
+            return Ok(true);
+        }
 
-    int block_index = block_id_.BlockIndex();
-    if (block_index + 1 < size.Get()) {
+        const int block_index = block_id_.BlockIndex();
+        if (block_index + 1 >= file_size_) { return Ok(false); }
         SetBlockNumber(block_index + 1);
         slot_ = 0;
-        return Ok(true);
+        from  = 0;
     }
+}
 
+ResultV<bool> TableScan::MoveToFreeSlot(const int block_index) {
+    SetBlockNumber(block_index);
+    Result read_result = ReadBitmap();
+    if (read_result.IsError()) {
+        return read_result + Error("TableScan::MoveToFreeSlot() failed to read "
+                                   "the occupancy bitmap");
+    }
+    if (CountRows(bitmap_) == slot_count_) { return Ok(false); }
+
+    int slot = FindSlot(bitmap_, 0, slot_count_, /*value=*/false);
+    while (slot != kNoSlot) {
+        // Concurrent inserts may probe the same slot, so it is locked for
+        // write at once rather than converting a read lock in `SetUsed()`.
+        slot_                 = slot;
+        ResultV<bool> is_used = IsUsed(/*for_update=*/true);
+        if (is_used.IsError()) {
+            return is_used + Error("TableScan::MoveToFreeSlot() failed to "
+                                   "check if the slot is used");
+        }
+        if (!is_used.Get()) { return Ok(true); }
+        slot = FindSlot(bitmap_, slot + 1, slot_count_, /*value=*/false);
+    }
     return Ok(false);
 }
 
-ResultV<bool> TableScan::IsUsed() {
-    disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length());
-    data::DataItem item;
-    FIRST_TRY(transaction_.Read(position, data::kTypeByte.ValueLength(), item));
-    return Ok(data::ReadByte(item) == kUsedFlag);
+ResultV<bool> TableScan::IsUsed(const bool for_update) {
+    ResultV<uint8_t> bits =
+        transaction_.ReadRecordBits(slot_, BitmapPosition(), for_update);
+    if (bits.IsError()) {
+        return bits + Error("TableScan::IsUsed() failed to read the bit of "
+                            "the slot");
+    }
+    return Ok((bits.Get() & SlotMask()) != 0);
 }
 
 Result TableScan::SetUsed() {
-    disk::DiskPosition position(/*block_id=*/block_id_,
-                                /*offset=*/slot_ * layout_.Length());
-    return transaction_.Write(position, data::kTypeByte.ValueLength(),
-                              data::Byte(kUsedFlag).Item());
+    FIRST_TRY(transaction_.WriteRecordBits(slot_, BitmapPosition(),
+                                           SlotMask(), /*value=*/true));
+    bitmap_block_index_ = -1;
+    return Ok();
+}
+
+Result TableScan::ReadBitmap() {
+    data::DataItem item;
+    FIRST_TRY(transaction_.ReadWithoutLock(
+        disk::DiskPosition(/*block_id=*/block_id_, /*offset=*/0),
+        bitmap_length_, item));
+    bitmap_.assign(item.begin(), item.end());
+    bitmap_block_index_ = block_id_.BlockIndex();
+    return Ok();
 }
 
 void TableScan::SetBlockNumber(int block_number) {
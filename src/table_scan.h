@@ -5,12 +5,19 @@
 #include "scan.h"
 #include "schema.h"
 #include "transaction/transaction.h"
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace scan {
 
 std::string TableFileName(const std::string &table_name);
 
+// TableScan scans the rows of a table. A block of the table begins with the
+// occupancy bitmap, whose bit `slot % 8` of the byte `slot / 8` tells if the
+// slot is used, and the slots follow it. The scan finds the used slots of a
+// block in its bitmap, 64 slots at once, so the empty and sparse blocks are
+// skipped without reading each slot.
 class TableScan : public UpdateScan {
   public:
     TableScan(transaction::Transaction &transaction, std::string table_name,
@@ -36,10 +43,13 @@ class TableScan : public UpdateScan {
                   const data::DataItemWithType &item);
 
     // Insert a new row to somewhere in the table. The scan moves to the newly
-    // inserted row.
+    // inserted row. The free slot is looked up in the free-space map of the
+    // transaction, and new blocks are appended in a batch when the table has
+    // no free slot.
     Result Insert();
 
-    // Delete the current row and move to the next row.
+    // Delete the current row and move to the next row. The slot of the row is
+    // freed when the transaction commits.
     Result Delete();
 
     // Closes the scan.
@@ -49,16 +59,41 @@ class TableScan : public UpdateScan {
     // When the database file is empty, create the file and its first block.
     Result CreateFirstBlock();
 
-    // Move to the next slot in the table. If there is a slot, returns true,
-    // otherwise return false. It does not check if the slot is not empty.
+    // Move to the next slot in the table whose bit is set in the occupancy
+    // bitmap. If there is a slot, returns true, otherwise return false. The
+    // bitmap is read without locks, so the caller must check if the slot is
+    // used with `IsUsed()`. The blocks appended after the size of the file is
+    // cached are not visited.
     ResultV<bool> NextSlot();
 
-    // Check if the currnt slot is used.
-    ResultV<bool> IsUsed();
+    // Move to the first free slot of the block of `block_index`. If there is
+    // no free slot, returns false. A full block is told by the number of the
+    // rows in the occupancy bitmap without reading the slots.
+    ResultV<bool> MoveToFreeSlot(const int block_index);
+
+    // Check if the currnt slot is used. If `for_update` is true, the slot is
+    // locked for write, since it is about to be set as used.
+    ResultV<bool> IsUsed(const bool for_update = false);
 
     // Set the current slot as used.
     Result SetUsed();
 
+    // Read the occupancy bitmap of the current block.
+    Result ReadBitmap();
+
+    // The position of the byte of the occupancy bitmap which has the bit of
+    // the current slot, and the mask of the bit.
+    inline disk::DiskPosition BitmapPosition() const {
+        return disk::DiskPosition(/*block_id=*/block_id_,
+                                  /*offset=*/slot_ / 8);
+    }
+    inline uint8_t SlotMask() const { return uint8_t(1) << (slot_ % 8); }
+
+    // The offset of the current slot in the block.
+    inline int SlotOffset() const {
+        return bitmap_length_ + slot_ * layout_.Length();
+    }
+
     // Set the block number.
     void SetBlockNumber(int block_number);
 
@@ -68,6 +103,20 @@ class TableScan : public UpdateScan {
 
     disk::BlockID block_id_;
     int slot_;
+
+    // The number of blocks of the file, cached at `Init()` and updated when
+    // the scan appends blocks.
+    size_t file_size_;
+
+    // The number of the slots in a block, and the length of the occupancy
+    // bitmap in bytes.
+    int slot_count_;
+    int bitmap_length_;
+
+    // The occupancy bitmap of the block of `bitmap_block_index_`, read by the
+    // scan. The index is -1 when the bitmap is not read.
+    std::vector<uint8_t> bitmap_;
+    int bitmap_block_index_ = -1;
 };
 
 } // namespace scan
@@ -1,9 +1,14 @@
+#include "data/char.h"
 #include "data/int.h"
 #include "table_scan.h"
 #include "transaction.h"
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 const std::string data_directory_path = "data_dir/";
 const std::string log_directory_path  = "log_dir/";
@@ -19,9 +24,9 @@ class TableScanTest : public ::testing::Test {
           buffer_manager(/*buffer_size=*/16, data_disk_manager, log_manager),
           lock_table(/*wait_time_sec=*/0.1),
           transaction(data_disk_manager, buffer_manager, log_manager,
-                      lock_table),
+                      lock_table, version_store, free_space_map),
           transaction_for_check(data_disk_manager, buffer_manager, log_manager,
-                                lock_table) {
+                                lock_table, version_store, free_space_map) {
 
         if (!std::filesystem::exists(data_directory_path)) {
             std::filesystem::create_directories(data_directory_path);
@@ -56,6 +61,8 @@ class TableScanTest : public ::testing::Test {
     dblog::LogManager log_manager;
     buffer::SimpleBufferManager buffer_manager;
     dbconcurrency::LockTable lock_table;
+    dbconcurrency::VersionStore version_store;
+    disk::FreeSpaceMap free_space_map;
 
     transaction::Transaction transaction;
     transaction::Transaction transaction_for_check;
@@ -142,4 +149,292 @@ TEST_F(TableScanTest, DeleteSuccess) {
     result = table_scan_for_check.Init();
     EXPECT_TRUE(result.IsOk()) << result.Error();
     EXPECT_TRUE(!result.Get()); // because there is a no row.
-}
\ No newline at end of file
+}
+
+TEST_F(TableScanTest, InsertDoesNotBlockScansOfTable) {
+    scan::TableScan table_scan(transaction, table_name, layout);
+    Result result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    Result insert_result = table_scan.Insert();
+    ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+    Result commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+
+    scan::TableScan table_scan_for_check(transaction_for_check, table_name,
+                                         layout);
+    result = table_scan_for_check.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // The block has only one slot, so the insert appends a new block while
+    // the other transaction is scanning the table.
+    transaction::Transaction transaction_for_insert(
+        data_disk_manager, buffer_manager, log_manager, lock_table,
+        version_store, free_space_map);
+    scan::TableScan table_scan_for_insert(transaction_for_insert, table_name,
+                                          layout);
+    result = table_scan_for_insert.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    insert_result = table_scan_for_insert.Insert();
+    ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+    Result update_result =
+        table_scan_for_insert.Update("field1", data::Int(123));
+    ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+
+    // The scan does not visit the block appended after it began.
+    ResultV<bool> next_result = table_scan_for_check.Next();
+    ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+    EXPECT_FALSE(next_result.Get());
+    EXPECT_EQ(lock_table.TimeoutCount(), 0);
+
+    commit_result = transaction_for_insert.Commit();
+    EXPECT_TRUE(commit_result.IsOk()) << commit_result.Error();
+    commit_result = transaction_for_check.Commit();
+    EXPECT_TRUE(commit_result.IsOk()) << commit_result.Error();
+}
+
+TEST_F(TableScanTest, InsertReusesSlotOfDeletedRow) {
+    const std::string filename = scan::TableFileName(table_name);
+    scan::TableScan table_scan(transaction, table_name, layout);
+    Result result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // The block has only one slot, so each insert fills a block, and the
+    // blocks are appended in a batch.
+    for (int i = 0; i < 3; i++) {
+        Result insert_result = table_scan.Insert();
+        ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+        Result update_result = table_scan.Update("field1", data::Int(i));
+        ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+    }
+    const size_t size = data_disk_manager.Size(filename).Get();
+    EXPECT_GT(size, 3);
+
+    // Delete the second row, and after the delete commits, the insert goes to
+    // its slot without appending blocks.
+    result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    ResultV<bool> next_result = table_scan.Next();
+    ASSERT_TRUE(next_result.IsOk() && next_result.Get());
+    Result delete_result = table_scan.Delete();
+    ASSERT_TRUE(delete_result.IsOk()) << delete_result.Error();
+    Result commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+    Result insert_result = table_scan.Insert();
+    ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+    Result update_result = table_scan.Update("field1", data::Int(3));
+    ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+    EXPECT_EQ(data_disk_manager.Size(filename).Get(), size);
+
+    commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+    scan::TableScan table_scan_for_check(transaction_for_check, table_name,
+                                         layout);
+    result = table_scan_for_check.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    std::vector<int> values;
+    while (true) {
+        ResultV<int> value = table_scan_for_check.GetInt("field1");
+        ASSERT_TRUE(value.IsOk()) << value.Error();
+        values.push_back(value.Get());
+        next_result = table_scan_for_check.Next();
+        ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+        if (!next_result.Get()) break;
+    }
+    EXPECT_EQ(values, std::vector<int>({0, 3, 2}));
+}
+
+class BitmapTableScanTest : public TableScanTest {
+  protected:
+    // A row has only one byte, so a block has 7 slots and a bitmap of one
+    // byte.
+    schema::Layout small_layout = schema::Layout(schema::Schema({
+        schema::Field("field1", data::TypeChar(1)),
+    }));
+};
+
+TEST_F(BitmapTableScanTest, ScanVisitsOnlyUsedSlots) {
+    scan::TableScan table_scan(transaction, table_name, small_layout);
+    Result result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    for (int i = 0; i < 10; i++) {
+        Result insert_result = table_scan.Insert();
+        ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+        Result update_result =
+            table_scan.Update("field1", data::Char(std::to_string(i), 1));
+        ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+    }
+
+    // Delete the odd rows.
+    result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    for (int i = 0; i < 10; i++) {
+        if (i % 2 == 1) {
+            Result delete_result = table_scan.Delete();
+            ASSERT_TRUE(delete_result.IsOk()) << delete_result.Error();
+        }
+        ResultV<bool> next_result = table_scan.Next();
+        ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+        EXPECT_EQ(next_result.Get(), i < 9);
+    }
+    Result commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+
+    scan::TableScan table_scan_for_check(transaction_for_check, table_name,
+                                         small_layout);
+    result = table_scan_for_check.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    std::vector<std::string> values;
+    while (true) {
+        ResultV<std::string> value = table_scan_for_check.GetChar("field1");
+        ASSERT_TRUE(value.IsOk()) << value.Error();
+        values.push_back(value.Get());
+        ResultV<bool> next_result = table_scan_for_check.Next();
+        ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+        if (!next_result.Get()) break;
+    }
+    EXPECT_EQ(values, std::vector<std::string>({"0", "2", "4", "6", "8"}));
+}
+
+TEST_F(BitmapTableScanTest, RollbackKeepsBitsOfOtherTransactions) {
+    scan::TableScan table_scan(transaction, table_name, small_layout);
+    Result result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // The other transaction inserts a row into the first slot, and this
+    // transaction inserts a row into the second slot of the same block, so
+    // both of them set bits of the same byte of the bitmap.
+    transaction::Transaction transaction_for_rollback(
+        data_disk_manager, buffer_manager, log_manager, lock_table,
+        version_store, free_space_map);
+    scan::TableScan table_scan_for_rollback(transaction_for_rollback,
+                                            table_name, small_layout);
+    result = table_scan_for_rollback.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    Result update_result =
+        table_scan_for_rollback.Update("field1", data::Char("a", 1));
+    ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+
+    Result insert_result = table_scan.Insert();
+    ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+    update_result = table_scan.Update("field1", data::Char("b", 1));
+    ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+
+    Result rollback_result = transaction_for_rollback.Rollback();
+    ASSERT_TRUE(rollback_result.IsOk()) << rollback_result.Error();
+    Result commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+
+    scan::TableScan table_scan_for_check(transaction_for_check, table_name,
+                                         small_layout);
+    result = table_scan_for_check.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    ResultV<std::string> value = table_scan_for_check.GetChar("field1");
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), "b");
+    ResultV<bool> next_result = table_scan_for_check.Next();
+    ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+    EXPECT_FALSE(next_result.Get());
+}
+
+TEST_F(BitmapTableScanTest, ScanWaitsForUncommittedDelete) {
+    scan::TableScan table_scan(transaction, table_name, small_layout);
+    Result result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    for (const std::string value : {"a", "b"}) {
+        Result insert_result = table_scan.Insert();
+        ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+        Result update_result =
+            table_scan.Update("field1", data::Char(value, 1));
+        ASSERT_TRUE(update_result.IsOk()) << update_result.Error();
+    }
+    Result commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+
+    // The second row, which a scan finds in the occupancy bitmap, is deleted,
+    // but the delete is not committed yet.
+    result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    ResultV<bool> next_result = table_scan.Next();
+    ASSERT_TRUE(next_result.IsOk() && next_result.Get());
+    Result delete_result = table_scan.Delete();
+    ASSERT_TRUE(delete_result.IsOk()) << delete_result.Error();
+
+    // The scan waits for the lock of the deleted row, and finds it after the
+    // delete rolls back.
+    std::vector<std::string> values;
+    std::thread scan([&] {
+        scan::TableScan table_scan_for_check(transaction_for_check,
+                                             table_name, small_layout);
+        Result init_result = table_scan_for_check.Init();
+        ASSERT_TRUE(init_result.IsOk()) << init_result.Error();
+        while (true) {
+            ResultV<std::string> value =
+                table_scan_for_check.GetChar("field1");
+            ASSERT_TRUE(value.IsOk()) << value.Error();
+            values.push_back(value.Get());
+            ResultV<bool> next_result = table_scan_for_check.Next();
+            ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+            if (!next_result.Get()) break;
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Result rollback_result = transaction.Rollback();
+    ASSERT_TRUE(rollback_result.IsOk()) << rollback_result.Error();
+    scan.join();
+    EXPECT_EQ(values, std::vector<std::string>({"a", "b"}));
+    EXPECT_EQ(lock_table.TimeoutCount(), 0);
+}
+
+TEST_F(BitmapTableScanTest, ConcurrentInsertsDoNotAbortEachOther) {
+    // The table is created in advance, so that the inserts look for free
+    // slots in the same block.
+    scan::TableScan table_scan(transaction, table_name, small_layout);
+    Result result = table_scan.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    Result insert_result = table_scan.Insert();
+    ASSERT_TRUE(insert_result.IsOk()) << insert_result.Error();
+    Result commit_result = transaction.Commit();
+    ASSERT_TRUE(commit_result.IsOk()) << commit_result.Error();
+
+    const int thread_count = 4, insert_count = 50;
+    auto insert_rows = [&](const char value, int &ok_count) {
+        for (int i = 0; i < insert_count; i++) {
+            transaction::Transaction transaction_for_insert(
+                data_disk_manager, buffer_manager, log_manager, lock_table,
+                version_store, free_space_map);
+            scan::TableScan table_scan_for_insert(transaction_for_insert,
+                                                  table_name, small_layout);
+            if (table_scan_for_insert.Init().IsError() ||
+                table_scan_for_insert.Insert().IsError() ||
+                table_scan_for_insert
+                    .Update("field1", data::Char(std::string(1, value), 1))
+                    .IsError() ||
+                transaction_for_insert.Commit().IsError())
+                continue;
+            ok_count++;
+        }
+    };
+    std::vector<int> ok_counts(thread_count, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back(insert_rows, 'a' + i, std::ref(ok_counts[i]));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(ok_counts, std::vector<int>(thread_count, insert_count));
+    EXPECT_EQ(lock_table.DeadlockCount(), 0);
+
+    scan::TableScan table_scan_for_check(transaction_for_check, table_name,
+                                         small_layout);
+    result = table_scan_for_check.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    int row_count = 0;
+    while (true) {
+        row_count++;
+        ResultV<bool> next_result = table_scan_for_check.Next();
+        ASSERT_TRUE(next_result.IsOk()) << next_result.Error();
+        if (!next_result.Get()) break;
+    }
+    EXPECT_EQ(row_count, 1 + thread_count * insert_count);
+}
@@ -1,5 +1,8 @@
 #include "buffer.h"
+#include <algorithm>
 #include <atomic>
+#include <limits>
+#include <mutex>
 #include <set>
 
 namespace buffer {
@@ -15,6 +18,25 @@ Buffer::Buffer() : block_id_(disk::BlockID("", 0)), block_(disk::Block()) {}
 Buffer::Buffer(const disk::BlockID &block_id, const disk::Block &block)
     : block_id_(block_id), block_(block), access_time_(CurrentTime()) {}
 
+Buffer::Buffer(const Buffer &other)
+    : latest_lsn_(other.latest_lsn_.load()),
+      recovery_lsn_(other.recovery_lsn_.load()),
+      modification_count_(other.modification_count_.load()),
+      block_id_(other.block_id_),
+      block_(other.block_), access_time_(other.access_time_.load()),
+      dirty_(other.dirty_.load()) {}
+
+Buffer &Buffer::operator=(const Buffer &other) {
+    latest_lsn_         = other.latest_lsn_.load();
+    recovery_lsn_       = other.recovery_lsn_.load();
+    modification_count_ = other.modification_count_.load();
+    block_id_           = other.block_id_;
+    block_              = other.block_;
+    access_time_        = other.access_time_.load();
+    dirty_              = other.dirty_.load();
+    return *this;
+}
+
 const disk::BlockID &Buffer::BlockID() const { return block_id_; }
 
 const disk::Block &Buffer::Block() {
@@ -24,26 +46,183 @@ const disk::Block &Buffer::Block() {
 
 void Buffer::SetBlock(const disk::Block &block,
                       const dblog::LogSequenceNumber lsn) {
+    std::lock_guard<std::shared_mutex> lock(latch_);
     access_time_ = CurrentTime();
     block_       = block;
-    if (lsn > latest_lsn_) latest_lsn_ = lsn;
+    MarkDirty(lsn);
 }
 
-BufferManager::BufferManager(disk::DiskManager &disk_manager,
-                             dblog::LogManager &log_manager)
-    : disk_manager_(disk_manager), log_manager_(log_manager) {}
+dblog::LogSequenceNumber Buffer::PageLogSequenceNumber() const {
+    std::vector<uint8_t> header;
+    if (block_.ReadBytes(0, kPageHeaderSize, header).IsError())
+        return dblog::kNullLogSequenceNumber;
 
-Result BufferManager::Read(const disk::BlockID &block_id, disk::Block &block) {
+    // The header holds the page log sequence number plus one, so that the
+    // zero-filled header of a new block is `kNullLogSequenceNumber`.
+    uint64_t value = 0;
+    for (int i = kPageHeaderSize - 1; i >= 0; i--)
+        value = value << 8 | header[i];
+    return value - 1;
+}
+
+Result Buffer::WriteBytes(const int offset, const std::vector<uint8_t> &bytes,
+                          const size_t bytes_offset, const size_t length,
+                          const dblog::LogSequenceNumber lsn) {
+    std::lock_guard<std::shared_mutex> lock(latch_);
+    access_time_ = CurrentTime();
+    Result write_result =
+        block_.WriteBytesWithOffsetLength(offset, bytes, bytes_offset, length);
+    if (write_result.IsError())
+        return write_result + Error("buffer::Buffer::WriteBytes() failed to "
+                                    "write bytes to the block.");
+    Result header_result = UpdatePageLogSequenceNumber(lsn);
+    if (header_result.IsError())
+        return header_result + Error("buffer::Buffer::WriteBytes() failed to "
+                                     "update the page header.");
+    MarkDirty(lsn);
+    return Ok();
+}
+
+Result Buffer::XorBytes(const int offset, const std::vector<uint8_t> &bytes,
+                        const size_t bytes_offset, const size_t length,
+                        const dblog::LogSequenceNumber lsn) {
+    std::lock_guard<std::shared_mutex> lock(latch_);
+    access_time_ = CurrentTime();
+    Result xor_result =
+        block_.XorBytesWithOffsetLength(offset, bytes, bytes_offset, length);
+    if (xor_result.IsError())
+        return xor_result + Error("buffer::Buffer::XorBytes() failed to xor "
+                                  "bytes into the block.");
+    Result header_result = UpdatePageLogSequenceNumber(lsn);
+    if (header_result.IsError())
+        return header_result + Error("buffer::Buffer::XorBytes() failed to "
+                                     "update the page header.");
+    MarkDirty(lsn);
+    return Ok();
+}
+
+Result Buffer::Write(const int offset, const int length,
+                     const data::DataItem &item,
+                     const dblog::LogSequenceNumber lsn) {
+    std::lock_guard<std::shared_mutex> lock(latch_);
+    access_time_        = CurrentTime();
+    Result write_result = block_.Write(offset, length, item);
+    if (write_result.IsError())
+        return write_result + Error("buffer::Buffer::Write() failed to write "
+                                    "the item to the block.");
+    Result header_result = UpdatePageLogSequenceNumber(lsn);
+    if (header_result.IsError())
+        return header_result + Error("buffer::Buffer::Write() failed to "
+                                     "update the page header.");
+    MarkDirty(lsn);
+    return Ok();
+}
+
+void Buffer::MarkDirty(const dblog::LogSequenceNumber lsn) {
+    // `kNullLogSequenceNumber` is the largest, so it never lowers the
+    // recovery lsn.
+    recovery_lsn_ = dirty_ ? std::min(recovery_lsn_.load(), lsn) : lsn;
+    dirty_        = true;
+    modification_count_++;
+    if (lsn != dblog::kNullLogSequenceNumber && lsn > latest_lsn_)
+        latest_lsn_ = lsn;
+}
+
+Result
+Buffer::UpdatePageLogSequenceNumber(const dblog::LogSequenceNumber lsn) {
+    if (lsn == dblog::kNullLogSequenceNumber) return Ok();
+    const dblog::LogSequenceNumber page_lsn = PageLogSequenceNumber();
+    if (page_lsn != dblog::kNullLogSequenceNumber && page_lsn >= lsn)
+        return Ok();
+
+    std::vector<uint8_t> header(kPageHeaderSize);
+    uint64_t value = lsn + 1;
+    for (int i = 0; i < kPageHeaderSize; i++, value >>= 8)
+        header[i] = value & 0xff;
+    return block_.WriteBytes(0, kPageHeaderSize, header);
+}
+
+void Buffer::Pin() {
+    pin_count_++;
+    access_time_ = CurrentTime();
+}
+
+PageGuard::PageGuard(PageGuard &&other) noexcept : buffer_(other.buffer_) {
+    other.buffer_ = nullptr;
+}
+
+PageGuard &PageGuard::operator=(PageGuard &&other) noexcept {
+    if (this != &other) {
+        Release();
+        buffer_       = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+PageGuard::~PageGuard() { Release(); }
+
+void PageGuard::Release() {
+    if (buffer_ != nullptr) {
+        buffer_->Unpin();
+        buffer_ = nullptr;
+    }
+}
+
+BufferManager::BufferManager(const int buffer_size,
+                             disk::DiskManager &disk_manager,
+                             dblog::LogManager &log_manager,
+                             const int shard_count)
+    : disk_manager_(disk_manager), log_manager_(log_manager),
+      buffer_pool_(buffer_size),
+      shards_(std::max(1, std::min(shard_count, buffer_size))) {
+    // The buffers are split as evenly as possible.
+    const int count = shards_.size();
+    for (int i = 0; i < count; i++) {
+        shards_[i].begin = static_cast<int64_t>(buffer_size) * i / count;
+        shards_[i].end   = static_cast<int64_t>(buffer_size) * (i + 1) / count;
+    }
+}
+
+Result BufferManager::Pin(const disk::BlockID &block_id, PageGuard &page) {
     auto buffer_result = FindBufferWithBlockID(block_id);
     if (buffer_result.IsOk()) {
-        block = buffer_result.Get()->Block();
+        hit_count_++;
+        page = PageGuard(buffer_result.Get());
         return Ok();
     }
+    miss_count_++;
+
+    disk::Block block;
     auto result = disk_manager_.Read(block_id, block);
     if (result.IsError()) {
-        return result + Error("buffer::BufferManager::Read() fail to read.");
+        return result + Error("buffer::BufferManager::Pin() fail to read.");
+    }
+
+    // Another thread may have cached (and modified) the block while this
+    // thread was reading it from the disk, in which case the cached buffer is
+    // pinned.
+    auto add_result = AddNewBuffer(Buffer(block_id, block));
+    if (add_result.IsError()) {
+        return add_result +
+               Error("buffer::BufferManager::Pin() fail to cache the block.");
+    }
+    page = PageGuard(add_result.Get());
+    return Ok();
+}
+
+Result BufferManager::Read(const disk::BlockID &block_id, disk::Block &block) {
+    PageGuard page;
+    Result pin_result = Pin(block_id, page);
+    if (pin_result.IsError()) {
+        return pin_result + Error("buffer::BufferManager::Read() fail to pin "
+                                  "the block.");
     }
-    return AddNewBuffer(Buffer(block_id, block));
+    // In-place writes take the latch exclusively, so the block is not copied
+    // while it is modified.
+    std::shared_lock<std::shared_mutex> latch(page.buffer_->Latch());
+    block = page.Block();
+    return Ok();
 }
 
 Result BufferManager::Write(const disk::BlockID &block_id,
@@ -51,33 +230,54 @@ Result BufferManager::Write(const disk::BlockID &block_id,
                             const dblog::LogSequenceNumber lsn) {
     auto buffer_result = FindBufferWithBlockID(block_id);
     if (buffer_result.IsOk()) {
-        buffer_result.Get()->SetBlock(block, lsn);
-        return Ok();
+        hit_count_++;
+    } else {
+        miss_count_++;
+        buffer_result = AddNewBuffer(Buffer(block_id, block));
+        if (buffer_result.IsError()) {
+            return buffer_result + Error("buffer::BufferManager::Write() fail "
+                                         "to cache the block.");
+        }
     }
-    return AddNewBuffer(Buffer(block_id, block));
+    PageGuard page(buffer_result.Get());
+    buffer_result.Get()->SetBlock(block, lsn);
+    return Ok();
 }
 
 Result BufferManager::Flush(const disk::BlockID &block_id) {
     auto buffer_result = FindBufferWithBlockID(block_id);
-    if (buffer_result.IsOk()) { return WriteBuffer(*buffer_result.Get()); }
+    if (buffer_result.IsOk()) {
+        PageGuard page(buffer_result.Get());
+        return WriteBuffer(*buffer_result.Get());
+    }
     return disk_manager_.Flush(block_id.Filename());
 }
 
 Result BufferManager::FlushAll() {
-    std::lock_guard<std::shared_mutex> lock(buffer_pool_mutex_);
-    std::set<std::string> filenames_to_be_flushed;
-
-    for (Buffer &buffer : buffer_pool_) {
-        if (buffer.IsDirty()) {
-            Result write_result = WriteBuffer(buffer);
-            if (write_result.IsError()) {
-                return write_result + Error("buffer::BufferManager::FlushAll() "
-                                            "failed to write.");
+    // The dirty buffers are pinned while the latch of each shard is held, and
+    // written after the latch is released.
+    std::vector<PageGuard> dirty_pages;
+    for (Shard &shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (int i = shard.begin; i < shard.end; i++) {
+            if (buffer_pool_[i].IsDirty()) {
+                buffer_pool_[i].Pin();
+                dirty_pages.push_back(PageGuard(&buffer_pool_[i]));
             }
-            filenames_to_be_flushed.insert(buffer.BlockID().Filename());
         }
     }
 
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::set<std::string> filenames_to_be_flushed;
+    for (PageGuard &page : dirty_pages) {
+        Result write_result = WriteBuffer(*page.buffer_, /*sync=*/false);
+        if (write_result.IsError()) {
+            return write_result + Error("buffer::BufferManager::FlushAll() "
+                                        "failed to write.");
+        }
+        filenames_to_be_flushed.insert(page.BlockID().Filename());
+    }
+
     for (const std::string &filename : filenames_to_be_flushed) {
         Result flush_result = disk_manager_.Flush(filename);
         if (flush_result.IsError()) {
@@ -88,90 +288,475 @@ Result BufferManager::FlushAll() {
     return Ok();
 }
 
+ResultV<int> BufferManager::CleanBuffers(const double clean_ratio,
+                                         const int max_count) {
+    const int buffer_size = buffer_pool_.size();
+    const int max_dirty   = buffer_size - buffer_size * clean_ratio;
+    const int clean_count = std::min(DirtyBufferCount() - max_dirty, max_count);
+    if (clean_count <= 0) return Ok(0);
+
+    // Pinned buffers are in use and will likely be modified again soon, so
+    // they are skipped. The buffers with the smallest block ids are written,
+    // so that consecutive batches write the files sequentially.
+    std::vector<PageGuard> dirty_pages;
+    for (Shard &shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (int i = shard.begin; i < shard.end; i++) {
+            if (buffer_pool_[i].IsDirty() && !buffer_pool_[i].IsPinned()) {
+                buffer_pool_[i].Pin();
+                dirty_pages.push_back(PageGuard(&buffer_pool_[i]));
+            }
+        }
+    }
+    std::sort(dirty_pages.begin(), dirty_pages.end(),
+              [](const PageGuard &lhs, const PageGuard &rhs) {
+                  return lhs.BlockID() < rhs.BlockID();
+              });
+    if (static_cast<int>(dirty_pages.size()) > clean_count) {
+        dirty_pages.resize(clean_count);
+    }
+
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::set<std::string> filenames_to_be_flushed;
+    for (PageGuard &page : dirty_pages) {
+        Result write_result = WriteBuffer(*page.buffer_, /*sync=*/false);
+        if (write_result.IsError()) {
+            return write_result + Error("buffer::BufferManager::CleanBuffers() "
+                                        "failed to write.");
+        }
+        filenames_to_be_flushed.insert(page.BlockID().Filename());
+    }
+    for (const std::string &filename : filenames_to_be_flushed) {
+        Result flush_result = disk_manager_.Flush(filename);
+        if (flush_result.IsError()) {
+            return flush_result + Error("buffer::BufferManager::CleanBuffers() "
+                                        "failed to flush.");
+        }
+    }
+    return Ok(static_cast<int>(dirty_pages.size()));
+}
+
+int BufferManager::DirtyBufferCount() const {
+    int count = 0;
+    for (const Buffer &buffer : buffer_pool_) {
+        if (buffer.IsDirty()) count++;
+    }
+    return count;
+}
+
+std::vector<DirtyPage> BufferManager::DirtyPageTable() {
+    // A transaction pins a page before it writes the log record of a
+    // modification, and keeps the page pinned and the update latch held until
+    // the modification is applied. Thus the pinned buffers are latched too, so
+    // that a modification logged before the checkpoint began is not missed
+    // while the page is still clean. The buffers are pinned while the latch of
+    // each shard is held, and latched after the latch is released.
+    //
+    // The buffers written by `FlushAll()` or `CleanBuffers()` are marked clean
+    // before their files are flushed, so the table is built after those files
+    // are flushed. Otherwise the redo point could pass the log records of a
+    // page which is not on disk yet.
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::vector<PageGuard> pages;
+    for (Shard &shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (int i = shard.begin; i < shard.end; i++) {
+            if (buffer_pool_[i].IsDirty() || buffer_pool_[i].IsPinned()) {
+                buffer_pool_[i].Pin();
+                pages.push_back(PageGuard(&buffer_pool_[i]));
+            }
+        }
+    }
+
+    std::vector<DirtyPage> dirty_pages;
+    for (PageGuard &page : pages) {
+        Buffer &buffer = *page.buffer_;
+        std::lock_guard<std::mutex> update_latch(buffer.UpdateLatch());
+        std::shared_lock<std::shared_mutex> latch(buffer.Latch());
+        if (buffer.IsDirty() && buffer.RecoveryLogSequenceNumber() !=
+                                    dblog::kNullLogSequenceNumber) {
+            dirty_pages.push_back(DirtyPage{
+                buffer.BlockID(), buffer.RecoveryLogSequenceNumber()});
+        }
+    }
+    return dirty_pages;
+}
+
+int BufferManager::ShardID(const disk::BlockID &block_id) const {
+    return std::hash<disk::BlockID>()(block_id) % shards_.size();
+}
+
 ResultV<Buffer *>
 BufferManager::FindBufferWithBlockID(const disk::BlockID &block_id) {
-    std::shared_lock<std::shared_mutex> lock(buffer_pool_mutex_);
-    for (auto &buffer : buffer_pool_) {
-        if (buffer.BlockID() == block_id) { return Ok(&buffer); }
+    const int shard_id = ShardID(block_id);
+    Shard &shard       = shards_[shard_id];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.page_table.find(block_id);
+    if (it != shard.page_table.end()) {
+        // The buffer is pinned while the latch of the shard is held so that
+        // it is not evicted before the caller uses it.
+        buffer_pool_[it->second].Pin();
+        RecordAccess(shard_id, it->second);
+        return Ok(&buffer_pool_[it->second]);
     }
     return Error("buffer::BufferManager::FindBufferWithBlockID() no buffer "
                  "with the block_id.");
 }
 
-Result BufferManager::WriteBuffer(Buffer &buffer) {
+Result BufferManager::WriteBuffer(Buffer &buffer, const bool sync) {
     // To make sure that the corresponding log is written to disk,
-    // flush the log file first and then write the block to disk.
-    auto log_result = log_manager_.Flush(buffer.LatestLogSequenceNumber());
-    if (log_result.IsError())
-        return log_result +
-               Error(
-                   "buffer::BufferManager::WriteBuffer() failed to flush log.");
-
-    auto write_result = disk_manager_.Write(buffer.BlockID(), buffer.Block());
+    // flush the log file first and then write the block to disk. No latch is
+    // held during the I/O, so that the writers of the block do not wait for
+    // it; the block is copied with the latch held, and the log is flushed
+    // again if the block was modified by a later log record meanwhile.
+    dblog::LogSequenceNumber flushed_lsn = buffer.LatestLogSequenceNumber();
+    disk::Block block;
+    uint64_t modification_count;
+    while (true) {
+        auto log_result = log_manager_.Flush(flushed_lsn);
+        if (log_result.IsError())
+            return log_result + Error("buffer::BufferManager::WriteBuffer() "
+                                      "failed to flush log.");
+
+        std::shared_lock<std::shared_mutex> latch(buffer.Latch());
+        const dblog::LogSequenceNumber latest_lsn =
+            buffer.LatestLogSequenceNumber();
+        if (latest_lsn <= flushed_lsn) {
+            block              = buffer.Block();
+            modification_count = buffer.ModificationCount();
+            break;
+        }
+        flushed_lsn = latest_lsn;
+    }
+
+    auto write_result = disk_manager_.Write(buffer.BlockID(), block);
     if (write_result.IsError())
         return write_result +
                Error("buffer::BufferManager::WriteBuffer() failed to write.");
 
-    auto flush_result = disk_manager_.Flush(buffer.BlockID().Filename());
-    if (flush_result.IsError())
-        return flush_result +
-               Error("buffer::BufferManager::WriteBuffer() failed to flush.");
+    if (sync) {
+        auto flush_result = disk_manager_.Flush(buffer.BlockID().Filename());
+        if (flush_result.IsError())
+            return flush_result +
+                   Error("buffer::BufferManager::WriteBuffer() failed to "
+                         "flush.");
+    }
+
+    // Writers take the latch exclusively, so the block is clean unless it was
+    // modified after it was copied.
+    std::shared_lock<std::shared_mutex> latch(buffer.Latch());
+    if (buffer.ModificationCount() == modification_count) buffer.MarkClean();
     return Ok();
 }
 
-Result BufferManager::AddNewBuffer(const Buffer &buffer) {
-    std::lock_guard<std::shared_mutex> lock(buffer_pool_mutex_);
+ResultV<Buffer *> BufferManager::AddNewBuffer(const Buffer &buffer) {
+    const int shard_id = ShardID(buffer.BlockID());
+    Shard &shard       = shards_[shard_id];
 
-    ResultV<int> evicted_buffer_id = SelectEvictBufferID();
-    if (evicted_buffer_id.IsError()) {
-        return evicted_buffer_id +
-               Error("buffer::BufferManager::AddNewBuffer() "
-                     "failed to select evict buffer.");
-    }
+    while (true) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
 
-    Buffer &evicted_buffer = buffer_pool_[evicted_buffer_id.Get()];
-    if (evicted_buffer.IsDirty()) {
-        Result write_result = WriteBuffer(evicted_buffer);
-        if (write_result.IsError()) {
-            return write_result + Error("buffer::BufferManager::AddNewBuffer() "
-                                        "failed to write buffer.");
+        auto cached = shard.page_table.find(buffer.BlockID());
+        if (cached != shard.page_table.end()) {
+            buffer_pool_[cached->second].Pin();
+            RecordAccess(shard_id, cached->second);
+            return Ok(&buffer_pool_[cached->second]);
         }
-    }
 
-    buffer_pool_[evicted_buffer_id.Get()] = buffer;
-    return Ok();
+        ResultV<int> evicted_buffer_id = SelectEvictBufferID(shard_id);
+        if (evicted_buffer_id.IsError()) {
+            return evicted_buffer_id +
+                   Error("buffer::BufferManager::AddNewBuffer() "
+                         "failed to select evict buffer.");
+        }
+
+        Buffer &evicted_buffer = buffer_pool_[evicted_buffer_id.Get()];
+        if (evicted_buffer.IsDirty()) {
+            // The victim is written back without holding the latch of the
+            // shard, so that the other threads can use the shard meanwhile.
+            // It is pinned so as not to be evicted by another thread, and a
+            // victim is selected again after that since the victim may be
+            // accessed (or even modified) during the write.
+            evicted_buffer.Pin();
+            PageGuard page(&evicted_buffer);
+            lock.unlock();
+            dirty_eviction_count_++;
+            Result write_result = WriteBuffer(evicted_buffer);
+            if (write_result.IsError()) {
+                return write_result +
+                       Error("buffer::BufferManager::AddNewBuffer() "
+                             "failed to write buffer.");
+            }
+            continue;
+        }
+
+        RecordEviction(shard_id, evicted_buffer_id.Get());
+        shard.page_table.erase(evicted_buffer.BlockID());
+        evicted_buffer                     = buffer;
+        shard.page_table[buffer.BlockID()] = evicted_buffer_id.Get();
+        evicted_buffer.Pin();
+        RecordLoad(shard_id, evicted_buffer_id.Get());
+        return Ok(&evicted_buffer);
+    }
 }
 
 SimpleBufferManager::SimpleBufferManager(const int buffer_size,
                                          disk::DiskManager &disk_manager,
-                                         dblog::LogManager &log_manager)
-    : BufferManager(disk_manager, log_manager) {
-    buffer_pool_.resize(buffer_size);
-}
+                                         dblog::LogManager &log_manager,
+                                         const int shard_count)
+    : BufferManager(buffer_size, disk_manager, log_manager, shard_count) {}
 
 const std::vector<Buffer> &SimpleBufferManager::BufferPool() const {
     return buffer_pool_;
 }
 
-ResultV<int> SimpleBufferManager::SelectEvictBufferID() { return Ok(0); }
+ResultV<int> SimpleBufferManager::SelectEvictBufferID(const int shard_id) {
+    const Shard &shard = GetShard(shard_id);
+    for (int i = shard.begin; i < shard.end; i++) {
+        if (!buffer_pool_[i].IsPinned()) return Ok(i);
+    }
+    return kAllBuffersPinned;
+}
 
 LRUBufferManager::LRUBufferManager(const int buffer_size,
                                    disk::DiskManager &disk_manager,
-                                   dblog::LogManager &log_manager)
-    : BufferManager(disk_manager, log_manager) {
-    buffer_pool_.resize(buffer_size);
+                                   dblog::LogManager &log_manager,
+                                   const int shard_count)
+    : BufferManager(buffer_size, disk_manager, log_manager, shard_count),
+      states_(ShardCount()), positions_(buffer_size) {
+    for (int shard_id = 0; shard_id < ShardCount(); shard_id++) {
+        const Shard &shard      = GetShard(shard_id);
+        std::list<int> &recency = states_[shard_id].recency_list;
+        for (int i = shard.begin; i < shard.end; i++) {
+            positions_[i] = recency.insert(recency.end(), i);
+        }
+    }
+}
+
+ResultV<int> LRUBufferManager::SelectEvictBufferID(const int shard_id) {
+    // Pinned buffers are skipped. They are usually few and close to the front
+    // of the list, since they have just been accessed.
+    const std::list<int> &recency = states_[shard_id].recency_list;
+    for (auto it = recency.rbegin(); it != recency.rend(); it++) {
+        if (!buffer_pool_[*it].IsPinned()) return Ok(*it);
+    }
+    return kAllBuffersPinned;
+}
+
+void LRUBufferManager::RecordAccess(const int shard_id, const int buffer_id) {
+    std::lock_guard<std::mutex> lock(states_[shard_id].mutex);
+    MoveToFront(shard_id, buffer_id);
+}
+
+void LRUBufferManager::RecordLoad(const int shard_id, const int buffer_id) {
+    std::lock_guard<std::mutex> lock(states_[shard_id].mutex);
+    MoveToFront(shard_id, buffer_id);
+}
+
+void LRUBufferManager::MoveToFront(const int shard_id, const int buffer_id) {
+    std::list<int> &recency = states_[shard_id].recency_list;
+    recency.splice(recency.begin(), recency, positions_[buffer_id]);
+}
+
+ClockBufferManager::ClockBufferManager(const int buffer_size,
+                                       disk::DiskManager &disk_manager,
+                                       dblog::LogManager &log_manager,
+                                       const int shard_count)
+    : BufferManager(buffer_size, disk_manager, log_manager, shard_count),
+      reference_bits_(new std::atomic<bool>[buffer_size]),
+      clock_hands_(ShardCount()) {
+    for (int i = 0; i < buffer_size; i++) {
+        reference_bits_[i] = false;
+    }
+    for (int shard_id = 0; shard_id < ShardCount(); shard_id++) {
+        clock_hands_[shard_id] = GetShard(shard_id).begin;
+    }
+}
+
+ResultV<int> ClockBufferManager::SelectEvictBufferID(const int shard_id) {
+    const Shard &shard = GetShard(shard_id);
+    int &clock_hand    = clock_hands_[shard_id];
+
+    // After one round every reference bit of unpinned buffers is cleared, so
+    // two rounds are enough to find a victim if there is.
+    for (int i = 0; i < 2 * (shard.end - shard.begin); i++) {
+        const int buffer_id = clock_hand;
+        clock_hand          = clock_hand + 1 < shard.end ? clock_hand + 1
+                                                         : shard.begin;
+        if (buffer_pool_[buffer_id].IsPinned()) continue;
+        if (reference_bits_[buffer_id].exchange(false)) continue;
+        return Ok(buffer_id);
+    }
+    return kAllBuffersPinned;
 }
 
-ResultV<int> LRUBufferManager::SelectEvictBufferID() {
-    int evict_buffer_id = 0;
-    int min_access_time = buffer_pool_[0].AccessTime();
-    for (int i = 1; i < buffer_pool_.size(); i++) {
-        if (buffer_pool_[i].AccessTime() < min_access_time) {
-            min_access_time = buffer_pool_[i].AccessTime();
-            evict_buffer_id = i;
+void ClockBufferManager::RecordAccess(const int shard_id,
+                                      const int buffer_id) {
+    reference_bits_[buffer_id].store(true, std::memory_order_relaxed);
+}
+
+void ClockBufferManager::RecordLoad(const int shard_id, const int buffer_id) {
+    reference_bits_[buffer_id].store(true, std::memory_order_relaxed);
+}
+
+TwoQueueBufferManager::TwoQueueBufferManager(const int buffer_size,
+                                             disk::DiskManager &disk_manager,
+                                             dblog::LogManager &log_manager,
+                                             const double a1in_ratio,
+                                             const double a1out_ratio,
+                                             const int shard_count)
+    : BufferManager(buffer_size, disk_manager, log_manager, shard_count),
+      states_(ShardCount()), queue_of_(buffer_size, Queue::kFree),
+      positions_(buffer_size) {
+    for (int shard_id = 0; shard_id < ShardCount(); shard_id++) {
+        const Shard &shard = GetShard(shard_id);
+        ShardState &state  = states_[shard_id];
+        const int size     = shard.end - shard.begin;
+        state.a1in_capacity  = std::max<size_t>(1, size * a1in_ratio);
+        state.a1out_capacity = std::max<size_t>(1, size * a1out_ratio);
+        for (int i = shard.begin; i < shard.end; i++) {
+            positions_[i] = state.free.insert(state.free.end(), i);
+        }
+    }
+}
+
+ResultV<int> TwoQueueBufferManager::SelectEvictBufferID(const int shard_id) {
+    const ShardState &state = states_[shard_id];
+    for (const int buffer_id : state.free) {
+        if (!buffer_pool_[buffer_id].IsPinned()) return Ok(buffer_id);
+    }
+
+    // A1in is reclaimed first when it exceeds its share, otherwise the least
+    // recently used buffer in Am is evicted.
+    int buffer_id = -1;
+    if (state.a1in.size() > state.a1in_capacity || state.am.empty()) {
+        buffer_id = UnpinnedTail(state.a1in);
+        if (buffer_id < 0) buffer_id = UnpinnedTail(state.am);
+    } else {
+        buffer_id = UnpinnedTail(state.am);
+        if (buffer_id < 0) buffer_id = UnpinnedTail(state.a1in);
+    }
+    if (buffer_id < 0) return kAllBuffersPinned;
+    return Ok(buffer_id);
+}
+
+void TwoQueueBufferManager::RecordAccess(const int shard_id,
+                                         const int buffer_id) {
+    ShardState &state = states_[shard_id];
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // Accesses to a block in A1in are regarded as correlated references, and
+    // do not change the order.
+    if (queue_of_[buffer_id] == Queue::kAm) {
+        state.am.splice(state.am.begin(), state.am, positions_[buffer_id]);
+    }
+}
+
+void TwoQueueBufferManager::RecordEviction(const int shard_id,
+                                           const int buffer_id) {
+    ShardState &state = states_[shard_id];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    switch (queue_of_[buffer_id]) {
+    case Queue::kFree:
+        state.free.erase(positions_[buffer_id]);
+        break;
+    case Queue::kA1in: {
+        state.a1in.erase(positions_[buffer_id]);
+        const disk::BlockID &block_id = buffer_pool_[buffer_id].BlockID();
+        if (state.a1out_positions.count(block_id) == 0) {
+            state.a1out_positions[block_id] =
+                state.a1out.insert(state.a1out.begin(), block_id);
         }
+        if (state.a1out.size() > state.a1out_capacity) {
+            state.a1out_positions.erase(state.a1out.back());
+            state.a1out.pop_back();
+        }
+        break;
+    }
+    case Queue::kAm:
+        state.am.erase(positions_[buffer_id]);
+        break;
+    }
+}
+
+void TwoQueueBufferManager::RecordLoad(const int shard_id,
+                                       const int buffer_id) {
+    ShardState &state = states_[shard_id];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const disk::BlockID &block_id = buffer_pool_[buffer_id].BlockID();
+    auto ghost                    = state.a1out_positions.find(block_id);
+    if (ghost != state.a1out_positions.end()) {
+        state.a1out.erase(ghost->second);
+        state.a1out_positions.erase(ghost);
+        queue_of_[buffer_id]  = Queue::kAm;
+        positions_[buffer_id] = state.am.insert(state.am.begin(), buffer_id);
+    } else {
+        queue_of_[buffer_id] = Queue::kA1in;
+        positions_[buffer_id] =
+            state.a1in.insert(state.a1in.begin(), buffer_id);
     }
-    return Ok(evict_buffer_id);
 }
 
-} // namespace buffer
\ No newline at end of file
+int TwoQueueBufferManager::UnpinnedTail(const std::list<int> &queue) const {
+    for (auto it = queue.rbegin(); it != queue.rend(); it++) {
+        if (!buffer_pool_[*it].IsPinned()) return *it;
+    }
+    return -1;
+}
+
+LRUKBufferManager::LRUKBufferManager(const int buffer_size,
+                                     disk::DiskManager &disk_manager,
+                                     dblog::LogManager &log_manager,
+                                     const int k, const int shard_count)
+    : BufferManager(buffer_size, disk_manager, log_manager, shard_count),
+      k_(k), states_(ShardCount()), histories_(buffer_size),
+      priority_of_(buffer_size, std::numeric_limits<int64_t>::min()) {
+    for (int shard_id = 0; shard_id < ShardCount(); shard_id++) {
+        const Shard &shard = GetShard(shard_id);
+        for (int i = shard.begin; i < shard.end; i++) {
+            states_[shard_id].priorities.emplace(priority_of_[i], i);
+        }
+    }
+}
+
+ResultV<int> LRUKBufferManager::SelectEvictBufferID(const int shard_id) {
+    for (const auto &[priority, buffer_id] : states_[shard_id].priorities) {
+        if (!buffer_pool_[buffer_id].IsPinned()) return Ok(buffer_id);
+    }
+    return kAllBuffersPinned;
+}
+
+void LRUKBufferManager::RecordAccess(const int shard_id, const int buffer_id) {
+    ShardState &state = states_[shard_id];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    UpdateHistory(state, buffer_id);
+}
+
+void LRUKBufferManager::RecordLoad(const int shard_id, const int buffer_id) {
+    ShardState &state = states_[shard_id];
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // The history of the evicted block is discarded.
+    histories_[buffer_id].clear();
+    UpdateHistory(state, buffer_id);
+}
+
+void LRUKBufferManager::UpdateHistory(ShardState &state, const int buffer_id) {
+    std::vector<uint64_t> &history = histories_[buffer_id];
+    history.push_back(++state.now);
+    if (history.size() > static_cast<size_t>(k_)) {
+        history.erase(history.begin());
+    }
+
+    int64_t priority = history.front();
+    if (history.size() < static_cast<size_t>(k_)) {
+        priority = static_cast<int64_t>(history.back()) +
+                   std::numeric_limits<int64_t>::min();
+    }
+
+    state.priorities.erase({priority_of_[buffer_id], buffer_id});
+    priority_of_[buffer_id] = priority;
+    state.priorities.emplace(priority, buffer_id);
+}
+
+} // namespace buffer
@@ -1,15 +1,32 @@
 #ifndef _TRANSACTION_BUFFER_H
 #define _TRANSACTION_BUFFER_H
 
+#include "data/data.h"
 #include "disk.h"
 #include "log.h"
 #include "result.h"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 using namespace ::result;
 
 namespace buffer {
 
+// Every block of a data file begins with a page header, which holds the page
+// log sequence number; the log sequence number of the last log record applied
+// to the block. Recovery compares it with a log record to know whether the
+// block already has the modification. The header is written by the in-place
+// writes with log sequence numbers, so the content of a data block starts at
+// `kPageHeaderSize`.
+constexpr int kPageHeaderSize = 8;
+
 // Buffer is a class for managing a block and related metadata for the block
 // like how often the block is accessed and if the block is pinned.
 class Buffer {
@@ -17,6 +34,11 @@ class Buffer {
     Buffer();
     Buffer(const disk::BlockID &block_id, const disk::Block &block);
 
+    // Copies the block and the metadata of `other`. The pin count and the
+    // latch are not copied; the new buffer is unpinned.
+    Buffer(const Buffer &other);
+    Buffer &operator=(const Buffer &other);
+
     // Returns block_id of the owned block.
     const disk::BlockID &BlockID() const;
 
@@ -31,25 +53,211 @@ class Buffer {
         return latest_lsn_;
     }
 
-    // Returns true if the block is dirty (modified).
-    bool IsDirty() const { return block_id_.Filename() != ""; }
+    // Log sequence number of the first modification of the block after it
+    // became dirty. If the block is clean or modified only without log
+    // records, returns `kNullLogSequenceNumber`.
+    dblog::LogSequenceNumber RecoveryLogSequenceNumber() const {
+        return recovery_lsn_;
+    }
+
+    // Returns the page log sequence number in the header of the block. A block
+    // which has never been modified with a log record (e.g. a new block)
+    // returns `kNullLogSequenceNumber`.
+    dblog::LogSequenceNumber PageLogSequenceNumber() const;
 
-    // Set the block with a log sequence number.
+    // Returns true if the block is dirty (modified after it was read from or
+    // written to disk).
+    inline bool IsDirty() const { return dirty_; }
+
+    // Returns the number of the modifications of the block. A copy of the
+    // block written to disk is up to date if the count has not changed since
+    // the copy was taken.
+    inline uint64_t ModificationCount() const { return modification_count_; }
+
+    // Marks the block clean. This method should be called while the latch is
+    // held, after the block is written to disk.
+    inline void MarkClean() {
+        dirty_        = false;
+        recovery_lsn_ = dblog::kNullLogSequenceNumber;
+    }
+
+    // Set the block with a log sequence number. The buffer becomes dirty. A
+    // modification which is not logged (e.g. undo of a rollback) passes
+    // `kNullLogSequenceNumber`.
     void SetBlock(const disk::Block &block, const dblog::LogSequenceNumber lsn);
 
+    // Writes `bytes`[`bytes_offset`:`bytes_offset`+`length`] to the block with
+    // `offset` in place, with a log sequence number. Unless `lsn` is
+    // `kNullLogSequenceNumber`, the page log sequence number in the header is
+    // updated.
+    Result WriteBytes(const int offset, const std::vector<uint8_t> &bytes,
+                      const size_t bytes_offset, const size_t length,
+                      const dblog::LogSequenceNumber lsn);
+
+    // XORs `bytes`[`bytes_offset`:`bytes_offset`+`length`] into the block
+    // with `offset` in place, with a log sequence number, in the same way as
+    // `WriteBytes()`.
+    Result XorBytes(const int offset, const std::vector<uint8_t> &bytes,
+                    const size_t bytes_offset, const size_t length,
+                    const dblog::LogSequenceNumber lsn);
+
+    // Writes the `item` of length `length` to the block with `offset` in
+    // place, with a log sequence number. Unless `lsn` is
+    // `kNullLogSequenceNumber`, the page log sequence number in the header is
+    // updated.
+    Result Write(const int offset, const int length, const data::DataItem &item,
+                 const dblog::LogSequenceNumber lsn);
+
+    // Returns the number of the users pinning this buffer.
+    inline int PinCount() const { return pin_count_; }
+
+    // Returns true if someone pins this buffer. Pinned buffers are never
+    // evicted.
+    inline bool IsPinned() const { return pin_count_ > 0; }
+
+    // Pins the buffer and updates the access time.
+    void Pin();
+
+    // Unpins the buffer.
+    inline void Unpin() { pin_count_--; }
+
+    // Latch which protects the content of the block. In-place writes take the
+    // latch exclusively and the copies written to disk are taken with it
+    // shared, so that a torn block is never written to disk.
+    inline std::shared_mutex &Latch() { return latch_; }
+
+    // Latch which orders the logged modifications of the block. A transaction
+    // holds it from writing the log record of a modification until the
+    // modification is applied, so that the modifications of different records
+    // of the block are applied in the order of their log sequence numbers.
+    inline std::mutex &UpdateLatch() { return update_latch_; }
+
   private:
-    dblog::LogSequenceNumber latest_lsn_;
+    // Marks the block dirty by the modification of `lsn`. This method should
+    // be called while the latch is held.
+    void MarkDirty(const dblog::LogSequenceNumber lsn);
+
+    // Writes `lsn` to the page header if it is larger than the page log
+    // sequence number. This method should be called while the latch is held.
+    Result UpdatePageLogSequenceNumber(const dblog::LogSequenceNumber lsn);
+
+    // The log sequence numbers and the modification count are atomic since
+    // they are read or written while the latch is not held exclusively.
+    std::atomic<dblog::LogSequenceNumber> latest_lsn_   = 0;
+    std::atomic<dblog::LogSequenceNumber> recovery_lsn_ =
+        dblog::kNullLogSequenceNumber;
+    std::atomic<uint64_t> modification_count_ = 0;
     disk::BlockID block_id_;
     disk::Block block_;
-    int access_time_ = 0;
+    std::atomic<int> access_time_ = 0;
+    std::atomic<int> pin_count_   = 0;
+    std::atomic<bool> dirty_      = false;
+    std::shared_mutex latch_;
+    std::mutex update_latch_;
+};
+
+// PageGuard pins a buffer in the buffer pool while it is alive, and gives
+// access to the block in the buffer without copying it. The buffer is
+// unpinned when the guard is destroyed or released. A PageGuard is obtained
+// by `BufferManager::Pin()`.
+class PageGuard {
+  public:
+    inline PageGuard() {}
+    PageGuard(PageGuard &&other) noexcept;
+    PageGuard &operator=(PageGuard &&other) noexcept;
+    PageGuard(const PageGuard &other)            = delete;
+    PageGuard &operator=(const PageGuard &other) = delete;
+    ~PageGuard();
+
+    // Returns true if this guard pins a buffer.
+    inline bool IsValid() const { return buffer_ != nullptr; }
+
+    // Returns block_id of the pinned block. The guard must be valid.
+    inline const disk::BlockID &BlockID() const { return buffer_->BlockID(); }
+
+    // Returns the pinned block in place. The guard must be valid. The caller
+    // must hold the update latch or the latch of the buffer while reading
+    // bytes which may be modified concurrently.
+    inline const disk::Block &Block() const { return buffer_->Block(); }
+
+    // Returns the page log sequence number of the pinned block. The guard
+    // must be valid.
+    inline dblog::LogSequenceNumber PageLogSequenceNumber() const {
+        return buffer_->PageLogSequenceNumber();
+    }
+
+    // Writes `bytes`[`bytes_offset`:`bytes_offset`+`length`] to the pinned
+    // block with `offset`. `lsn` is the log sequence number of the log record
+    // of this modification. The guard must be valid.
+    inline Result WriteBytes(const int offset,
+                             const std::vector<uint8_t> &bytes,
+                             const size_t bytes_offset, const size_t length,
+                             const dblog::LogSequenceNumber lsn) {
+        return buffer_->WriteBytes(offset, bytes, bytes_offset, length, lsn);
+    }
+
+    // XORs `bytes`[`bytes_offset`:`bytes_offset`+`length`] into the pinned
+    // block with `offset`. `lsn` is the log sequence number of the log record
+    // of this modification. The guard must be valid.
+    inline Result XorBytes(const int offset, const std::vector<uint8_t> &bytes,
+                           const size_t bytes_offset, const size_t length,
+                           const dblog::LogSequenceNumber lsn) {
+        return buffer_->XorBytes(offset, bytes, bytes_offset, length, lsn);
+    }
+
+    // Writes the `item` of length `length` to the pinned block with `offset`.
+    // `lsn` is the log sequence number of the log record of this
+    // modification. The guard must be valid.
+    inline Result Write(const int offset, const int length,
+                        const data::DataItem &item,
+                        const dblog::LogSequenceNumber lsn) {
+        return buffer_->Write(offset, length, item, lsn);
+    }
+
+    // Returns the update latch of the pinned buffer. The guard must be valid.
+    inline std::mutex &UpdateLatch() const { return buffer_->UpdateLatch(); }
+
+    // Unpins the buffer. After this method is called, the guard is invalid.
+    void Release();
+
+  private:
+    friend class BufferManager;
+
+    // `buffer` must be already pinned. The guard takes over the pin.
+    inline explicit PageGuard(Buffer *buffer) : buffer_(buffer) {}
+
+    Buffer *buffer_ = nullptr;
+};
+
+// An entry of the dirty page table. `recovery_lsn` is the log sequence number
+// of the first modification of the page after it became dirty; the log
+// records before it are already reflected in the page on disk.
+struct DirtyPage {
+    disk::BlockID block_id;
+    dblog::LogSequenceNumber recovery_lsn;
 };
 
 // BufferManager manages the buffer pool and reads and writes blocks to the
 // buffer pool. Eviction policy should be implemented in the derived class.
+//
+// The buffer pool is partitioned into shards by the hash of the block id. Each
+// shard owns a contiguous range of buffers, a page table and a latch, so
+// threads accessing blocks in different shards never contend. Eviction
+// policies also work per shard. A dirty victim is written back to disk without
+// holding the latch of the shard.
 class BufferManager {
   public:
-    explicit BufferManager(disk::DiskManager &disk_manager,
-                           dblog::LogManager &log_manager);
+    // `buffer_size` buffers are split into `shard_count` shards.
+    // `shard_count` is clamped into [1, `buffer_size`].
+    BufferManager(const int buffer_size, disk::DiskManager &disk_manager,
+                  dblog::LogManager &log_manager, const int shard_count = 1);
+    virtual ~BufferManager() = default;
+
+    // Pins the block of `block_id` in the buffer pool and sets `page` to the
+    // guard of the buffer. The block is read from disk when it is not cached.
+    // While `page` is alive, the buffer is never evicted and the block can be
+    // read and written in place through `page`.
+    Result Pin(const disk::BlockID &block_id, PageGuard &page);
 
     // Reads the block of `block_id` from the buffer pool. The block with
     // `block_id` is cached in `buffer_pool_`.
@@ -68,61 +276,296 @@ class BufferManager {
     // Flush the block of `block_id` to disk.
     Result Flush(const disk::BlockID &block_id);
 
-    // Flush all buffers.
+    // Flush all dirty buffers.
     Result FlushAll();
 
+    // Writes dirty and unpinned buffers to disk so that at least
+    // `clean_ratio` of the buffer pool is clean, up to `max_count` buffers at
+    // a time. The buffers are written in the order of the block ids and each
+    // file is flushed once at the end. Returns the number of written buffers.
+    // This method is used by the background page cleaner.
+    ResultV<int> CleanBuffers(const double clean_ratio, const int max_count);
+
+    // Returns the number of accesses which found the block in the buffer pool.
+    inline size_t HitCount() const { return hit_count_; }
+
+    // Returns the number of accesses which did not find the block in the
+    // buffer pool.
+    inline size_t MissCount() const { return miss_count_; }
+
+    // Returns the number of dirty buffers in the buffer pool.
+    int DirtyBufferCount() const;
+
+    // Returns the dirty pages which are modified with log records. This method
+    // does not stop the other threads, so the table is used for a fuzzy
+    // checkpoint. It waits for the modifications in progress, whose log
+    // records may be already written, to be applied.
+    std::vector<DirtyPage> DirtyPageTable();
+
+    // Returns the number of evictions which had to write the victim to disk.
+    inline size_t DirtyEvictionCount() const { return dirty_eviction_count_; }
+
+    // Returns the number of shards.
+    inline int ShardCount() const { return shards_.size(); }
+
+  protected:
+    // Shard is a partition of the buffer pool. The buffers from `begin` to
+    // `end` (exclusive) in `buffer_pool_` belong to the shard.
+    struct Shard {
+        int begin = 0, end = 0;
+
+        // Maps the block id to the index of the buffer in `buffer_pool_` which
+        // caches the block. Guarded by `mutex`.
+        std::unordered_map<disk::BlockID, int> page_table;
+        std::shared_mutex mutex;
+    };
+
+    // Returns the shard of `shard_id`.
+    inline const Shard &GetShard(const int shard_id) const {
+        return shards_[shard_id];
+    }
+
   private:
-    // Find the buffer with the `block_id` and return a pointer to the
+    // Returns the id of the shard which caches the block of `block_id`.
+    int ShardID(const disk::BlockID &block_id) const;
+
+    // Find the buffer with the `block_id`, pin it and return a pointer to the
     // buffer, if there is no buffer with the `block_id`, returns ErrorValue.
+    // The buffer is looked up with the page table of the shard, so this method
+    // takes constant time regardless of the size of the buffer pool.
     // The returned pointer is a mutable reference to the buffer in
     // `buffer_pool_` (NOTE: shared_ptr doesn't work in this case; you cannot
-    // mutate the buffer in `buffer_pool_` with shared_ptr.)
+    // mutate the buffer in `buffer_pool_` with shared_ptr.) The caller must
+    // unpin the buffer.
     ResultV<Buffer *> FindBufferWithBlockID(const disk::BlockID &block_id);
 
     // Writes the buffer to the disk. This method flushes the log file first and
     // then writes the block to the disk, to make sure that the corresponding
-    // log is written to disk.
-    Result WriteBuffer(Buffer &buffer);
+    // log is written to disk. The buffer must be pinned or the latch of its
+    // shard must be held. The latch of the buffer is held only while the block
+    // is copied, not during the I/O. If `sync` is false, the file is not
+    // flushed and the caller must flush it while holding `flush_mutex_`.
+    Result WriteBuffer(Buffer &buffer, const bool sync = true);
 
-    // Add new buffer to the buffer pool. When the buffer poll is full, select a
-    // evicted buffer and swap the content.
-    Result AddNewBuffer(const Buffer &buffer);
+    // Add new buffer to the buffer pool. When the shard is full, select a
+    // evicted buffer and swap the content. If the block of `buffer` has already
+    // been cached (e.g. by another thread), the cached buffer is kept. Returns
+    // the pointer to the buffer which caches the block. The returned buffer is
+    // pinned, and the caller must unpin it.
+    // When the selected buffer is dirty, it is pinned and written back after
+    // the latch of the shard is released, and then a victim is selected again.
+    ResultV<Buffer *> AddNewBuffer(const Buffer &buffer);
 
-    // Selects a buffer to evict in the buffer pool. This method should be
-    // implemented in the derived class.
-    virtual ResultV<int> SelectEvictBufferID() = 0;
+    // Selects a buffer to evict in the shard of `shard_id`. This method should
+    // be implemented in the derived class. The selected buffer must belong to
+    // the shard and must not be pinned. This method is called while the latch
+    // of the shard is exclusively held.
+    virtual ResultV<int> SelectEvictBufferID(const int shard_id) = 0;
+
+    // Called when the buffer of `buffer_id` in the shard of `shard_id` is
+    // accessed and it already caches the block. Eviction policies override
+    // this to track accesses. This method is called while the latch of the
+    // shard is held shared, so it can be called concurrently by multiple
+    // threads.
+    virtual void RecordAccess(const int shard_id, const int buffer_id) {}
+
+    // Called right before the block in the buffer of `buffer_id` is replaced
+    // with a new block. This method is called while the latch of the shard is
+    // exclusively held.
+    virtual void RecordEviction(const int shard_id, const int buffer_id) {}
+
+    // Called right after a new block is loaded into the buffer of `buffer_id`.
+    // This method is called while the latch of the shard is exclusively held.
+    virtual void RecordLoad(const int shard_id, const int buffer_id) {}
 
   protected:
     disk::DiskManager &disk_manager_;
     dblog::LogManager &log_manager_;
     std::vector<Buffer> buffer_pool_;
-    std::shared_mutex buffer_pool_mutex_;
+
+  private:
+    std::vector<Shard> shards_;
+
+    // Serializes the writes which defer flushing files, so that `FlushAll()`
+    // never returns and `DirtyPageTable()` never reads while a buffer marked
+    // clean is not flushed yet.
+    std::mutex flush_mutex_;
+
+    std::atomic<size_t> hit_count_            = 0;
+    std::atomic<size_t> miss_count_           = 0;
+    std::atomic<size_t> dirty_eviction_count_ = 0;
 };
 
+// The error which implies that every buffer in the buffer pool is pinned and no
+// buffer can be evicted.
+const ResultV<int> kAllBuffersPinned =
+    Error("buffer::BufferManager::SelectEvictBufferID() all buffers are "
+          "pinned.");
+
 // SimpleBufferManager is a simple implementation of BufferManager.
 // This class does not implement any eviction policy (just flush the first
-// block).
+// unpinned block).
 class SimpleBufferManager : public BufferManager {
   public:
     SimpleBufferManager(const int buffer_size, disk::DiskManager &disk_manager,
-                        dblog::LogManager &log_manager);
+                        dblog::LogManager &log_manager,
+                        const int shard_count = 1);
 
     const std::vector<Buffer> &BufferPool() const;
 
   private:
-    ResultV<int> SelectEvictBufferID();
+    ResultV<int> SelectEvictBufferID(const int shard_id);
 };
 
 // LRUBufferManager implements the LRU (Least Recently Used) eviction policy.
+// Buffers are kept in a list ordered by the recency of the access, so both an
+// access and an eviction take constant time.
 class LRUBufferManager : public BufferManager {
   public:
     LRUBufferManager(const int buffer_size, disk::DiskManager &disk_manager,
-                     dblog::LogManager &log_manager);
+                     dblog::LogManager &log_manager, const int shard_count = 1);
+
+  private:
+    struct ShardState {
+        // Buffer ids ordered from the most recently used one.
+        std::list<int> recency_list;
+        std::mutex mutex;
+    };
+
+    ResultV<int> SelectEvictBufferID(const int shard_id);
+    void RecordAccess(const int shard_id, const int buffer_id);
+    void RecordLoad(const int shard_id, const int buffer_id);
+
+    // Moves the buffer of `buffer_id` to the front of the recency list.
+    void MoveToFront(const int shard_id, const int buffer_id);
+
+    std::vector<ShardState> states_;
+    std::vector<std::list<int>::iterator> positions_;
+};
+
+// ClockBufferManager implements the CLOCK (second chance) eviction policy.
+// Each buffer has a reference bit which is set when the buffer is accessed.
+// The clock hand sweeps the buffers, clearing reference bits, and evicts the
+// first buffer whose reference bit is not set. An access only sets a bit, so
+// hits never contend on a lock.
+class ClockBufferManager : public BufferManager {
+  public:
+    ClockBufferManager(const int buffer_size, disk::DiskManager &disk_manager,
+                       dblog::LogManager &log_manager,
+                       const int shard_count = 1);
 
   private:
-    ResultV<int> SelectEvictBufferID();
+    ResultV<int> SelectEvictBufferID(const int shard_id);
+    void RecordAccess(const int shard_id, const int buffer_id);
+    void RecordLoad(const int shard_id, const int buffer_id);
+
+    std::unique_ptr<std::atomic<bool>[]> reference_bits_;
+
+    // The clock hand of each shard.
+    std::vector<int> clock_hands_;
+};
+
+// TwoQueueBufferManager implements the 2Q eviction policy (Johnson and Shasha,
+// VLDB 1994). A block loaded for the first time enters the FIFO queue A1in.
+// Only a block which is loaded again while its id is remembered in the ghost
+// queue A1out (i.e. it was evicted from A1in recently) enters the LRU queue Am.
+// Therefore blocks touched only once by a sequential scan are evicted from
+// A1in without pushing the hot blocks in Am out of the buffer pool.
+class TwoQueueBufferManager : public BufferManager {
+  public:
+    // `a1in_ratio` is the ratio of each shard used for A1in and `a1out_ratio`
+    // is the number of block ids remembered in A1out relative to the size of
+    // the shard.
+    TwoQueueBufferManager(const int buffer_size,
+                          disk::DiskManager &disk_manager,
+                          dblog::LogManager &log_manager,
+                          const double a1in_ratio  = 0.25,
+                          const double a1out_ratio = 0.5,
+                          const int shard_count    = 1);
+
+  private:
+    enum class Queue {
+        kFree = 0,
+        kA1in = 1,
+        kAm   = 2,
+    };
+
+    struct ShardState {
+        size_t a1in_capacity = 0, a1out_capacity = 0;
+
+        // Buffers which have never been used.
+        std::list<int> free;
+
+        // The FIFO queue of blocks loaded once, whose front is the newest.
+        std::list<int> a1in;
+
+        // The LRU queue of hot blocks, whose front is the most recently used.
+        std::list<int> am;
+
+        // The ghost FIFO queue of block ids evicted from `a1in`, whose front
+        // is the newest. `a1out_positions` maps the ids to their positions in
+        // `a1out` for constant-time lookups.
+        std::list<disk::BlockID> a1out;
+        std::unordered_map<disk::BlockID, std::list<disk::BlockID>::iterator>
+            a1out_positions;
+
+        std::mutex mutex;
+    };
+
+    ResultV<int> SelectEvictBufferID(const int shard_id);
+    void RecordAccess(const int shard_id, const int buffer_id);
+    void RecordEviction(const int shard_id, const int buffer_id);
+    void RecordLoad(const int shard_id, const int buffer_id);
+
+    // Returns the first unpinned buffer from the tail of `queue`, or -1 if
+    // there is no such buffer.
+    int UnpinnedTail(const std::list<int> &queue) const;
+
+    std::vector<ShardState> states_;
+    std::vector<Queue> queue_of_;
+    std::vector<std::list<int>::iterator> positions_;
+};
+
+// LRUKBufferManager implements the LRU-K eviction policy (O'Neil et al.,
+// SIGMOD 1993). The buffer whose K-th most recent access is the oldest is
+// evicted, and buffers which have been accessed less than K times are evicted
+// first (in the LRU order). A block touched once by a scan therefore never
+// outlives a block which has been accessed K times. The buffers are kept in an
+// ordered set, so an access and an eviction take O(log n) time.
+class LRUKBufferManager : public BufferManager {
+  public:
+    LRUKBufferManager(const int buffer_size, disk::DiskManager &disk_manager,
+                      dblog::LogManager &log_manager, const int k = 2,
+                      const int shard_count = 1);
+
+  private:
+    struct ShardState {
+        uint64_t now = 0;
+
+        // Pairs of the eviction priority and the buffer id, ordered from the
+        // buffer to evict first. The priority of a buffer is the K-th most
+        // recent access time if the buffer has been accessed K times,
+        // otherwise the most recent access time minus 2^63.
+        std::set<std::pair<int64_t, int>> priorities;
+        std::mutex mutex;
+    };
+
+    ResultV<int> SelectEvictBufferID(const int shard_id);
+    void RecordAccess(const int shard_id, const int buffer_id);
+    void RecordLoad(const int shard_id, const int buffer_id);
+
+    // Records an access to the history of `buffer_id` and updates its
+    // eviction priority.
+    void UpdateHistory(ShardState &state, const int buffer_id);
+
+    const int k_;
+    std::vector<ShardState> states_;
+
+    // The last K access times of each buffer, whose front is the oldest.
+    std::vector<std::vector<uint64_t>> histories_;
+    std::vector<int64_t> priority_of_;
 };
 
 } // namespace buffer
 
-#endif // BUFFER_H
\ No newline at end of file
+#endif // BUFFER_H
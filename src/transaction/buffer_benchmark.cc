@@ -0,0 +1,181 @@
+// Compares hit ratios of the eviction policies of BufferManager on a workload
+// which mixes point lookups on a hot set of blocks with full sequential scans,
+// and measures the throughput of concurrent random reads with the buffer pool
+// split into shards.
+//
+// usage: buffer_benchmark [rounds]
+
+#include "buffer.h"
+#include "disk.h"
+#include "log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string kDirectoryPath = "buffer_benchmark_dir/";
+const std::string kDataFilename  = "data";
+const std::string kLogFilename   = "log";
+const int kBlockSize             = 128;
+const int kBlockCount            = 4096;
+const int kBufferSize            = 256;
+const int kHotBlockCount         = 192;
+const int kLookupsPerRound       = 4000;
+const double kHotLookupRatio     = 0.9;
+const int kReadsPerThread        = 20000;
+
+struct Statistics {
+    size_t lookup_hit = 0, lookup_miss = 0, total_hit = 0, total_miss = 0;
+};
+
+// Runs `rounds` rounds of point lookups followed by a full scan.
+Result RunWorkload(buffer::BufferManager &buffer_manager, const int rounds,
+                   Statistics &statistics) {
+    std::mt19937 engine(/*seed=*/42);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<int> hot(0, kHotBlockCount - 1);
+    std::uniform_int_distribution<int> cold(0, kBlockCount - 1);
+    disk::Block block;
+
+    for (int round = 0; round < rounds; round++) {
+        const size_t hit_before  = buffer_manager.HitCount();
+        const size_t miss_before = buffer_manager.MissCount();
+        for (int i = 0; i < kLookupsPerRound; i++) {
+            const int index =
+                coin(engine) < kHotLookupRatio ? hot(engine) : cold(engine);
+            SOLO_TRY(buffer_manager.Read(disk::BlockID(kDataFilename, index),
+                                         block));
+        }
+        statistics.lookup_hit += buffer_manager.HitCount() - hit_before;
+        statistics.lookup_miss += buffer_manager.MissCount() - miss_before;
+
+        for (int index = 0; index < kBlockCount; index++) {
+            SOLO_TRY(buffer_manager.Read(disk::BlockID(kDataFilename, index),
+                                         block));
+        }
+    }
+    statistics.total_hit  = buffer_manager.HitCount();
+    statistics.total_miss = buffer_manager.MissCount();
+    return Ok();
+}
+
+// Runs `thread_count` threads which read random blocks, and returns the number
+// of reads per second.
+double RunConcurrentWorkload(buffer::BufferManager &buffer_manager,
+                             const int thread_count) {
+    std::vector<std::thread> threads;
+    std::atomic<bool> failed = false;
+    const auto start         = std::chrono::steady_clock::now();
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&buffer_manager, &failed, t] {
+            std::mt19937 engine(/*seed=*/t);
+            std::uniform_int_distribution<int> index(0, kBlockCount - 1);
+            disk::Block block;
+            for (int i = 0; i < kReadsPerThread; i++) {
+                const disk::BlockID block_id(kDataFilename, index(engine));
+                if (buffer_manager.Read(block_id, block).IsError()) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (failed) return 0.0;
+    return thread_count * kReadsPerThread / elapsed.count();
+}
+
+double Ratio(const size_t hit, const size_t miss) {
+    return hit + miss == 0 ? 0.0 : static_cast<double>(hit) / (hit + miss);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 10;
+
+    std::filesystem::remove_all(kDirectoryPath);
+    disk::DiskManager disk_manager(kDirectoryPath, kBlockSize);
+    if (disk_manager
+            .AllocateNewBlocks(disk::BlockID(kDataFilename, kBlockCount - 1))
+            .IsError()) {
+        std::cerr << "failed to create the data file." << std::endl;
+        return 1;
+    }
+    dblog::LogManager log_manager(kLogFilename, kDirectoryPath, kBlockSize);
+    if (log_manager.Init().IsError()) {
+        std::cerr << "failed to initialize the log file." << std::endl;
+        return 1;
+    }
+
+    using Factory = std::function<std::unique_ptr<buffer::BufferManager>()>;
+    const std::vector<std::pair<std::string, Factory>> policies = {
+        {"LRU",
+         [&] {
+             return std::make_unique<buffer::LRUBufferManager>(
+                 kBufferSize, disk_manager, log_manager);
+         }},
+        {"CLOCK",
+         [&] {
+             return std::make_unique<buffer::ClockBufferManager>(
+                 kBufferSize, disk_manager, log_manager);
+         }},
+        {"2Q",
+         [&] {
+             return std::make_unique<buffer::TwoQueueBufferManager>(
+                 kBufferSize, disk_manager, log_manager);
+         }},
+        {"LRU-2",
+         [&] {
+             return std::make_unique<buffer::LRUKBufferManager>(
+                 kBufferSize, disk_manager, log_manager, /*k=*/2);
+         }},
+    };
+
+    std::printf("blocks: %d, buffers: %d, hot blocks: %d, rounds: %d\n",
+                kBlockCount, kBufferSize, kHotBlockCount, rounds);
+    std::printf("%-8s %16s %16s\n", "policy", "lookup hit ratio",
+                "total hit ratio");
+    for (const auto &[name, factory] : policies) {
+        std::unique_ptr<buffer::BufferManager> buffer_manager = factory();
+        Statistics statistics;
+        Result result = RunWorkload(*buffer_manager, rounds, statistics);
+        if (result.IsError()) {
+            std::cerr << result.Error() << std::endl;
+            return 1;
+        }
+        std::printf("%-8s %16.3f %16.3f\n", name.c_str(),
+                    Ratio(statistics.lookup_hit, statistics.lookup_miss),
+                    Ratio(statistics.total_hit, statistics.total_miss));
+    }
+
+    std::printf("\nconcurrent random reads (reads/sec), buffers: %d\n",
+                kBufferSize * 4);
+    std::printf("%-8s %12s %12s\n", "threads", "1 shard", "16 shards");
+    for (const int thread_count : {1, 2, 4, 8}) {
+        std::printf("%-8d", thread_count);
+        for (const int shard_count : {1, 16}) {
+            buffer::ClockBufferManager buffer_manager(
+                kBufferSize * 4, disk_manager, log_manager, shard_count);
+            std::printf(" %12.0f",
+                        RunConcurrentWorkload(buffer_manager, thread_count));
+        }
+        std::printf("\n");
+    }
+
+    std::filesystem::remove_all(kDirectoryPath);
+    return 0;
+}
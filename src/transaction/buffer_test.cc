@@ -6,6 +6,8 @@
 #include <fstream>
 #include <gtest/gtest.h>
 #include <string>
+#include <thread>
+#include <vector>
 
 TEST(BufferBlockID, CorrectlyReturnsBlockID) {
     const disk::BlockID block_id("filename", 1);
@@ -29,6 +31,38 @@ TEST(BufferSetBlock, CorrectlySetBlock) {
     EXPECT_EQ(buf.Block().Content(), block.Content());
 }
 
+TEST(BufferPageLogSequenceNumber, LoggedWritesUpdatePageHeader) {
+    buffer::Buffer buf(disk::BlockID("filename", 0),
+                       disk::Block(/*block_size=*/16));
+    EXPECT_EQ(buf.PageLogSequenceNumber(), dblog::kNullLogSequenceNumber);
+
+    const std::vector<uint8_t> value = {'a', 'i'};
+    ASSERT_TRUE(buf.WriteBytes(buffer::kPageHeaderSize, value,
+                               /*bytes_offset=*/0, /*length=*/2, /*lsn=*/0)
+                    .IsOk());
+    EXPECT_EQ(buf.PageLogSequenceNumber(), 0);
+    ASSERT_TRUE(buf.WriteBytes(buffer::kPageHeaderSize, value,
+                               /*bytes_offset=*/0, /*length=*/2,
+                               /*lsn=*/uint64_t(1) << 40)
+                    .IsOk());
+    EXPECT_EQ(buf.PageLogSequenceNumber(), uint64_t(1) << 40);
+
+    // Neither an unlogged write nor an older log record moves the page log
+    // sequence number back.
+    ASSERT_TRUE(buf.WriteBytes(buffer::kPageHeaderSize, value,
+                               /*bytes_offset=*/0, /*length=*/2,
+                               /*lsn=*/dblog::kNullLogSequenceNumber)
+                    .IsOk());
+    ASSERT_TRUE(buf.WriteBytes(buffer::kPageHeaderSize, value,
+                               /*bytes_offset=*/0, /*length=*/2, /*lsn=*/5)
+                    .IsOk());
+    EXPECT_EQ(buf.PageLogSequenceNumber(), uint64_t(1) << 40);
+    std::vector<uint8_t> content;
+    ASSERT_TRUE(
+        buf.Block().ReadBytes(buffer::kPageHeaderSize, 2, content).IsOk());
+    EXPECT_EQ(content, value);
+}
+
 TWO_FILE_EXISTENT_TEST(BufferManagerTest, "hello ", "");
 FILE_NONEXISTENT_TEST(NonExistentFileTest);
 
@@ -183,6 +217,91 @@ TEST_F(NonExistentFileTest, BufferManagerFlushFailWhenThereIsNoBlock) {
     EXPECT_TRUE(buffer_manager.Flush(block_id).IsError());
 }
 
+TEST_F(BufferManagerTest, BufferManagerReadsEvictedBlockAgain) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/3);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/5, disk_manager,
+                                               log_manager);
+    const disk::BlockID block_id0(filename0, 0), block_id1(filename0, 1);
+    disk::Block read_block(3, "xxx");
+
+    ASSERT_TRUE(buffer_manager.Read(block_id0, read_block).IsOk());
+    ASSERT_TRUE(buffer_manager.Read(block_id1, read_block).IsOk());
+
+    // SimpleBufferManager always evicts the first buffer.
+    EXPECT_FALSE(
+        DoesBufferPoolContainTheBlock(buffer_manager.BufferPool(), block_id0));
+    EXPECT_TRUE(
+        DoesBufferPoolContainTheBlock(buffer_manager.BufferPool(), block_id1));
+    auto read_result = buffer_manager.Read(block_id0, read_block);
+    EXPECT_TRUE(read_result.IsOk()) << read_result.Error();
+    std::vector<uint8_t> expect = {'h', 'e', 'l'};
+    EXPECT_EQ(read_block.Content(), expect);
+    EXPECT_TRUE(
+        DoesBufferPoolContainTheBlock(buffer_manager.BufferPool(), block_id0));
+}
+
+TEST_F(BufferManagerTest, BufferManagerPinReturnsBlockInPlace) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/3);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/5, disk_manager,
+                                               log_manager);
+    const disk::BlockID block_id(filename0, 0);
+
+    buffer::PageGuard page;
+    auto pin_result = buffer_manager.Pin(block_id, page);
+
+    ASSERT_TRUE(pin_result.IsOk()) << pin_result.Error();
+    EXPECT_TRUE(page.IsValid());
+    EXPECT_EQ(page.BlockID(), block_id);
+    std::vector<uint8_t> expect = {'h', 'e', 'l'};
+    EXPECT_EQ(page.Block().Content(), expect);
+    EXPECT_EQ(buffer_manager.BufferPool()[0].PinCount(), 1);
+
+    const std::vector<uint8_t> value = {'a', 'i'};
+    ASSERT_TRUE(page.WriteBytes(/*offset=*/1, value, /*bytes_offset=*/0,
+                                /*length=*/2,
+                                /*lsn=*/dblog::kNullLogSequenceNumber)
+                    .IsOk());
+    disk::Block read_block;
+    ASSERT_TRUE(buffer_manager.Read(block_id, read_block).IsOk());
+    expect = {'h', 'a', 'i'};
+    EXPECT_EQ(read_block.Content(), expect);
+
+    page.Release();
+    EXPECT_FALSE(page.IsValid());
+    EXPECT_EQ(buffer_manager.BufferPool()[0].PinCount(), 0);
+}
+
+TEST_F(BufferManagerTest, BufferManagerDoesNotEvictPinnedBuffer) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/3);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/1, disk_manager,
+                                               log_manager);
+    const disk::BlockID block_id0(filename0, 0), block_id1(filename0, 1);
+    disk::Block read_block;
+
+    buffer::PageGuard page;
+    ASSERT_TRUE(buffer_manager.Pin(block_id0, page).IsOk());
+
+    // The only buffer is pinned, so no buffer can be evicted.
+    EXPECT_TRUE(buffer_manager.Read(block_id1, read_block).IsError());
+    EXPECT_TRUE(
+        DoesBufferPoolContainTheBlock(buffer_manager.BufferPool(), block_id0));
+
+    page.Release();
+    auto read_result = buffer_manager.Read(block_id1, read_block);
+    EXPECT_TRUE(read_result.IsOk()) << read_result.Error();
+    EXPECT_TRUE(
+        DoesBufferPoolContainTheBlock(buffer_manager.BufferPool(), block_id1));
+}
+
 TEST_F(BufferManagerTest, LRUBufferManagerReadsCorrectly) {
     disk::DiskManager disk_manager(directory_path, /*block_size=*/3);
     dblog::LogManager log_manager(filename1, directory_path,
@@ -217,4 +336,197 @@ TEST_F(BufferManagerTest, LRUBufferManagerWritesCorrectly) {
     ASSERT_TRUE(buffer_manager.Read(block_id, read_block).IsOk());
     std::vector<uint8_t> expect = {'a', 'i', 'u'};
     EXPECT_EQ(read_block.Content(), expect);
-}
\ No newline at end of file
+}
+TWO_FILE_EXISTENT_TEST(EvictionPolicyTest, "abcdefghij", "");
+
+// Reads the blocks from `begin` to `end` (exclusive) of `filename` in order.
+Result ScanBlocks(buffer::BufferManager &buffer_manager,
+                  const std::string &filename, const int begin,
+                  const int end) {
+    disk::Block read_block;
+    for (int i = begin; i < end; i++) {
+        FIRST_TRY(buffer_manager.Read(disk::BlockID(filename, i), read_block));
+    }
+    return Ok();
+}
+
+TEST_F(EvictionPolicyTest, LRUBufferManagerEvictsLeastRecentlyUsedBlock) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/3, disk_manager,
+                                            log_manager);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 3).IsOk());
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+
+    // Block 1 is the least recently used one.
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 3, 4).IsOk());
+
+    EXPECT_EQ(buffer_manager.HitCount(), 1);
+    EXPECT_EQ(buffer_manager.MissCount(), 4);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+    EXPECT_EQ(buffer_manager.HitCount(), 2);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 1, 2).IsOk());
+    EXPECT_EQ(buffer_manager.MissCount(), 5);
+}
+
+TEST_F(EvictionPolicyTest, ClockBufferManagerGivesSecondChance) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::ClockBufferManager buffer_manager(/*buffer_size=*/3, disk_manager,
+                                              log_manager);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 4).IsOk());
+
+    // Block 1 is referenced again, so block 2 is evicted instead of block 1.
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 1, 2).IsOk());
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 4, 5).IsOk());
+
+    EXPECT_EQ(buffer_manager.HitCount(), 1);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 1, 2).IsOk());
+    EXPECT_EQ(buffer_manager.HitCount(), 2);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 2, 3).IsOk());
+    EXPECT_EQ(buffer_manager.HitCount(), 2);
+}
+
+TEST_F(EvictionPolicyTest, TwoQueueBufferManagerKeepsHotBlockDuringScan) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::TwoQueueBufferManager buffer_manager(
+        /*buffer_size=*/4, disk_manager, log_manager, /*a1in_ratio=*/0.25,
+        /*a1out_ratio=*/0.5);
+
+    // Block 0 is evicted from A1in and loaded again, so it enters Am.
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 5).IsOk());
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+    EXPECT_EQ(buffer_manager.MissCount(), 6);
+
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 5, 10).IsOk());
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+
+    EXPECT_EQ(buffer_manager.HitCount(), 1);
+    EXPECT_EQ(buffer_manager.MissCount(), 11);
+}
+
+TEST_F(EvictionPolicyTest, LRUKBufferManagerKeepsHotBlockDuringScan) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUKBufferManager buffer_manager(/*buffer_size=*/3, disk_manager,
+                                             log_manager, /*k=*/2);
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+
+    // Scanned blocks are accessed only once, so they are evicted first.
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 1, 10).IsOk());
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+
+    EXPECT_EQ(buffer_manager.HitCount(), 2);
+    EXPECT_EQ(buffer_manager.MissCount(), 10);
+}
+
+TEST_F(EvictionPolicyTest, LRUKBufferManagerDoesNotEvictPinnedBuffer) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUKBufferManager buffer_manager(/*buffer_size=*/2, disk_manager,
+                                             log_manager, /*k=*/2);
+    buffer::PageGuard page;
+    ASSERT_TRUE(buffer_manager.Pin(disk::BlockID(filename0, 0), page).IsOk());
+
+    // Block 0 has the lowest priority, but it is pinned.
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 1, 5).IsOk());
+    page.Release();
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 0, 1).IsOk());
+
+    EXPECT_EQ(buffer_manager.HitCount(), 1);
+}
+
+TEST_F(EvictionPolicyTest, BufferManagerWritesBackDirtyVictim) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/1, disk_manager,
+                                               log_manager);
+    const disk::BlockID block_id0(filename0, 0);
+    ASSERT_TRUE(
+        buffer_manager.Write(block_id0, disk::Block(1, "x"), /*lsn=*/0).IsOk());
+    EXPECT_TRUE(buffer_manager.BufferPool()[0].IsDirty());
+
+    ASSERT_TRUE(ScanBlocks(buffer_manager, filename0, 1, 2).IsOk());
+
+    EXPECT_FALSE(buffer_manager.BufferPool()[0].IsDirty());
+    disk::Block read_block;
+    ASSERT_TRUE(disk_manager.Read(block_id0, read_block).IsOk());
+    std::vector<uint8_t> expect = {'x'};
+    EXPECT_EQ(read_block.Content(), expect);
+}
+
+TEST_F(EvictionPolicyTest, ShardedBufferManagerReadsAndWritesBlocks) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager, /*shard_count=*/8);
+    EXPECT_EQ(buffer_manager.ShardCount(), 4);
+
+    const std::string expect_content = "ABCDEFGHIJ";
+    for (int i = 0; i < 10; i++) {
+        const disk::Block block(1, expect_content.substr(i, 1).c_str());
+        ASSERT_TRUE(buffer_manager
+                        .Write(disk::BlockID(filename0, i), block, /*lsn=*/0)
+                        .IsOk());
+    }
+    ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+    for (int i = 0; i < 10; i++) {
+        disk::Block read_block;
+        ASSERT_TRUE(
+            buffer_manager.Read(disk::BlockID(filename0, i), read_block)
+                .IsOk());
+        EXPECT_EQ(read_block.Content()[0], expect_content[i]);
+    }
+}
+
+TEST_F(EvictionPolicyTest, ShardedBufferManagerWorksInParallel) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::ClockBufferManager buffer_manager(/*buffer_size=*/6, disk_manager,
+                                              log_manager, /*shard_count=*/3);
+
+    // Each thread repeatedly writes its own blocks and reads them back, while
+    // the blocks are evicted by the other thread. Each thread pins at most one
+    // buffer at a time, so some buffer in each shard is always unpinned.
+    std::vector<std::thread> threads;
+    std::atomic<int> failures = 0;
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 100; i++) {
+                const disk::BlockID block_id(filename0, t + 2 * (i % 5));
+                const char content[2] = {static_cast<char>('a' + i % 26), 0};
+                disk::Block read_block;
+                if (buffer_manager.Write(block_id, disk::Block(1, content), 0)
+                        .IsError() ||
+                    buffer_manager.Read(block_id, read_block).IsError() ||
+                    read_block.Content()[0] != content[0]) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures, 0);
+}
@@ -1,8 +1,122 @@
 #include "checksum.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MYDB_CRC32C_X86 1
+#include <nmmintrin.h>
+#endif
 
 namespace dblog {
 
-// TODO: compute check sum
-uint32_t ComputeChecksum(const std::vector<uint8_t> &bytes) { return 0; }
+namespace internal {
+
+// The reversed polynomial of CRC32C.
+constexpr uint32_t kCrc32cPolynomial = 0x82f63b78;
+
+using Crc32cTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// Builds the tables for slicing-by-8. `tables[k][b]` is the CRC of the byte
+// `b` followed by `k` zero bytes.
+constexpr Crc32cTables MakeCrc32cTables() {
+    Crc32cTables tables{};
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (kCrc32cPolynomial & (0u - (crc & 1)));
+        }
+        tables[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            const uint32_t previous = tables[k - 1][b];
+            tables[k][b] = (previous >> 8) ^ tables[0][previous & 0xff];
+        }
+    }
+    return tables;
+}
+
+constexpr Crc32cTables kCrc32cTables = MakeCrc32cTables();
+
+// Reads 8 bytes as a little-endian integer.
+inline uint64_t ReadLittleEndian64(const uint8_t *data) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+uint32_t ExtendCrc32cSoftware(const uint32_t checksum, const uint8_t *data,
+                              const size_t length) {
+    const Crc32cTables &t = kCrc32cTables;
+    uint32_t crc          = ~checksum;
+    size_t i              = 0;
+    for (; i + 8 <= length; i += 8) {
+        const uint64_t word = ReadLittleEndian64(data + i) ^ crc;
+        crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+              t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+              t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+              t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    }
+    for (; i < length; i++) {
+        crc = (crc >> 8) ^ t[0][(crc ^ data[i]) & 0xff];
+    }
+    return ~crc;
+}
+
+#ifdef MYDB_CRC32C_X86
+
+bool IsCrc32cHardwareSupported() {
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+
+__attribute__((target("sse4.2"))) uint32_t
+ExtendCrc32cHardware(const uint32_t checksum, const uint8_t *data,
+                     const size_t length) {
+    uint64_t crc = ~checksum;
+    size_t i     = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+    }
+    uint32_t crc32 = crc;
+    for (; i < length; i++) {
+        crc32 = _mm_crc32_u8(crc32, data[i]);
+    }
+    return ~crc32;
+}
+
+#else
+
+bool IsCrc32cHardwareSupported() { return false; }
+
+uint32_t ExtendCrc32cHardware(const uint32_t checksum, const uint8_t *data,
+                              const size_t length) {
+    return ExtendCrc32cSoftware(checksum, data, length);
+}
+
+#endif
+
+} // namespace internal
+
+uint32_t ExtendChecksum(const uint32_t checksum, const uint8_t *data,
+                        const size_t length) {
+    // The implementation is selected once at the first call.
+    static const auto extend = internal::IsCrc32cHardwareSupported()
+                                   ? internal::ExtendCrc32cHardware
+                                   : internal::ExtendCrc32cSoftware;
+    return extend(checksum, data, length);
+}
+
+uint32_t ComputeChecksum(const uint8_t *data, const size_t length) {
+    return ExtendChecksum(/*checksum=*/0, data, length);
+}
+
+uint32_t ComputeChecksum(const std::vector<uint8_t> &bytes) {
+    return ComputeChecksum(bytes.data(), bytes.size());
+}
 
 } // namespace dblog
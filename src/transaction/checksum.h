@@ -1,14 +1,41 @@
 #ifndef _TRANSACTION_CHECKSUM_H
 #define _TRANSACTION_CHECKSUM_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
 namespace dblog {
 
-// Computes checksum of the `bytes`.
+// Computes checksum of the `bytes`. The checksum is CRC32C (Castagnoli), which
+// is computed with the SSE4.2 crc32 instruction when the CPU supports it.
 uint32_t ComputeChecksum(const std::vector<uint8_t> &bytes);
 
+// Computes checksum of `length` bytes from `data`.
+uint32_t ComputeChecksum(const uint8_t *data, const size_t length);
+
+// Extends `checksum` of some bytes with the following `length` bytes from
+// `data`, so that a checksum of bytes split into pieces can be computed
+// without concatenating them. `checksum` of empty bytes is 0.
+uint32_t ExtendChecksum(const uint32_t checksum, const uint8_t *data,
+                        const size_t length);
+
+namespace internal {
+
+// Extends CRC32C `checksum` with a table-driven (slicing-by-8) algorithm.
+uint32_t ExtendCrc32cSoftware(const uint32_t checksum, const uint8_t *data,
+                              const size_t length);
+
+// Returns true if CRC32C can be computed with the hardware instructions.
+bool IsCrc32cHardwareSupported();
+
+// Extends CRC32C `checksum` with the hardware instructions. This function must
+// not be called if `IsCrc32cHardwareSupported()` returns false.
+uint32_t ExtendCrc32cHardware(const uint32_t checksum, const uint8_t *data,
+                              const size_t length);
+
+} // namespace internal
+
 } // namespace dblog
 
-#endif // _CHECKSUM_H
\ No newline at end of file
+#endif // _CHECKSUM_H
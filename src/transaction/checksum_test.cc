@@ -0,0 +1,76 @@
+#include "checksum.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+std::vector<uint8_t> Bytes(const std::string &s) {
+    return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+TEST(Checksum, ComputeChecksumOfEmptyBytes) {
+    EXPECT_EQ(dblog::ComputeChecksum(std::vector<uint8_t>()), 0);
+}
+
+TEST(Checksum, ComputeChecksumMatchesCrc32cCheckValue) {
+    EXPECT_EQ(dblog::ComputeChecksum(Bytes("123456789")), 0xe3069283);
+}
+
+// The test vectors from RFC 3720 (iSCSI), B.4.
+TEST(Checksum, ComputeChecksumMatchesRfc3720Examples) {
+    std::vector<uint8_t> bytes(32, 0x00);
+    EXPECT_EQ(dblog::ComputeChecksum(bytes), 0x8a9136aa);
+
+    bytes = std::vector<uint8_t>(32, 0xff);
+    EXPECT_EQ(dblog::ComputeChecksum(bytes), 0x62a8ab43);
+
+    for (int i = 0; i < 32; i++) {
+        bytes[i] = i;
+    }
+    EXPECT_EQ(dblog::ComputeChecksum(bytes), 0x46dd794e);
+
+    for (int i = 0; i < 32; i++) {
+        bytes[i] = 31 - i;
+    }
+    EXPECT_EQ(dblog::ComputeChecksum(bytes), 0x113fdb5c);
+}
+
+TEST(Checksum, ExtendChecksumEqualsChecksumOfConcatenatedBytes) {
+    const std::vector<uint8_t> bytes = Bytes("a log body split into pieces");
+    for (size_t split = 0; split <= bytes.size(); split++) {
+        const uint32_t first =
+            dblog::ComputeChecksum(bytes.data(), /*length=*/split);
+        EXPECT_EQ(dblog::ExtendChecksum(first, bytes.data() + split,
+                                        bytes.size() - split),
+                  dblog::ComputeChecksum(bytes));
+    }
+}
+
+TEST(Checksum, SoftwareAndHardwareImplementationsAgree) {
+    if (!dblog::internal::IsCrc32cHardwareSupported()) {
+        GTEST_SKIP() << "CRC32C instructions are not supported.";
+    }
+    std::vector<uint8_t> bytes(1000);
+    uint32_t state = 1;
+    for (uint8_t &byte : bytes) {
+        state = state * 1103515245 + 12345;
+        byte  = state >> 16;
+    }
+
+    // Unaligned starts and lengths which are not multiples of 8.
+    for (size_t offset = 0; offset < 9; offset++) {
+        for (size_t length = 0; offset + length <= bytes.size();
+             length += 37) {
+            EXPECT_EQ(dblog::internal::ExtendCrc32cSoftware(
+                          0, bytes.data() + offset, length),
+                      dblog::internal::ExtendCrc32cHardware(
+                          0, bytes.data() + offset, length));
+        }
+    }
+}
+
+TEST(Checksum, ChecksumDetectsCorruption) {
+    std::vector<uint8_t> bytes = Bytes("log record body");
+    const uint32_t checksum    = dblog::ComputeChecksum(bytes);
+    bytes[3] ^= 0x01;
+    EXPECT_NE(dblog::ComputeChecksum(bytes), checksum);
+}
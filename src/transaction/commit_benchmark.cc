@@ -0,0 +1,84 @@
+// Measures the number of commits per second of RecoveryManager::Commit() with
+// concurrent committers, with and without a group commit window.
+//
+// usage: commit_benchmark [commits per thread]
+
+#include "log.h"
+#include "log_record.h"
+#include "recovery.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string kDirectoryPath = "commit_benchmark_dir/";
+const std::string kLogFilename   = "log";
+const int kBlockSize             = 4096;
+
+// Runs `thread_count` threads which commit `commits_per_thread` transactions
+// each, and returns the number of commits per second. `sync_count` is set to
+// the number of syncs of the log file.
+double RunCommits(const int thread_count, const int commits_per_thread,
+                  const std::chrono::microseconds window,
+                  size_t &sync_count) {
+    std::filesystem::remove_all(kDirectoryPath);
+    dblog::LogManager log_manager(kLogFilename, kDirectoryPath, kBlockSize);
+    if (log_manager.Init().IsError()) return 0.0;
+    log_manager.SetGroupCommit(window, thread_count);
+    recovery::RecoveryManager recovery_manager(log_manager);
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> failed = false;
+    const auto start         = std::chrono::steady_clock::now();
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < commits_per_thread; i++) {
+                const dblog::TransactionID transaction_id =
+                    t * commits_per_thread + i;
+                if (recovery_manager
+                        .WriteLog(dblog::LogTransactionBegin(transaction_id))
+                        .IsError() ||
+                    recovery_manager.Commit(transaction_id).IsError()) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    sync_count = log_manager.SyncCount();
+    if (failed) return 0.0;
+    return thread_count * commits_per_thread / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const int commits_per_thread = argc > 1 ? std::atoi(argv[1]) : 100;
+
+    std::printf("%-8s %-10s %14s %10s\n", "threads", "window", "commits/sec",
+                "syncs");
+    for (const int thread_count : {1, 2, 4, 8, 16}) {
+        for (const int window_us : {0, 200}) {
+            size_t sync_count = 0;
+            const double commits_per_sec =
+                RunCommits(thread_count, commits_per_thread,
+                           std::chrono::microseconds(window_us), sync_count);
+            std::printf("%-8d %-10s %14.0f %10zu\n", thread_count,
+                        (std::to_string(window_us) + "us").c_str(),
+                        commits_per_sec, sync_count);
+        }
+    }
+
+    std::filesystem::remove_all(kDirectoryPath);
+    return 0;
+}
@@ -1,106 +1,350 @@
 #include "concurrency.h"
+#include <algorithm>
 #include <chrono>
+#include <set>
+#include <tuple>
 
 namespace dbconcurrency {
 
-inline bool IsReadLocked(int lock) { return lock > 0; }
+namespace {
 
-inline bool IsLockedByOne(int lock) { return lock == 1; }
+constexpr int kLockModeCount = 5;
 
-inline bool IsWriteLocked(int lock) { return lock < 0; }
+// kCompatibility[mode0][mode1] is true if `mode0` and `mode1` are compatible.
+// The modes are in the order of IS, IX, S, SIX and X.
+constexpr bool kCompatibility[kLockModeCount][kLockModeCount] = {
+    {true, true, true, true, false},     // IS
+    {true, true, false, false, false},   // IX
+    {true, false, true, false, false},   // S
+    {true, false, false, false, false},  // SIX
+    {false, false, false, false, false}, // X
+};
 
-inline bool IsNotLocked(int lock) { return lock == 0; }
+// kSupremum[mode0][mode1] is the supremum of `mode0` and `mode1`.
+constexpr LockMode kSupremum[kLockModeCount][kLockModeCount] = {
+    {LockMode::kIntentionShared, LockMode::kIntentionExclusive,
+     LockMode::kShared, LockMode::kSharedIntentionExclusive,
+     LockMode::kExclusive},
+    {LockMode::kIntentionExclusive, LockMode::kIntentionExclusive,
+     LockMode::kSharedIntentionExclusive, LockMode::kSharedIntentionExclusive,
+     LockMode::kExclusive},
+    {LockMode::kShared, LockMode::kSharedIntentionExclusive, LockMode::kShared,
+     LockMode::kSharedIntentionExclusive, LockMode::kExclusive},
+    {LockMode::kSharedIntentionExclusive, LockMode::kSharedIntentionExclusive,
+     LockMode::kSharedIntentionExclusive, LockMode::kSharedIntentionExclusive,
+     LockMode::kExclusive},
+    {LockMode::kExclusive, LockMode::kExclusive, LockMode::kExclusive,
+     LockMode::kExclusive, LockMode::kExclusive},
+};
 
-inline void LockRead(int &lock) { lock++; }
+} // namespace
 
-inline void UnlockRead(int &lock) { lock--; }
+bool IsCompatible(const LockMode mode0, const LockMode mode1) {
+    return kCompatibility[static_cast<int>(mode0)][static_cast<int>(mode1)];
+}
+
+LockMode Supremum(const LockMode mode0, const LockMode mode1) {
+    return kSupremum[static_cast<int>(mode0)][static_cast<int>(mode1)];
+}
 
-inline void LockWrite(int &lock) { lock = -1; }
+LockID::LockID(const std::string &filename)
+    : granularity_(Granularity::kTable), block_id_(filename, 0), slot_(0) {}
 
-inline void UnlockWrite(int &lock) { lock = 0; }
+LockID::LockID(const disk::BlockID &block_id)
+    : granularity_(Granularity::kBlock), block_id_(block_id), slot_(0) {}
 
-Result LockTable::ReadLock(const disk::BlockID &block_id) {
-    std::unique_lock<std::mutex> lock(lock_table_mutex_);
-    if (read_write_condition_.wait_for(lock, wait_time_, [this, block_id] {
-            int lock = lock_table_[block_id];
-            return IsNotLocked(lock) || IsReadLocked(lock);
-        })) {
-        LockRead(lock_table_[block_id]);
-        return Ok();
+LockID::LockID(const disk::BlockID &block_id, const int slot)
+    : granularity_(Granularity::kRecord), block_id_(block_id), slot_(slot) {}
+
+LockID LockID::Parent() const {
+    if (granularity_ == Granularity::kRecord) return LockID(block_id_);
+    return LockID(block_id_.Filename());
+}
+
+bool LockID::operator==(const LockID &other) const {
+    return granularity_ == other.granularity_ && slot_ == other.slot_ &&
+           block_id_ == other.block_id_;
+}
+
+bool LockID::operator!=(const LockID &other) const {
+    return !(*this == other);
+}
+
+bool LockID::operator<(const LockID &other) const {
+    return std::tie(granularity_, block_id_, slot_) <
+           std::tie(other.granularity_, other.block_id_, other.slot_);
+}
+
+size_t LockID::Hash() const {
+    // Combines the hashes in the same way as the hash of disk::BlockID.
+    size_t seed = std::hash<disk::BlockID>()(block_id_);
+    seed ^= std::hash<int>()(slot_) + 0x9e3779b97f4a7c15ULL + (seed << 6) +
+            (seed >> 2);
+    return seed + static_cast<size_t>(granularity_);
+}
+
+LockTable::LockTable(double wait_time_sec, const int shard_count)
+    : wait_time_(int(wait_time_sec * 1000)),
+      shards_(std::max(1, shard_count)) {}
+
+Result LockTable::Lock(const LockID &lock_id,
+                       const dblog::TransactionID transaction_id,
+                       const LockMode mode) {
+    Result result = Acquire(lock_id, transaction_id, mode);
+    if (result.IsError())
+        return result + Error("dbconcurrency::LockTable::Lock() failed to "
+                              "acquire the lock.");
+    return Ok();
+}
+
+Result LockTable::ReadLock(const LockID &lock_id,
+                           const dblog::TransactionID transaction_id) {
+    Result result = Acquire(lock_id, transaction_id, LockMode::kShared);
+    if (result.IsError())
+        return result + Error("dbconcurrency::LockTable::ReadLock() failed to "
+                              "acquire read lock.");
+    return Ok();
+}
+
+Result LockTable::WriteLock(const LockID &lock_id,
+                            const dblog::TransactionID transaction_id) {
+    Result result = Acquire(lock_id, transaction_id, LockMode::kExclusive);
+    if (result.IsError())
+        return result + Error("dbconcurrency::LockTable::WriteLock() failed to "
+                              "acquire write lock.");
+    return Ok();
+}
+
+Result LockTable::WriteLockWhenOwningReadLock(
+    const LockID &lock_id, const dblog::TransactionID transaction_id) {
+    Result result = Acquire(lock_id, transaction_id, LockMode::kExclusive);
+    if (result.IsError())
+        return result + Error("dbconcurrency::LockTable::"
+                              "WriteLockWhenOwningReadLock() failed to acquire "
+                              "write lock.");
+    return Ok();
+}
+
+void LockTable::Release(const LockID &lock_id,
+                        const dblog::TransactionID transaction_id) {
+    Shard &shard = shards_[ShardIndex(lock_id)];
+    std::lock_guard<std::mutex> latch(shard.mutex);
+    auto it = shard.locks.find(lock_id);
+    if (it == shard.locks.end()) return;
+    Entry &entry = it->second;
+    entry.holders.erase(
+        std::remove_if(entry.holders.begin(), entry.holders.end(),
+                       [&](const auto &holder) {
+                           return holder.first == transaction_id;
+                       }),
+        entry.holders.end());
+
+    GrantWaiters(entry);
+    if (entry.holders.empty() && entry.queue.empty()) shard.locks.erase(it);
+}
+
+bool LockTable::IsGrantable(const Entry &entry,
+                            const dblog::TransactionID transaction_id,
+                            const LockMode mode) {
+    for (const auto &[holder, holder_mode] : entry.holders) {
+        if (holder != transaction_id && !IsCompatible(holder_mode, mode))
+            return false;
     }
-    return Error("dbconcurrency::LockTable::ReadLock() failed to acquire read "
-                 "lock in time limit.");
+    return true;
 }
 
-Result LockTable::WriteLock(const disk::BlockID &block_id) {
-    std::unique_lock<std::mutex> lock(lock_table_mutex_);
-    if (read_write_condition_.wait_for(lock, wait_time_, [this, block_id] {
-            return IsNotLocked(lock_table_[block_id]);
-        })) {
-        LockWrite(lock_table_[block_id]);
-        return Ok();
+void LockTable::Grant(Entry &entry, const dblog::TransactionID transaction_id,
+                      const LockMode mode) {
+    for (auto &[holder, holder_mode] : entry.holders) {
+        if (holder == transaction_id) {
+            holder_mode = mode;
+            return;
+        }
     }
-    return Error("dbconcurrency::LockTable::WriteLock() failed to acquire "
-                 "write lock in time limit.");
+    entry.holders.emplace_back(transaction_id, mode);
 }
 
-Result LockTable::WriteLockWhenOwningReadLock(const disk::BlockID &block_id) {
-    std::unique_lock<std::mutex> lock(lock_table_mutex_);
-    if (read_write_condition_.wait_for(lock, wait_time_, [this, block_id] {
-            return IsLockedByOne(lock_table_[block_id]);
-        })) {
-        LockWrite(lock_table_[block_id]);
-        return Ok();
+void LockTable::GrantWaiters(Entry &entry) {
+    while (!entry.queue.empty()) {
+        Request *request = entry.queue.front();
+        if (!IsGrantable(entry, request->transaction_id, request->mode)) break;
+        Grant(entry, request->transaction_id, request->mode);
+        request->granted = true;
+        entry.queue.pop_front();
+        request->condition.notify_one();
     }
-    return Error("dbconcurrency::LockTable::WriteLockWhenOwningReadLock() "
-                 "failed to acquire write lock in time limit.");
 }
 
-void LockTable::Release(const disk::BlockID &block_id) {
-    std::unique_lock<std::mutex> lock(lock_table_mutex_);
-    if (IsReadLocked(lock_table_[block_id])) {
-        UnlockRead(lock_table_[block_id]);
+Result LockTable::Acquire(const LockID &lock_id,
+                          const dblog::TransactionID transaction_id,
+                          const LockMode mode) {
+    Shard &shard = shards_[ShardIndex(lock_id)];
+    std::unique_lock<std::mutex> latch(shard.mutex);
+    Entry &entry = shard.locks[lock_id];
+
+    // A transaction holding the lock converts it to the supremum of the modes.
+    LockMode target_mode = mode;
+    bool is_conversion   = false;
+    for (const auto &[holder, holder_mode] : entry.holders) {
+        if (holder == transaction_id) {
+            if (Supremum(holder_mode, mode) == holder_mode) return Ok();
+            target_mode   = Supremum(holder_mode, mode);
+            is_conversion = true;
+        }
+    }
+
+    // The lock is given at once only when no request waits before, so that
+    // the requests are granted in FIFO order. A conversion goes before the
+    // waiting requests, which wait for the transaction to release the lock.
+    if ((entry.queue.empty() || is_conversion) &&
+        IsGrantable(entry, transaction_id, target_mode)) {
+        Grant(entry, transaction_id, target_mode);
+        return Ok();
     }
-    if (IsWriteLocked(lock_table_[block_id])) {
-        UnlockWrite(lock_table_[block_id]);
+    Request request{transaction_id, target_mode};
+    if (is_conversion)
+        entry.queue.push_front(&request);
+    else
+        entry.queue.push_back(&request);
+    shard.waitings.emplace(transaction_id, lock_id);
+
+    // Removes the request which failed from the queue. The requests after it
+    // may be granted then.
+    auto cancel = [&] {
+        entry.queue.erase(
+            std::find(entry.queue.begin(), entry.queue.end(), &request));
+        shard.waitings.erase(transaction_id);
+        GrantWaiters(entry);
+        if (entry.holders.empty() && entry.queue.empty())
+            shard.locks.erase(lock_id);
+    };
+
+    // The wait-for graph crosses the shards, so it is searched with the
+    // latches of all the shards, which are taken in the order of the shards.
+    latch.unlock();
+    {
+        std::vector<std::unique_lock<std::mutex>> latches;
+        latches.reserve(shards_.size());
+        for (Shard &each_shard : shards_) {
+            latches.emplace_back(each_shard.mutex);
+        }
+        if (!request.granted && IsDeadlock(lock_id, transaction_id)) {
+            cancel();
+            deadlock_count_++;
+            return Error("dbconcurrency::LockTable::Acquire() waiting for "
+                         "the lock makes a deadlock.");
+        }
     }
-    read_write_condition_.notify_all();
+
+    latch.lock();
+    const bool granted =
+        request.condition.wait_until(latch,
+                                     std::chrono::steady_clock::now() +
+                                         wait_time_,
+                                     [&] { return request.granted; });
+    if (!granted) {
+        cancel();
+        timeout_count_++;
+        return Error("dbconcurrency::LockTable::Acquire() failed to "
+                     "acquire the lock in time limit.");
+    }
+    shard.waitings.erase(transaction_id);
+    return Ok();
 }
 
-Result ConcurrentManager::ReadLock(const disk::BlockID &block_id) {
-    if (owned_locks_.count(block_id)) return Ok();
-    Result lock_result = lock_table_.ReadLock(block_id);
+bool LockTable::IsDeadlock(const LockID &lock_id,
+                           const dblog::TransactionID transaction_id) const {
+    // A waiting transaction waits for the requests before it in the queue and
+    // the holders whose modes are not compatible with it. A transaction in
+    // `waitings` of a shard whose request is not in the queue has already
+    // been granted.
+    std::vector<dblog::TransactionID> to_visit;
+    auto add_blockers = [&](const LockID &waiting_lock_id,
+                            const dblog::TransactionID waiting_id) {
+        const Shard &shard = shards_[ShardIndex(waiting_lock_id)];
+        auto it            = shard.locks.find(waiting_lock_id);
+        if (it == shard.locks.end()) return;
+        const Entry &entry = it->second;
+        auto request =
+            std::find_if(entry.queue.begin(), entry.queue.end(),
+                         [&](const Request *request) {
+                             return request->transaction_id == waiting_id;
+                         });
+        if (request == entry.queue.end()) return;
+        for (auto before = entry.queue.begin(); before != request; before++) {
+            to_visit.push_back((*before)->transaction_id);
+        }
+        for (const auto &[holder, holder_mode] : entry.holders) {
+            if (holder != waiting_id &&
+                !IsCompatible(holder_mode, (*request)->mode))
+                to_visit.push_back(holder);
+        }
+    };
+
+    add_blockers(lock_id, transaction_id);
+    std::set<dblog::TransactionID> visited;
+    while (!to_visit.empty()) {
+        const dblog::TransactionID blocker = to_visit.back();
+        to_visit.pop_back();
+        if (blocker == transaction_id) return true;
+        if (!visited.insert(blocker).second) continue;
+        for (const Shard &shard : shards_) {
+            auto it = shard.waitings.find(blocker);
+            if (it != shard.waitings.end()) {
+                add_blockers(it->second, blocker);
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+Result ConcurrentManager::ReadLock(const LockID &lock_id) {
+    Result lock_result =
+        Lock(lock_id, LockMode::kShared, LockMode::kIntentionShared);
     if (lock_result.IsError())
         return lock_result + Error("dbconcurrency::ConcurrentManager::ReadLock("
                                    ") failed to acquire read lock.");
-    owned_locks_[block_id] = ReadOrWrite::kRead;
     return Ok();
 }
 
-Result ConcurrentManager::WriteLock(const disk::BlockID &block_id) {
-    if (owned_locks_.count(block_id)) {
-        if (owned_locks_[block_id] == ReadOrWrite::kWrite) return Ok();
-        Result lock_result = lock_table_.WriteLockWhenOwningReadLock(block_id);
-        if (lock_result.IsError())
-            return lock_result +
-                   Error("dbconcurrency::ConcurrentManager::WriteLock() failed "
-                         "to acquire write lock when owning read lock.");
-    } else {
-        Result lock_result = lock_table_.WriteLock(block_id);
-        if (lock_result.IsError())
-            return lock_result +
-                   Error("dbconcurrency::ConcurrentManager::WriteLock() failed "
-                         "to acquire write lock.");
-    }
-    owned_locks_[block_id] = ReadOrWrite::kWrite;
+Result ConcurrentManager::WriteLock(const LockID &lock_id) {
+    Result lock_result =
+        Lock(lock_id, LockMode::kExclusive, LockMode::kIntentionExclusive);
+    if (lock_result.IsError())
+        return lock_result + Error("dbconcurrency::ConcurrentManager::"
+                                   "WriteLock() failed to acquire write lock.");
     return Ok();
 }
 
 void ConcurrentManager::Release() {
-    for (auto &[block_id, _] : owned_locks_) {
-        lock_table_.Release(block_id);
+    // The records are released before the blocks and the blocks before the
+    // tables, so that no transaction is granted a table while this
+    // transaction still holds a part of it.
+    for (auto it = owned_locks_.rbegin(); it != owned_locks_.rend(); it++) {
+        lock_table_.Release(it->first, transaction_id_);
     }
     owned_locks_.clear();
 }
 
-} // namespace dbconcurrency
\ No newline at end of file
+Result ConcurrentManager::Lock(const LockID &lock_id, const LockMode mode,
+                               const LockMode intention_mode) {
+    if (lock_id.Level() != LockID::Granularity::kTable) {
+        Result parent_result =
+            Lock(lock_id.Parent(), intention_mode, intention_mode);
+        if (parent_result.IsError()) return parent_result;
+    }
+
+    auto it = owned_locks_.find(lock_id);
+    if (it != owned_locks_.end() && Supremum(it->second, mode) == it->second)
+        return Ok();
+    Result lock_result = lock_table_.Lock(lock_id, transaction_id_, mode);
+    if (lock_result.IsError())
+        return lock_result + Error("dbconcurrency::ConcurrentManager::Lock() "
+                                   "failed to acquire the lock.");
+    owned_locks_[lock_id] =
+        it == owned_locks_.end() ? mode : Supremum(it->second, mode);
+    return Ok();
+}
+
+} // namespace dbconcurrency
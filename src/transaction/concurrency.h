@@ -2,66 +2,259 @@
 #define _TRANSACTION_CONCURRENCY_H
 
 #include "disk.h"
+#include "log.h"
 #include "result.h"
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <map>
 #include <mutex>
+#include <string>
 #include <vector>
 
 namespace dbconcurrency {
 
-// LockTable manages the read-write lock of blocks.
-// All these class methods are thread-safe.
+// The default number of shards of LockTable.
+constexpr int kDefaultLockTableShardCount = 16;
+
+// LockMode is the mode of a lock. A transaction locks a record, a block or a
+// table with kShared to read it and with kExclusive to write it. Before that,
+// the transaction locks the enclosing block and table with an intention mode,
+// kIntentionShared or kIntentionExclusive, which tells that it is reading or
+// writing a part of them. kSharedIntentionExclusive is a shared lock which
+// also intends to write a part.
+enum class LockMode {
+    kIntentionShared          = 0,
+    kIntentionExclusive       = 1,
+    kShared                   = 2,
+    kSharedIntentionExclusive = 3,
+    kExclusive                = 4,
+};
+
+// Returns true if two transactions can hold the lock of a target in `mode0`
+// and `mode1` at the same time.
+bool IsCompatible(const LockMode mode0, const LockMode mode1);
+
+// Returns the weakest mode which is at least as strong as both `mode0` and
+// `mode1`. A transaction holding a lock in `mode0` and requesting `mode1`
+// converts the lock to this mode.
+LockMode Supremum(const LockMode mode0, const LockMode mode1);
+
+// LockID identifies the target of a lock, which is a table, a block of the
+// table or a record in a slot of the block. The targets make a hierarchy, in
+// which a table includes its blocks and a block includes its records. A table
+// is identified by its file.
+class LockID {
+  public:
+    enum class Granularity {
+        kTable  = 0,
+        kBlock  = 1,
+        kRecord = 2,
+    };
+
+    // The lock of the table stored in the file `filename`.
+    explicit LockID(const std::string &filename);
+
+    // The lock of the block.
+    LockID(const disk::BlockID &block_id);
+
+    // The lock of the record in `slot` of the block.
+    LockID(const disk::BlockID &block_id, const int slot);
+
+    inline Granularity Level() const { return granularity_; }
+
+    // Returns the target which includes this target. Must not be called for a
+    // table.
+    LockID Parent() const;
+
+    bool operator==(const LockID &other) const;
+
+    bool operator!=(const LockID &other) const;
+
+    // Orders the targets by the granularity first, so that the records come
+    // after the blocks and the blocks come after the tables.
+    bool operator<(const LockID &other) const;
+
+    size_t Hash() const;
+
+  private:
+    Granularity granularity_;
+
+    // The block index of a table is always 0.
+    disk::BlockID block_id_;
+
+    // The slot of a block or a table is always 0.
+    int slot_;
+};
+
+// LockTable manages the locks of tables, blocks and records, which are owned
+// by transactions. All these class methods are thread-safe.
+//
+// A transaction holds a lock in one mode. When it requests another mode of a
+// lock it already holds, the lock is converted to the supremum of the modes.
+//
+// The lock table is partitioned into shards by the hash of the lock id, and
+// each shard has its own latch, so that transactions locking targets in
+// different shards never contend. Each lock has a FIFO queue of the waiting
+// requests. A request waits in the queue when its mode is not compatible with
+// the holders or other requests are waiting before it, and a release grants
+// the lock to the requests from the head of the queue as long as they are
+// compatible, waking only them. A conversion is queued at the head, because
+// the transaction already holds the lock.
+//
+// A transaction waiting for a lock waits for the transactions holding it in an
+// incompatible mode and those waiting before it in the queue, which makes a
+// wait-for graph. When a transaction is about to wait, the graph is searched
+// from the transaction with the latches of all the shards held, and if the
+// transaction is reached again, the wait would close a cycle of the graph,
+// that is, a deadlock. Then the lock request fails at once instead of waiting
+// for `wait_time_sec`. Only the transaction which closes the cycle fails, so
+// exactly one transaction of a deadlock is the victim. The other conflicts
+// wait up to `wait_time_sec`.
 class LockTable {
   public:
-    inline explicit LockTable(double wait_time_sec)
-        : wait_time_(int(wait_time_sec * 1000)) {}
+    // `shard_count` is clamped to be at least 1.
+    explicit LockTable(double wait_time_sec,
+                       const int shard_count = kDefaultLockTableShardCount);
+
+    // Try to get the lock of `lock_id` in `mode` for the transaction
+    // `transaction_id`. If the transaction already holds the lock, it is
+    // converted to the supremum of the modes. If a deadlock is detected or
+    // `wait_time_sec_` passed, returns the failed reesult.
+    Result Lock(const LockID &lock_id,
+                const dblog::TransactionID transaction_id,
+                const LockMode mode);
 
-    // Try to get the read lock of the block. If `wait_time_sec_` passed,
+    // Try to get the read (shared) lock of `lock_id` for the transaction
+    // `transaction_id`. If a deadlock is detected or `wait_time_sec_` passed,
     // returns the failed reesult.
-    Result ReadLock(const disk::BlockID &block_id);
+    Result ReadLock(const LockID &lock_id,
+                    const dblog::TransactionID transaction_id);
 
-    // Try to get the write lock of the block. If `wait_time_sec_` passed,
+    // Try to get the write (exclusive) lock of `lock_id` for the transaction
+    // `transaction_id`. If a deadlock is detected or `wait_time_sec_` passed,
     // returns the failed reesult.
-    Result WriteLock(const disk::BlockID &block_id);
+    Result WriteLock(const LockID &lock_id,
+                     const dblog::TransactionID transaction_id);
+
+    // Try to get the write lock of `lock_id` when the transaction
+    // `transaction_id` owns read lock of it. If a deadlock is detected or
+    // `wait_time_sec_` passed, returns the failed reesult.
+    Result
+    WriteLockWhenOwningReadLock(const LockID &lock_id,
+                                const dblog::TransactionID transaction_id);
+
+    // Release lock of `lock_id` owned by the transaction `transaction_id`.
+    void Release(const LockID &lock_id,
+                 const dblog::TransactionID transaction_id);
+
+    // Returns the number of lock requests which failed because of a deadlock.
+    inline size_t DeadlockCount() const { return deadlock_count_; }
 
-    // Try to get the write lock of the block when the transaction owns read
-    // lock of the block. If `wait_time_sec_` passed, returns the failed
-    // reesult.
-    Result WriteLockWhenOwningReadLock(const disk::BlockID &block_id);
+    // Returns the number of lock requests which failed because
+    // `wait_time_sec` passed.
+    inline size_t TimeoutCount() const { return timeout_count_; }
 
-    // Release lock of `block_id`.
-    void Release(const disk::BlockID &block_id);
+    // Returns the number of shards.
+    inline int ShardCount() const { return shards_.size(); }
 
   private:
+    // A request waiting in the queue of a lock. The request lives on the stack
+    // of the waiting thread, which waits for `granted` with `condition`.
+    // `mode` is the mode the transaction holds after the request is granted.
+    struct Request {
+        dblog::TransactionID transaction_id;
+        LockMode mode;
+        bool granted = false;
+        std::condition_variable condition;
+    };
+
+    // The entry of the lock of a target has the holders with their modes, and
+    // the waiting requests in FIFO order.
+    struct Entry {
+        std::vector<std::pair<dblog::TransactionID, LockMode>> holders;
+        std::deque<Request *> queue;
+    };
+
+    // Shard is a partition of the lock table. The locks of the targets in the
+    // shard, and the targets for which the transactions wait, are guarded by
+    // `mutex`.
+    struct Shard {
+        std::mutex mutex;
+        std::map<LockID, Entry> locks;
+        std::map<dblog::TransactionID, LockID> waitings;
+    };
+
+    // Returns the index of the shard of the lock of `lock_id`.
+    inline size_t ShardIndex(const LockID &lock_id) const {
+        return lock_id.Hash() % shards_.size();
+    }
+
+    // Returns true if the lock of `mode` can be given to the transaction
+    // `transaction_id`, that is, `mode` is compatible with the modes of the
+    // other holders.
+    static bool IsGrantable(const Entry &entry,
+                            const dblog::TransactionID transaction_id,
+                            const LockMode mode);
+
+    // Gives the lock of `mode` to the transaction `transaction_id`, replacing
+    // the mode it holds.
+    static void Grant(Entry &entry, const dblog::TransactionID transaction_id,
+                      const LockMode mode);
+
+    // Grants the lock to the requests from the head of the queue while they
+    // can be granted, and wakes them up.
+    static void GrantWaiters(Entry &entry);
+
+    // Waits until the transaction `transaction_id` gets the lock of `mode` of
+    // `lock_id`, and takes it.
+    Result Acquire(const LockID &lock_id,
+                   const dblog::TransactionID transaction_id,
+                   const LockMode mode);
+
+    // Returns true if the transaction `transaction_id` waiting for the lock of
+    // `lock_id` is in a cycle of the wait-for graph. The latches of all the
+    // shards must be held.
+    bool IsDeadlock(const LockID &lock_id,
+                    const dblog::TransactionID transaction_id) const;
+
     std::chrono::milliseconds wait_time_;
-    std::mutex lock_table_mutex_;
-    std::condition_variable read_write_condition_;
-    std::map<disk::BlockID, int> lock_table_;
+    std::vector<Shard> shards_;
+
+    std::atomic<size_t> deadlock_count_ = 0;
+    std::atomic<size_t> timeout_count_  = 0;
 };
 
-// Manages locked block of one transaction.
+// Manages locked targets of one transaction. Before a transaction locks a
+// block or a record, the manager locks the enclosing table and block with the
+// intention mode, so that a lock of a whole table or block conflicts with the
+// locks of its parts.
 class ConcurrentManager {
   public:
-    inline ConcurrentManager(LockTable &lock_table) : lock_table_(lock_table) {}
+    inline ConcurrentManager(LockTable &lock_table,
+                             const dblog::TransactionID transaction_id)
+        : lock_table_(lock_table), transaction_id_(transaction_id) {}
 
-    // Try to acquire read lock of the block.
-    Result ReadLock(const disk::BlockID &block_id);
+    // Try to acquire read lock of the target.
+    Result ReadLock(const LockID &lock_id);
 
-    // Try to acquire write lock of the block.
-    Result WriteLock(const disk::BlockID &block_id);
+    // Try to acquire write lock of the target.
+    Result WriteLock(const LockID &lock_id);
 
     // Unlock all the locks the manager owns.
     void Release();
 
   private:
-    enum class ReadOrWrite {
-        kRead  = 0,
-        kWrite = 1,
-    };
+    // Locks the enclosing targets of `lock_id` in `intention_mode` from the
+    // table down, and then `lock_id` in `mode`. A lock the manager already
+    // owns in a mode at least as strong is not requested again.
+    Result Lock(const LockID &lock_id, const LockMode mode,
+                const LockMode intention_mode);
+
     LockTable &lock_table_;
-    std::map<disk::BlockID, ReadOrWrite> owned_locks_;
+    dblog::TransactionID transaction_id_;
+    std::map<LockID, LockMode> owned_locks_;
 };
 
 } // namespace dbconcurrency
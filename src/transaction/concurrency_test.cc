@@ -1,8 +1,10 @@
 #include "concurrency.h"
 #include "disk.h"
+#include <atomic>
 #include <chrono>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <mutex>
 #include <thread>
 
 dbconcurrency::LockTable lock_table(/*wait_time_sec=*/2);
@@ -12,25 +14,25 @@ const disk::BlockID block0("a.txt", 0), block1("a.txt", 2), block2("a.txt", 4),
 
 void WriteLockCorrectlyLockOtherThread0() {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    Result result = lock_table.WriteLock(block0);
+    Result result = lock_table.WriteLock(block0, /*transaction_id=*/1);
     EXPECT_TRUE(result.IsOk());
     shared[block0] = 5;
 
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    lock_table.Release(block0);
+    lock_table.Release(block0, /*transaction_id=*/1);
 }
 
 void WriteLockCorrectlyLockOtherThread1() {
-    Result result = lock_table.ReadLock(block0);
+    Result result = lock_table.ReadLock(block0, /*transaction_id=*/2);
     EXPECT_TRUE(result.IsOk());
     EXPECT_EQ(shared[block0], 0);
-    lock_table.Release(block0);
+    lock_table.Release(block0, /*transaction_id=*/2);
 
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    result = lock_table.ReadLock(block0);
+    result = lock_table.ReadLock(block0, /*transaction_id=*/2);
     EXPECT_TRUE(result.IsOk());
     EXPECT_EQ(shared[block0], 5);
-    lock_table.Release(block0);
+    lock_table.Release(block0, /*transaction_id=*/2);
 }
 
 TEST(ConcurrencyLockTable, WriteLockCorrectlyLockOtherThread) {
@@ -41,35 +43,35 @@ TEST(ConcurrencyLockTable, WriteLockCorrectlyLockOtherThread) {
 }
 
 void ReadLockCorrectlyLockWriteThread0() {
-    Result result = lock_table.WriteLock(block1);
+    Result result = lock_table.WriteLock(block1, /*transaction_id=*/3);
     EXPECT_TRUE(result.IsOk());
     shared[block1] = 8;
-    lock_table.Release(block1);
+    lock_table.Release(block1, /*transaction_id=*/3);
 
-    result = lock_table.ReadLock(block1);
+    result = lock_table.ReadLock(block1, /*transaction_id=*/3);
     EXPECT_TRUE(result.IsOk());
 
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    lock_table.Release(block1);
+    lock_table.Release(block1, /*transaction_id=*/3);
 }
 
 void ReadLockCorrectlyLockWriteThread1() {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    Result result = lock_table.ReadLock(block1);
+    Result result = lock_table.ReadLock(block1, /*transaction_id=*/4);
     EXPECT_TRUE(result.IsOk());
     EXPECT_EQ(shared[block1], 8);
-    lock_table.Release(block1);
+    lock_table.Release(block1, /*transaction_id=*/4);
 
-    result = lock_table.WriteLock(block1);
+    result = lock_table.WriteLock(block1, /*transaction_id=*/4);
     EXPECT_TRUE(result.IsOk());
     EXPECT_EQ(shared[block1], 8);
     shared[block1] = 10;
-    lock_table.Release(block1);
+    lock_table.Release(block1, /*transaction_id=*/4);
 
-    result = lock_table.ReadLock(block1);
+    result = lock_table.ReadLock(block1, /*transaction_id=*/4);
     EXPECT_TRUE(result.IsOk());
     EXPECT_EQ(shared[block1], 10);
-    lock_table.Release(block1);
+    lock_table.Release(block1, /*transaction_id=*/4);
 }
 
 TEST(ConcurrencyLockTable, ReadLockCorrectlyLockWriteThread) {
@@ -81,24 +83,26 @@ TEST(ConcurrencyLockTable, ReadLockCorrectlyLockWriteThread) {
 }
 
 void DetectDeadLock0() {
-    Result result = lock_table.WriteLock(block2);
+    Result result = lock_table.WriteLock(block2, /*transaction_id=*/5);
     EXPECT_TRUE(result.IsOk());
 
+    // The transaction 6 already waits for this transaction, so this request
+    // closes the cycle and fails.
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    result = lock_table.ReadLock(block3);
-    EXPECT_TRUE(result.IsOk());
-    lock_table.Release(block2);
-    lock_table.Release(block3);
+    result = lock_table.ReadLock(block3, /*transaction_id=*/5);
+    EXPECT_TRUE(result.IsError()); // Dead locked!
+    lock_table.Release(block2, /*transaction_id=*/5);
 }
 
 void DetectDeadLock1() {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    Result result = lock_table.WriteLock(block3);
+    Result result = lock_table.WriteLock(block3, /*transaction_id=*/6);
     EXPECT_TRUE(result.IsOk());
 
-    result = lock_table.ReadLock(block2);
-    EXPECT_TRUE(result.IsError()); // Dead locked!
-    lock_table.Release(block3);
+    result = lock_table.ReadLock(block2, /*transaction_id=*/6);
+    EXPECT_TRUE(result.IsOk());
+    lock_table.Release(block2, /*transaction_id=*/6);
+    lock_table.Release(block3, /*transaction_id=*/6);
 }
 
 TEST(ConcurrencyLockTable, DetectDeadLock) {
@@ -109,16 +113,241 @@ TEST(ConcurrencyLockTable, DetectDeadLock) {
 }
 
 TEST(ConcurrencyLockTable, AcquireWriteLockWhenOwningReadLock) {
-    Result result = lock_table.ReadLock(block0);
+    Result result = lock_table.ReadLock(block0, /*transaction_id=*/7);
     EXPECT_TRUE(result.IsOk());
 
-    result = lock_table.WriteLockWhenOwningReadLock(block0);
+    result = lock_table.WriteLockWhenOwningReadLock(block0,
+                                                    /*transaction_id=*/7);
     EXPECT_TRUE(result.IsOk());
-    lock_table.Release(block0);
+    lock_table.Release(block0, /*transaction_id=*/7);
+}
+
+TEST(ConcurrencyLockTable, DeadlockIsDetectedWithoutWaiting) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/10);
+    ASSERT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/1).IsOk());
+    ASSERT_TRUE(lock_table.WriteLock(block1, /*transaction_id=*/2).IsOk());
+
+    // The transaction 1 waits for the transaction 2, which then closes the
+    // cycle and fails at once.
+    std::thread thread([&] {
+        EXPECT_TRUE(lock_table.ReadLock(block1, /*transaction_id=*/1).IsOk());
+        lock_table.Release(block0, /*transaction_id=*/1);
+        lock_table.Release(block1, /*transaction_id=*/1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/2).IsError());
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(1));
+    lock_table.Release(block1, /*transaction_id=*/2);
+    thread.join();
+
+    EXPECT_EQ(lock_table.DeadlockCount(), 1);
+    EXPECT_EQ(lock_table.TimeoutCount(), 0);
+}
+
+TEST(ConcurrencyLockTable, UpgradeDeadlockIsDetected) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/10);
+    ASSERT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/1).IsOk());
+    ASSERT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/2).IsOk());
+
+    // Both readers upgrade, and the second one is the victim.
+    std::thread thread([&] {
+        EXPECT_TRUE(
+            lock_table.WriteLockWhenOwningReadLock(block0, /*transaction_id=*/1)
+                .IsOk());
+        lock_table.Release(block0, /*transaction_id=*/1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(
+        lock_table.WriteLockWhenOwningReadLock(block0, /*transaction_id=*/2)
+            .IsError());
+    lock_table.Release(block0, /*transaction_id=*/2);
+    thread.join();
+    EXPECT_EQ(lock_table.DeadlockCount(), 1);
+}
+
+TEST(ConcurrencyLockTable, TimeoutIsCountedApartFromDeadlock) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/0.1);
+    ASSERT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/1).IsOk());
+    EXPECT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/2).IsError());
+    EXPECT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/3).IsError());
+    EXPECT_EQ(lock_table.TimeoutCount(), 2);
+    EXPECT_EQ(lock_table.DeadlockCount(), 0);
+
+    // A read lock is shared, and the lock is free after the release.
+    lock_table.Release(block0, /*transaction_id=*/1);
+    EXPECT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/2).IsOk());
+    EXPECT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/3).IsOk());
+    lock_table.Release(block0, /*transaction_id=*/2);
+    lock_table.Release(block0, /*transaction_id=*/3);
+    EXPECT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/1).IsOk());
+    lock_table.Release(block0, /*transaction_id=*/1);
+}
+
+TEST(ConcurrencyLockTable, WaitingRequestsAreGrantedInFifoOrder) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/10);
+    ASSERT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/1).IsOk());
+
+    // The writer waits for the reader, and the later reader waits behind the
+    // writer even though the read lock is shared.
+    std::vector<int> order;
+    std::mutex order_mutex;
+    std::thread writer([&] {
+        EXPECT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/2).IsOk());
+        {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(2);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        lock_table.Release(block0, /*transaction_id=*/2);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread reader([&] {
+        EXPECT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/3).IsOk());
+        {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(3);
+        }
+        lock_table.Release(block0, /*transaction_id=*/3);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    lock_table.Release(block0, /*transaction_id=*/1);
+    writer.join();
+    reader.join();
+
+    EXPECT_EQ(order, std::vector<int>({2, 3}));
+    EXPECT_EQ(lock_table.DeadlockCount(), 0);
+    EXPECT_EQ(lock_table.TimeoutCount(), 0);
+}
+
+TEST(ConcurrencyLockTable, ReleaseWakesCompatibleWaiters) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/10);
+    ASSERT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/1).IsOk());
+
+    // The two readers share the lock after the release, while the writer
+    // queued behind them keeps waiting until both release it.
+    std::atomic<int> readers = 0;
+    auto read = [&](const dblog::TransactionID transaction_id) {
+        EXPECT_TRUE(lock_table.ReadLock(block0, transaction_id).IsOk());
+        readers++;
+        while (readers < 2) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        readers--;
+        lock_table.Release(block0, transaction_id);
+    };
+    std::thread reader0(read, 2);
+    std::thread reader1(read, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread writer([&] {
+        EXPECT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/4).IsOk());
+        EXPECT_EQ(readers, 0);
+        lock_table.Release(block0, /*transaction_id=*/4);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    lock_table.Release(block0, /*transaction_id=*/1);
+    reader0.join();
+    reader1.join();
+    writer.join();
+    EXPECT_EQ(lock_table.TimeoutCount(), 0);
+}
+
+TEST(ConcurrencyLockTable, DeadlockIsDetectedAcrossShards) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/10,
+                                        /*shard_count=*/64);
+    const disk::BlockID other("b.txt", 3);
+    ASSERT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/1).IsOk());
+    ASSERT_TRUE(lock_table.WriteLock(other, /*transaction_id=*/2).IsOk());
+
+    std::thread thread([&] {
+        EXPECT_TRUE(lock_table.WriteLock(other, /*transaction_id=*/1).IsOk());
+        lock_table.Release(block0, /*transaction_id=*/1);
+        lock_table.Release(other, /*transaction_id=*/1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(lock_table.WriteLock(block0, /*transaction_id=*/2).IsError());
+    lock_table.Release(other, /*transaction_id=*/2);
+    thread.join();
+    EXPECT_EQ(lock_table.DeadlockCount(), 1);
+}
+
+TEST(ConcurrencyLockTable, ShardCountIsAtLeastOne) {
+    EXPECT_EQ(dbconcurrency::LockTable(/*wait_time_sec=*/1).ShardCount(),
+              dbconcurrency::kDefaultLockTableShardCount);
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/1,
+                                        /*shard_count=*/0);
+    EXPECT_EQ(lock_table.ShardCount(), 1);
+    ASSERT_TRUE(lock_table.ReadLock(block0, /*transaction_id=*/1).IsOk());
+    ASSERT_TRUE(lock_table.ReadLock(block1, /*transaction_id=*/1).IsOk());
+    lock_table.Release(block0, /*transaction_id=*/1);
+    lock_table.Release(block1, /*transaction_id=*/1);
+}
+
+TEST(ConcurrencyLockTable, LockModesAreCompatibleAndConverted) {
+    using dbconcurrency::LockMode;
+    EXPECT_TRUE(dbconcurrency::IsCompatible(LockMode::kIntentionShared,
+                                            LockMode::kIntentionExclusive));
+    EXPECT_TRUE(dbconcurrency::IsCompatible(
+        LockMode::kIntentionShared, LockMode::kSharedIntentionExclusive));
+    EXPECT_FALSE(dbconcurrency::IsCompatible(LockMode::kIntentionExclusive,
+                                             LockMode::kShared));
+    EXPECT_FALSE(dbconcurrency::IsCompatible(LockMode::kIntentionShared,
+                                             LockMode::kExclusive));
+    EXPECT_EQ(dbconcurrency::Supremum(LockMode::kIntentionExclusive,
+                                      LockMode::kShared),
+              LockMode::kSharedIntentionExclusive);
+    EXPECT_EQ(dbconcurrency::Supremum(LockMode::kShared,
+                                      LockMode::kIntentionShared),
+              LockMode::kShared);
+
+    // The transaction 1 holding S and requesting IX converts the lock to SIX,
+    // which is compatible only with IS.
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/0.1);
+    const dbconcurrency::LockID table("a.txt");
+    ASSERT_TRUE(lock_table.Lock(table, 1, LockMode::kShared).IsOk());
+    ASSERT_TRUE(
+        lock_table.Lock(table, 1, LockMode::kIntentionExclusive).IsOk());
+    EXPECT_TRUE(lock_table.Lock(table, 2, LockMode::kIntentionShared).IsOk());
+    EXPECT_TRUE(lock_table.Lock(table, 3, LockMode::kShared).IsError());
+    lock_table.Release(table, 1);
+    lock_table.Release(table, 2);
+    EXPECT_TRUE(lock_table.Lock(table, 3, LockMode::kShared).IsOk());
+    lock_table.Release(table, 3);
+}
+
+TEST(ConcurrencyManager, RecordsOfBlockAreLockedSeparately) {
+    dbconcurrency::LockTable lock_table(/*wait_time_sec=*/0.1);
+    dbconcurrency::ConcurrentManager manager0(lock_table, /*transaction_id=*/1);
+    dbconcurrency::ConcurrentManager manager1(lock_table, /*transaction_id=*/2);
+    dbconcurrency::ConcurrentManager manager2(lock_table, /*transaction_id=*/3);
+
+    // Different records of a block are written by different transactions.
+    EXPECT_TRUE(manager0.WriteLock(dbconcurrency::LockID(block0, 0)).IsOk());
+    EXPECT_TRUE(manager1.WriteLock(dbconcurrency::LockID(block0, 1)).IsOk());
+    EXPECT_TRUE(manager1.ReadLock(dbconcurrency::LockID(block0, 2)).IsOk());
+    EXPECT_TRUE(manager2.ReadLock(dbconcurrency::LockID(block0, 2)).IsOk());
+    EXPECT_TRUE(manager2.ReadLock(dbconcurrency::LockID(block0, 0)).IsError());
+
+    // The intention locks make the block and the table conflict with them.
+    dbconcurrency::ConcurrentManager manager3(lock_table, /*transaction_id=*/4);
+    EXPECT_TRUE(manager3.ReadLock(block0).IsError());
+    EXPECT_TRUE(manager3.ReadLock(block1).IsOk());
+    EXPECT_TRUE(
+        manager3.WriteLock(dbconcurrency::LockID(block0.Filename())).IsError());
+    manager3.Release();
+
+    manager0.Release();
+    manager1.Release();
+    manager2.Release();
+    EXPECT_TRUE(
+        manager3.WriteLock(dbconcurrency::LockID(block0.Filename())).IsOk());
+    manager3.Release();
 }
 
 void ReadWriteLock0() {
-    dbconcurrency::ConcurrentManager manager(lock_table);
+    dbconcurrency::ConcurrentManager manager(lock_table, /*transaction_id=*/8);
     Result result = manager.ReadLock(block0);
     EXPECT_TRUE(result.IsOk());
 
@@ -131,7 +360,7 @@ void ReadWriteLock0() {
 
 void ReadWriteLock1() {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    dbconcurrency::ConcurrentManager manager(lock_table);
+    dbconcurrency::ConcurrentManager manager(lock_table, /*transaction_id=*/9);
     Result result = manager.ReadLock(block1);
     EXPECT_TRUE(result.IsOk());
 
@@ -149,7 +378,8 @@ TEST(ConcurrencyManager, ConcurrencyManagerReadWriteLock) {
 }
 
 TEST(ConcurrencyManager, ConcurrencyManagerWriteLockWhileHavingReadLock) {
-    dbconcurrency::ConcurrentManager manager(lock_table);
+    dbconcurrency::ConcurrentManager manager(lock_table,
+                                             /*transaction_id=*/10);
 
     Result result = manager.ReadLock(block1);
     EXPECT_TRUE(result.IsOk());
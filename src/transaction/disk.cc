@@ -4,11 +4,14 @@
 #include "data/char.h"
 #include "data/int.h"
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <cerrno>
 #include <fcntl.h>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <vector>
 
@@ -21,6 +24,11 @@ const std::string &BlockID::Filename() const { return filename_; }
 
 const int BlockID::BlockIndex() const { return block_index_; }
 
+void BlockID::Assign(const std::string &filename, const int block_index) {
+    filename_.assign(filename);
+    block_index_ = block_index;
+}
+
 BlockID BlockID::operator+(int block_index_to_advance) const {
     return BlockID(filename_, block_index_ + block_index_to_advance);
 }
@@ -137,6 +145,20 @@ Result Block::WriteBytesWithOffsetLength(const size_t offset,
                  "the block.");
 }
 
+Result Block::XorBytesWithOffsetLength(const size_t offset,
+                                       const std::vector<uint8_t> &value,
+                                       const size_t value_offset,
+                                       const size_t length) {
+    if (offset + length <= content_.size() &&
+        value_offset + length <= value.size()) {
+        for (size_t i = 0; i < length; i++)
+            content_[offset + i] ^= value[value_offset + i];
+        return Ok();
+    }
+    return Error("disk::Block::XorBytesWithOffsetLength() value does not fit "
+                 "the block.");
+}
+
 ResultV<int> Block::ReadInt(const int offset) const {
     return data::ReadInt(content_, offset);
 }
@@ -172,108 +194,236 @@ DiskManager::DiskManager(const std::string &directory_path,
                          const int block_size)
     : directory_path_(directory_path), block_size_(block_size) {}
 
-Result DiskManager::Read(const BlockID &block_id, Block &block) {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+ResultV<DiskManager::FileHandle>
+DiskManager::FileDescriptor(const std::string &filename, const bool create) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = file_descriptors_.find(filename);
+        if (it != file_descriptors_.end()) return Ok(it->second);
+    }
 
-    std::ifstream file(directory_path_ + block_id.Filename(),
-                       std::ios::ate | std::ios::binary);
-    if (!file.is_open())
-        return Error("disk::DiskManager::Read() failed to open a file.");
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    auto it = file_descriptors_.find(filename);
+    if (it != file_descriptors_.end()) return Ok(it->second);
 
-    file.seekg(block_id.BlockIndex() * block_size_, std::ios::beg);
-    if (file.fail()) {
-        file.close();
-        return Error("disk::DiskManager::Read() failed to seek a file.");
+    int flags = O_RDWR;
+    if (create) {
+        if (!std::filesystem::exists(directory_path_)) {
+            std::filesystem::create_directories(directory_path_);
+        }
+        flags |= O_CREAT;
     }
 
+    int fd = open((directory_path_ + filename).c_str(), flags, 0644);
+    if (fd < 0)
+        return Error("disk::DiskManager::FileDescriptor() failed to open a "
+                     "file.");
+    FileHandle handle(new int(fd), [](const int *descriptor) {
+        close(*descriptor);
+        delete descriptor;
+    });
+    file_descriptors_[filename] = handle;
+    return Ok(handle);
+}
+
+Result DiskManager::Read(const BlockID &block_id, Block &block) {
+    ResultV<FileHandle> fd = FileDescriptor(block_id.Filename());
+    if (fd.IsError())
+        return fd + Error("disk::DiskManager::Read() failed to open a file.");
+
     std::vector<uint8_t> block_content(block_size_);
-    file.read((char *)&block_content[0], block_size_);
-    if (file.fail()) {
-        file.close();
-        return Error("disk::DiskManager::Read() failed to read a file.");
+    const off_t position = off_t(block_id.BlockIndex()) * block_size_;
+    size_t read_size     = 0;
+    while (read_size < block_size_) {
+        ssize_t result = pread(*fd.Get(), &block_content[read_size],
+                               block_size_ - read_size, position + read_size);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0)
+            return Error("disk::DiskManager::Read() failed to read a file.");
+        read_size += result;
     }
 
     block = Block(block_size_, block_content);
-    file.close();
     return Ok();
 }
 
-Result DiskManager::Write(const BlockID &block_id, const Block &block) {
-    std::lock_guard<std::shared_mutex> lock(mutex_);
-
-    std::ofstream file(directory_path_ + block_id.Filename(),
-                       std::ios::ate | std::ios::binary | std::ios::in);
-    if (!file.is_open())
-        return Error("disk::DiskManager::Write() failed to open a file.");
+Result DiskManager::ReadBlocks(const BlockID &first_block_id,
+                               const int block_count,
+                               std::vector<uint8_t> &bytes) {
+    ResultV<FileHandle> fd = FileDescriptor(first_block_id.Filename());
+    if (fd.IsError())
+        return fd +
+               Error("disk::DiskManager::ReadBlocks() failed to open a file.");
 
-    file.seekp(block_id.BlockIndex() * block_size_, std::ios::beg);
-    if (file.fail()) {
-        file.close();
-        return Error("disk::DiskManager::Write() failed to seek a file.");
+    const size_t length  = size_t(block_count) * block_size_;
+    const off_t position = off_t(first_block_id.BlockIndex()) * block_size_;
+    bytes.resize(length);
+    size_t read_size = 0;
+    while (read_size < length) {
+        ssize_t result = pread(*fd.Get(), &bytes[read_size],
+                               length - read_size, position + read_size);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0)
+            return Error(
+                "disk::DiskManager::ReadBlocks() failed to read a file.");
+        read_size += result;
     }
+    return Ok();
+}
+
+Result DiskManager::Write(const BlockID &block_id, const Block &block) {
+    ResultV<FileHandle> fd = FileDescriptor(block_id.Filename());
+    if (fd.IsError())
+        return fd + Error("disk::DiskManager::Write() failed to open a file.");
 
     const auto &content_vector = block.Content();
-    file.write((char *)&content_vector[0], block_size_);
-    if (file.fail()) {
-        file.close();
-        return Error("disk::DiskManager::Write() failed to write to a file.");
+    const off_t position       = off_t(block_id.BlockIndex()) * block_size_;
+    size_t written_size        = 0;
+    while (written_size < block_size_) {
+        ssize_t result =
+            pwrite(*fd.Get(), &content_vector[written_size],
+                   block_size_ - written_size, position + written_size);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0)
+            return Error(
+                "disk::DiskManager::Write() failed to write to a file.");
+        written_size += result;
     }
+    return Ok();
+}
 
-    file.close();
+Result DiskManager::WriteBlocks(const BlockID &first_block_id,
+                                const int block_count, const uint8_t *bytes) {
+    ResultV<FileHandle> fd = FileDescriptor(first_block_id.Filename());
+    if (fd.IsError())
+        return fd +
+               Error("disk::DiskManager::WriteBlocks() failed to open a file.");
+
+    const size_t length  = size_t(block_count) * block_size_;
+    const off_t position = off_t(first_block_id.BlockIndex()) * block_size_;
+    size_t written_size  = 0;
+    while (written_size < length) {
+        ssize_t result = pwrite(*fd.Get(), bytes + written_size,
+                                length - written_size, position + written_size);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0)
+            return Error(
+                "disk::DiskManager::WriteBlocks() failed to write to a file.");
+        written_size += result;
+    }
     return Ok();
 }
 
 Result DiskManager::Flush(const std::string &filename) {
-    std::lock_guard<std::shared_mutex> lock(mutex_);
-
-    int fd = open((directory_path_ + filename).c_str(), O_FSYNC);
-    if (fd < 0)
-        return Error("disk::DiskManager::Flush() failed to open a file.");
-
-    if (fsync(fd) < 0) {
-        close(fd);
-        return Error("disk::DiskManager::Flush() failed to fsync.");
-    }
+    ResultV<FileHandle> fd = FileDescriptor(filename);
+    if (fd.IsError())
+        return fd + Error("disk::DiskManager::Flush() failed to open a file.");
 
-    close(fd);
+    if (fdatasync(*fd.Get()) < 0)
+        return Error("disk::DiskManager::Flush() failed to fdatasync.");
     return Ok();
 }
 
 ResultV<size_t> DiskManager::Size(const std::string &filename) {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    ResultV<FileHandle> fd = FileDescriptor(filename);
+    if (fd.IsError()) return Ok(0);
 
-    try {
-        std::uintmax_t filesize =
-            std::filesystem::file_size(directory_path_ + filename);
-        return Ok((filesize / block_size_));
-    } catch (std::filesystem::filesystem_error) { return Ok(0); }
+    struct stat file_stat;
+    if (fstat(*fd.Get(), &file_stat) < 0)
+        return Error("disk::DiskManager::Size() failed to stat a file.");
+    return Ok(size_t(file_stat.st_size / block_size_));
 }
 
 Result DiskManager::AllocateNewBlocks(const BlockID &block_id) {
-    std::lock_guard<std::shared_mutex> lock(mutex_);
+    ResultV<FileHandle> fd =
+        FileDescriptor(block_id.Filename(), /*create=*/true);
+    if (fd.IsError())
+        return fd + Error("disk::DiskManager::AllocatedNewBlocks() failed to "
+                          "create a new file.");
+
+    if (ftruncate(*fd.Get(),
+                  off_t(block_id.BlockIndex() + 1) * block_size_) < 0)
+        return Error("disk::DiskManager::AllocatedNewBlocks() failed to "
+                     "allocate new blocks.");
+    return Ok();
+}
 
-    const auto filepath = directory_path_ + block_id.Filename();
-    if (!std::filesystem::exists(filepath)) {
-        if (!std::filesystem::exists(directory_path_)) {
-            std::filesystem::create_directories(directory_path_);
-        }
+ResultV<int> DiskManager::AppendBlocks(const std::string &filename,
+                                       const int block_count) {
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    ResultV<size_t> size = Size(filename);
+    if (size.IsError())
+        return size + Error("disk::DiskManager::AppendBlocks() failed to get "
+                            "the size of the file.");
+
+    const int first_block_index = size.Get();
+    Result allocate_result      = AllocateNewBlocks(
+        BlockID(filename, first_block_index + block_count - 1));
+    if (allocate_result.IsError())
+        return allocate_result + Error("disk::DiskManager::AppendBlocks() "
+                                       "failed to allocate the blocks.");
+    return Ok(first_block_index);
+}
 
-        // Uses std::ofstream to create the file.
-        std::ofstream file(filepath);
-        if (!file.is_open())
-            return Error("disk::DiskManager::AllocatedNewBlocks() failed to "
-                         "create a new file.");
-        file.close();
-    }
+Result DiskManager::PreallocateBlocks(const BlockID &block_id) {
+    ResultV<FileHandle> fd =
+        FileDescriptor(block_id.Filename(), /*create=*/true);
+    if (fd.IsError())
+        return fd + Error("disk::DiskManager::PreallocateBlocks() failed to "
+                          "create a new file.");
+
+    const off_t length = off_t(block_id.BlockIndex() + 1) * block_size_;
+    if (fallocate(*fd.Get(), 0, 0, length) == 0) return Ok();
+    if (errno != EOPNOTSUPP)
+        return Error("disk::DiskManager::PreallocateBlocks() failed to "
+                     "preallocate the blocks.");
+    if (ftruncate(*fd.Get(), length) < 0)
+        return Error("disk::DiskManager::PreallocateBlocks() failed to "
+                     "allocate the blocks.");
+    return Ok();
+}
 
-    try {
-        std::filesystem::resize_file(filepath,
-                                     (block_id.BlockIndex() + 1) * block_size_);
-        return Ok();
-    } catch (std::filesystem::filesystem_error) {
-        return Error("disk::DiskManager::AllocatedNewBlocks() failed to "
-                     "allocate new blocks.");
+Result DiskManager::Rename(const std::string &from, const std::string &to) {
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    if (rename((directory_path_ + from).c_str(),
+               (directory_path_ + to).c_str()) < 0)
+        return Error("disk::DiskManager::Rename() failed to rename a file.");
+
+    // The descriptor of the replaced file is closed when the I/O in progress
+    // on it finishes.
+    file_descriptors_.erase(to);
+    auto from_it = file_descriptors_.find(from);
+    if (from_it != file_descriptors_.end()) {
+        file_descriptors_[to] = from_it->second;
+        file_descriptors_.erase(from_it);
     }
+    return Ok();
+}
+
+Result DiskManager::Remove(const std::string &filename) {
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    file_descriptors_.erase(filename);
+    if (unlink((directory_path_ + filename).c_str()) < 0)
+        return Error("disk::DiskManager::Remove() failed to remove a file.");
+    return Ok();
+}
+
+Result DiskManager::DiscardBlocks(const BlockID &first_block_id,
+                                  const int block_count) {
+    if (block_count <= 0) return Ok();
+    ResultV<FileHandle> fd = FileDescriptor(first_block_id.Filename());
+    if (fd.IsError())
+        return fd + Error("disk::DiskManager::DiscardBlocks() failed to open a "
+                          "file.");
+
+    const off_t position = off_t(first_block_id.BlockIndex()) * block_size_;
+    const off_t length   = off_t(block_count) * block_size_;
+    if (fallocate(*fd.Get(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  position, length) < 0 &&
+        errno != EOPNOTSUPP)
+        return Error("disk::DiskManager::DiscardBlocks() failed to release "
+                     "the blocks.");
+    return Ok();
 }
 
 // Moves the `block` to the next block of `block_id`.
@@ -339,4 +489,19 @@ Result ReadBytesAcrossBlocks(disk::BlockID &block_id, int &offset,
     return Ok();
 }
 
-} // namespace disk
\ No newline at end of file
+} // namespace disk
+
+namespace std {
+
+size_t
+hash<disk::BlockID>::operator()(const disk::BlockID &block_id) const noexcept {
+    // Combines the hashes of the filename and the block index in the same way
+    // as boost::hash_combine. The block index is mixed in so that consecutive
+    // blocks of one file do not collide in the same bucket.
+    size_t seed = hash<std::string>()(block_id.Filename());
+    seed ^= hash<int>()(block_id.BlockIndex()) + 0x9e3779b97f4a7c15ULL +
+            (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+} // namespace std
\ No newline at end of file
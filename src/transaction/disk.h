@@ -4,8 +4,10 @@
 #include <cstdint>
 #include <data/data.h>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "result.h"
@@ -28,6 +30,10 @@ class BlockID {
     // Returns the block index.
     const int BlockIndex() const;
 
+    // Sets the filename and the block index. The memory of the filename is
+    // reused, so that a block id can be reused without allocating memory.
+    void Assign(const std::string &filename, const int block_index);
+
     BlockID operator+(int block_index_to_advance) const;
 
     BlockID &operator+=(int block_index_to_advance);
@@ -47,13 +53,6 @@ class BlockID {
     int block_index_;
 };
 
-// Returns end of file marker of the `filename`. This block is used to assure
-// that conflict does not occur when file size changes. To assure that the
-// conflict does not occur, the end of file is locked.
-inline BlockID EndOfFileBlockID(const std::string &filename) {
-    return BlockID(filename, -1);
-}
-
 // Specify position in the disk by BlockID and offset in the block.
 class DiskPosition {
   public:
@@ -62,7 +61,7 @@ class DiskPosition {
         : block_id_(block_id), offset_(offset) {}
 
     // Block id of the position
-    inline const disk::BlockID BlockID() const { return block_id_; }
+    inline const disk::BlockID &BlockID() const { return block_id_; }
 
     // Offset of the position in the block
     inline int Offset() const { return offset_; }
@@ -125,6 +124,14 @@ class Block {
                                       const size_t value_offset,
                                       const size_t length);
 
+    // XORs `value`[`value_offset`:`value_offset`+`length`] into the block with
+    // `offset`. If `value`[`value_offset`:`value_offset`+`length`] does not fit
+    // the block, return Error.
+    Result XorBytesWithOffsetLength(const size_t offset,
+                                    const std::vector<uint8_t> &value,
+                                    const size_t value_offset,
+                                    const size_t length);
+
     // Reads the int with the `offset`. The value is read as little-endian.
     ResultV<int> ReadInt(const int offset) const;
 
@@ -152,15 +159,24 @@ class Block {
     std::vector<uint8_t> content_;
 };
 
-// Manages writes and reads to disk.
+// Manages writes and reads to disk. Files are opened once and their file
+// descriptors are cached until this manager is destroyed, and blocks are read
+// and written with positional I/O (pread/pwrite). Therefore reads and writes
+// to different blocks (even of the same file) can run in parallel.
 class DiskManager {
   public:
     // Initiate a disk manager, the directory of `directory_path` should exist
     // when this disk manager is initiated.
     // WARNING: You should not use the same directory path for multiple
-    // DiskManager. This can cause unexpected behavior.
+    // DiskManager. This can cause unexpected behavior. Files in the directory
+    // must not be removed or replaced while this manager is alive except by
+    // `Rename()` and `Remove()`, because the opened file descriptors are
+    // cached.
     DiskManager(const std::string &directory_path, const int block_size);
 
+    // Closes all the cached file descriptors.
+    ~DiskManager() = default;
+
     // Returns a directory path which this instance manages.
     inline const std::string &DirectoryPath() const { return directory_path_; }
 
@@ -172,12 +188,25 @@ class DiskManager {
     // unintentional behavior.
     Result Read(const BlockID &block_id, Block &block);
 
+    // Reads `block_count` consecutive blocks from `first_block_id` with one
+    // read request. The content of the blocks is written to `bytes`, which is
+    // resized to `block_count` * `BlockSize()`.
+    Result ReadBlocks(const BlockID &first_block_id, const int block_count,
+                      std::vector<uint8_t> &bytes);
+
     // Writes the bytes `block` to the place of `block_id`. `block.BlockSize()`
     // and `this.BlockSize()` must be the same to run this function without any
     // unintentional behavior.
     Result Write(const BlockID &block_id, const Block &block);
 
-    // Flushes the writes of `directory_path`/`filename` to the disk.
+    // Writes `block_count` consecutive blocks from `first_block_id` with one
+    // write request. `bytes` must have `block_count` * `BlockSize()` bytes.
+    Result WriteBlocks(const BlockID &first_block_id, const int block_count,
+                       const uint8_t *bytes);
+
+    // Flushes the writes of `directory_path`/`filename` to the disk. The
+    // metadata of the file, such as the modification time, is not flushed
+    // unless it is needed to read the data (fdatasync).
     Result Flush(const std::string &filename);
 
     // The number of blocks in the file of `filename`.
@@ -189,10 +218,59 @@ class DiskManager {
     // `block_id.Filename()` exists, resize it.
     Result AllocateNewBlocks(const BlockID &block_id);
 
+    // Appends `block_count` new blocks to the end of the file of `filename`,
+    // and returns the index of the first appended block. The file is created
+    // if it does not exist. The appends are serialized by a latch, so that
+    // concurrent appends to a file get different blocks and never shrink it.
+    ResultV<int> AppendBlocks(const std::string &filename,
+                              const int block_count);
+
+    // Allocates the disk space of the blocks until the id of `block_id`
+    // (including the end) in the same way as `AllocateNewBlocks()`, but the
+    // space is reserved on disk, so that writes to the blocks do not change
+    // the size of the file. When the file system cannot reserve the space,
+    // the file is only resized.
+    Result PreallocateBlocks(const BlockID &block_id);
+
+    // Renames the file of `from` to `to`. The file of `to` is replaced if it
+    // exists. The cached file descriptor of `from` is kept for `to`. The file
+    // descriptor of the replaced file is closed after the I/O in progress on
+    // it finishes.
+    Result Rename(const std::string &from, const std::string &to);
+
+    // Removes the file of `filename` and closes its cached file descriptor
+    // after the I/O in progress on it finishes.
+    Result Remove(const std::string &filename);
+
+    // Releases the disk space of `block_count` consecutive blocks from
+    // `first_block_id` without changing the size of the file. The blocks are
+    // read as zeros afterwards. When the file system cannot release the space,
+    // this function does nothing.
+    Result DiscardBlocks(const BlockID &first_block_id, const int block_count);
+
   private:
+    // An opened file descriptor, which is closed when the last reference is
+    // dropped. A reference is held across each I/O, so that the descriptor is
+    // never closed (and its number reused by another file) while it is used.
+    using FileHandle = std::shared_ptr<const int>;
+
+    // Returns the cached file descriptor of `filename`. When the file is not
+    // opened yet, opens the file and caches the descriptor. If `create` is
+    // true, the file (and the directory) is created when it does not exist.
+    ResultV<FileHandle> FileDescriptor(const std::string &filename,
+                                       const bool create = false);
+
     const std::string directory_path_;
     const int block_size_;
+
+    // Maps a filename to its opened file descriptor. The mutex only guards the
+    // map, not I/O on the descriptors.
+    std::unordered_map<std::string, FileHandle> file_descriptors_;
     std::shared_mutex mutex_;
+
+    // Serializes `AppendBlocks()`, which reads and then changes the size of a
+    // file.
+    std::mutex append_mutex_;
 };
 
 // Read bytes which can lie across multiple blocks. `block_id` and `offset`
@@ -207,4 +285,14 @@ Result ReadBytesAcrossBlocks(disk::BlockID &block_id, int &offset,
 
 } // namespace disk
 
+namespace std {
+
+// Hash of `disk::BlockID`, so that a BlockID can be used as a key of unordered
+// containers such as the page table of the buffer manager.
+template <> struct hash<disk::BlockID> {
+    size_t operator()(const disk::BlockID &block_id) const noexcept;
+};
+
+} // namespace std
+
 #endif // DISK_H
\ No newline at end of file
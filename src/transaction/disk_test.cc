@@ -1,5 +1,8 @@
 #include "disk.h"
 #include "macro_test.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <data/int.h>
@@ -7,6 +10,8 @@
 #include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 TEST(BlockID, ReturnsCorrectFilename) {
     const disk::BlockID block_id("metadata.tbl", 0);
@@ -74,6 +79,16 @@ TEST(BlockID, CompareOrder) {
     EXPECT_TRUE(block_id0 < block_id3);
 }
 
+TEST(BlockID, EqualBlockIDsHaveEqualHash) {
+    const disk::BlockID block_id0("file0.tbl", 3), block_id1("file0.tbl", 3),
+        block_id2("file0.tbl", 4), block_id3("file1.tbl", 3);
+    const std::hash<disk::BlockID> hash;
+
+    EXPECT_EQ(hash(block_id0), hash(block_id1));
+    EXPECT_NE(hash(block_id0), hash(block_id2));
+    EXPECT_NE(hash(block_id0), hash(block_id3));
+}
+
 TEST(DiskPosition, InstantiationSuccess) {
     disk::DiskPosition position(disk::BlockID("filename", 1), 3);
 
@@ -390,6 +405,41 @@ TEST_F(TempFileTest, DiskManagerCorrectlyReads) {
     EXPECT_TRUE(block.ReadByte(3).IsError());
 }
 
+TEST_F(TempFileTest, DiskManagerReadsMultipleBlocks) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/3);
+    std::vector<uint8_t> bytes;
+
+    auto read_result = disk_manager.ReadBlocks(disk::BlockID(filename, 0),
+                                               /*block_count=*/2, bytes);
+
+    EXPECT_TRUE(read_result.IsOk()) << read_result.Error();
+    const std::vector<uint8_t> expect = {'h', 'e', 'l', 'l', 'o', ' '};
+    EXPECT_EQ(bytes, expect);
+    EXPECT_TRUE(disk_manager
+                    .ReadBlocks(disk::BlockID(filename, 1), /*block_count=*/2,
+                                bytes)
+                    .IsError());
+}
+
+TEST_F(TempFileTest, DiskManagerWritesMultipleBlocks) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/3);
+    const std::vector<uint8_t> bytes = {'w', 'o', 'r', 'l', 'd', '!'};
+
+    auto write_result = disk_manager.WriteBlocks(disk::BlockID(filename, 1),
+                                                 /*block_count=*/2,
+                                                 bytes.data());
+
+    EXPECT_TRUE(write_result.IsOk()) << write_result.Error();
+    std::vector<uint8_t> read_bytes;
+    ASSERT_TRUE(disk_manager
+                    .ReadBlocks(disk::BlockID(filename, 0), /*block_count=*/3,
+                                read_bytes)
+                    .IsOk());
+    const std::vector<uint8_t> expect = {'h', 'e', 'l', 'w', 'o',
+                                         'r', 'l', 'd', '!'};
+    EXPECT_EQ(read_bytes, expect);
+}
+
 TEST_F(NonExistentFileTest, DiskManagerReadFail) {
     disk::DiskManager disk_manager(directory_path,
                                    /*block_size=*/3);
@@ -489,6 +539,109 @@ TEST_F(NonExistentFileTest, DiskManagerAllocateNewFileSucceedsWithoutFile) {
         (block_index + 1) * block_size);
 }
 
+TEST_F(NonExistentFileTest, DiskManagerAppendsBlocksConcurrently) {
+    const int block_size   = 4;
+    const int thread_count = 4;
+    const int append_count = 16;
+    disk::DiskManager disk_manager(directory_path, block_size);
+
+    // Every append gets its own blocks, and the file has all of them.
+    std::vector<std::vector<int>> first_indexes(thread_count);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < append_count; i++) {
+                ResultV<int> first = disk_manager.AppendBlocks(
+                    non_existent_filename, /*block_count=*/2);
+                ASSERT_TRUE(first.IsOk()) << first.Error();
+                first_indexes[t].push_back(first.Get());
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    std::vector<int> all_indexes;
+    for (const std::vector<int> &indexes : first_indexes) {
+        all_indexes.insert(all_indexes.end(), indexes.begin(), indexes.end());
+    }
+    std::sort(all_indexes.begin(), all_indexes.end());
+    for (int i = 0; i < all_indexes.size(); i++) {
+        EXPECT_EQ(all_indexes[i], 2 * i);
+    }
+    EXPECT_EQ(disk_manager.Size(non_existent_filename).Get(),
+              2 * thread_count * append_count);
+}
+
+TEST_F(NonExistentFileTest, DiskManagerPreallocatesRenamesAndRemovesFile) {
+    const int block_size = 4;
+    disk::DiskManager disk_manager(directory_path, block_size);
+    ASSERT_TRUE(disk_manager
+                    .PreallocateBlocks(
+                        disk::BlockID(non_existent_filename, /*block_index=*/7))
+                    .IsOk());
+    EXPECT_EQ(disk_manager.Size(non_existent_filename).Get(), 8);
+    disk::Block block(block_size, "abcd");
+    ASSERT_TRUE(
+        disk_manager.Write(disk::BlockID(non_existent_filename, 3), block)
+            .IsOk());
+
+    // The file is read under the new name after it is renamed.
+    const std::string renamed_filename = non_existent_filename + ".renamed";
+    ASSERT_TRUE(
+        disk_manager.Rename(non_existent_filename, renamed_filename).IsOk());
+    EXPECT_FALSE(
+        std::filesystem::exists(directory_path + non_existent_filename));
+    disk::Block read_block;
+    ASSERT_TRUE(
+        disk_manager.Read(disk::BlockID(renamed_filename, 3), read_block)
+            .IsOk());
+    EXPECT_EQ(read_block.Content(), block.Content());
+
+    ASSERT_TRUE(disk_manager.Remove(renamed_filename).IsOk());
+    EXPECT_FALSE(std::filesystem::exists(directory_path + renamed_filename));
+    EXPECT_TRUE(disk_manager.Remove(renamed_filename).IsError());
+}
+
+TEST_F(NonExistentFileTest, DiskManagerRemoveDoesNotRedirectWritesInProgress) {
+    const int block_size = 4, repeat_count = 1000;
+    disk::DiskManager disk_manager(directory_path, block_size);
+    const std::string removed_filename = non_existent_filename + ".removed";
+    const disk::Block block(block_size, "abcd");
+
+    // A file is removed while another thread writes to it, and a new file is
+    // opened at once. The writes to the removed file must not go to the new
+    // file, even if the new file gets the same file descriptor number.
+    for (int i = 0; i < repeat_count; i++) {
+        ASSERT_TRUE(
+            disk_manager.AllocateNewBlocks(disk::BlockID(removed_filename, 0))
+                .IsOk());
+        std::atomic<bool> stopped = false;
+        std::thread writer([&] {
+            while (!stopped) {
+                disk_manager.Write(disk::BlockID(removed_filename, 0), block);
+            }
+        });
+        ASSERT_TRUE(disk_manager.Remove(removed_filename).IsOk());
+        ASSERT_TRUE(
+            disk_manager
+                .AllocateNewBlocks(disk::BlockID(non_existent_filename, 0))
+                .IsOk());
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        stopped = true;
+        writer.join();
+
+        disk::Block read_block;
+        ASSERT_TRUE(
+            disk_manager.Read(disk::BlockID(non_existent_filename, 0),
+                              read_block)
+                .IsOk());
+        ASSERT_EQ(read_block.Content(), std::vector<uint8_t>(block_size, 0));
+        ASSERT_TRUE(disk_manager.Remove(non_existent_filename).IsOk());
+    }
+}
+
 TEST_F(
     TempFileTest,
     DiskManagerCorrectlyReadAndWriteBytesIncludingNullCharacterAndTrailingSpace) {
@@ -507,6 +660,49 @@ TEST_F(
     EXPECT_EQ(block.Content(), original_content);
 }
 
+TEST_F(TempFileTest, DiskManagerWritesDifferentBlocksInParallel) {
+    const int block_size = 16, block_count = 64, thread_count = 4;
+    disk::DiskManager manager(/*directory_path=*/directory_path,
+                              /*block_size=*/block_size);
+    ASSERT_TRUE(
+        manager.AllocateNewBlocks(disk::BlockID(filename, block_count - 1))
+            .IsOk());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&manager, this, t] {
+            for (int i = t; i < block_count; i += thread_count) {
+                disk::Block block(block_size);
+                block.WriteInt(/*offset=*/0, i);
+                EXPECT_TRUE(
+                    manager.Write(disk::BlockID(filename, i), block).IsOk());
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (int i = 0; i < block_count; i++) {
+        disk::Block block;
+        ASSERT_TRUE(manager.Read(disk::BlockID(filename, i), block).IsOk());
+        EXPECT_EQ(block.ReadInt(/*offset=*/0).Get(), i);
+    }
+}
+
+TEST_F(TempFileTest, DiskManagerReadsBlocksAllocatedAfterOpening) {
+    const int block_size = 3;
+    disk::DiskManager manager(/*directory_path=*/directory_path,
+                              /*block_size=*/block_size);
+    disk::Block block;
+    ASSERT_TRUE(manager.Read(disk::BlockID(filename, 0), block).IsOk());
+    EXPECT_TRUE(manager.Read(disk::BlockID(filename, 4), block).IsError());
+
+    ASSERT_TRUE(manager.AllocateNewBlocks(disk::BlockID(filename, 4)).IsOk());
+
+    EXPECT_EQ(manager.Size(filename).Get(), 5);
+    EXPECT_TRUE(manager.Read(disk::BlockID(filename, 4), block).IsOk());
+}
+
 TEST_F(TempFileTest, DiskReadBytesAcrossBlocksOneBlockSuccess) {
     const size_t block_size = 5;
     disk::DiskManager manager(directory_path, block_size);
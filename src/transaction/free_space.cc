@@ -0,0 +1,31 @@
+#include "free_space.h"
+
+namespace disk {
+
+int FreeSpaceMap::Find(const std::string &filename, const int block_count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    File &file = files_[filename];
+    if (!file.free_blocks.empty()) return *file.free_blocks.begin();
+    if (file.checked_block_count < block_count)
+        return file.checked_block_count++;
+    return kNoFreeBlock;
+}
+
+void FreeSpaceMap::Add(const std::string &filename,
+                       const int first_block_index,
+                       const int last_block_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    File &file = files_[filename];
+    for (int block_index = first_block_index; block_index <= last_block_index;
+         block_index++) {
+        file.free_blocks.insert(block_index);
+    }
+}
+
+void FreeSpaceMap::Remove(const std::string &filename,
+                          const int block_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_[filename].free_blocks.erase(block_index);
+}
+
+} // namespace disk
@@ -0,0 +1,56 @@
+#ifndef _TRANSACTION_FREE_SPACE_H
+#define _TRANSACTION_FREE_SPACE_H
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace disk {
+
+// Returned by `FreeSpaceMap::Find()` when no block may have free space.
+constexpr int kNoFreeBlock = -1;
+
+// FreeSpaceMap tracks the blocks of each file which may have free space, so
+// that an insert goes to such a block without probing the whole file. All
+// these class methods are thread-safe.
+//
+// The map is only a hint. It is kept in memory and not locked for the
+// transactions, so the caller must check that the block actually has free
+// space, and remove the block with `Remove()` when it does not. After the
+// restart, the map knows nothing about the existing blocks, so `Find()`
+// returns each of them once, from the first one, after the blocks known to
+// have free space run out. Thus every block is checked at most once until it
+// is added again.
+class FreeSpaceMap {
+  public:
+    // Returns the index of a block of the file `filename`, which has
+    // `block_count` blocks, which may have free space. If there is no such
+    // block, returns `kNoFreeBlock`.
+    int Find(const std::string &filename, const int block_count);
+
+    // Tells that the blocks of `filename` from `first_block_index` to
+    // `last_block_index` (including the end) may have free space.
+    void Add(const std::string &filename, const int first_block_index,
+             const int last_block_index);
+
+    // Tells that the block of `filename` has no free space.
+    void Remove(const std::string &filename, const int block_index);
+
+  private:
+    struct File {
+        // The blocks which may have free space.
+        std::set<int> free_blocks;
+
+        // The number of blocks from the first one returned by `Find()` while
+        // the free blocks were unknown.
+        int checked_block_count = 0;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, File> files_;
+};
+
+} // namespace disk
+
+#endif
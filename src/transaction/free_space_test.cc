@@ -0,0 +1,34 @@
+#include "free_space.h"
+#include <gtest/gtest.h>
+
+TEST(FreeSpaceMap, FindsAddedBlocks) {
+    disk::FreeSpaceMap free_space_map;
+    free_space_map.Add("a.txt", 2, 4);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/5), 2);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/5), 2);
+
+    free_space_map.Remove("a.txt", 2);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/5), 3);
+    free_space_map.Remove("a.txt", 3);
+    free_space_map.Remove("a.txt", 4);
+
+    // The blocks of the other files are not affected.
+    EXPECT_EQ(free_space_map.Find("b.txt", /*block_count=*/0),
+              disk::kNoFreeBlock);
+}
+
+TEST(FreeSpaceMap, FindsUncheckedBlocksOnce) {
+    disk::FreeSpaceMap free_space_map;
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/2), 0);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/2), 1);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/2),
+              disk::kNoFreeBlock);
+
+    // The blocks known to have free space are found first.
+    free_space_map.Add("a.txt", 0, 0);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/3), 0);
+    free_space_map.Remove("a.txt", 0);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/3), 2);
+    EXPECT_EQ(free_space_map.Find("a.txt", /*block_count=*/3),
+              disk::kNoFreeBlock);
+}
@@ -0,0 +1,81 @@
+// Measures the throughput of LockTable when concurrent transactions lock
+// random blocks, with the lock table split into shards. Each transaction
+// takes read locks on a few blocks and a write lock on one, and releases
+// them all at the end, so most lock requests are granted without waiting.
+//
+// usage: lock_benchmark [transactions per thread]
+
+#include "concurrency.h"
+#include "disk.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string kDataFilename = "data";
+const int kBlockCount           = 4096;
+const int kReadsPerTransaction  = 4;
+const double kWaitTimeSec       = 1.0;
+
+// Runs `thread_count` threads which each run `transaction_count`
+// transactions, and returns the number of lock requests per second.
+double RunWorkload(dbconcurrency::LockTable &lock_table,
+                   const int thread_count, const int transaction_count) {
+    std::vector<std::thread> threads;
+    std::atomic<dblog::TransactionID> next_transaction_id = 1;
+    std::atomic<size_t> granted                        = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+            std::mt19937 engine(/*seed=*/t);
+            std::uniform_int_distribution<int> index(0, kBlockCount - 1);
+            for (int i = 0; i < transaction_count; i++) {
+                dbconcurrency::ConcurrentManager manager(
+                    lock_table, next_transaction_id++);
+                for (int j = 0; j < kReadsPerTransaction; j++) {
+                    const disk::BlockID block_id(kDataFilename, index(engine));
+                    if (manager.ReadLock(block_id).IsOk()) granted++;
+                }
+                const disk::BlockID block_id(kDataFilename, index(engine));
+                if (manager.WriteLock(block_id).IsOk()) granted++;
+                manager.Release();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return granted / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const int transaction_count = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    std::printf("blocks: %d, transactions per thread: %d\n", kBlockCount,
+                transaction_count);
+    std::printf("%-8s %12s %12s %12s\n", "threads", "1 shard", "16 shards",
+                "deadlocks");
+    for (const int thread_count : {1, 2, 4, 8}) {
+        std::printf("%-8d", thread_count);
+        size_t deadlock_count = 0;
+        for (const int shard_count : {1, 16}) {
+            dbconcurrency::LockTable lock_table(kWaitTimeSec, shard_count);
+            std::printf(" %12.0f", RunWorkload(lock_table, thread_count,
+                                               transaction_count));
+            deadlock_count += lock_table.DeadlockCount();
+        }
+        std::printf(" %12zu\n", deadlock_count);
+    }
+    return 0;
+}
@@ -1,18 +1,28 @@
 #include "log.h"
 #include "data/int.h"
 #include "data/uint32.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
 #include <iostream>
+#include <set>
+#include <thread>
 
 namespace dblog {
 
 namespace internal {
 
-constexpr int kDefaultOffset = 4;
+constexpr int kDefaultOffset = 8;
 
 LogBlock::LogBlock(const int block_size) : block_(block_size) {
     UpdateOffset(kDefaultOffset);
 }
 
+LogBlock::LogBlock(const disk::Block &block, const int offset)
+    : block_(block) {
+    UpdateOffset(offset);
+}
+
 ResultE<size_t> LogBlock::Append(const std::vector<uint8_t> &bytes,
                                  size_t bytes_offset) {
     ResultE<size_t> append_result =
@@ -28,6 +38,8 @@ ResultE<size_t> LogBlock::Append(const std::vector<uint8_t> &bytes,
 
 constexpr int kOffsetPositionInLogBlock = 0;
 
+constexpr int kBlockNumberPositionInLogBlock = 4;
+
 Result LogBlock::ReadLogBlock(disk::DiskManager &disk_manager,
                               const disk::BlockID block_id) {
     Result read_result = disk_manager.Read(block_id, block_);
@@ -37,7 +49,7 @@ Result LogBlock::ReadLogBlock(disk::DiskManager &disk_manager,
 
     // NOTE: We don't care the error case as block_ is assured to be large
     // enough to store the offset, more specifically size of the block_ is
-    // larger than 4.
+    // larger than 8.
     offset_ = block_.ReadInt(kOffsetPositionInLogBlock).Get();
     return Ok();
 }
@@ -47,16 +59,106 @@ void LogBlock::UpdateOffset(int new_offset) {
 
     // NOTE: We don't care the error case as block_ is assured to be large
     // enough to store the offset, more specifically size of the block_ is
-    // larger than 4.
+    // larger than 8.
     block_.WriteInt(/*offset=*/kOffsetPositionInLogBlock, /*value=*/offset_);
 }
 
+// Returns true if the log block of `block_index` placed at `block_start` of
+// `bytes` has been written, that is, it has a valid offset and its block
+// number is `block_index`.
+bool IsWrittenLogBlock(const std::vector<uint8_t> &bytes,
+                       const size_t block_start, const int block_index,
+                       const int block_size) {
+    // NOTE: We don't care the error case as the offset region is in `bytes`.
+    const int offset =
+        data::ReadInt(bytes, block_start + kOffsetPositionInLogBlock).Get();
+    const int block_number =
+        data::ReadInt(bytes, block_start + kBlockNumberPositionInLogBlock)
+            .Get();
+    return kDefaultOffset <= offset && offset <= block_size &&
+           block_number == block_index;
+}
+
+LogSegments::LogSegments(disk::DiskManager &disk_manager,
+                         const std::string &log_filename,
+                         const int segment_block_count)
+    : disk_manager_(disk_manager), log_filename_(log_filename),
+      segment_block_count_(segment_block_count) {}
+
+std::string LogSegments::SegmentFilename(const int segment) const {
+    return log_filename_ + "." + std::to_string(segment);
+}
+
+disk::BlockID LogSegments::SegmentBlockID(const int block_index) const {
+    return disk::BlockID(SegmentFilename(block_index / segment_block_count_),
+                         block_index % segment_block_count_);
+}
+
+Result LogSegments::ReadLogBlock(const int block_index, LogBlock &block) {
+    Result read_result =
+        block.ReadLogBlock(disk_manager_, SegmentBlockID(block_index));
+    if (read_result.IsError())
+        return read_result + Error("dblog::internal::LogSegments::"
+                                   "ReadLogBlock() failed to read the log "
+                                   "block.");
+
+    if (!IsWrittenLogBlock(block.RawBlock().Content(), 0, block_index,
+                           BlockSize()))
+        block = LogBlock(BlockSize());
+    return Ok();
+}
+
+Result LogSegments::ReadBlocks(const int first_block_index,
+                               const int block_count,
+                               std::vector<uint8_t> &bytes) {
+    // The log blocks in one log segment are read with one read request.
+    const int stop = first_block_index + block_count;
+    bytes.clear();
+    bytes.reserve(size_t(block_count) * BlockSize());
+    std::vector<uint8_t> segment_bytes;
+    for (int block_index = first_block_index; block_index < stop;) {
+        const int count =
+            std::min(stop - block_index,
+                     segment_block_count_ -
+                         block_index % segment_block_count_);
+        Result read_result = disk_manager_.ReadBlocks(
+            SegmentBlockID(block_index), count, segment_bytes);
+        if (read_result.IsError())
+            return read_result + Error("dblog::internal::LogSegments::"
+                                       "ReadBlocks() failed to read the log "
+                                       "blocks.");
+        bytes.insert(bytes.end(), segment_bytes.begin(), segment_bytes.end());
+        block_index += count;
+    }
+    return Ok();
+}
+
+Result LogSegments::WriteBlocks(const int first_block_index,
+                                const int block_count, const uint8_t *bytes) {
+    const int stop = first_block_index + block_count;
+    for (int block_index = first_block_index; block_index < stop;) {
+        const int count =
+            std::min(stop - block_index,
+                     segment_block_count_ -
+                         block_index % segment_block_count_);
+        Result write_result = disk_manager_.WriteBlocks(
+            SegmentBlockID(block_index), count,
+            bytes + size_t(block_index - first_block_index) * BlockSize());
+        if (write_result.IsError())
+            return write_result + Error("dblog::internal::LogSegments::"
+                                        "WriteBlocks() failed to write the "
+                                        "log blocks.");
+        block_index += count;
+    }
+    return Ok();
+}
+
 // Read bytes which can lie across multiple log blocks. `position` specifies the
 // start position to read the bytes. The `position` needs to be located outside
 // the offset region of the block (outside the first `kDefaultOffset` bytes of
 // the block). `block` is the block in which `position` is located. `length` is
 // the length of the bytes to read. The bytes are written to `bytes`.
-Result ReadBytesAcrossBlocks(disk::DiskManager &disk_manager,
+Result ReadBytesAcrossBlocks(LogSegments &segments,
                              const LogBlock &block,
                              const disk::DiskPosition &position, int length,
                              std::vector<uint8_t> &bytes) {
@@ -65,9 +167,9 @@ Result ReadBytesAcrossBlocks(disk::DiskManager &disk_manager,
                      "not be first kDefaultOffset bytes of the block.");
 
     int length_of_first_block =
-        (position.Offset() + length <= disk_manager.BlockSize()
+        (position.Offset() + length <= segments.BlockSize()
              ? length
-             : disk_manager.BlockSize() - position.Offset());
+             : segments.BlockSize() - position.Offset());
 
     Result read_result = block.RawBlock().ReadBytes(
         position.Offset(), length_of_first_block, bytes);
@@ -78,14 +180,14 @@ Result ReadBytesAcrossBlocks(disk::DiskManager &disk_manager,
 
     if (length == 0) return Ok();
 
-    const int log_block_size       = disk_manager.BlockSize() - kDefaultOffset;
+    const int log_block_size       = segments.BlockSize() - kDefaultOffset;
     disk::BlockID current_block_id = position.BlockID();
     LogBlock current_block         = block;
 
     while (length > 0) {
         current_block_id += 1;
-        Result read_result =
-            current_block.ReadLogBlock(disk_manager, current_block_id);
+        Result read_result = segments.ReadLogBlock(
+            current_block_id.BlockIndex(), current_block);
         if (read_result.IsError())
             return read_result + Error("dblog::internal::ReadBytesAcrossBlocks("
                                        ") failed to read the blocks");
@@ -113,12 +215,12 @@ Result ReadBytesAcrossBlocks(disk::DiskManager &disk_manager,
 // the start position to read the bytes. The `position` needs to be located
 // outside the offset region of the block (outside the first `kDefaultOffset`
 // bytes of the block). `block` is the block in which `position` is located.
-ResultV<uint32_t> ReadUint32AcrossBlocks(disk::DiskManager &disk_manager,
+ResultV<uint32_t> ReadUint32AcrossBlocks(LogSegments &segments,
                                          const LogBlock &block,
                                          const disk::DiskPosition &position) {
     std::vector<uint8_t> uint32_bytes(data::kUint32Bytesize);
     auto read_result = ReadBytesAcrossBlocks(
-        disk_manager, block, position, data::kUint32Bytesize, uint32_bytes);
+        segments, block, position, data::kUint32Bytesize, uint32_bytes);
     if (read_result.IsError()) {
         return read_result +
                Error("dblog::internal::ReadUint32AcrossBlocks() failed to read "
@@ -144,40 +246,41 @@ disk::DiskPosition MoveInLogBlock(const disk::DiskPosition &position,
 // The `position` needs to be located outside the offset region of the block.
 // `block` is the block in which `position` is located. `length` is the length
 // of the bytes to read. The bytes are written to `bytes`.
-Result ReadBytesAcrossBlocksWithOffset(disk::DiskManager &disk_manager,
+Result ReadBytesAcrossBlocksWithOffset(LogSegments &segments,
                                        const LogBlock &block,
                                        const disk::DiskPosition &position,
                                        const int offset, int length,
                                        std::vector<uint8_t> &bytes) {
     disk::DiskPosition start_position =
-        MoveInLogBlock(position, offset, disk_manager.BlockSize());
+        MoveInLogBlock(position, offset, segments.BlockSize());
     if (start_position.BlockID() == position.BlockID()) {
-        return ReadBytesAcrossBlocks(disk_manager, block, start_position,
-                                     length, bytes);
+        return ReadBytesAcrossBlocks(segments, block, start_position, length,
+                                     bytes);
     }
 
     LogBlock start_block;
     auto read_result =
-        start_block.ReadLogBlock(disk_manager, start_position.BlockID());
+        segments.ReadLogBlock(start_position.BlockID().BlockIndex(),
+                              start_block);
     if (read_result.IsError())
         return read_result +
                Error("dblog::internal::ReadBytesAcrossBlocksWithOffset() "
                      "failed to read the start block.");
-    return ReadBytesAcrossBlocks(disk_manager, start_block, start_position,
-                                 length, bytes);
+    return ReadBytesAcrossBlocks(segments, start_block, start_position, length,
+                                 bytes);
 }
 
 // Read int which can lie across multiple log blocks.
 // `position.`.Move(`offset`) specifies the start position to read the bytes.
 // The `position` needs to be located outside the offset region of the block.
 // `block` is the block in which `position` is located.
-ResultV<int> ReadIntAcrossBlocksWithOffset(disk::DiskManager &disk_manager,
+ResultV<int> ReadIntAcrossBlocksWithOffset(LogSegments &segments,
                                            const LogBlock &block,
                                            const disk::DiskPosition &position,
                                            const int offset) {
     std::vector<uint8_t> int_bytes(data::kIntBytesize);
     auto read_result = ReadBytesAcrossBlocksWithOffset(
-        disk_manager, block, position, offset, data::kIntBytesize, int_bytes);
+        segments, block, position, offset, data::kIntBytesize, int_bytes);
     if (read_result.IsError()) {
         return read_result +
                Error("dblog::internal::ReadIntAcrossBlocksWithOffset() failed "
@@ -201,12 +304,12 @@ constexpr size_t kApproximateLogRecordLength =
 
 // Read the previous log of the log which starts from `log_start`. The `block`
 // is the block that `log_start` is located.
-ResultV<LogIterator> ReadPreviousLog(disk::DiskManager &disk_manager,
+ResultV<LogIterator> ReadPreviousLog(internal::LogSegments &segments,
                                      const disk::DiskPosition &log_start,
                                      const internal::LogBlock &block) {
 
     ResultV<int> log_body_length_result =
-        internal::ReadIntAcrossBlocksWithOffset(disk_manager, block, log_start,
+        internal::ReadIntAcrossBlocksWithOffset(segments, block, log_start,
                                                 -kLogLengthBytesize);
     if (log_body_length_result.IsError()) {
         return log_body_length_result +
@@ -217,31 +320,31 @@ ResultV<LogIterator> ReadPreviousLog(disk::DiskManager &disk_manager,
     disk::DiskPosition previous_log_start = internal::MoveInLogBlock(
         log_start,
         -(kLogHeaderLength + log_body_length_result.Get() + kLogLengthBytesize),
-        disk_manager.BlockSize());
+        segments.BlockSize());
 
     if (previous_log_start.BlockID() == log_start.BlockID()) {
-        return Ok(LogIterator(disk_manager, previous_log_start,
+        return Ok(LogIterator(segments, previous_log_start,
                               log_body_length_result.Get(), block));
     }
-    return Ok(LogIterator(disk_manager, previous_log_start,
+    return Ok(LogIterator(segments, previous_log_start,
                           log_body_length_result.Get()));
 }
 
-LogIterator::LogIterator(disk::DiskManager &disk_manager,
+LogIterator::LogIterator(internal::LogSegments &segments,
                          const disk::DiskPosition &log_start,
                          int log_body_length)
-    : disk_manager_(disk_manager), log_start_(log_start),
+    : segments_(segments), log_start_(log_start),
       log_body_length_(log_body_length) {}
 
-LogIterator::LogIterator(disk::DiskManager &disk_manager,
+LogIterator::LogIterator(internal::LogSegments &segments,
                          const disk::DiskPosition &log_start,
                          int log_body_length, const internal::LogBlock &block)
-    : disk_manager_(disk_manager), log_start_(log_start),
+    : segments_(segments), log_start_(log_start),
       log_body_length_(log_body_length),
       log_start_block_(new internal::LogBlock(block)) {}
 
 LogIterator::LogIterator(const LogIterator &other)
-    : disk_manager_(other.disk_manager_), log_start_(other.log_start_),
+    : segments_(other.segments_), log_start_(other.log_start_),
       log_body_length_(other.log_body_length_) {
     if (other.log_start_block_) {
         log_start_block_ = std::unique_ptr<internal::LogBlock>(
@@ -267,14 +370,14 @@ ResultV<std::vector<uint8_t>> LogIterator::LogBody() {
     }
 
     auto checksum_result = internal::ReadUint32AcrossBlocks(
-        disk_manager_, block_result.Get(), log_start_);
+        segments_, block_result.Get(), log_start_);
     if (checksum_result.IsError())
         return checksum_result +
                Error("dblog::LogIterator::LogBody() failed to read checksum.");
 
     std::vector<uint8_t> log_body;
     auto read_result = ReadBytesAcrossBlocksWithOffset(
-        disk_manager_, block_result.Get(), log_start_, kLogHeaderLength,
+        segments_, block_result.Get(), log_start_, kLogHeaderLength,
         log_body_length_, log_body);
     if (read_result.IsError()) {
         return read_result +
@@ -291,7 +394,7 @@ ResultV<bool> LogIterator::HasNext() {
     const int log_record_length =
         kLogHeaderLength + log_body_length_ + kLogLengthBytesize;
     disk::DiskPosition next_log_start = internal::MoveInLogBlock(
-        log_start_, log_record_length, disk_manager_.BlockSize());
+        log_start_, log_record_length, segments_.BlockSize());
 
     if (next_log_start.BlockID() == log_start_.BlockID()) {
         auto block_result = LogStartBlock();
@@ -304,8 +407,8 @@ ResultV<bool> LogIterator::HasNext() {
     }
 
     internal::LogBlock next_log_block;
-    Result read_result =
-        next_log_block.ReadLogBlock(disk_manager_, next_log_start.BlockID());
+    Result read_result = segments_.ReadLogBlock(
+        next_log_start.BlockID().BlockIndex(), next_log_block);
     if (read_result.IsError()) {
         return read_result + Error("dblog::LogIterator::HasNext() failed to "
                                    "read next log start block.");
@@ -323,7 +426,7 @@ Result LogIterator::Next() {
     const int log_record_length =
         kLogHeaderLength + log_body_length_ + kLogLengthBytesize;
     ResultV<int> next_log_body_length_result = ReadIntAcrossBlocksWithOffset(
-        disk_manager_, block_result.Get(), log_start_,
+        segments_, block_result.Get(), log_start_,
         log_record_length + kChecksumBytesize);
     if (next_log_body_length_result.IsError()) {
         return next_log_body_length_result +
@@ -332,7 +435,7 @@ Result LogIterator::Next() {
     }
 
     disk::DiskPosition next_log_start = internal::MoveInLogBlock(
-        log_start_, log_record_length, disk_manager_.BlockSize());
+        log_start_, log_record_length, segments_.BlockSize());
 
     if (next_log_start.BlockID() != log_start_.BlockID()) {
         this->log_start_block_.reset();
@@ -358,7 +461,7 @@ Result LogIterator::Previous() {
     }
 
     auto previous_log_result =
-        ReadPreviousLog(disk_manager_, log_start_, block_result.Get());
+        ReadPreviousLog(segments_, log_start_, block_result.Get());
     if (previous_log_result.IsError())
         return previous_log_result + Error("dblog::LogIterator::Previous() "
                                            "failed to read previous log.");
@@ -376,8 +479,8 @@ ResultV<internal::LogBlock> LogIterator::LogStartBlock() {
     if (log_start_block_) { return Ok(*log_start_block_.get()); }
 
     log_start_block_ = std::make_unique<internal::LogBlock>();
-    auto read_result =
-        log_start_block_->ReadLogBlock(disk_manager_, log_start_.BlockID());
+    auto read_result = segments_.ReadLogBlock(log_start_.BlockID().BlockIndex(),
+                                              *log_start_block_);
     if (read_result.IsError()) {
         return read_result + Error("dblog::LogIterator::LogStartBlock() failed "
                                    "to read log start block.");
@@ -385,115 +488,992 @@ ResultV<internal::LogBlock> LogIterator::LogStartBlock() {
     return Ok(*log_start_block_.get());
 }
 
+LogReader::LogReader(internal::LogSegments &segments,
+                     const disk::BlockID &last_block_id,
+                     const internal::LogBlock &last_block,
+                     const int window_block_count)
+    : segments_(segments), last_block_id_(last_block_id),
+      last_block_(last_block),
+      window_block_count_(std::max(1, window_block_count)),
+      data_size_(segments.BlockSize() - internal::kDefaultOffset),
+      end_(uint64_t(last_block_id.BlockIndex()) * data_size_ +
+           last_block.Offset() - internal::kDefaultOffset) {}
+
+Result LogReader::SeekToFirst() {
+    forward_ = true;
+    valid_   = false;
+    if (end_ == 0) return Ok();
+    return MoveTo(0);
+}
+
+Result LogReader::SeekToLast() {
+    forward_ = false;
+    valid_   = false;
+    if (end_ == 0) return Ok();
+
+    ResultV<int> log_body_length = ReadInt(end_ - kLogLengthBytesize);
+    if (log_body_length.IsError()) {
+        return log_body_length + Error("dblog::LogReader::SeekToLast() failed "
+                                       "to read log body length in tail.");
+    }
+    const uint64_t log_record_length =
+        kLogHeaderLength + log_body_length.Get() + kLogLengthBytesize;
+    if (log_body_length.Get() < 0 || log_record_length > end_) {
+        return Error("dblog::LogReader::SeekToLast() the log body length in "
+                     "tail is broken.");
+    }
+    return MoveTo(end_ - log_record_length);
+}
+
+Result LogReader::Seek(const LogSequenceNumber lsn) {
+    if (lsn >= end_)
+        return Error("dblog::LogReader::Seek() the log sequence number is out "
+                     "of the log.");
+    return MoveTo(lsn);
+}
+
+bool LogReader::HasNext() const {
+    return valid_ && position_ + kLogHeaderLength + log_body_length_ +
+                             kLogLengthBytesize <
+                         end_;
+}
+
+Result LogReader::Next() {
+    if (!HasNext())
+        return Error("dblog::LogReader::Next() there is no next log record.");
+    forward_ = true;
+    return MoveTo(position_ + kLogHeaderLength + log_body_length_ +
+                  kLogLengthBytesize);
+}
+
+bool LogReader::HasPrevious() const { return valid_ && position_ > 0; }
+
+Result LogReader::Previous() {
+    if (!HasPrevious())
+        return Error(
+            "dblog::LogReader::Previous() there is no previous log record.");
+    forward_ = false;
+
+    ResultV<int> log_body_length = ReadInt(position_ - kLogLengthBytesize);
+    if (log_body_length.IsError()) {
+        return log_body_length + Error("dblog::LogReader::Previous() failed "
+                                       "to read log body length in tail.");
+    }
+    const uint64_t log_record_length =
+        kLogHeaderLength + log_body_length.Get() + kLogLengthBytesize;
+    if (log_body_length.Get() < 0 || log_record_length > position_) {
+        return Error("dblog::LogReader::Previous() the log body length in "
+                     "tail is broken.");
+    }
+    return MoveTo(position_ - log_record_length);
+}
+
+ResultV<std::vector<uint8_t>> LogReader::LogBody() {
+    ResultV<LogBodyView> view_result = ViewLogBody();
+    if (view_result.IsError()) return Error(view_result.Error());
+    const LogBodyView &view = view_result.Get();
+    return Ok(std::vector<uint8_t>(view.bytes->begin() + view.begin,
+                                   view.bytes->begin() + view.end));
+}
+
+ResultV<LogBodyView> LogReader::ViewLogBody() {
+    if (!valid_)
+        return Error("dblog::LogReader::ViewLogBody() the reader does not "
+                     "point to a log record.");
+
+    Result load_result = Load(position_, kLogHeaderLength + log_body_length_);
+    if (load_result.IsError()) {
+        return load_result + Error("dblog::LogReader::ViewLogBody() failed to "
+                                   "read log record.");
+    }
+    const size_t offset = position_ - window_start_;
+    const uint32_t checksum =
+        data::ReadUint32(window_, offset).Get();
+    const uint8_t *log_body_start = window_.data() + offset + kLogHeaderLength;
+    if (ComputeChecksum(log_body_start, log_body_length_) != checksum)
+        return Error(kCompleteLogNotWrittenToDisk.Error());
+    const int begin = offset + kLogHeaderLength;
+    return Ok(LogBodyView{&window_, begin, begin + log_body_length_});
+}
+
+Result LogReader::MoveTo(const uint64_t position) {
+    valid_ = false;
+    ResultV<int> log_body_length = ReadInt(position + kChecksumBytesize);
+    if (log_body_length.IsError()) {
+        return log_body_length + Error("dblog::LogReader::MoveTo() failed to "
+                                       "read log body length in header.");
+    }
+    if (log_body_length.Get() < 0 ||
+        position + kLogHeaderLength + log_body_length.Get() +
+                kLogLengthBytesize >
+            end_) {
+        return Error("dblog::LogReader::MoveTo() the log body length in "
+                     "header is broken.");
+    }
+    valid_           = true;
+    position_        = position;
+    log_body_length_ = log_body_length.Get();
+    return Ok();
+}
+
+Result LogReader::Load(const uint64_t position, const size_t length) {
+    if (window_start_ <= position &&
+        position + length <= window_start_ + window_.size())
+        return Ok();
+    if (position + length > end_)
+        return Error("dblog::LogReader::Load() the bytes are out of the log.");
+
+    const int first_block = position / data_size_;
+    const int last_block  = (position + length - 1) / data_size_;
+    const int block_count =
+        std::max(window_block_count_, last_block - first_block + 1);
+    const int last_index = last_block_id_.BlockIndex();
+    int start, stop;
+    if (forward_) {
+        start = first_block;
+        stop  = std::min(first_block + block_count, last_index + 1);
+    } else {
+        // The window is not extended to the log segment before, which may
+        // have been released by `LogManager::Truncate()`.
+        const int segment_start =
+            first_block - first_block % segments_.SegmentBlockCount();
+        stop  = last_block + 1;
+        start = std::max(segment_start, stop - block_count);
+    }
+
+    // The blocks before the last block are read from disk at once.
+    std::vector<uint8_t> blocks;
+    const int disk_block_count = std::min(stop, last_index) - start;
+    if (disk_block_count > 0) {
+        Result read_result =
+            segments_.ReadBlocks(start, disk_block_count, blocks);
+        if (read_result.IsError()) {
+            return read_result + Error("dblog::LogReader::Load() failed to "
+                                       "read log blocks.");
+        }
+    }
+    if (stop == last_index + 1) {
+        const std::vector<uint8_t> &content = last_block_.RawBlock().Content();
+        blocks.insert(blocks.end(), content.begin(), content.end());
+    }
+
+    // The offset regions are removed.
+    const int block_size = segments_.BlockSize();
+    window_.clear();
+    window_.reserve(size_t(stop - start) * data_size_);
+    for (int i = 0; i < stop - start; i++) {
+        const auto block_begin = blocks.begin() + size_t(i) * block_size;
+        window_.insert(window_.end(), block_begin + internal::kDefaultOffset,
+                       block_begin + block_size);
+    }
+    window_start_ = uint64_t(start) * data_size_;
+    return Ok();
+}
+
+ResultV<int> LogReader::ReadInt(const uint64_t position) {
+    Result load_result = Load(position, kLogLengthBytesize);
+    if (load_result.IsError()) {
+        return load_result +
+               Error("dblog::LogReader::ReadInt() failed to read the bytes.");
+    }
+    return data::ReadInt(window_, position - window_start_);
+}
+
+// An entry of the file dictionary starts at a block with the checksum and the
+// length of the filename, followed by the filename.
+constexpr int kFileEntryHeaderBytesize = 2 * data::kUint32Bytesize;
+
+FileDictionary::FileDictionary(disk::DiskManager &disk_manager,
+                               const std::string &filename)
+    : disk_manager_(disk_manager), filename_(filename) {}
+
+Result FileDictionary::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ids_.clear();
+    filenames_.clear();
+    block_count_ = 0;
+
+    ResultV<size_t> size_result = disk_manager_.Size(filename_);
+    if (size_result.IsError()) {
+        return size_result + Error("dblog::FileDictionary::Load() failed to "
+                                   "get the size of the dictionary file.");
+    }
+    if (size_result.Get() == 0) return Ok();
+    std::vector<uint8_t> bytes;
+    Result read_result = disk_manager_.ReadBlocks(
+        disk::BlockID(filename_, 0), size_result.Get(), bytes);
+    if (read_result.IsError()) {
+        return read_result + Error("dblog::FileDictionary::Load() failed to "
+                                   "read the dictionary file.");
+    }
+
+    const int block_size = disk_manager_.BlockSize();
+    size_t position      = 0;
+    while (position + kFileEntryHeaderBytesize <= bytes.size()) {
+        const uint32_t checksum = data::ReadUint32(bytes, position).Get();
+        const uint32_t length =
+            data::ReadUint32(bytes, position + data::kUint32Bytesize).Get();
+        const size_t end = position + kFileEntryHeaderBytesize + length;
+        if (length == 0 || end > bytes.size()) break;
+        const std::vector<uint8_t> entry(
+            bytes.begin() + position + data::kUint32Bytesize,
+            bytes.begin() + end);
+        if (checksum != ComputeChecksum(entry)) break;
+
+        std::string filename(bytes.begin() + position +
+                                 kFileEntryHeaderBytesize,
+                             bytes.begin() + end);
+        ids_.emplace(filename, filenames_.size());
+        filenames_.push_back(std::move(filename));
+        position = (end + block_size - 1) / block_size * block_size;
+    }
+    block_count_ = position / block_size;
+    return Ok();
+}
+
+ResultV<FileID> FileDictionary::ID(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = ids_.find(filename); it != ids_.end()) return Ok(it->second);
+    if (filename.empty()) {
+        return Error("dblog::FileDictionary::ID() the filename is empty.");
+    }
+
+    std::vector<uint8_t> entry;
+    data::WriteUint32NoFail(entry, entry.size(), filename.size());
+    entry.insert(entry.end(), filename.begin(), filename.end());
+    std::vector<uint8_t> bytes;
+    data::WriteUint32NoFail(bytes, bytes.size(), ComputeChecksum(entry));
+    bytes.insert(bytes.end(), entry.begin(), entry.end());
+    const int block_size  = disk_manager_.BlockSize();
+    const int block_count = (bytes.size() + block_size - 1) / block_size;
+    bytes.resize(size_t(block_count) * block_size, 0);
+
+    // The id is given only after the entry is synced, so that a log record
+    // never has an id which is lost by a crash.
+    const disk::BlockID first_block_id(filename_, block_count_);
+    Result allocate_result =
+        disk_manager_.AllocateNewBlocks(first_block_id + (block_count - 1));
+    if (allocate_result.IsError()) {
+        return allocate_result + Error("dblog::FileDictionary::ID() failed to "
+                                       "extend the dictionary file.");
+    }
+    Result write_result =
+        disk_manager_.WriteBlocks(first_block_id, block_count, bytes.data());
+    if (write_result.IsError()) {
+        return write_result + Error("dblog::FileDictionary::ID() failed to "
+                                    "write the entry.");
+    }
+    Result sync_result = disk_manager_.Flush(filename_);
+    if (sync_result.IsError()) {
+        return sync_result + Error("dblog::FileDictionary::ID() failed to "
+                                   "sync the dictionary file.");
+    }
+
+    const FileID id = filenames_.size();
+    ids_.emplace(filename, id);
+    filenames_.push_back(filename);
+    block_count_ += block_count;
+    return Ok(id);
+}
+
+const std::string *FileDictionary::Filename(const FileID id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return id < filenames_.size() ? &filenames_[id] : nullptr;
+}
+
+// The file dictionary of a log is the file `log_filename`.files.
+const std::string kFileDictionarySuffix = ".files";
+
+// The number of the slots in which writers publish the ends of their log
+// records. A writer waits until its log record starts within this number of
+// bytes from the end of the filled part of the log stream, so that no two log
+// records being copied share a slot.
+constexpr size_t kFilledEndSlotCount = 1 << 16;
+
+// The interval at which a writer waiting for space in the log buffer checks
+// the space again even if it is not notified.
+constexpr std::chrono::microseconds kLogBufferWaitInterval(100);
+
 LogManager::LogManager(const std::string &log_filename,
                        const std::string &log_directory_path,
-                       const size_t block_size)
+                       const size_t block_size, const size_t buffer_size,
+                       const size_t segment_size)
     : log_filename_(log_filename),
       disk_manager_(disk::DiskManager(
-          /*directory_path=*/log_directory_path, /*block_size=*/block_size)) {}
+          /*directory_path=*/log_directory_path, /*block_size=*/block_size)),
+      segments_(disk_manager_, log_filename_, segment_size / block_size),
+      files_(disk_manager_, log_filename_ + kFileDictionarySuffix),
+      data_size_(int(block_size) - internal::kDefaultOffset),
+      buffer_block_count_(buffer_size / block_size),
+      filled_ends_(kFilledEndSlotCount) {}
+
+LogManager::~LogManager() { StopFlusher(); }
 
 Result LogManager::Init() {
-    std::lock_guard<std::shared_mutex> lock(mutex_);
-    if (disk_manager_.BlockSize() < internal::kDefaultOffset) {
+    // The flusher of the previous initialization is stopped.
+    StopFlusher();
+
+    if (disk_manager_.BlockSize() <= internal::kDefaultOffset) {
         return Error(
-            "dblog::LogManager::Init() log blocksize must be larger than 4.");
+            "dblog::LogManager::Init() log blocksize must be larger than 8.");
+    }
+    if (buffer_block_count_ < 2) {
+        return Error("dblog::LogManager::Init() the log buffer must have at "
+                     "least 2 log blocks.");
+    }
+    if (segments_.SegmentBlockCount() < 1) {
+        return Error("dblog::LogManager::Init() the log segment must have at "
+                     "least 1 log block.");
     }
 
-    const auto expect_logfile_size = disk_manager_.Size(log_filename_);
-    if (expect_logfile_size.IsError())
-        return expect_logfile_size +
-               Error("dblog::LogManager::Init() the log file does not exist.");
-    const size_t current_logfile_size = expect_logfile_size.Get();
+    Result files_result = files_.Load();
+    if (files_result.IsError()) {
+        return files_result + Error("dblog::LogManager::Init() failed to load "
+                                    "the file dictionary.");
+    }
 
-    if (current_logfile_size == 0) {
-        current_block_id_ = disk::BlockID(log_filename_, 0);
-        if (disk_manager_.AllocateNewBlocks(current_block_id_).IsError()) {
-            return Error("dblog::LogManager::Init() failed to allocate new "
-                         "blocks in the log file.");
+    buffer_.assign(size_t(buffer_block_count_) * disk_manager_.BlockSize(), 0);
+    ResultV<int> last_index = OpenSegments();
+    if (last_index.IsError()) {
+        return last_index + Error("dblog::LogManager::Init() failed to open "
+                                  "the log segments.");
+    }
+
+    LogSequenceNumber end = 0;
+    if (last_index.Get() >= 0) {
+        internal::LogBlock last_block;
+        if (segments_.ReadLogBlock(last_index.Get(), last_block).IsError()) {
+            return Error(
+                "dblog::LogManager::Init() the last block cannot be read.");
         }
-        current_block_ = internal::LogBlock(disk_manager_.BlockSize());
-        return Ok();
+
+        // The log sequence number of the next log record is the end of the
+        // log stream, which is already written to disk. The last block is
+        // placed in the log buffer to append log records to it.
+        end = LogSequenceNumber(last_index.Get()) * data_size_ +
+              last_block.Offset() - internal::kDefaultOffset;
+        const std::vector<uint8_t> &content = last_block.RawBlock().Content();
+        std::copy(content.begin(), content.end(),
+                  BufferBlock(last_index.Get()));
     }
 
-    current_block_id_ = disk::BlockID(log_filename_, current_logfile_size - 1);
-    if (current_block_.ReadLogBlock(disk_manager_, current_block_id_)
-            .IsError()) {
-        return Error(
-            "dblog::LogManager::Init() the last block cannot be read.");
+    reserved_number_     = end;
+    filled_number_       = end;
+    written_number_      = end;
+    buffer_start_number_ = end / data_size_ * data_size_;
+    next_save_number_    = end;
+    flusher_             = std::thread(&LogManager::RunFlusher, this);
+    return Ok();
+}
+
+ResultV<int> LogManager::OpenSegments() {
+    // The log segments are found by their filenames `log_filename_`.`n`.
+    const std::string prefix = log_filename_ + ".";
+    std::set<int> segments;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(
+             disk_manager_.DirectoryPath(), error)) {
+        const std::string filename = entry.path().filename().string();
+        if (filename.compare(0, prefix.size(), prefix) != 0) continue;
+        const std::string number = filename.substr(prefix.size());
+        if (number.empty() || number.size() > 9 ||
+            !std::all_of(number.begin(), number.end(), ::isdigit))
+            continue;
+        segments.insert(std::stoi(number));
+    }
+
+    // The end of the log is in the last log segment whose first block is
+    // written; the log segments after it are spares.
+    int last_index = -1;
+    for (auto it = segments.rbegin(); it != segments.rend(); it++) {
+        ResultV<int> index = LastWrittenBlockIndex(*it);
+        if (index.IsError()) {
+            return index + Error("dblog::LogManager::OpenSegments() failed "
+                                 "to find the last block.");
+        }
+        if (index.Get() >= 0) {
+            last_index = index.Get();
+            break;
+        }
+    }
+
+    const int segment = last_index < 0
+                            ? 0
+                            : last_index / segments_.SegmentBlockCount();
+    if (segments.count(segment) == 0) {
+        Result create_result = CreateSegment(segment);
+        if (create_result.IsError()) {
+            return create_result + Error("dblog::LogManager::OpenSegments() "
+                                         "failed to create a log segment.");
+        }
+        segments.insert(segment);
+    }
+
+    // The log segments which are not next to the others are left by
+    // `Truncate()` interrupted by a crash, and they are removed.
+    first_segment_ = segment;
+    while (segments.count(first_segment_ - 1) > 0)
+        first_segment_--;
+    last_segment_ = segment;
+    while (segments.count(last_segment_ + 1) > 0)
+        last_segment_++;
+    for (const int stale_segment : segments) {
+        if (first_segment_ <= stale_segment && stale_segment <= last_segment_)
+            continue;
+        Result remove_result =
+            disk_manager_.Remove(segments_.SegmentFilename(stale_segment));
+        if (remove_result.IsError()) {
+            return remove_result + Error("dblog::LogManager::OpenSegments() "
+                                         "failed to remove a log segment.");
+        }
+    }
+    return Ok(last_index);
+}
+
+ResultV<int> LogManager::LastWrittenBlockIndex(const int segment) {
+    // The blocks are read forward by the size of the log buffer until a block
+    // which is not written. A block which is not written has no offset or has
+    // the block number of the log segment before it is reused.
+    const int block_size          = disk_manager_.BlockSize();
+    const int segment_block_count = segments_.SegmentBlockCount();
+    const int first_block         = segment * segment_block_count;
+    std::vector<uint8_t> bytes;
+    for (int start = 0; start < segment_block_count;
+         start += buffer_block_count_) {
+        const int block_count =
+            std::min(buffer_block_count_, segment_block_count - start);
+        Result read_result = segments_.ReadBlocks(first_block + start,
+                                                  block_count, bytes);
+        if (read_result.IsError()) {
+            return read_result + Error("dblog::LogManager::"
+                                       "LastWrittenBlockIndex() failed to "
+                                       "read log blocks.");
+        }
+        for (int i = 0; i < block_count; i++) {
+            const int block_index = first_block + start + i;
+            if (!internal::IsWrittenLogBlock(bytes, size_t(i) * block_size,
+                                             block_index, block_size))
+                return Ok(block_index == first_block ? -1 : block_index - 1);
+        }
+    }
+    return Ok(first_block + segment_block_count - 1);
+}
+
+Result LogManager::CreateSegment(const int segment) {
+    const int segment_block_count = segments_.SegmentBlockCount();
+    Result preallocate_result = disk_manager_.PreallocateBlocks(
+        segments_.SegmentBlockID((segment + 1) * segment_block_count - 1));
+    if (preallocate_result.IsError()) {
+        return preallocate_result + Error("dblog::LogManager::CreateSegment() "
+                                          "failed to preallocate the log "
+                                          "segment.");
     }
     return Ok();
 }
 
 ResultV<LogIterator> LogManager::LastLog() {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    disk::BlockID last_block_id;
+    internal::LogBlock last_block;
+    Result write_result = WriteFilledBuffer(last_block_id, last_block);
+    if (write_result.IsError()) {
+        return write_result + Error("dblog::LogManager::LastLog() failed to "
+                                    "write the log buffer.");
+    }
     return ReadPreviousLog(
-        disk_manager_,
-        disk::DiskPosition(current_block_id_, current_block_.Offset()),
-        current_block_);
+        segments_, disk::DiskPosition(last_block_id, last_block.Offset()),
+        last_block);
+}
+
+ResultV<LogReader> LogManager::NewReader(const int window_block_count) {
+    disk::BlockID last_block_id;
+    internal::LogBlock last_block;
+    Result write_result = WriteFilledBuffer(last_block_id, last_block);
+    if (write_result.IsError()) {
+        return write_result + Error("dblog::LogManager::NewReader() failed to "
+                                    "write the log buffer.");
+    }
+    return Ok(LogReader(segments_, last_block_id, last_block,
+                        window_block_count));
 }
 
 ResultV<LogSequenceNumber>
 LogManager::WriteLog(const std::vector<uint8_t> &log_record_bytes) {
-    std::lock_guard<std::shared_mutex> lock(mutex_);
+    ResultV<LogSequenceNumber> reserve_result =
+        ReserveLog(log_record_bytes.size());
+    if (reserve_result.IsError()) return reserve_result;
+    CopyLog(reserve_result.Get(), log_record_bytes);
+    return reserve_result;
+}
 
-    const disk::BlockID rollback_block_id   = current_block_id_;
-    const internal::LogBlock rollback_block = current_block_;
+ResultV<LogSequenceNumber>
+LogManager::WriteLog(const std::vector<uint8_t> &log_record_bytes,
+                     const TransactionID transaction_id,
+                     const bool ends_transaction) {
+    ResultV<LogSequenceNumber> reserve_result =
+        ReserveLog(log_record_bytes.size());
+    if (reserve_result.IsError()) return reserve_result;
+
+    // The active transaction table is updated before the log record is
+    // published, so the table reflects all the log records in the filled part
+    // of the log stream.
+    const LogSequenceNumber lsn = reserve_result.Get();
+    {
+        std::lock_guard<std::mutex> lock(transactions_mutex_);
+        if (ends_transaction) {
+            active_transactions_.erase(transaction_id);
+        } else {
+            auto [it, inserted] = active_transactions_.try_emplace(
+                transaction_id, ActiveTransaction{lsn, lsn});
+            it->second.last_lsn = lsn;
+        }
+    }
+    CopyLog(lsn, log_record_bytes);
+    return Ok(lsn);
+}
 
-    ResultE<size_t> append_result =
-        current_block_.Append(log_record_bytes, /*bytes_offset=*/0);
-    while (append_result.IsError()) {
-        size_t next_offset = append_result.Error();
-        Result move_result = MoveToNextBlock();
-        if (move_result.IsError()) {
-            current_block_id_ = rollback_block_id;
-            current_block_    = rollback_block;
-            return move_result +
-                   Error("dblog::LogManager::WriteLog() failed to save the "
-                         "current block or allocate a next block.");
+std::map<TransactionID, ActiveTransaction>
+LogManager::ActiveTransactions(LogSequenceNumber &end_lsn) {
+    // When the log buffer is broken, the log stream is never filled and the
+    // table is returned as it is; the log records cannot be written anyway.
+    end_lsn = reserved_number_;
+    WaitForFilled(end_lsn);
+    std::lock_guard<std::mutex> lock(transactions_mutex_);
+    return active_transactions_;
+}
+
+// The master file has the log sequence number of the last checkpoint and its
+// checksum at the head of the first block.
+const std::string kMasterFileSuffix = ".master";
+constexpr int kMasterRecordLength   = 2 * data::kUint32Bytesize;
+
+Result LogManager::WriteMasterRecord(const LogSequenceNumber checkpoint_lsn) {
+    const disk::BlockID master_block_id(log_filename_ + kMasterFileSuffix, 0);
+    if (disk_manager_.BlockSize() < kMasterRecordLength + kChecksumBytesize) {
+        return Error("dblog::LogManager::WriteMasterRecord() log blocksize is "
+                     "too small for the master record.");
+    }
+
+    std::vector<uint8_t> bytes;
+    data::WriteUint32NoFail(bytes, bytes.size(), uint32_t(checkpoint_lsn));
+    data::WriteUint32NoFail(bytes, bytes.size(),
+                            uint32_t(checkpoint_lsn >> 32));
+    data::WriteUint32NoFail(bytes, bytes.size(), ComputeChecksum(bytes));
+    disk::Block block(disk_manager_.BlockSize());
+    Result write_bytes_result = block.WriteBytes(0, bytes.size(), bytes);
+    if (write_bytes_result.IsError()) {
+        return write_bytes_result + Error("dblog::LogManager::"
+                                          "WriteMasterRecord() failed to "
+                                          "make the master block.");
+    }
+
+    Result allocate_result = disk_manager_.AllocateNewBlocks(master_block_id);
+    if (allocate_result.IsError()) {
+        return allocate_result + Error("dblog::LogManager::WriteMasterRecord() "
+                                       "failed to create the master file.");
+    }
+    Result write_result = disk_manager_.Write(master_block_id, block);
+    if (write_result.IsError()) {
+        return write_result + Error("dblog::LogManager::WriteMasterRecord() "
+                                    "failed to write the master record.");
+    }
+    Result sync_result = disk_manager_.Flush(master_block_id.Filename());
+    if (sync_result.IsError()) {
+        return sync_result + Error("dblog::LogManager::WriteMasterRecord() "
+                                   "failed to sync the master file.");
+    }
+    return Ok();
+}
+
+ResultV<LogSequenceNumber> LogManager::ReadMasterRecord() {
+    const disk::BlockID master_block_id(log_filename_ + kMasterFileSuffix, 0);
+    ResultV<size_t> size_result =
+        disk_manager_.Size(master_block_id.Filename());
+    if (size_result.IsError()) {
+        return size_result + Error("dblog::LogManager::ReadMasterRecord() "
+                                   "failed to get the size of master file.");
+    }
+    if (size_result.Get() == 0) return Ok(kNullLogSequenceNumber);
+
+    disk::Block block;
+    Result read_result = disk_manager_.Read(master_block_id, block);
+    if (read_result.IsError()) {
+        return read_result + Error("dblog::LogManager::ReadMasterRecord() "
+                                   "failed to read the master record.");
+    }
+    const std::vector<uint8_t> &content = block.Content();
+    const std::vector<uint8_t> bytes(content.begin(),
+                                     content.begin() + kMasterRecordLength);
+    ResultV<uint32_t> checksum = data::ReadUint32(content, kMasterRecordLength);
+    if (checksum.IsError() || checksum.Get() != ComputeChecksum(bytes)) {
+        return Error("dblog::LogManager::ReadMasterRecord() the master record "
+                     "is broken.");
+    }
+    return Ok(LogSequenceNumber(data::ReadUint32(bytes, 4).Get()) << 32 |
+              data::ReadUint32(bytes, 0).Get());
+}
+
+// The number of the log segments kept after the log segment being written,
+// which are reused instead of creating new log segments.
+constexpr int kMaxSpareLogSegmentCount = 2;
+
+Result LogManager::Truncate(const LogSequenceNumber lsn) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    // The log segment of the last log block synced is never released, as the
+    // end of the log stream is found from it when the log is opened, and it is
+    // synced again by the next flush.
+    const int segment_block_count = segments_.SegmentBlockCount();
+    const int keep_segment =
+        std::min<LogSequenceNumber>(lsn / data_size_,
+                                    LastBlockIndex(next_save_number_)) /
+        segment_block_count;
+    const int current_segment =
+        LastBlockIndex(written_number_) / segment_block_count;
+    for (; first_segment_ < keep_segment; first_segment_++) {
+        const std::string filename = segments_.SegmentFilename(first_segment_);
+        if (last_segment_ - current_segment >= kMaxSpareLogSegmentCount) {
+            Result remove_result = disk_manager_.Remove(filename);
+            if (remove_result.IsError()) {
+                return remove_result + Error("dblog::LogManager::Truncate() "
+                                             "failed to remove a log "
+                                             "segment.");
+            }
+            continue;
         }
-        append_result = current_block_.Append(log_record_bytes, next_offset);
+
+        // The log segment is reused after the last one. Its blocks are told
+        // from the written ones by their block numbers.
+        Result rename_result = disk_manager_.Rename(
+            filename, segments_.SegmentFilename(last_segment_ + 1));
+        if (rename_result.IsError()) {
+            return rename_result + Error("dblog::LogManager::Truncate() "
+                                         "failed to reuse a log segment.");
+        }
+        last_segment_++;
     }
+    return Ok();
+}
 
-    return Ok(current_number_++);
+ResultV<LogSequenceNumber> LogManager::ReserveLog(const size_t length) {
+    if (buffer_failed_)
+        return Error("dblog::LogManager::ReserveLog() the log buffer cannot "
+                     "be written to the log file.");
+    if (length > size_t(buffer_block_count_ - 1) * data_size_)
+        return Error("dblog::LogManager::ReserveLog() the log record is too "
+                     "long for the log buffer.");
+
+    const LogSequenceNumber lsn = reserved_number_.fetch_add(length);
+    const LogSequenceNumber end = lsn + length;
+    if (HasBufferSpace(lsn, end)) return Ok(lsn);
+
+    // The log buffer is full, so the flusher is woken up to write it.
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    waiting_writers_++;
+    while (!HasBufferSpace(lsn, end) && !buffer_failed_) {
+        flusher_condition_.notify_one();
+        space_condition_.wait_for(lock, kLogBufferWaitInterval);
+    }
+    waiting_writers_--;
+    if (buffer_failed_)
+        return Error("dblog::LogManager::ReserveLog() the log buffer cannot "
+                     "be written to the log file.");
+    return Ok(lsn);
+}
+
+void LogManager::CopyLog(const LogSequenceNumber lsn,
+                         const std::vector<uint8_t> &log_record_bytes) {
+    if (log_record_bytes.empty()) return;
+
+    // The log record is split at the offset regions of the log blocks.
+    size_t copied_length = 0;
+    while (copied_length < log_record_bytes.size()) {
+        const LogSequenceNumber position = lsn + copied_length;
+        const int block_offset           = position % data_size_;
+        const size_t length =
+            std::min(log_record_bytes.size() - copied_length,
+                     size_t(data_size_ - block_offset));
+        std::copy_n(log_record_bytes.begin() + copied_length, length,
+                    BufferBlock(position / data_size_) +
+                        internal::kDefaultOffset + block_offset);
+        copied_length += length;
+    }
+
+    filled_ends_[lsn % filled_ends_.size()] = lsn + log_record_bytes.size();
+    AdvanceFilled();
+}
+
+bool LogManager::HasBufferSpace(const LogSequenceNumber lsn,
+                                const LogSequenceNumber end) const {
+    return end <= buffer_start_number_ +
+                      LogSequenceNumber(buffer_block_count_) * data_size_ &&
+           lsn < filled_number_ + filled_ends_.size();
+}
+
+void LogManager::AdvanceFilled() {
+    LogSequenceNumber filled = filled_number_;
+    while (true) {
+        // The slot has the end of an old log record until the log record at
+        // `filled` is published.
+        const LogSequenceNumber end =
+            filled_ends_[filled % filled_ends_.size()];
+        if (end <= filled) return;
+        if (!filled_number_.compare_exchange_strong(filled, end)) continue;
+
+        // The flusher is woken up when a log block is filled entirely and
+        // the log buffer has become half full.
+        if (end / data_size_ > filled / data_size_) {
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            if (ShouldWriteBuffer()) flusher_condition_.notify_one();
+        }
+        filled = end;
+    }
+}
+
+Result LogManager::WaitForFilled(const LogSequenceNumber end) {
+    // The writers in the middle of copying finish soon, unless they wait for
+    // the flusher.
+    while (filled_number_ < end) {
+        if (buffer_failed_)
+            return Error("dblog::LogManager::WaitForFilled() the log buffer "
+                         "cannot be written to the log file.");
+        std::this_thread::yield();
+    }
+    return Ok();
+}
+
+Result LogManager::WriteBuffer(const LogSequenceNumber end) {
+    const LogSequenceNumber written = written_number_;
+    if (end <= written) return Ok();
+
+    // A log segment is created before it is written, unless a spare one is
+    // left by `Truncate()`.
+    const int first_block = written / data_size_;
+    const int last_block  = LastBlockIndex(end);
+    while (last_segment_ < last_block / segments_.SegmentBlockCount()) {
+        Result create_result = CreateSegment(last_segment_ + 1);
+        if (create_result.IsError()) {
+            return create_result + Error("dblog::LogManager::WriteBuffer() "
+                                         "failed to create a log segment.");
+        }
+        last_segment_++;
+    }
+
+    // The offset regions of the log blocks are updated, and the log blocks
+    // which are consecutive in the log buffer are written at once.
+    int block = first_block;
+    while (block <= last_block) {
+        const int block_count =
+            std::min(last_block - block + 1,
+                     buffer_block_count_ - block % buffer_block_count_);
+        for (int i = block; i < block + block_count; i++) {
+            const LogSequenceNumber filled_length =
+                std::min(end - LogSequenceNumber(i) * data_size_,
+                         LogSequenceNumber(data_size_));
+
+            // NOTE: We don't care the error case as the offset region is
+            // always in the log buffer.
+            const size_t block_start =
+                size_t(i % buffer_block_count_) * disk_manager_.BlockSize();
+            data::WriteInt(buffer_,
+                           block_start + internal::kOffsetPositionInLogBlock,
+                           internal::kDefaultOffset + filled_length);
+            data::WriteInt(buffer_,
+                           block_start +
+                               internal::kBlockNumberPositionInLogBlock,
+                           i);
+        }
+        Result write_result =
+            segments_.WriteBlocks(block, block_count, BufferBlock(block));
+        if (write_result.IsError()) {
+            return write_result + Error("dblog::LogManager::WriteBuffer() "
+                                        "failed to write log blocks.");
+        }
+        block += block_count;
+    }
+
+    written_number_      = end;
+    buffer_start_number_ = end / data_size_ * data_size_;
+    return Ok();
+}
+
+Result LogManager::WriteFilledBuffer(disk::BlockID &last_block_id,
+                                     internal::LogBlock &last_block) {
+    Result fill_result = WaitForFilled(reserved_number_);
+    if (fill_result.IsError()) {
+        return fill_result + Error("dblog::LogManager::WriteFilledBuffer() "
+                                   "failed to wait for log records.");
+    }
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const LogSequenceNumber end = filled_number_;
+    Result write_result         = WriteBuffer(end);
+    if (write_result.IsError()) {
+        return write_result + Error("dblog::LogManager::WriteFilledBuffer() "
+                                    "failed to write the log buffer.");
+    }
+
+    const int block_index = LastBlockIndex(end);
+    last_block_id         = disk::BlockID(log_filename_, block_index);
+    if (end > 0 && end % data_size_ == 0) {
+        // The last block is filled entirely and may be reused in the log
+        // buffer, so it is read from disk.
+        Result read_result = segments_.ReadLogBlock(block_index, last_block);
+        if (read_result.IsError()) {
+            return read_result + Error("dblog::LogManager::WriteFilledBuffer() "
+                                       "failed to read the last block.");
+        }
+        return Ok();
+    }
+
+    // Only the filled part is copied, as writers may be copying log records
+    // after it.
+    const int offset = internal::kDefaultOffset + end % data_size_;
+    const uint8_t *block = BufferBlock(block_index);
+    last_block = internal::LogBlock(
+        disk::Block(disk_manager_.BlockSize(),
+                    std::vector<uint8_t>(block, block + offset)),
+        offset);
+    return Ok();
+}
+
+void LogManager::StopFlusher() {
+    if (!flusher_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        stop_flusher_ = true;
+    }
+    flusher_condition_.notify_one();
+    flusher_.join();
+    stop_flusher_ = false;
+}
+
+bool LogManager::ShouldWriteBuffer() const {
+    const LogSequenceNumber filled_block_end =
+        filled_number_ / data_size_ * data_size_;
+    const LogSequenceNumber written = written_number_;
+    if (filled_block_end <= written) return false;
+    return waiting_writers_ > 0 ||
+           filled_block_end - written >=
+               LogSequenceNumber(buffer_block_count_) * data_size_ / 2;
+}
+
+void LogManager::RunFlusher() {
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    while (true) {
+        flusher_condition_.wait(
+            lock, [&] { return stop_flusher_ || ShouldWriteBuffer(); });
+        const bool stop = stop_flusher_;
+        lock.unlock();
+
+        // Only the log blocks filled entirely are written; the last log block
+        // is written by `Flush()`.
+        const LogSequenceNumber end = filled_number_ / data_size_ * data_size_;
+        Result write_result         = Ok();
+        {
+            std::lock_guard<std::mutex> write_lock(write_mutex_);
+            write_result = WriteBuffer(end);
+        }
+
+        lock.lock();
+        if (write_result.IsError()) buffer_failed_ = true;
+        space_condition_.notify_all();
+        if (stop || buffer_failed_) return;
+    }
 }
 
 Result LogManager::Flush(LogSequenceNumber number_to_flush) {
     if (number_to_flush < next_save_number_) return Ok();
-    return Flush();
+    return GroupFlush(number_to_flush + 1, /*force=*/false);
 }
 
 Result LogManager::Flush() {
-    std::lock_guard<std::shared_mutex> lock(mutex_);
+    return GroupFlush(reserved_number_, /*force=*/true);
+}
 
-    Result write_result = WriteCurrentBlock();
-    if (write_result.IsError()) {
-        return write_result + Error("dblog::LogManager::Flush() failed to "
-                                    "write the current block.");
-    }
-    next_save_number_ = current_number_;
-    return disk_manager_.Flush(log_filename_);
+void LogManager::SetGroupCommit(const std::chrono::microseconds window,
+                                const int batch_size) {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    group_commit_window_     = window;
+    group_commit_batch_size_ = batch_size;
 }
 
-Result LogManager::MoveToNextBlock() {
-    Result write_result = WriteCurrentBlock();
-    if (write_result.IsError()) {
-        return write_result + Error("dblog::LogManager::MoveToNextBlock() "
-                                    "failed to write current block.");
+Result LogManager::GroupFlush(const LogSequenceNumber save_number,
+                              const bool force) {
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    const auto is_saved = [&] {
+        return !force && save_number <= next_save_number_;
+    };
+
+    // Waits for the running flush, which may write the log records of this
+    // caller too. A leader in its window is notified that a caller joined.
+    waiting_flushers_++;
+    flush_condition_.notify_all();
+    flush_condition_.wait(lock, [&] { return !flushing_ || is_saved(); });
+    if (is_saved()) {
+        waiting_flushers_--;
+        return Ok();
+    }
+
+    // This caller becomes the leader, and waits for the others to join.
+    flushing_ = true;
+    if (group_commit_window_.count() > 0) {
+        flush_condition_.wait_for(lock, group_commit_window_, [&] {
+            return waiting_flushers_ >= group_commit_batch_size_;
+        });
+    }
+    waiting_flushers_--;
+    lock.unlock();
+
+    LogSequenceNumber saved_number = 0;
+    Result flush_result            = WriteAndSync(saved_number);
+
+    // When the flush fails, a waiting caller becomes the next leader and
+    // retries.
+    lock.lock();
+    flushing_ = false;
+    if (flush_result.IsOk() && saved_number > next_save_number_) {
+        next_save_number_ = saved_number;
     }
-    return AllocateNextBlock();
+    flush_condition_.notify_all();
+    return flush_result;
 }
 
-Result LogManager::AllocateNextBlock() {
-    current_block_id_ =
-        disk::BlockID(log_filename_, current_block_id_.BlockIndex() + 1);
-    Result allocate_result = disk_manager_.AllocateNewBlocks(current_block_id_);
-    if (allocate_result.IsError()) {
-        current_block_id_ =
-            disk::BlockID(log_filename_, current_block_id_.BlockIndex() - 1);
-        return allocate_result + Error("dblog::LogManager::AllocateNextBlock() "
-                                       "failed to allocate new block.");
+Result LogManager::WriteAndSync(LogSequenceNumber &saved_number) {
+    const LogSequenceNumber previous_saved = next_save_number_;
+    const LogSequenceNumber end            = reserved_number_;
+    Result fill_result          = WaitForFilled(end);
+    if (fill_result.IsError()) {
+        return fill_result + Error("dblog::LogManager::WriteAndSync() failed "
+                                   "to wait for log records.");
+    }
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        Result write_result = WriteBuffer(end);
+        if (write_result.IsError()) {
+            return write_result + Error("dblog::LogManager::WriteAndSync() "
+                                        "failed to write the log buffer.");
+        }
+    }
+    saved_number = end;
+
+    // The log records appended during the sync are not regarded as saved, so
+    // the latch is not needed here. The log segments written after the last
+    // sync are synced.
+    sync_count_++;
+    const int segment_block_count = segments_.SegmentBlockCount();
+    const int last_block          = LastBlockIndex(end);
+    const int first_segment =
+        std::min<LogSequenceNumber>(previous_saved / data_size_, last_block) /
+        segment_block_count;
+    for (int segment = first_segment;
+         segment <= last_block / segment_block_count; segment++) {
+        Result sync_result =
+            disk_manager_.Flush(segments_.SegmentFilename(segment));
+        if (sync_result.IsError()) {
+            return sync_result + Error("dblog::LogManager::WriteAndSync() "
+                                       "failed to sync the log segment.");
+        }
     }
-    current_block_ = internal::LogBlock(disk_manager_.BlockSize());
     return Ok();
 }
 
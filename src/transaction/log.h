@@ -4,30 +4,63 @@
 #include "checksum.h"
 #include "disk.h"
 #include "result.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
 #include <memory>
-#include <shared_mutex>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace dblog {
 
 using namespace ::result;
 
-using LogSequenceNumber = uint32_t;
+// The log sequence number (LSN) of a log record is the position of the record
+// in the log stream, which is the log file without the offset regions of the
+// log blocks. A log record can be read directly from its LSN.
+using LogSequenceNumber = uint64_t;
+
+// Indicates that there is no log record, e.g. the previous log record of the
+// first log record of a transaction.
+constexpr LogSequenceNumber kNullLogSequenceNumber = UINT64_MAX;
+
+// TransactionID is represented as an unsigned 32-bit integer.
+using TransactionID = uint32_t;
+
+// An entry of the active transaction table. `first_lsn` and `last_lsn` are the
+// log sequence numbers of the first and the last log records of the
+// transaction.
+struct ActiveTransaction {
+    LogSequenceNumber first_lsn;
+    LogSequenceNumber last_lsn;
+};
 
 namespace internal {
 
 // LogBLock is a kind of block. The main feature is that it has the offset at
 // the first 4-bytes of the block. To append new log records, the offset is
-// necessary.
+// necessary. The next 4-bytes has the block number, which is the index of the
+// block in the whole log, so that a stale block of a reused log segment is
+// told from a written one. The offset and the block number are the offset
+// region of the block.
 class LogBlock {
   public:
     inline LogBlock() {};
 
     // Initiate this log block with `block_size` including the offset region.
-    // `block_size` must be larger than 4 as the offset cannot in the block.
-    // The offset is initiated with 0.
+    // `block_size` must be larger than 8 as the offset region cannot in the
+    // block. The offset is initiated with the end of the offset region.
     explicit LogBlock(const int block_size);
 
+    // Initiate this log block with the content of `block`, whose data region
+    // is filled until `offset`. The offset is written to the block.
+    LogBlock(const disk::Block &block, const int offset);
+
     // Returns the offset of the log block (the part from the offset is empty).
     inline int Offset() const { return offset_; }
 
@@ -54,6 +87,51 @@ class LogBlock {
     int offset_;
 };
 
+// LogSegments maps the log blocks to the log segment files. The log is split
+// into log segments of `segment_block_count` blocks, and the log segment `n`
+// is the file `log_filename`.`n`. A log block is identified by its index in
+// the whole log, and a request over multiple log blocks is split at the
+// boundaries of the log segments.
+class LogSegments {
+  public:
+    LogSegments(disk::DiskManager &disk_manager,
+                const std::string &log_filename,
+                const int segment_block_count);
+
+    // Returns the block size of the log blocks.
+    inline int BlockSize() const { return disk_manager_.BlockSize(); }
+
+    // Returns the number of log blocks in a log segment.
+    inline int SegmentBlockCount() const { return segment_block_count_; }
+
+    // Returns the filename of the log segment `segment`.
+    std::string SegmentFilename(const int segment) const;
+
+    // Returns the block of the log segment file in which the log block of
+    // `block_index` is placed.
+    disk::BlockID SegmentBlockID(const int block_index) const;
+
+    // Reads the log block of `block_index`. If the block is not written, or
+    // it is a stale block which was written before the log segment was
+    // reused, `block` becomes an empty log block.
+    Result ReadLogBlock(const int block_index, LogBlock &block);
+
+    // Reads `block_count` consecutive log blocks from `first_block_index` to
+    // `bytes`, which is resized to `block_count` * `BlockSize()`.
+    Result ReadBlocks(const int first_block_index, const int block_count,
+                      std::vector<uint8_t> &bytes);
+
+    // Writes `block_count` consecutive log blocks from `first_block_index`.
+    // `bytes` must have `block_count` * `BlockSize()` bytes.
+    Result WriteBlocks(const int first_block_index, const int block_count,
+                       const uint8_t *bytes);
+
+  private:
+    disk::DiskManager &disk_manager_;
+    const std::string log_filename_;
+    const int segment_block_count_;
+};
+
 } // namespace internal
 
 // The error that implies the complete log record is not written to the disk.
@@ -68,12 +146,13 @@ const ResultV<std::vector<uint8_t>> kCompleteLogNotWrittenToDisk =
 // | log header (8bytes) | log body | log length (4bytes) |
 //
 // `log_body_length` is length of log body, not length of the whole log record.
-// `log_start` is the position that log header starts.
+// `log_start` is the position that log header starts, whose block index is the
+// index of the log block in the whole log.
 class LogIterator {
   public:
-    LogIterator(disk::DiskManager &disk_manager,
+    LogIterator(internal::LogSegments &segments,
                 const disk::DiskPosition &log_start, int log_body_length);
-    LogIterator(disk::DiskManager &disk_manager,
+    LogIterator(internal::LogSegments &segments,
                 const disk::DiskPosition &log_start, int log_body_length,
                 const internal::LogBlock &block);
 
@@ -102,63 +181,416 @@ class LogIterator {
     // Returns the block at which `log_start_` is located.
     ResultV<internal::LogBlock> LogStartBlock();
 
-    disk::DiskManager &disk_manager_;
+    internal::LogSegments &segments_;
     disk::DiskPosition log_start_;
     int log_body_length_;
     std::unique_ptr<internal::LogBlock> log_start_block_;
 };
 
-// LogManager manages a log file. This class has a current (most recent) log
-// block of the log file, and append log records to the log file.
+// LogBodyView refers to the log body `bytes[begin, end)` of a log record
+// without owning the bytes.
+struct LogBodyView {
+    const std::vector<uint8_t> *bytes = nullptr;
+    int begin = 0, end = 0;
+};
+
+// The default number of log blocks which LogReader reads at once.
+constexpr int kDefaultLogReaderWindowBlockCount = 64;
+
+// LogReader is a cursor over log records, which is used to scan the log file
+// forward or backward. Unlike LogIterator, it reads many consecutive log
+// blocks at once into a window and decodes log records from the window, so
+// that each block is read from disk only once while the log file is scanned
+// in one direction.
+//
+// The log file is regarded as a stream of bytes in which the offset regions of
+// the log blocks are removed; a log record is located by the position of its
+// head in the stream. A reader is obtained by `LogManager::NewReader()`, and
+// sees the log records written before it is obtained.
+class LogReader {
+  public:
+    // `last_block` is the content of the last block of the log file of
+    // `last_block_id`, which may not be written to disk yet. The last block is
+    // never read from disk.
+    LogReader(internal::LogSegments &segments,
+              const disk::BlockID &last_block_id,
+              const internal::LogBlock &last_block,
+              const int window_block_count = kDefaultLogReaderWindowBlockCount);
+
+    // Returns true if the reader points to a log record.
+    inline bool Valid() const { return valid_; }
+
+    // Returns true if there is no log record.
+    inline bool Empty() const { return end_ == 0; }
+
+    // Moves to the first log record. If there is no log record, the reader
+    // becomes invalid.
+    Result SeekToFirst();
+
+    // Moves to the last log record. If there is no log record, the reader
+    // becomes invalid.
+    Result SeekToLast();
+
+    // Returns true if there is a log record after the current one.
+    bool HasNext() const;
+
+    // Moves to the log record whose log sequence number is `lsn`.
+    Result Seek(const LogSequenceNumber lsn);
+
+    // Moves to the next log record. If the next log record does not exist, it
+    // returns the failure.
+    Result Next();
+
+    // Returns true if there is a log record before the current one.
+    bool HasPrevious() const;
+
+    // Moves to the previous log record. If the previous log record does not
+    // exist, it returns the failure.
+    Result Previous();
+
+    // Returns the log body of the current log record without headers. If the
+    // checksum does not match, returns `kCompleteLogNotWrittenToDisk`.
+    ResultV<std::vector<uint8_t>> LogBody();
+
+    // Returns the view of the log body of the current log record in the
+    // window of the reader, so that the log body is not copied. The view is
+    // valid until the reader moves. If the checksum does not match, returns
+    // `kCompleteLogNotWrittenToDisk`.
+    ResultV<LogBodyView> ViewLogBody();
+
+    // Returns the log sequence number of the current log record.
+    inline LogSequenceNumber Position() const { return position_; }
+
+  private:
+    // Moves to the log record at `position` whose log body length is read
+    // from its header.
+    Result MoveTo(const uint64_t position);
+
+    // Makes the window contain the bytes [`position`, `position` + `length`)
+    // of the stream. When the window is reloaded, it is extended after the
+    // bytes if `forward_` is true, otherwise before the bytes.
+    Result Load(const uint64_t position, const size_t length);
+
+    // Reads an int at `position` of the stream.
+    ResultV<int> ReadInt(const uint64_t position);
+
+    internal::LogSegments &segments_;
+    disk::BlockID last_block_id_;
+    internal::LogBlock last_block_;
+    int window_block_count_;
+
+    // The size of the data region of a log block.
+    int data_size_;
+
+    // The end of the stream.
+    uint64_t end_;
+
+    // `window_` has the bytes of the stream from `window_start_`.
+    uint64_t window_start_ = 0;
+    std::vector<uint8_t> window_;
+
+    // The direction of the last move, which decides how the window is loaded.
+    bool forward_ = false;
+
+    bool valid_          = false;
+    uint64_t position_   = 0;
+    int log_body_length_ = 0;
+};
+
+// FileID is the id of a data file in the file dictionary of a log.
+using FileID = uint32_t;
+
+// FileDictionary gives ids to the filenames of the data files, so that log
+// records have the short id instead of the filename. The ids are never
+// reused and the dictionary only grows. The dictionary is persisted in its own
+// file, where an entry occupies its own blocks and is never rewritten. A new
+// entry is synced before its id is returned, so that the id is always known
+// when a log record with it is read.
+class FileDictionary {
+  public:
+    // Initiate a dictionary persisted in `filename` of `disk_manager`.
+    FileDictionary(disk::DiskManager &disk_manager,
+                   const std::string &filename);
+
+    // Reads the entries from the dictionary file. The entry at the end which
+    // is not entirely written (by a crash) is ignored and overwritten later.
+    Result Load();
+
+    // Returns the id of `filename`. If the dictionary does not have it, a new
+    // id is given and written to the dictionary file.
+    ResultV<FileID> ID(const std::string &filename);
+
+    // Returns the filename of `id`. If the dictionary does not have `id`,
+    // returns nullptr. The filename lives as long as the dictionary.
+    const std::string *Filename(const FileID id) const;
+
+  private:
+    disk::DiskManager &disk_manager_;
+    const std::string filename_;
+
+    // `filenames_` is indexed by the ids, and the entries end before the
+    // block `block_count_` of the dictionary file.
+    mutable std::mutex mutex_;
+    std::map<std::string, FileID> ids_;
+    std::deque<std::string> filenames_;
+    int block_count_ = 0;
+};
+
+// The default size of the log buffer of LogManager in bytes.
+constexpr size_t kDefaultLogBufferSize = 4 << 20;
+
+// The default size of a log segment file of LogManager in bytes.
+constexpr size_t kDefaultLogSegmentSize = 16 << 20;
+
+// LogManager manages a log, which is split into log segment files of the same
+// size. Log records are appended to the log buffer, which is a ring of log
+// blocks in memory, and the log blocks are written to the log segments by a
+// background flusher thread when the log buffer becomes half full, or by
+// `Flush()`.
+//
+// A log segment is preallocated on disk when it is created, so that writing
+// and syncing the log does not change the size of the files. The log segments
+// released by `Truncate()` are renamed to the log segments after the end of
+// the log and reused, so that the disk space of the log stays bounded.
+//
+// A writer reserves the bytes of its log record at the end of the log stream
+// with an atomic fetch-add, and copies the log record to the log buffer
+// without any latch, so that writers copy their log records in parallel. As
+// writers finish copying out of order, each writer publishes the end of its
+// log record in a slot indexed by its log sequence number, and the filled part
+// of the log stream, of which all the bytes are copied, is advanced along the
+// slots. The flusher writes the log blocks in the filled part, and `Flush()`
+// writes the rest of the filled part and syncs the log file.
 class LogManager {
   public:
-    // Initiate a log manager, the file of `log_directory_path`/`log_filename`
-    // should exist when this log manager is initiated. `block_size` is the size
-    // of the block of log file, which must be larger than 4. The Init function
-    // should be called right after the constrcutor is called.
+    // Initiate a log manager, whose log segment files are
+    // `log_directory_path`/`log_filename`.`n`. `block_size` is the size of the
+    // block of log file, which must be larger than 8. The log buffer has
+    // `buffer_size` bytes and a log segment has `segment_size` bytes, which
+    // are rounded down to log blocks. The log buffer must be at least 2 log
+    // blocks. The Init function should be called right after the constrcutor
+    // is called.
     LogManager(const std::string &log_filename,
-               const std::string &log_directory_path, const size_t block_size);
+               const std::string &log_directory_path, const size_t block_size,
+               const size_t buffer_size  = kDefaultLogBufferSize,
+               const size_t segment_size = kDefaultLogSegmentSize);
+
+    // Stops the flusher. The log blocks which are filled are written to the
+    // log file, but the log file is not synced.
+    ~LogManager();
 
     // This function should be called before starting using the instance.
     Result Init();
 
     inline disk::DiskManager &DiskManager() { return disk_manager_; }
 
-    // Writes bytes to log file.
+    // Returns the file dictionary of the log, which is persisted in
+    // `log_directory_path`/`log_filename`.files and loaded by `Init()`.
+    inline FileDictionary &Files() { return files_; }
+
+    // Writes bytes to log file, and returns the log sequence number of them.
+    // The log record must fit in the log buffer without one log block.
     ResultV<LogSequenceNumber>
     WriteLog(const std::vector<uint8_t> &log_record_bytes);
 
+    // Writes bytes of a log record of the transaction `transaction_id` to log
+    // file. The active transaction table is updated together with the write;
+    // the transaction is removed from the table if `ends_transaction` is true.
+    ResultV<LogSequenceNumber>
+    WriteLog(const std::vector<uint8_t> &log_record_bytes,
+             const TransactionID transaction_id, const bool ends_transaction);
+
+    // Returns the active transaction table. `end_lsn` is set to the end of the
+    // log stream when the table is taken; the log records before it are
+    // reflected in the table.
+    std::map<TransactionID, ActiveTransaction>
+    ActiveTransactions(LogSequenceNumber &end_lsn);
+
+    // Writes the log sequence number of the last checkpoint log record to the
+    // master file and syncs it.
+    Result WriteMasterRecord(const LogSequenceNumber checkpoint_lsn);
+
+    // Reads the log sequence number of the last checkpoint log record from the
+    // master file. If no checkpoint has been written, returns
+    // `kNullLogSequenceNumber`.
+    ResultV<LogSequenceNumber> ReadMasterRecord();
+
+    // Releases the log segments which are entirely before `lsn`. A few of
+    // them are kept to be reused after the end of the log, and the others are
+    // removed. The log records before `lsn` must not be read afterwards.
+    Result Truncate(const LogSequenceNumber lsn);
+
     // Returns the most recent log iterator.
     ResultV<LogIterator> LastLog();
 
+    // Returns a reader of the log records written so far. The reader is not
+    // positioned; call `LogReader::SeekToFirst()` or `SeekToLast()` first. The
+    // log records in the log buffer are written to the log file (without
+    // syncing) so that the reader can read them.
+    ResultV<LogReader> NewReader(const int window_block_count =
+                                     kDefaultLogReaderWindowBlockCount);
+
     // Flushes log records until logs with log sequence number of
-    // `number_to_flush` (including the end).
+    // `number_to_flush` (including the end). Concurrent callers are grouped:
+    // one of them (the leader) writes and syncs the log file for all of them,
+    // and the others wait for the leader to finish (group commit).
     Result Flush(LogSequenceNumber number_to_flush);
 
     // Flushes all log records.
     Result Flush();
 
+    // Configures group commit. A leader of a flush waits up to `window` for
+    // other callers of `Flush()` to join the flush, until `batch_size`
+    // callers (including the leader) are waiting. By default `window` is zero
+    // and a leader flushes immediately; only the callers which arrive during
+    // the flush are grouped.
+    void SetGroupCommit(const std::chrono::microseconds window,
+                        const int batch_size);
+
+    // Returns the number of times the log file has been synced by `Flush()`.
+    inline size_t SyncCount() const { return sync_count_; }
+
   private:
-    // Writes the current block to disk and allocates a new block and sets the
-    // block to the `current_block`.
-    Result MoveToNextBlock();
-
-    // Writes the current block to disk.
-    inline Result WriteCurrentBlock() {
-        return disk_manager_.Write(current_block_id_,
-                                   current_block_.RawBlock());
+    // Makes sure that the log stream before `save_number` is written to disk.
+    // If `force` is true, the log file is synced even when it has already been
+    // written.
+    Result GroupFlush(const LogSequenceNumber save_number, const bool force);
+
+    // Writes the log records reserved so far and syncs the log file.
+    // `saved_number` is set to the end of the log stream written to disk.
+    // Called by the leader of a group flush.
+    Result WriteAndSync(LogSequenceNumber &saved_number);
+
+    // Reserves `length` bytes at the end of the log stream for a log record,
+    // and waits until the bytes can be copied to the log buffer. Returns the
+    // log sequence number of the log record.
+    ResultV<LogSequenceNumber> ReserveLog(const size_t length);
+
+    // Copies `log_record_bytes` to the log buffer at `lsn` reserved by
+    // `ReserveLog()`, and publishes that the bytes are filled.
+    void CopyLog(const LogSequenceNumber lsn,
+                 const std::vector<uint8_t> &log_record_bytes);
+
+    // Returns true if the bytes [`lsn`, `end`) of the log stream can be copied
+    // to the log buffer.
+    bool HasBufferSpace(const LogSequenceNumber lsn,
+                        const LogSequenceNumber end) const;
+
+    // Advances `filled_number_` along the ends of the log records published in
+    // `filled_ends_`.
+    void AdvanceFilled();
+
+    // Waits until the log stream before `end` is filled.
+    Result WaitForFilled(const LogSequenceNumber end);
+
+    // Writes the log stream before `end`, which must be filled, to the log
+    // segments. `write_mutex_` must be held.
+    Result WriteBuffer(const LogSequenceNumber end);
+
+    // Creates the log segment `segment` by preallocating it.
+    Result CreateSegment(const int segment);
+
+    // Finds the log segments in the log directory, and sets `first_segment_`
+    // and `last_segment_`. Returns the index of the last block written to the
+    // log. If no block is written, returns -1.
+    ResultV<int> OpenSegments();
+
+    // Returns the index of the last block written to the log segment
+    // `segment`, whose blocks are written from the first one. If no block is
+    // written, returns -1.
+    ResultV<int> LastWrittenBlockIndex(const int segment);
+
+    // Writes the filled log stream to the log file, and sets `last_block_id`
+    // and `last_block` to the last block of the log file.
+    Result WriteFilledBuffer(disk::BlockID &last_block_id,
+                             internal::LogBlock &last_block);
+
+    // Returns true if the flusher should write the log buffer. `buffer_mutex_`
+    // must be held.
+    bool ShouldWriteBuffer() const;
+
+    // The loop of the flusher, which writes the log blocks filled entirely.
+    void RunFlusher();
+
+    // Stops the flusher if it is running.
+    void StopFlusher();
+
+    // Returns the index of the log block which has the last byte of the log
+    // stream ending at `end`. When the log stream is empty, returns 0.
+    inline int LastBlockIndex(const LogSequenceNumber end) const {
+        return end == 0 ? 0 : (end - 1) / data_size_;
     }
 
-    // Allocates the next block of the current block.
-    Result AllocateNextBlock();
+    // Returns the log block of `block_index` in the log buffer.
+    inline uint8_t *BufferBlock(const int block_index) {
+        return buffer_.data() +
+               size_t(block_index % buffer_block_count_) *
+                   disk_manager_.BlockSize();
+    }
 
     const std::string log_filename_;
     disk::DiskManager disk_manager_;
-    LogSequenceNumber current_number_   = 0;
-    LogSequenceNumber next_save_number_ = 0;
-    disk::BlockID current_block_id_;
-    internal::LogBlock current_block_;
-    std::shared_mutex mutex_;
+    internal::LogSegments segments_;
+    FileDictionary files_;
+
+    // The size of the data region of a log block.
+    int data_size_;
+
+    // The log buffer has the log blocks of the log stream from
+    // `buffer_start_number_`, and the log block of a log sequence number is
+    // placed at its block index modulo `buffer_block_count_`.
+    const int buffer_block_count_;
+    std::vector<uint8_t> buffer_;
+    std::atomic<LogSequenceNumber> buffer_start_number_ = 0;
+
+    // The log sequence number of the next log record, which is the end of the
+    // log stream reserved by writers.
+    std::atomic<LogSequenceNumber> reserved_number_ = 0;
+
+    // All the bytes of the log stream before `filled_number_` are copied to
+    // the log buffer. A writer publishes the end of its log record in the slot
+    // of its log sequence number modulo the number of the slots.
+    std::atomic<LogSequenceNumber> filled_number_ = 0;
+    std::vector<std::atomic<LogSequenceNumber>> filled_ends_;
+
+    // The log stream before `written_number_` is written to the log segments.
+    // Updated while `write_mutex_` is held, which serializes the writes. The
+    // log segments from `first_segment_` to `last_segment_` exist, and the
+    // log segments after the one being written are spares to be written.
+    std::mutex write_mutex_;
+    std::atomic<LogSequenceNumber> written_number_ = 0;
+    int first_segment_ = 0;
+    int last_segment_  = 0;
+
+    // The flusher waits for log blocks to be filled, and `waiting_writers_`
+    // writers wait for the flusher to make space in the log buffer.
+    // `buffer_failed_` is set when the flusher fails to write the log file.
+    std::mutex buffer_mutex_;
+    std::condition_variable flusher_condition_;
+    std::condition_variable space_condition_;
+    int waiting_writers_ = 0;
+    bool stop_flusher_   = false;
+    std::atomic<bool> buffer_failed_ = false;
+    std::thread flusher_;
+
+    // The active transaction table, guarded by `transactions_mutex_`.
+    std::mutex transactions_mutex_;
+    std::map<TransactionID, ActiveTransaction> active_transactions_;
+
+    // The log stream before `next_save_number_` is written to disk.
+    // Updated while `flush_mutex_` is held.
+    std::atomic<LogSequenceNumber> next_save_number_ = 0;
+
+    // Group commit state guarded by `flush_mutex_`. `flushing_` is true while
+    // a leader flushes the log file, and `waiting_flushers_` is the number of
+    // callers waiting for a flush (including the leader before it starts).
+    std::mutex flush_mutex_;
+    std::condition_variable flush_condition_;
+    bool flushing_        = false;
+    int waiting_flushers_ = 0;
+    std::chrono::microseconds group_commit_window_{0};
+    int group_commit_batch_size_ = 1;
+    std::atomic<size_t> sync_count_ = 0;
 };
 
 } // namespace dblog
@@ -0,0 +1,69 @@
+// Measures the throughput of LogManager::WriteLog() with concurrent writers.
+// Writers reserve their log records with an atomic fetch-add and copy them to
+// the log buffer in parallel, and the log file is synced once at the end.
+//
+// usage: log_benchmark [log records per thread]
+
+#include "log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string kDirectoryPath = "log_benchmark_dir/";
+const std::string kLogFilename   = "log";
+const int kBlockSize             = 4096;
+const int kLogRecordLength       = 96;
+
+// Runs `thread_count` threads which write `logs_per_thread` log records each,
+// and returns the number of log records written per second.
+double RunWrites(const int thread_count, const int logs_per_thread) {
+    std::filesystem::remove_all(kDirectoryPath);
+    dblog::LogManager log_manager(kLogFilename, kDirectoryPath, kBlockSize);
+    if (log_manager.Init().IsError()) return 0.0;
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> failed = false;
+    const auto start         = std::chrono::steady_clock::now();
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+            const std::vector<uint8_t> log_record_bytes(kLogRecordLength,
+                                                        uint8_t(t));
+            for (int i = 0; i < logs_per_thread; i++) {
+                if (log_manager.WriteLog(log_record_bytes).IsError()) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (log_manager.Flush().IsError()) failed = true;
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (failed) return 0.0;
+    return thread_count * logs_per_thread / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const int logs_per_thread = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    std::printf("%-8s %14s %10s\n", "threads", "logs/sec", "MB/sec");
+    for (const int thread_count : {1, 2, 4, 8, 16}) {
+        const double logs_per_sec = RunWrites(thread_count, logs_per_thread);
+        std::printf("%-8d %14.0f %10.1f\n", thread_count, logs_per_sec,
+                    logs_per_sec * kLogRecordLength / (1 << 20));
+    }
+
+    std::filesystem::remove_all(kDirectoryPath);
+    return 0;
+}
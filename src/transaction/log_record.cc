@@ -4,6 +4,9 @@
 #include "data/data.h"
 #include "data/int.h"
 #include "data/uint32.h"
+#include "data/varint.h"
+#include <algorithm>
+#include <cstring>
 
 namespace dblog {
 
@@ -15,7 +18,14 @@ constexpr uint8_t kLogOperationMask        = 0b01000000;
 constexpr uint8_t kLogTransactionEndMask   = 0b10000000;
 constexpr uint8_t kLogCheckpointingMask    = 0b11000000;
 
-constexpr uint8_t kUpdateFlag = 0b00010000;
+constexpr uint8_t kDeltaFlag        = 0b00010000;
+constexpr uint8_t kCompensationFlag = 0b00100000;
+
+// The lowest 4 bits of the header of an operation are the version of its
+// format. The version 0 was the format with the filename and the fixed-width
+// integers, which is not read anymore.
+constexpr uint8_t kFormatVersionMask   = 0b00001111;
+constexpr uint8_t kLogOperationVersion = 1;
 
 constexpr uint8_t kCommitFlag   = 0b00000000;
 constexpr uint8_t kRollbackFlag = 0b00100000;
@@ -28,6 +38,14 @@ inline bool IsOperation(uint8_t log_header) {
     return (log_header & 0b11000000) == kLogOperationMask;
 }
 
+inline bool IsCompensation(uint8_t log_header) {
+    return (log_header & kCompensationFlag) == kCompensationFlag;
+}
+
+inline bool IsDelta(uint8_t log_header) {
+    return (log_header & kDeltaFlag) == kDeltaFlag;
+}
+
 inline bool IsTransactionEnd(uint8_t log_header) {
     return (log_header & 0b11000000) == kLogTransactionEndMask;
 }
@@ -44,119 +62,261 @@ inline bool IsRollback(uint8_t log_header) {
     return (log_header & 0b00110000) == kRollbackFlag;
 }
 
-ResultV<std::unique_ptr<LogRecord>>
-ReadLogTransactionBegin(const std::vector<uint8_t> &log_body_bytes) {
-    ResultV<uint32_t> transaction_id_result =
-        data::ReadUint32(log_body_bytes, 1);
-    if (transaction_id_result.IsError()) {
-        return transaction_id_result + Error("dblog::ReadLogTransactionBegin() "
-                                             "failed to read transaction id.");
+// Bytes size of a log sequence number in a log body.
+constexpr int kLogSequenceNumberBytesize = 2 * data::kUint32Bytesize;
+
+// Writes `lsn` as two little-endian uint32 (the lower half first).
+void WriteLogSequenceNumberNoFail(std::vector<uint8_t> &bytes,
+                                  const size_t offset,
+                                  const LogSequenceNumber lsn) {
+    data::WriteUint32NoFail(bytes, offset, uint32_t(lsn));
+    data::WriteUint32NoFail(bytes, offset + data::kUint32Bytesize,
+                            uint32_t(lsn >> 32));
+}
+
+ResultV<LogSequenceNumber>
+ReadLogSequenceNumber(const std::vector<uint8_t> &bytes, const int offset) {
+    ResultV<uint32_t> lower_result = data::ReadUint32(bytes, offset);
+    if (lower_result.IsError()) {
+        return lower_result + Error("dblog::ReadLogSequenceNumber() failed to "
+                                    "read the lower half.");
     }
-    return ResultV<std::unique_ptr<LogRecord>>(std::move(
-        std::make_unique<LogTransactionBegin>(transaction_id_result.Get())));
+    ResultV<uint32_t> upper_result =
+        data::ReadUint32(bytes, offset + data::kUint32Bytesize);
+    if (upper_result.IsError()) {
+        return upper_result + Error("dblog::ReadLogSequenceNumber() failed to "
+                                    "read the upper half.");
+    }
+    return Ok(LogSequenceNumber(upper_result.Get()) << 32 |
+              lower_result.Get());
 }
 
-ResultV<std::unique_ptr<LogRecord>> ReadLogOperationUpdate(
-    TransactionID transaction_id, const disk::DiskPosition &offset,
-    const std::vector<uint8_t> &log_body_bytes, int bytes_offset) {
-    return ResultV<std::unique_ptr<LogRecord>>(
-        std::move(std::make_unique<LogOperation>(
-            transaction_id, offset, log_body_bytes, bytes_offset)));
+// Writes the header and the fields of an operation before the images. The
+// previous log sequence number is written with 1 added, so that
+// `kNullLogSequenceNumber` is written as 0 in one byte.
+void WriteLogOperationFieldsNoFail(std::vector<uint8_t> &bytes,
+                                   const uint8_t header,
+                                   const TransactionID transaction_id,
+                                   const LogSequenceNumber previous_lsn,
+                                   const FileID file_id, const int block_index,
+                                   const int offset) {
+    bytes.push_back(header);
+    data::WriteVarintNoFail(bytes, bytes.size(), transaction_id);
+    data::WriteVarintNoFail(bytes, bytes.size(), previous_lsn + 1);
+    data::WriteVarintNoFail(bytes, bytes.size(), file_id);
+    data::WriteVarintNoFail(bytes, bytes.size(), uint32_t(block_index));
+    data::WriteVarintNoFail(bytes, bytes.size(), uint32_t(offset));
+}
+
+// Appends the images of the compensation log record of an operation whose
+// images are `bytes[images_begin, end)`. A delta undoes itself. Otherwise, the
+// new data of the compensation log record is the previous data of the
+// operation, and vice versa.
+void AppendCompensationImagesNoFail(std::vector<uint8_t> &compensation,
+                                    const std::vector<uint8_t> &bytes,
+                                    const int images_begin, const int end,
+                                    const bool delta) {
+    const auto images_begin_it = bytes.begin() + images_begin;
+    const auto end_it          = bytes.begin() + end;
+    if (delta) {
+        compensation.insert(compensation.end(), images_begin_it, end_it);
+        return;
+    }
+    const auto new_item_begin = images_begin_it + (end - images_begin) / 2;
+    compensation.insert(compensation.end(), new_item_begin, end_it);
+    compensation.insert(compensation.end(), images_begin_it, new_item_begin);
+}
+
+// Writes the images `bytes[images_begin, end)` of an operation to `page` at
+// `offset`; the new data if `redo` is true and the previous data otherwise. A
+// delta is applied by XOR either way.
+Result ApplyOperationImages(buffer::PageGuard &page, const int offset,
+                            const std::vector<uint8_t> &bytes,
+                            const int images_begin, const int end,
+                            const bool delta, const bool redo,
+                            const LogSequenceNumber lsn) {
+    if (!delta) {
+        const int value_length = (end - images_begin) / 2;
+        return page.WriteBytes(offset, bytes,
+                               images_begin + (redo ? value_length : 0),
+                               value_length, lsn);
+    }
+
+    int delta_offset           = images_begin;
+    ResultV<uint64_t> position = data::ReadVarint(bytes, delta_offset);
+    if (position.IsError() || delta_offset > end)
+        return Error("dblog::ApplyOperationImages() failed to read the "
+                     "position of the delta.");
+    return page.XorBytes(offset + position.Get(), bytes, delta_offset,
+                         end - delta_offset, lsn);
+}
+
+// Undoes the operation whose images are `bytes[images_begin, end)` on the
+// page of `block_id`.
+Result UnDoOperation(buffer::BufferManager &buffer_manager,
+                     const disk::BlockID &block_id, const int offset,
+                     const std::vector<uint8_t> &bytes, const int images_begin,
+                     const int end, const bool delta,
+                     const LogSequenceNumber lsn) {
+    buffer::PageGuard page;
+    Result result = buffer_manager.Pin(block_id, page);
+    if (result.IsError())
+        return result +
+               Error("dblog::UnDoOperation() failed to pin data block.");
+
+    // The compensation log record is already written to the log file, so the
+    // buffer can be flushed after the log is flushed up to `lsn`.
+    Result write_result = ApplyOperationImages(
+        page, offset, bytes, images_begin, end, delta, /*redo=*/false, lsn);
+    if (write_result.IsError())
+        return write_result + Error("dblog::UnDoOperation() failed to write "
+                                    "previous item to the block.");
+    return Ok();
+}
+
+// Redoes the operation whose images are `bytes[images_begin, end)` on the page
+// of `block_id`, unless the page already has it.
+ResultV<bool> ReDoOperation(buffer::BufferManager &buffer_manager,
+                            const disk::BlockID &block_id, const int offset,
+                            const std::vector<uint8_t> &bytes,
+                            const int images_begin, const int end,
+                            const bool delta, const LogSequenceNumber lsn) {
+    buffer::PageGuard page;
+    Result result = buffer_manager.Pin(block_id, page);
+    if (result.IsError())
+        return result +
+               Error("dblog::ReDoOperation() failed to pin data block.");
+
+    // The page already has the modification of this log record when the page
+    // log sequence number is not smaller than `lsn`.
+    const LogSequenceNumber page_lsn = page.PageLogSequenceNumber();
+    if (lsn != kNullLogSequenceNumber &&
+        page_lsn != kNullLogSequenceNumber && page_lsn >= lsn)
+        return Ok(false);
+
+    // When doing ReDo, the log record is already written to the log file.
+    // Therefore, the buffer can be flushed whenever it is needed.
+    Result write_result = ApplyOperationImages(
+        page, offset, bytes, images_begin, end, delta, /*redo=*/true, lsn);
+    if (write_result.IsError())
+        return write_result + Error("dblog::ReDoOperation() failed to write "
+                                    "new item to the block.");
+    return Ok(true);
 }
 
 ResultV<std::unique_ptr<LogRecord>>
-ReadLogOperation(const std::vector<uint8_t> &log_body_bytes) {
+ReadLogCheckpointing(const std::vector<uint8_t> &log_body_bytes) {
     int offset = 1;
 
-    ResultV<uint32_t> transaction_id_result =
-        data::ReadUint32(log_body_bytes, offset);
-    if (transaction_id_result.IsError()) {
-        return transaction_id_result +
-               Error(
-                   "dblog::ReadLogOperation() failed to read transaction id.");
+    ResultV<LogSequenceNumber> begin_lsn_result =
+        ReadLogSequenceNumber(log_body_bytes, offset);
+    if (begin_lsn_result.IsError()) {
+        return begin_lsn_result + Error("dblog::ReadLogCheckpointing() failed "
+                                        "to read begin lsn.");
     }
-    offset += data::kUint32Bytesize;
+    offset += kLogSequenceNumberBytesize;
 
-    ResultV<uint32_t> filename_length_result =
+    ResultV<uint32_t> transaction_count_result =
         data::ReadUint32(log_body_bytes, offset);
-    if (filename_length_result.IsError()) {
-        return filename_length_result +
-               Error("dblog::ReadLogOperation() failed to read filename.");
+    if (transaction_count_result.IsError()) {
+        return transaction_count_result +
+               Error("dblog::ReadLogCheckpointing() failed to read the number "
+                     "of active transactions.");
     }
     offset += data::kUint32Bytesize;
-    const uint32_t filename_length = filename_length_result.Get();
-
-    ResultV<std::string> filename_result =
-        data::ReadString(log_body_bytes, offset,
-                         /*length=*/filename_length);
-    if (filename_result.IsError()) {
-        return filename_result +
-               Error("dblog::ReadLogOperation() failed to read filename.");
-    }
-    offset += filename_length;
 
-    ResultV<int> blockindex_result = data::ReadInt(log_body_bytes, offset);
-    if (blockindex_result.IsError()) {
-        return blockindex_result +
-               Error("dblog::ReadLogOperation() failed to read block_index.");
+    std::map<TransactionID, ActiveTransaction> active_transactions;
+    for (uint32_t i = 0; i < transaction_count_result.Get(); i++) {
+        ResultV<uint32_t> transaction_id_result =
+            data::ReadUint32(log_body_bytes, offset);
+        ResultV<LogSequenceNumber> first_lsn_result = ReadLogSequenceNumber(
+            log_body_bytes, offset + data::kUint32Bytesize);
+        ResultV<LogSequenceNumber> last_lsn_result = ReadLogSequenceNumber(
+            log_body_bytes,
+            offset + data::kUint32Bytesize + kLogSequenceNumberBytesize);
+        if (transaction_id_result.IsError() || first_lsn_result.IsError() ||
+            last_lsn_result.IsError()) {
+            return Error("dblog::ReadLogCheckpointing() failed to read an "
+                         "active transaction.");
+        }
+        offset += data::kUint32Bytesize + 2 * kLogSequenceNumberBytesize;
+        active_transactions[transaction_id_result.Get()] =
+            ActiveTransaction{first_lsn_result.Get(), last_lsn_result.Get()};
     }
-    offset += data::kIntBytesize;
 
-    ResultV<int> offset_result = data::ReadInt(log_body_bytes, offset);
-    if (offset_result.IsError()) {
-        return offset_result + Error("dblog::ReadLogOperation() failed to read "
-                                     "offset of the block.");
+    ResultV<uint32_t> page_count_result =
+        data::ReadUint32(log_body_bytes, offset);
+    if (page_count_result.IsError()) {
+        return page_count_result + Error("dblog::ReadLogCheckpointing() failed "
+                                         "to read the number of dirty pages.");
     }
-    offset += data::kIntBytesize;
-
-    return ReadLogOperationUpdate(
-        transaction_id_result.Get(),
-        disk::DiskPosition(
-            disk::BlockID(filename_result.Get(), blockindex_result.Get()),
-            offset_result.Get()),
-        log_body_bytes, offset);
-}
+    offset += data::kUint32Bytesize;
 
-ResultV<std::unique_ptr<LogRecord>>
-ReadLogTransactionEnd(const std::vector<uint8_t> &log_body_bytes) {
-    ResultV<uint32_t> transaction_id_result =
-        data::ReadUint32(log_body_bytes, 1);
-    if (transaction_id_result.IsError()) {
-        return transaction_id_result + Error("dblog::ReadLogTransactionEnd() "
-                                             "failed to read transaction_id.");
+    std::vector<buffer::DirtyPage> dirty_pages;
+    for (uint32_t i = 0; i < page_count_result.Get(); i++) {
+        ResultV<uint32_t> filename_length_result =
+            data::ReadUint32(log_body_bytes, offset);
+        if (filename_length_result.IsError()) {
+            return filename_length_result +
+                   Error("dblog::ReadLogCheckpointing() failed to read "
+                         "filename.");
+        }
+        offset += data::kUint32Bytesize;
+        const uint32_t filename_length = filename_length_result.Get();
+
+        ResultV<std::string> filename_result =
+            data::ReadString(log_body_bytes, offset,
+                             /*length=*/filename_length);
+        if (filename_result.IsError()) {
+            return filename_result + Error("dblog::ReadLogCheckpointing() "
+                                           "failed to read filename.");
+        }
+        offset += filename_length;
+
+        ResultV<int> block_index_result = data::ReadInt(log_body_bytes, offset);
+        ResultV<LogSequenceNumber> recovery_lsn_result = ReadLogSequenceNumber(
+            log_body_bytes, offset + data::kIntBytesize);
+        if (block_index_result.IsError() || recovery_lsn_result.IsError()) {
+            return Error("dblog::ReadLogCheckpointing() failed to read a dirty "
+                         "page.");
+        }
+        offset += data::kIntBytesize + kLogSequenceNumberBytesize;
+        dirty_pages.push_back(buffer::DirtyPage{
+            disk::BlockID(filename_result.Get(), block_index_result.Get()),
+            recovery_lsn_result.Get()});
     }
 
-    TransactionEndType transaction_end_type;
-    if (IsCommit(log_body_bytes[0]))
-        transaction_end_type = TransactionEndType::kCommit;
-    else if (IsRollback(log_body_bytes[0]))
-        transaction_end_type = TransactionEndType::kRollback;
-    else
-        return Error("dblog::ReadLogTransactionEnd() transaction type should "
-                     "be either Commit or Rollback.");
-
     return ResultV<std::unique_ptr<LogRecord>>(
-        std::move(std::make_unique<LogTransactionEnd>(
-            transaction_id_result.Get(), transaction_end_type)));
+        std::move(std::make_unique<LogCheckpointing>(
+            begin_lsn_result.Get(), active_transactions, dirty_pages)));
 }
 
 ResultV<std::unique_ptr<LogRecord>>
-ReadLogCheckpointing(const std::vector<uint8_t> &log_body_bytes) {
-    return ResultV<std::unique_ptr<LogRecord>>(
-        std::move(std::make_unique<LogCheckpointing>()));
-}
+ReadLogRecord(const std::vector<uint8_t> &log_body_bytes,
+              const FileDictionary &files) {
+    LogRecordView view;
+    Result decode_result = view.Decode(
+        LogBodyView{&log_body_bytes, 0, int(log_body_bytes.size())}, files);
+    if (decode_result.IsError()) {
+        return decode_result + Error("dblog::ReadLogRecord() failed to decode "
+                                     "the log record.");
+    }
 
-ResultV<std::unique_ptr<LogRecord>>
-ReadLogRecord(const std::vector<uint8_t> &log_body_bytes) {
-    if (IsTransactionBegin(log_body_bytes[0]))
-        return ReadLogTransactionBegin(log_body_bytes);
-    else if (IsOperation(log_body_bytes[0]))
-        return ReadLogOperation(log_body_bytes);
-    else if (IsTransactionEnd(log_body_bytes[0]))
-        return ReadLogTransactionEnd(log_body_bytes);
-    else if (IsCheckpointing(log_body_bytes[0]))
+    switch (view.Type()) {
+    case LogType::kTransactionBegin:
+        return ResultV<std::unique_ptr<LogRecord>>(
+            std::make_unique<LogTransactionBegin>(view.GetTransactionID()));
+    case LogType::kOperation:
+        return ResultV<std::unique_ptr<LogRecord>>(
+            std::make_unique<LogOperation>(view));
+    case LogType::kTransactionEnd:
+        return ResultV<std::unique_ptr<LogRecord>>(
+            std::make_unique<LogTransactionEnd>(
+                view.GetTransactionID(), view.GetTransactionEndType()));
+    case LogType::kCheckpointing:
         return ReadLogCheckpointing(log_body_bytes);
-    return Error("fail");
+    }
+    return Error("dblog::ReadLogRecord() unknown log type.");
 }
 
 // Returns mask bits of a transaction-end log.
@@ -196,113 +356,117 @@ LogTransactionBegin::LogTransactionBegin(const TransactionID transaction_id)
 }
 
 // This is an super roughly estimated average size of log operation.
-constexpr size_t kEstimatedAverageLogSize = 34;
+constexpr size_t kEstimatedAverageLogSize = 24;
 
 LogOperation::LogOperation(TransactionID transaction_id,
                            const disk::DiskPosition &offset,
-                           const int value_length,
+                           const FileID file_id, const int value_length,
                            const std::vector<uint8_t> &previous_item,
-                           const data::DataItem &new_item)
-    : transaction_id_(transaction_id), offset_(offset) {
+                           const data::DataItem &new_item,
+                           const LogSequenceNumber previous_lsn,
+                           const bool delta)
+    : transaction_id_(transaction_id), previous_lsn_(previous_lsn),
+      offset_(offset), file_id_(file_id) {
     log_body_.reserve(kEstimatedAverageLogSize);
 
-    log_body_.push_back(kLogOperationMask);
-    data::WriteUint32NoFail(log_body_, log_body_.size(), transaction_id);
-    data::WriteUint32NoFail(log_body_, log_body_.size(),
-                            offset.BlockID().Filename().size());
-    data::WriteStringNoFail(log_body_, log_body_.size(),
-                            offset.BlockID().Filename());
-    data::WriteIntNoFail(log_body_, log_body_.size(),
-                         offset.BlockID().BlockIndex());
-    data::WriteIntNoFail(log_body_, log_body_.size(), offset.Offset());
-
-    previous_item_offset_in_log_body_ = log_body_.size();
+    WriteLogOperationFieldsNoFail(
+        log_body_, kLogOperationMask | kLogOperationVersion, transaction_id,
+        previous_lsn, file_id, offset.BlockID().BlockIndex(), offset.Offset());
+    const int previous_offset = log_body_.size();
+    images_offset_in_log_body_ = previous_offset;
     data::WriteBytesWithOffsetNoFail(log_body_, log_body_.size(), previous_item,
                                      0);
-    new_item_offset_in_log_body_ = log_body_.size();
+    const int new_offset = log_body_.size();
     log_body_.resize(log_body_.size() + value_length);
-    Result write_result = data::Write(
-        new_item, log_body_, new_item_offset_in_log_body_, value_length);
+    Result write_result =
+        data::Write(new_item, log_body_, new_offset, value_length);
     if (write_result.IsError())
         throw std::runtime_error(
             "dblog::LogOperation::LogOperation() failed to write new "
             "item to the log body.");
+    if (!delta) return;
+
+    // The delta is the XOR of the previous and new data from the first to the
+    // last different byte, and it is used unless it is longer than the data.
+    // Thus a change of one byte is always a delta, which is undone by XOR
+    // without overwriting the bits modified by other transactions.
+    int first = 0, last = value_length;
+    while (first < last &&
+           log_body_[previous_offset + first] == log_body_[new_offset + first])
+        first++;
+    while (last > first && log_body_[previous_offset + last - 1] ==
+                               log_body_[new_offset + last - 1])
+        last--;
+    const int position_bytesize = data::VarintBytesize(first);
+    if (position_bytesize + last - first > 2 * value_length) return;
+
+    for (int i = first; i < last; i++)
+        log_body_[previous_offset + i] ^= log_body_[new_offset + i];
+    std::memmove(log_body_.data() + previous_offset + position_bytesize,
+                 log_body_.data() + previous_offset + first, last - first);
+    data::WriteVarintNoFail(log_body_, previous_offset, first);
+    log_body_.resize(previous_offset + position_bytesize + last - first);
+    log_body_[0] |= kDeltaFlag;
 }
 
-LogOperation::LogOperation(TransactionID transaction_id,
+LogOperation::LogOperation(std::vector<uint8_t> log_body,
+                           TransactionID transaction_id,
                            const disk::DiskPosition &offset,
-                           const std::vector<uint8_t> &log_body,
-                           const int data_offset_in_log_body)
-    : transaction_id_(transaction_id), offset_(offset) {
-    log_body_.reserve(kEstimatedAverageLogSize);
-
-    log_body_.push_back(kLogOperationMask);
-    data::WriteUint32NoFail(log_body_, log_body_.size(), transaction_id);
-    data::WriteUint32NoFail(log_body_, log_body_.size(),
-                            offset.BlockID().Filename().size());
-    data::WriteStringNoFail(log_body_, log_body_.size(),
-                            offset.BlockID().Filename());
-    data::WriteIntNoFail(log_body_, log_body_.size(),
-                         offset.BlockID().BlockIndex());
-    data::WriteIntNoFail(log_body_, log_body_.size(), offset.Offset());
-
-    // The length of the item is half of the (left part of) log body size.
-    const int item_bytesize = (log_body.size() - data_offset_in_log_body) / 2;
-    previous_item_offset_in_log_body_ = log_body_.size();
-    new_item_offset_in_log_body_      = log_body_.size() + item_bytesize;
-
-    data::WriteBytesWithOffsetNoFail(log_body_, log_body_.size(), log_body,
-                                     data_offset_in_log_body);
+                           const FileID file_id,
+                           const LogSequenceNumber previous_lsn,
+                           const int images_offset_in_log_body)
+    : transaction_id_(transaction_id), previous_lsn_(previous_lsn),
+      compensation_(dblog::IsCompensation(log_body[0])), offset_(offset),
+      file_id_(file_id), images_offset_in_log_body_(images_offset_in_log_body),
+      log_body_(std::move(log_body)) {}
+
+LogOperation::LogOperation(const LogRecordView &operation)
+    : LogOperation(
+          std::vector<uint8_t>(
+              operation.log_body_.bytes->begin() + operation.log_body_.begin,
+              operation.log_body_.bytes->begin() + operation.log_body_.end),
+          operation.transaction_id_,
+          disk::DiskPosition(operation.block_id_, operation.offset_),
+          operation.file_id_, operation.previous_lsn_,
+          operation.images_offset_ - operation.log_body_.begin) {}
+
+bool LogOperation::IsDelta() const { return dblog::IsDelta(log_body_[0]); }
+
+LogOperation LogOperation::CompensationLogRecord() const {
+    std::vector<uint8_t> log_body;
+    log_body.reserve(log_body_.size());
+    WriteLogOperationFieldsNoFail(log_body, log_body_[0] | kCompensationFlag,
+                                  transaction_id_, previous_lsn_, file_id_,
+                                  offset_.BlockID().BlockIndex(),
+                                  offset_.Offset());
+    const int images_offset = log_body.size();
+    AppendCompensationImagesNoFail(log_body, log_body_,
+                                   images_offset_in_log_body_,
+                                   log_body_.size(), IsDelta());
+    return LogOperation(std::move(log_body), transaction_id_, offset_,
+                        file_id_, previous_lsn_, images_offset);
 }
 
-Result LogOperation::UnDo(buffer::BufferManager &buffer_manager) const {
-    disk::Block block;
-    Result result = buffer_manager.Read(offset_.BlockID(), block);
+Result LogOperation::UnDo(buffer::BufferManager &buffer_manager,
+                          const LogSequenceNumber lsn) const {
+    Result result = UnDoOperation(buffer_manager, offset_.BlockID(),
+                                  offset_.Offset(), log_body_,
+                                  images_offset_in_log_body_,
+                                  log_body_.size(), IsDelta(), lsn);
     if (result.IsError())
-        return result +
-               Error("dblog::LogOperation::Undo() failed read data block.");
-
-    Result write_result = block.WriteBytesWithOffsetLength(
-        offset_.Offset(), log_body_, previous_item_offset_in_log_body_,
-        ValueLength());
-    if (write_result.IsError())
-        return write_result +
-               Error("dblog::LogOperation::Undo() failed to write previous "
-                     "item to the block.");
-
-    // When doing UnDo, the log record is already written to the log file.
-    // Therefore, we don't need to specify the log sequence number (there is no
-    // log record that should be written before the buffer is flushed).
-    result = buffer_manager.Write(offset_.BlockID(), block, /*lsn=*/0);
-    if (result.IsError())
-        return result + Error("dblog::LogOperation::Undo() failed to "
-                              "write block to disk.");
+        return result + Error("dblog::LogOperation::Undo() failed to undo.");
     return Ok();
 }
 
-Result LogOperation::ReDo(buffer::BufferManager &buffer_manager) const {
-    disk::Block block;
-    Result result = buffer_manager.Read(offset_.BlockID(), block);
-    if (result.IsError())
-        return result +
-               Error("dblog::LogOperation::Redo() failed read data block.");
-
-    Result write_result = block.WriteBytesWithOffsetLength(
-        offset_.Offset(), log_body_, new_item_offset_in_log_body_,
-        ValueLength());
-    if (write_result.IsError())
-        return write_result +
-               Error("dblog::LogOperation::Redo() failed to write new "
-                     "item to the block.");
-
-    // When doing UnDo, the log record is already written to the log file.
-    // Therefore, we don't need to specify the log sequence number (there is no
-    // log record that should be written before the buffer is flushed).
-    result = buffer_manager.Write(offset_.BlockID(), block, /*lsn=*/0);
+ResultV<bool> LogOperation::ReDo(buffer::BufferManager &buffer_manager,
+                                 const LogSequenceNumber lsn) const {
+    ResultV<bool> result = ReDoOperation(buffer_manager, offset_.BlockID(),
+                                         offset_.Offset(), log_body_,
+                                         images_offset_in_log_body_,
+                                         log_body_.size(), IsDelta(), lsn);
     if (result.IsError())
-        return result + Error("dblog::LogOperation::Redo() failed to "
-                              "write block to disk.");
-    return Ok();
+        return result + Error("dblog::LogOperation::Redo() failed to redo.");
+    return result;
 }
 
 LogTransactionEnd::LogTransactionEnd(TransactionID transaction_id,
@@ -314,6 +478,206 @@ LogTransactionEnd::LogTransactionEnd(TransactionID transaction_id,
     data::WriteUint32(log_body_, 1, transaction_id_);
 }
 
-LogCheckpointing::LogCheckpointing() { log_body_ = {kLogCheckpointingMask}; }
+LogCheckpointing::LogCheckpointing()
+    : LogCheckpointing(kNullLogSequenceNumber, {}, {}) {}
+
+LogCheckpointing::LogCheckpointing(
+    const LogSequenceNumber begin_lsn,
+    const std::map<TransactionID, ActiveTransaction> &active_transactions,
+    const std::vector<buffer::DirtyPage> &dirty_pages)
+    : begin_lsn_(begin_lsn), active_transactions_(active_transactions),
+      dirty_pages_(dirty_pages) {
+    log_body_.push_back(kLogCheckpointingMask);
+    WriteLogSequenceNumberNoFail(log_body_, log_body_.size(), begin_lsn_);
+
+    data::WriteUint32NoFail(log_body_, log_body_.size(),
+                            active_transactions_.size());
+    for (const auto &[transaction_id, transaction] : active_transactions_) {
+        data::WriteUint32NoFail(log_body_, log_body_.size(), transaction_id);
+        WriteLogSequenceNumberNoFail(log_body_, log_body_.size(),
+                                     transaction.first_lsn);
+        WriteLogSequenceNumberNoFail(log_body_, log_body_.size(),
+                                     transaction.last_lsn);
+    }
+
+    data::WriteUint32NoFail(log_body_, log_body_.size(), dirty_pages_.size());
+    for (const buffer::DirtyPage &dirty_page : dirty_pages_) {
+        const std::string &filename = dirty_page.block_id.Filename();
+        data::WriteUint32NoFail(log_body_, log_body_.size(), filename.size());
+        data::WriteStringNoFail(log_body_, log_body_.size(), filename);
+        data::WriteIntNoFail(log_body_, log_body_.size(),
+                             dirty_page.block_id.BlockIndex());
+        WriteLogSequenceNumberNoFail(log_body_, log_body_.size(),
+                                     dirty_page.recovery_lsn);
+    }
+}
+
+LogSequenceNumber LogCheckpointing::RedoLogSequenceNumber() const {
+    LogSequenceNumber redo_lsn = begin_lsn_;
+    for (const auto &[transaction_id, transaction] : active_transactions_)
+        redo_lsn = std::min(redo_lsn, transaction.first_lsn);
+    for (const buffer::DirtyPage &dirty_page : dirty_pages_)
+        redo_lsn = std::min(redo_lsn, dirty_page.recovery_lsn);
+    return redo_lsn;
+}
+
+Result LogRecordView::Decode(const LogBodyView &log_body,
+                             const FileDictionary &files) {
+    if (log_body.bytes == nullptr || log_body.begin >= log_body.end)
+        return Error("dblog::LogRecordView::Decode() the log body is empty.");
+    const std::vector<uint8_t> &bytes = *log_body.bytes;
+    const uint8_t header              = bytes[log_body.begin];
+    log_body_                         = log_body;
+    transaction_id_                   = 0;
+    transaction_end_type_             = TransactionEndType::kCommit;
+    previous_lsn_                     = kNullLogSequenceNumber;
+
+    if (IsCheckpointing(header)) {
+        type_ = LogType::kCheckpointing;
+        return Ok();
+    }
+
+    if (!IsOperation(header)) {
+        const size_t byte_size = IsTransactionBegin(header)
+                                     ? kLogTransactionBeginByteSize
+                                     : kLogTransactionEndByteSize;
+        if (size_t(log_body.end - log_body.begin) < byte_size)
+            return Error("dblog::LogRecordView::Decode() failed to read "
+                         "transaction id.");
+        transaction_id_ = data::ReadUint32(bytes, log_body.begin + 1).Get();
+        if (IsTransactionBegin(header)) {
+            type_ = LogType::kTransactionBegin;
+            return Ok();
+        }
+
+        type_ = LogType::kTransactionEnd;
+        if (IsCommit(header))
+            transaction_end_type_ = TransactionEndType::kCommit;
+        else if (IsRollback(header))
+            transaction_end_type_ = TransactionEndType::kRollback;
+        else
+            return Error("dblog::LogRecordView::Decode() transaction type "
+                         "should be either Commit or Rollback.");
+        return Ok();
+    }
+
+    type_ = LogType::kOperation;
+    if ((header & kFormatVersionMask) != kLogOperationVersion) {
+        return Error("dblog::LogRecordView::Decode() the format version of the "
+                     "operation is not supported.");
+    }
+    int offset = log_body.begin + 1;
+
+    ResultV<uint64_t> transaction_id_result = data::ReadVarint(bytes, offset);
+    if (transaction_id_result.IsError() ||
+        transaction_id_result.Get() > UINT32_MAX) {
+        return Error(
+            "dblog::LogRecordView::Decode() failed to read transaction id.");
+    }
+
+    ResultV<uint64_t> previous_lsn_result = data::ReadVarint(bytes, offset);
+    if (previous_lsn_result.IsError()) {
+        return previous_lsn_result + Error("dblog::LogRecordView::Decode() "
+                                           "failed to read previous lsn.");
+    }
+
+    ResultV<uint64_t> file_id_result = data::ReadVarint(bytes, offset);
+    if (file_id_result.IsError() || file_id_result.Get() > UINT32_MAX) {
+        return Error("dblog::LogRecordView::Decode() failed to read file id.");
+    }
+    const std::string *filename = files.Filename(file_id_result.Get());
+    if (filename == nullptr) {
+        return Error("dblog::LogRecordView::Decode() the file id is not in the "
+                     "file dictionary.");
+    }
+
+    ResultV<uint64_t> block_index_result = data::ReadVarint(bytes, offset);
+    if (block_index_result.IsError() ||
+        block_index_result.Get() > UINT32_MAX) {
+        return Error(
+            "dblog::LogRecordView::Decode() failed to read block_index.");
+    }
+
+    ResultV<uint64_t> offset_result = data::ReadVarint(bytes, offset);
+    if (offset_result.IsError() || offset_result.Get() > UINT32_MAX ||
+        offset > log_body.end) {
+        return Error("dblog::LogRecordView::Decode() failed to read offset of "
+                     "the block.");
+    }
+
+    // The previous and new data have the same length, and a delta starts with
+    // its position in the item.
+    int delta_offset = offset;
+    if (dblog::IsDelta(header)) {
+        if (data::ReadVarint(bytes, delta_offset).IsError() ||
+            delta_offset > log_body.end) {
+            return Error("dblog::LogRecordView::Decode() failed to read the "
+                         "position of the delta.");
+        }
+    } else if ((log_body.end - offset) % 2 != 0) {
+        return Error("dblog::LogRecordView::Decode() the previous and new data "
+                     "have different lengths.");
+    }
+
+    transaction_id_ = transaction_id_result.Get();
+    previous_lsn_   = previous_lsn_result.Get() - 1;
+    file_id_        = file_id_result.Get();
+    block_id_.Assign(*filename, int(block_index_result.Get()));
+    offset_        = int(offset_result.Get());
+    images_offset_ = offset;
+    return Ok();
+}
+
+bool LogRecordView::IsCompensation() const {
+    return dblog::IsCompensation((*log_body_.bytes)[log_body_.begin]);
+}
+
+bool LogRecordView::IsDelta() const {
+    return dblog::IsDelta((*log_body_.bytes)[log_body_.begin]);
+}
+
+Result LogRecordView::UnDo(buffer::BufferManager &buffer_manager,
+                           const LogSequenceNumber lsn) const {
+    Result result =
+        UnDoOperation(buffer_manager, block_id_, offset_, *log_body_.bytes,
+                      images_offset_, log_body_.end, IsDelta(), lsn);
+    if (result.IsError())
+        return result + Error("dblog::LogRecordView::UnDo() failed to undo.");
+    return Ok();
+}
+
+ResultV<bool> LogRecordView::ReDo(buffer::BufferManager &buffer_manager,
+                                  const LogSequenceNumber lsn) const {
+    ResultV<bool> result =
+        ReDoOperation(buffer_manager, block_id_, offset_, *log_body_.bytes,
+                      images_offset_, log_body_.end, IsDelta(), lsn);
+    if (result.IsError())
+        return result + Error("dblog::LogRecordView::ReDo() failed to redo.");
+    return result;
+}
+
+// Bytes size of the header of a log record; the checksum and the length of the
+// log body.
+constexpr int kLogRecordHeaderBytesize =
+    data::kUint32Bytesize + data::kIntBytesize;
+
+void LogRecordView::CompensationLogRecordWithHeader(
+    std::vector<uint8_t> &bytes) const {
+    bytes.resize(kLogRecordHeaderBytesize);
+    WriteLogOperationFieldsNoFail(
+        bytes, (*log_body_.bytes)[log_body_.begin] | kCompensationFlag,
+        transaction_id_, previous_lsn_, file_id_, block_id_.BlockIndex(),
+        offset_);
+    AppendCompensationImagesNoFail(bytes, *log_body_.bytes, images_offset_,
+                                   log_body_.end, IsDelta());
+
+    const int log_body_length = bytes.size() - kLogRecordHeaderBytesize;
+    data::WriteUint32NoFail(
+        bytes, 0,
+        ComputeChecksum(bytes.data() + kLogRecordHeaderBytesize,
+                        log_body_length));
+    data::WriteIntNoFail(bytes, data::kUint32Bytesize, log_body_length);
+    data::WriteIntNoFail(bytes, bytes.size(), log_body_length);
+}
 
 } // namespace dblog
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "data/data.h"
 #include "disk.h"
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -26,9 +27,6 @@ enum class LogType {
     kCheckpointing = 3,
 };
 
-// TransactionID is represented as an unsigned 32-bit integer.
-using TransactionID = uint32_t;
-
 // Types of the end of transctions.
 enum class TransactionEndType {
     // Indicates that the transaction successfully commits.
@@ -41,6 +39,8 @@ enum class TransactionEndType {
 // The base class for all types of log records
 class LogRecord {
   public:
+    virtual ~LogRecord() = default;
+
     // The log type
     virtual LogType Type() const = 0;
 
@@ -52,14 +52,27 @@ class LogRecord {
     // LogTransactionEnd, returns meaningless value.
     virtual TransactionEndType GetTransactionEndType() const = 0;
 
+    // Returns the log sequence number of the previous log record of the same
+    // transaction. If the record is not LogOperation or it is the first
+    // operation of the transaction, returns `kNullLogSequenceNumber`.
+    virtual LogSequenceNumber GetPreviousLogSequenceNumber() const = 0;
+
     // The log body which is written to the log file with a header
     virtual const std::vector<uint8_t> &LogBody() const = 0;
 
-    // Put the state back to the state bfore the operation
-    virtual Result UnDo(buffer::BufferManager &buffer_manager) const = 0;
+    // Put the state back to the state bfore the operation. `lsn` is the log
+    // sequence number of the compensation log record of this undo, which is
+    // written to the page header. If the undo is not logged, `lsn` is
+    // `kNullLogSequenceNumber`.
+    virtual Result UnDo(buffer::BufferManager &buffer_manager,
+                        const LogSequenceNumber lsn) const = 0;
 
-    // Put the state after the operation
-    virtual Result ReDo(buffer::BufferManager &buffer_manager) const = 0;
+    // Put the state after the operation. `lsn` is the log sequence number of
+    // this log record. The page is not modified if its page log sequence
+    // number shows that the page already has the modification. Returns true
+    // if the page is modified.
+    virtual ResultV<bool> ReDo(buffer::BufferManager &buffer_manager,
+                               const LogSequenceNumber lsn) const = 0;
 
     // Appends the log body to `bytes`.
     void AppendLogBody(std::vector<uint8_t> &bytes) const {
@@ -76,9 +89,15 @@ uint32_t ComputeChecksum(const std::vector<uint8_t> &bytes);
 // atomic write of logs). NOTE: log length must be smaller than 2^32-1.
 std::vector<uint8_t> LogRecordWithHeader(const LogRecord &log_record);
 
-// Read LogRecord from `log_body_bytes`.
+// Read LogRecord from `log_body_bytes`. The file ids of the operations are
+// resolved to the filenames by `files`. The fields are decoded in place, so
+// no bytes are copied other than the log body of the returned log record. To
+// read log records without allocating memory, use `LogRecordView`.
 ResultV<std::unique_ptr<LogRecord>>
-ReadLogRecord(const std::vector<uint8_t> &log_body_bytes);
+ReadLogRecord(const std::vector<uint8_t> &log_body_bytes,
+              const FileDictionary &files);
+
+class LogRecordView;
 
 // Log record which indicates that a transaction begins.
 class LogTransactionBegin : public LogRecord {
@@ -89,12 +108,17 @@ class LogTransactionBegin : public LogRecord {
     inline TransactionEndType GetTransactionEndType() const {
         return TransactionEndType::kCommit;
     }
+    inline LogSequenceNumber GetPreviousLogSequenceNumber() const {
+        return kNullLogSequenceNumber;
+    }
     inline const std::vector<uint8_t> &LogBody() const { return log_body_; }
-    inline Result UnDo(buffer::BufferManager &buffer_manager) const {
+    inline Result UnDo(buffer::BufferManager &buffer_manager,
+                       const LogSequenceNumber lsn) const {
         return Ok();
     }
-    inline Result ReDo(buffer::BufferManager &buffer_manager) const {
-        return Ok();
+    inline ResultV<bool> ReDo(buffer::BufferManager &buffer_manager,
+                              const LogSequenceNumber lsn) const {
+        return Ok(false);
     }
 
   private:
@@ -103,41 +127,87 @@ class LogTransactionBegin : public LogRecord {
 };
 
 // Log record which indicates that an item is inserted, updated or deleted in
-// the disk.
+// the disk. The file of the modification is written as its id in the file
+// dictionary of the log, and the integers are written as varints. The images
+// of the item are written either as the previous and the new data, or
+// optionally as the XOR of them (delta) from the first to the last different
+// byte unless it is longer. A delta is applied by XOR both to redo and to
+// undo, which is correct because the page log sequence number makes sure that
+// a log record is redone only on the page without it, and a log record is
+// undone only on the page with it. Undoing a delta flips back only the bits it
+// changed, so the bits of the same bytes changed by other transactions are
+// kept.
 class LogOperation : public LogRecord {
   public:
     // Initialize a LogOperation log. `previous_item` and `new_item` are the
     // previous and new data. `previous_item_bytes` is the bytes because this is
-    // read from the disk.
-    LogOperation(TransactionID transaction_id, const disk::DiskPosition &offset,
-                 const int value_length,
-                 const std::vector<uint8_t> &previous_item_bytes,
-                 const data::DataItem &new_item);
-
-    // Initialize a LogOperation log. `log_body`[`data_offset_in_log_body`:]
-    // corresponds to the bytes of the previous and new data.
-    LogOperation(TransactionID transaction_id, const disk::DiskPosition &offset,
-                 const std::vector<uint8_t> &log_body,
-                 int data_offset_in_log_body);
+    // read from the disk. `file_id` is the id of the file of `offset` in the
+    // file dictionary. `previous_lsn` is the log sequence number of the
+    // previous log record of the transaction, which rollback follows. If
+    // `delta` is true, the images are written as a delta unless it is longer;
+    // then `previous_item_bytes` must be the bytes on the page, because the
+    // delta is applied to the page by XOR.
+    LogOperation(
+        TransactionID transaction_id, const disk::DiskPosition &offset,
+        const FileID file_id, const int value_length,
+        const std::vector<uint8_t> &previous_item_bytes,
+        const data::DataItem &new_item,
+        const LogSequenceNumber previous_lsn = kNullLogSequenceNumber,
+        const bool delta                     = false);
+
+    // Initialize a LogOperation log with the encoded `log_body`, whose fields
+    // before `images_offset_in_log_body` are decoded to the arguments. The
+    // compensation and the delta are told by the header of `log_body`.
+    LogOperation(std::vector<uint8_t> log_body, TransactionID transaction_id,
+                 const disk::DiskPosition &offset, const FileID file_id,
+                 const LogSequenceNumber previous_lsn,
+                 const int images_offset_in_log_body);
+
+    // Initialize a LogOperation log with a copy of the log body of the
+    // operation `operation`.
+    explicit LogOperation(const LogRecordView &operation);
 
     inline LogType Type() const { return LogType::kOperation; }
     inline TransactionID GetTransactionID() const { return transaction_id_; }
     inline TransactionEndType GetTransactionEndType() const {
         return TransactionEndType::kCommit;
     }
+    inline LogSequenceNumber GetPreviousLogSequenceNumber() const {
+        return previous_lsn_;
+    }
     inline const std::vector<uint8_t> &LogBody() const { return log_body_; }
-    Result UnDo(buffer::BufferManager &buffer_manager) const;
-    Result ReDo(buffer::BufferManager &buffer_manager) const;
+    Result UnDo(buffer::BufferManager &buffer_manager,
+                const LogSequenceNumber lsn) const;
+    ResultV<bool> ReDo(buffer::BufferManager &buffer_manager,
+                       const LogSequenceNumber lsn) const;
 
-  private:
-    // Returns the length of the values  in the log record.
-    inline int ValueLength() const {
-        return new_item_offset_in_log_body_ - previous_item_offset_in_log_body_;
-    }
+    // Position of the modification.
+    inline const disk::DiskPosition &Position() const { return offset_; }
+
+    // The id of the file of the modification in the file dictionary.
+    inline FileID GetFileID() const { return file_id_; }
+
+    // Returns true if this is a compensation log record, which is written
+    // when an operation is undone. A compensation log record is only redone
+    // and never undone; its previous log sequence number is the one of the
+    // operation to undo next.
+    inline bool IsCompensation() const { return compensation_; }
+
+    // Returns true if the images are written as a delta.
+    bool IsDelta() const;
 
+    // Returns the compensation log record which undoes this operation; it
+    // writes the previous data and the operation before this one is undone
+    // next.
+    LogOperation CompensationLogRecord() const;
+
+  private:
     TransactionID transaction_id_;
+    LogSequenceNumber previous_lsn_;
+    bool compensation_ = false;
     disk::DiskPosition offset_;
-    int previous_item_offset_in_log_body_, new_item_offset_in_log_body_;
+    FileID file_id_;
+    int images_offset_in_log_body_;
     std::vector<uint8_t> log_body_;
 };
 
@@ -151,12 +221,17 @@ class LogTransactionEnd : public LogRecord {
     inline TransactionEndType GetTransactionEndType() const {
         return transaction_end_type_;
     }
+    inline LogSequenceNumber GetPreviousLogSequenceNumber() const {
+        return kNullLogSequenceNumber;
+    }
     const std::vector<uint8_t> &LogBody() const { return log_body_; }
-    inline Result UnDo(buffer::BufferManager &buffer_manager) const {
+    inline Result UnDo(buffer::BufferManager &buffer_manager,
+                       const LogSequenceNumber lsn) const {
         return Ok();
     }
-    inline Result ReDo(buffer::BufferManager &buffer_manager) const {
-        return Ok();
+    inline ResultV<bool> ReDo(buffer::BufferManager &buffer_manager,
+                              const LogSequenceNumber lsn) const {
+        return Ok(false);
     }
 
   private:
@@ -165,27 +240,135 @@ class LogTransactionEnd : public LogRecord {
     std::vector<uint8_t> log_body_;
 };
 
-// Log record which indicates that a checkpointing finishes.
+// Log record which indicates that a checkpointing finishes. The record has the
+// active transaction table and the dirty page table when the checkpoint began,
+// so that recovery can start from the checkpoint.
 class LogCheckpointing : public LogRecord {
   public:
     LogCheckpointing();
+
+    // `begin_lsn` is the end of the log stream when `active_transactions` was
+    // taken, and `dirty_pages` was taken after that.
+    LogCheckpointing(
+        const LogSequenceNumber begin_lsn,
+        const std::map<TransactionID, ActiveTransaction> &active_transactions,
+        const std::vector<buffer::DirtyPage> &dirty_pages);
+
     inline LogType Type() const { return LogType::kCheckpointing; }
     inline TransactionID GetTransactionID() const { return 0; }
     inline TransactionEndType GetTransactionEndType() const {
         return TransactionEndType::kCommit;
     }
+    inline LogSequenceNumber GetPreviousLogSequenceNumber() const {
+        return kNullLogSequenceNumber;
+    }
     inline const std::vector<uint8_t> &LogBody() const { return log_body_; }
-    inline Result UnDo(buffer::BufferManager &buffer_manager) const {
+    inline Result UnDo(buffer::BufferManager &buffer_manager,
+                       const LogSequenceNumber lsn) const {
         return Ok();
     }
-    inline Result ReDo(buffer::BufferManager &buffer_manager) const {
-        return Ok();
+    inline ResultV<bool> ReDo(buffer::BufferManager &buffer_manager,
+                              const LogSequenceNumber lsn) const {
+        return Ok(false);
+    }
+
+    inline LogSequenceNumber BeginLogSequenceNumber() const {
+        return begin_lsn_;
+    }
+    inline const std::map<TransactionID, ActiveTransaction> &
+    ActiveTransactions() const {
+        return active_transactions_;
+    }
+    inline const std::vector<buffer::DirtyPage> &DirtyPages() const {
+        return dirty_pages_;
     }
 
+    // Returns the log sequence number from which recovery has to read the log
+    // records; the first log record of the active transactions, the first
+    // modification of the dirty pages, or the beginning of the checkpoint.
+    LogSequenceNumber RedoLogSequenceNumber() const;
+
   private:
+    LogSequenceNumber begin_lsn_ = kNullLogSequenceNumber;
+    std::map<TransactionID, ActiveTransaction> active_transactions_;
+    std::vector<buffer::DirtyPage> dirty_pages_;
     std::vector<uint8_t> log_body_;
 };
 
+// LogRecordView is a log record decoded in place from a log body, which it
+// refers to instead of copying, so that reading a log record allocates no
+// memory. The kind of the log record is told by `Type()` and the methods for
+// the kind are called, instead of the virtual methods of `LogRecord`. The view
+// is valid as long as the log body is. A view is meant to be reused for the
+// log records one after another, and then the memory of the block id of an
+// operation is reused as well.
+//
+// The fields of a checkpointing record are not decoded, because they are
+// read only once by recovery; they are read by `ReadLogRecord()`.
+class LogRecordView {
+  public:
+    // Decodes the log body `log_body`. The file id of an operation is
+    // resolved to the filename by `files`.
+    Result Decode(const LogBodyView &log_body, const FileDictionary &files);
+
+    // The log type
+    inline LogType Type() const { return type_; }
+
+    // The log body which the view refers to.
+    inline const LogBodyView &LogBody() const { return log_body_; }
+
+    // Returns TransactionID of the log record. When the record type is
+    // checkpointing, always returns 0.
+    inline TransactionID GetTransactionID() const { return transaction_id_; }
+
+    // Returns transaction end type of a transaction end. Otherwise, returns
+    // meaningless value.
+    inline TransactionEndType GetTransactionEndType() const {
+        return transaction_end_type_;
+    }
+
+    // Returns the log sequence number of the previous log record of the same
+    // transaction. If the record is not an operation or it is the first
+    // operation of the transaction, returns `kNullLogSequenceNumber`.
+    inline LogSequenceNumber GetPreviousLogSequenceNumber() const {
+        return previous_lsn_;
+    }
+
+    // The following methods are only for an operation; see `LogOperation`.
+
+    // Block id and offset in the block of the modification.
+    inline const disk::BlockID &BlockID() const { return block_id_; }
+    inline int Offset() const { return offset_; }
+
+    inline FileID GetFileID() const { return file_id_; }
+    bool IsCompensation() const;
+    bool IsDelta() const;
+
+    Result UnDo(buffer::BufferManager &buffer_manager,
+                const LogSequenceNumber lsn) const;
+    ResultV<bool> ReDo(buffer::BufferManager &buffer_manager,
+                       const LogSequenceNumber lsn) const;
+
+    // Writes the compensation log record which undoes this operation with the
+    // header, as `LogRecordWithHeader()` does, to `bytes`. The memory of
+    // `bytes` is reused, so that a buffer can be reused to write the
+    // compensation log records one after another.
+    void CompensationLogRecordWithHeader(std::vector<uint8_t> &bytes) const;
+
+  private:
+    friend class LogOperation;
+
+    LogBodyView log_body_;
+    LogType type_                            = LogType::kCheckpointing;
+    TransactionID transaction_id_            = 0;
+    TransactionEndType transaction_end_type_ = TransactionEndType::kCommit;
+    LogSequenceNumber previous_lsn_          = kNullLogSequenceNumber;
+    FileID file_id_                          = 0;
+    disk::BlockID block_id_;
+    int offset_        = 0;
+    int images_offset_ = 0;
+};
+
 } // namespace dblog
 
 #endif
\ No newline at end of file
@@ -32,13 +32,13 @@ TEST(LogRecordLogOperation, InstantiationSuccess) {
     const std::vector<uint8_t> int_value = {4, 0, 0, 0};
     const data::DataItem dummy_value     = data::Int(0).Item();
     dblog::LogOperation log_op(id, disk::DiskPosition(block_id, 4),
-                               data::kTypeInt.ValueLength(),
+                               /*file_id=*/0, data::kTypeInt.ValueLength(),
                                /*previous_item=*/int_value,
                                /*new_item=*/dummy_value);
 
     EXPECT_EQ(log_op.Type(), dblog::LogType::kOperation);
     auto log_body = log_op.LogBody();
-    EXPECT_EQ(log_body[0], 0b01000000);
+    EXPECT_EQ(log_body[0], 0b01000001);
 }
 
 TEST(LogRecordLogTransactionEnd, InstantiationSuccess) {
@@ -61,12 +61,50 @@ TEST(LogRecordLogCheckpointing, InstantiationSuccess) {
     EXPECT_EQ(log_body[0], 0b11000000);
 }
 
-TEST(LogRecordTransactionBegin, WriteReadCorrectly) {
+FILE_NONEXISTENT_TEST(LogRecordRead);
+
+TEST_F(LogRecordRead, CheckpointingTablesWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    const std::map<dblog::TransactionID, dblog::ActiveTransaction>
+        active_transactions = {{3, {/*first_lsn=*/40, /*last_lsn=*/90}},
+                               {8, {/*first_lsn=*/70, /*last_lsn=*/70}}};
+    const std::vector<buffer::DirtyPage> dirty_pages = {
+        {disk::BlockID("xxx.txt", 4), /*recovery_lsn=*/50},
+        {disk::BlockID("y", 0), /*recovery_lsn=*/20}};
+    dblog::LogCheckpointing log_record(/*begin_lsn=*/100, active_transactions,
+                                       dirty_pages);
+
+    ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
+        dblog::ReadLogRecord(log_record.LogBody(), files);
+    ASSERT_TRUE(log_record_ptr_result.IsOk()) << log_record_ptr_result.Error();
+    ASSERT_EQ(log_record_ptr_result.Get()->Type(),
+              dblog::LogType::kCheckpointing);
+    const auto &checkpoint = static_cast<const dblog::LogCheckpointing &>(
+        *log_record_ptr_result.Get());
+    EXPECT_EQ(checkpoint.LogBody(), log_record.LogBody());
+    EXPECT_EQ(checkpoint.BeginLogSequenceNumber(), 100);
+    ASSERT_EQ(checkpoint.ActiveTransactions().size(), 2);
+    EXPECT_EQ(checkpoint.ActiveTransactions().at(3).first_lsn, 40);
+    EXPECT_EQ(checkpoint.ActiveTransactions().at(3).last_lsn, 90);
+    ASSERT_EQ(checkpoint.DirtyPages().size(), 2);
+    EXPECT_EQ(checkpoint.DirtyPages()[1].block_id, disk::BlockID("y", 0));
+    EXPECT_EQ(checkpoint.DirtyPages()[1].recovery_lsn, 20);
+
+    // Recovery starts from the oldest of them.
+    EXPECT_EQ(checkpoint.RedoLogSequenceNumber(), 20);
+    EXPECT_EQ(dblog::LogCheckpointing().RedoLogSequenceNumber(),
+              dblog::kNullLogSequenceNumber);
+}
+
+TEST_F(LogRecordRead, TransactionBeginWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
     dblog::LogTransactionBegin log_record(/*transaction_id=*/6);
 
     auto log_body = log_record.LogBody();
     ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
-        dblog::ReadLogRecord(log_body);
+        dblog::ReadLogRecord(log_body, files);
     EXPECT_TRUE(log_record_ptr_result.IsOk());
 
     std::unique_ptr<dblog::LogRecord> log_record_ptr =
@@ -75,17 +113,21 @@ TEST(LogRecordTransactionBegin, WriteReadCorrectly) {
     EXPECT_EQ(log_record_ptr->LogBody(), log_body);
 }
 
-TEST(LogRecordOperation, UpdateWriteReadCorrectly) {
+TEST_F(LogRecordRead, OperationUpdateWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    ResultV<dblog::FileID> file_id = files.ID("xxx.txt");
+    ASSERT_TRUE(file_id.IsOk()) << file_id.Error();
     const std::vector<uint8_t> previous_value = {4, 0, 0, 0};
     const data::DataItem new_value            = data::Int(6).Item();
     dblog::LogOperation log_record(
         /*transaction_id=*/6,
-        disk::DiskPosition(disk::BlockID("xxx.txt", 4), 3),
+        disk::DiskPosition(disk::BlockID("xxx.txt", 4), 3), file_id.Get(),
         data::kTypeInt.ValueLength(), previous_value, new_value);
 
     auto log_body = log_record.LogBody();
     ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
-        dblog::ReadLogRecord(log_body);
+        dblog::ReadLogRecord(log_body, files);
     EXPECT_TRUE(log_record_ptr_result.IsOk());
 
     std::unique_ptr<dblog::LogRecord> log_record_ptr =
@@ -94,13 +136,215 @@ TEST(LogRecordOperation, UpdateWriteReadCorrectly) {
     EXPECT_EQ(log_record_ptr->LogBody(), log_body);
 }
 
-TEST(LogRecordTransactionEnd, WriteReadCorrectly) {
+TEST_F(LogRecordRead, OperationPreviousLogSequenceNumberWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    ResultV<dblog::FileID> file_id = files.ID("xxx.txt");
+    ASSERT_TRUE(file_id.IsOk()) << file_id.Error();
+    const std::vector<uint8_t> previous_value = {4, 0, 0, 0};
+    const data::DataItem new_value            = data::Int(6).Item();
+    dblog::LogOperation log_record(
+        /*transaction_id=*/6,
+        disk::DiskPosition(disk::BlockID("xxx.txt", 4), 3), file_id.Get(),
+        data::kTypeInt.ValueLength(), previous_value, new_value,
+        /*previous_lsn=*/(uint64_t(1) << 40) + 3);
+
+    ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
+        dblog::ReadLogRecord(log_record.LogBody(), files);
+    ASSERT_TRUE(log_record_ptr_result.IsOk());
+    EXPECT_EQ(log_record_ptr_result.Get()->GetPreviousLogSequenceNumber(),
+              (uint64_t(1) << 40) + 3);
+}
+
+TEST_F(LogRecordRead, OperationCompensationLogRecordWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    ResultV<dblog::FileID> file_id = files.ID("xxx.txt");
+    ASSERT_TRUE(file_id.IsOk()) << file_id.Error();
+    const std::vector<uint8_t> previous_value = {4, 0, 0, 0};
+    const data::DataItem new_value            = data::Int(6).Item();
+    dblog::LogOperation operation(
+        /*transaction_id=*/6,
+        disk::DiskPosition(disk::BlockID("xxx.txt", 4), 3), file_id.Get(),
+        data::kTypeInt.ValueLength(), previous_value, new_value,
+        /*previous_lsn=*/5);
+    EXPECT_FALSE(operation.IsCompensation());
+
+    // The compensation log record writes the previous value back, and the
+    // operation before `operation` is undone next.
+    const dblog::LogOperation compensation = operation.CompensationLogRecord();
+    EXPECT_TRUE(compensation.IsCompensation());
+    EXPECT_EQ(compensation.GetTransactionID(), 6);
+    EXPECT_EQ(compensation.GetPreviousLogSequenceNumber(), 5);
+    const dblog::LogOperation expect_compensation(
+        /*transaction_id=*/6,
+        disk::DiskPosition(disk::BlockID("xxx.txt", 4), 3), file_id.Get(),
+        data::kTypeInt.ValueLength(), /*previous_item=*/{6, 0, 0, 0},
+        data::Int(4).Item(), /*previous_lsn=*/5);
+    EXPECT_EQ(std::vector<uint8_t>(compensation.LogBody().begin() + 1,
+                                   compensation.LogBody().end()),
+              std::vector<uint8_t>(expect_compensation.LogBody().begin() + 1,
+                                   expect_compensation.LogBody().end()));
+
+    ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
+        dblog::ReadLogRecord(compensation.LogBody(), files);
+    ASSERT_TRUE(log_record_ptr_result.IsOk());
+    const dblog::LogRecord &log_record = *log_record_ptr_result.Get();
+    EXPECT_EQ(log_record.Type(), dblog::LogType::kOperation);
+    EXPECT_TRUE(static_cast<const dblog::LogOperation &>(log_record)
+                    .IsCompensation());
+    EXPECT_EQ(log_record.LogBody(), compensation.LogBody());
+}
+
+TEST_F(LogRecordRead, OperationIsCompactAndIndependentOfFilename) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    const std::string long_filename = "a_table_with_a_long_name.table";
+    ASSERT_TRUE(files.ID("t").IsOk());
+    ResultV<dblog::FileID> file_id = files.ID(long_filename);
+    ASSERT_TRUE(file_id.IsOk()) << file_id.Error();
+
+    // Only the third byte changes, so the delta is 1 byte at position 2.
+    const std::vector<uint8_t> previous_value = {4, 0, 0, 0};
+    const data::DataItem new_value = data::Int(4 + (5 << 16)).Item();
+    const disk::DiskPosition position(disk::BlockID(long_filename, 300), 20);
+    dblog::LogOperation log_record(
+        /*transaction_id=*/6, position, file_id.Get(),
+        data::kTypeInt.ValueLength(), previous_value, new_value,
+        /*previous_lsn=*/1000, /*delta=*/true);
+    EXPECT_TRUE(log_record.IsDelta());
+    EXPECT_EQ(log_record.LogBody(),
+              std::vector<uint8_t>({0b01010001, /*transaction_id=*/6,
+                                    /*previous_lsn+1=*/0b11101001, 0b111,
+                                    /*file_id=*/1,
+                                    /*block_index=*/0b10101100, 0b10,
+                                    /*offset=*/20, /*position=*/2,
+                                    /*delta=*/5}));
+
+    ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
+        dblog::ReadLogRecord(log_record.LogBody(), files);
+    ASSERT_TRUE(log_record_ptr_result.IsOk()) << log_record_ptr_result.Error();
+    const auto &operation =
+        static_cast<const dblog::LogOperation &>(*log_record_ptr_result.Get());
+    EXPECT_EQ(operation.GetTransactionID(), 6);
+    EXPECT_EQ(operation.GetPreviousLogSequenceNumber(), 1000);
+    EXPECT_EQ(operation.GetFileID(), file_id.Get());
+    EXPECT_EQ(operation.Position().BlockID(), position.BlockID());
+    EXPECT_EQ(operation.Position().Offset(), position.Offset());
+    EXPECT_TRUE(operation.IsDelta());
+}
+
+TEST_F(LogRecordRead, OperationReadFailsWithUnknownFileOrVersion) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    dblog::LogOperation log_record(
+        /*transaction_id=*/6, disk::DiskPosition(disk::BlockID("xxx", 4), 3),
+        /*file_id=*/0, data::kTypeInt.ValueLength(), {4, 0, 0, 0},
+        data::Int(6).Item());
+    EXPECT_TRUE(dblog::ReadLogRecord(log_record.LogBody(), files).IsError());
+
+    // The operations of the old format, with the version 0, are not read.
+    ASSERT_TRUE(files.ID("xxx").IsOk());
+    EXPECT_TRUE(dblog::ReadLogRecord(log_record.LogBody(), files).IsOk());
+    std::vector<uint8_t> old_log_body = log_record.LogBody();
+    old_log_body[0] &= 0b11110000;
+    EXPECT_TRUE(dblog::ReadLogRecord(old_log_body, files).IsError());
+}
+
+TEST_F(LogRecordRead, ViewDecodesLogRecordsInPlace) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    ResultV<dblog::FileID> file_id = files.ID("xxx.txt");
+    ASSERT_TRUE(file_id.IsOk()) << file_id.Error();
+
+    // The log bodies are laid out in one buffer as in the window of a log
+    // reader, and one view is reused for them.
+    const dblog::LogTransactionBegin begin(/*transaction_id=*/3);
+    const dblog::LogOperation operation(
+        /*transaction_id=*/3,
+        disk::DiskPosition(disk::BlockID("xxx.txt", 4), 7), file_id.Get(),
+        data::kTypeInt.ValueLength(), /*previous_item=*/{1, 0, 0, 0},
+        data::Int(2).Item(), /*previous_lsn=*/9);
+    const dblog::LogTransactionEnd end(/*transaction_id=*/3,
+                                       dblog::TransactionEndType::kRollback);
+    std::vector<uint8_t> bytes = {0xff};
+    std::vector<dblog::LogBodyView> log_bodies;
+    for (const dblog::LogRecord *log_record :
+         std::vector<const dblog::LogRecord *>{&begin, &operation, &end}) {
+        const int log_body_begin = bytes.size();
+        log_record->AppendLogBody(bytes);
+        log_bodies.push_back(
+            dblog::LogBodyView{&bytes, log_body_begin, int(bytes.size())});
+        bytes.push_back(0xff);
+    }
+
+    dblog::LogRecordView view;
+    ASSERT_TRUE(view.Decode(log_bodies[0], files).IsOk());
+    EXPECT_EQ(view.Type(), dblog::LogType::kTransactionBegin);
+    EXPECT_EQ(view.GetTransactionID(), 3);
+
+    ASSERT_TRUE(view.Decode(log_bodies[1], files).IsOk());
+    EXPECT_EQ(view.Type(), dblog::LogType::kOperation);
+    EXPECT_EQ(view.GetTransactionID(), 3);
+    EXPECT_EQ(view.GetPreviousLogSequenceNumber(), 9);
+    EXPECT_EQ(view.GetFileID(), file_id.Get());
+    EXPECT_EQ(view.BlockID(), disk::BlockID("xxx.txt", 4));
+    EXPECT_EQ(view.Offset(), 7);
+    EXPECT_FALSE(view.IsCompensation());
+    EXPECT_EQ(dblog::LogOperation(view).LogBody(), operation.LogBody());
+
+    ASSERT_TRUE(view.Decode(log_bodies[2], files).IsOk());
+    EXPECT_EQ(view.Type(), dblog::LogType::kTransactionEnd);
+    EXPECT_EQ(view.GetTransactionID(), 3);
+    EXPECT_EQ(view.GetTransactionEndType(),
+              dblog::TransactionEndType::kRollback);
+    EXPECT_EQ(view.GetPreviousLogSequenceNumber(),
+              dblog::kNullLogSequenceNumber);
+
+    EXPECT_TRUE(
+        view.Decode(dblog::LogBodyView{&bytes, log_bodies[1].begin,
+                                       log_bodies[1].begin + 3},
+                    files)
+            .IsError());
+}
+
+TEST_F(LogRecordRead, ViewWritesCompensationLogRecordWithHeader) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
+    ResultV<dblog::FileID> file_id = files.ID("xxx.txt");
+    ASSERT_TRUE(file_id.IsOk()) << file_id.Error();
+    for (const bool delta : {false, true}) {
+        const dblog::LogOperation operation(
+            /*transaction_id=*/6,
+            disk::DiskPosition(disk::BlockID("xxx.txt", 4), 3), file_id.Get(),
+            data::kTypeInt.ValueLength(), /*previous_item=*/{4, 0, 0, 0},
+            data::Int(6).Item(), /*previous_lsn=*/5, delta);
+        EXPECT_EQ(operation.IsDelta(), delta);
+
+        dblog::LogRecordView view;
+        ASSERT_TRUE(view.Decode(dblog::LogBodyView{&operation.LogBody(), 0,
+                                                   int(operation.LogBody()
+                                                           .size())},
+                                files)
+                        .IsOk());
+        // The buffer has a longer log record before, whose bytes do not
+        // remain.
+        std::vector<uint8_t> bytes(100, 0xff);
+        view.CompensationLogRecordWithHeader(bytes);
+        EXPECT_EQ(bytes, dblog::LogRecordWithHeader(
+                             operation.CompensationLogRecord()));
+    }
+}
+
+TEST_F(LogRecordRead, TransactionEndWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
     dblog::LogTransactionEnd log_record(
         /*transaction_id=*/6, dblog::TransactionEndType::kCommit);
 
     auto log_body = log_record.LogBody();
     ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
-        dblog::ReadLogRecord(log_body);
+        dblog::ReadLogRecord(log_body, files);
     EXPECT_TRUE(log_record_ptr_result.IsOk());
 
     std::unique_ptr<dblog::LogRecord> log_record_ptr =
@@ -109,12 +353,14 @@ TEST(LogRecordTransactionEnd, WriteReadCorrectly) {
     EXPECT_EQ(log_record_ptr->LogBody(), log_body);
 }
 
-TEST(LogRecordCheckpointing, WriteReadCorrectly) {
+TEST_F(LogRecordRead, CheckpointingWriteReadCorrectly) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/16);
+    dblog::FileDictionary files(disk_manager, non_existent_filename);
     dblog::LogCheckpointing log_record;
 
     auto log_body = log_record.LogBody();
     ResultV<std::unique_ptr<dblog::LogRecord>> log_record_ptr_result =
-        dblog::ReadLogRecord(log_body);
+        dblog::ReadLogRecord(log_body, files);
     EXPECT_TRUE(log_record_ptr_result.IsOk());
 
     std::unique_ptr<dblog::LogRecord> log_record_ptr =
@@ -132,7 +378,8 @@ TEST_F(LogRecordTransactionBeginWithFile, UnDoCorrectly) {
     buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
                                                log_manager);
     dblog::LogTransactionBegin log_record(4);
-    EXPECT_TRUE(log_record.UnDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.UnDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
 }
 
 TEST_F(LogRecordTransactionBeginWithFile, ReDoCorrectly) {
@@ -142,7 +389,8 @@ TEST_F(LogRecordTransactionBeginWithFile, ReDoCorrectly) {
     buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
                                                log_manager);
     dblog::LogTransactionBegin log_record(4);
-    EXPECT_TRUE(log_record.ReDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.ReDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
 }
 
 TWO_FILE_EXISTENT_TEST(LogRecordOperationWithFile, "", "");
@@ -161,12 +409,13 @@ TEST_F(LogRecordOperationWithFile, UnDoCorrectly) {
     const int offset = 7;
     dblog::LogOperation log_record(
         /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
-        data::kTypeInt.ValueLength(),
+        /*file_id=*/0, data::kTypeInt.ValueLength(),
         /*previous_item=*/int_value, /*new_item=*/dummy_value);
     ASSERT_TRUE(
         disk_manager.AllocateNewBlocks(disk::BlockID(filename0, 2)).IsOk());
 
-    EXPECT_TRUE(log_record.UnDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.UnDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
     Result flush_result = buffer_manager.Flush(block_id);
     ASSERT_TRUE(flush_result.IsOk()) << flush_result.Error();
 
@@ -189,15 +438,17 @@ TEST_F(LogRecordOperationWithFile, InitializedFromLogBytesThenUnDoCorrectly) {
     const disk::BlockID block_id(filename0, 0);
     const int offset                     = 7;
     const int expect_value               = 4;
-    const std::vector<uint8_t> log_bytes = {121, expect_value, 0, 0, 0, 0, 0, 0,
-                                            0};
+    const std::vector<uint8_t> log_bytes = {0b01000001, expect_value, 0, 0, 0,
+                                            0,          0,            0, 0};
     dblog::LogOperation log_record(
-        /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
-        /*log_bytes=*/log_bytes, /*data_offset_in_log_bytes=*/1);
+        /*log_body=*/log_bytes, /*transaction_id=*/4,
+        disk::DiskPosition(block_id, offset), /*file_id=*/0,
+        dblog::kNullLogSequenceNumber, /*images_offset_in_log_body=*/1);
     ASSERT_TRUE(
         disk_manager.AllocateNewBlocks(disk::BlockID(filename0, 2)).IsOk());
 
-    EXPECT_TRUE(log_record.UnDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.UnDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
     Result flush_result = buffer_manager.Flush(block_id);
     ASSERT_TRUE(flush_result.IsOk()) << flush_result.Error();
 
@@ -223,12 +474,13 @@ TEST_F(LogRecordOperationWithFile, ReDoCorrectly) {
     const int offset = 7;
     dblog::LogOperation log_record(
         /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
-        data::kTypeInt.ValueLength(),
+        /*file_id=*/0, data::kTypeInt.ValueLength(),
         /*previous_item=*/dummy_value, /*new_item=*/int_value);
     ASSERT_TRUE(
         disk_manager.AllocateNewBlocks(disk::BlockID(filename0, 2)).IsOk());
 
-    EXPECT_TRUE(log_record.ReDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.ReDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
     Result flush_result = buffer_manager.Flush(block_id);
     ASSERT_TRUE(flush_result.IsOk()) << flush_result.Error();
 
@@ -250,15 +502,17 @@ TEST_F(LogRecordOperationWithFile, InitializedFromLogBytesThenReDoCorrectly) {
     const disk::BlockID block_id(filename0, 0);
     const int offset                     = 7;
     const int expect_value               = 4;
-    const std::vector<uint8_t> log_bytes = {121,          0, 0, 0, 0,
+    const std::vector<uint8_t> log_bytes = {0b01000001,   0, 0, 0, 0,
                                             expect_value, 0, 0, 0};
     dblog::LogOperation log_record(
-        /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
-        /*log_bytes=*/log_bytes, /*data_offset_in_log_bytes=*/1);
+        /*log_body=*/log_bytes, /*transaction_id=*/4,
+        disk::DiskPosition(block_id, offset), /*file_id=*/0,
+        dblog::kNullLogSequenceNumber, /*images_offset_in_log_body=*/1);
     ASSERT_TRUE(
         disk_manager.AllocateNewBlocks(disk::BlockID(filename0, 2)).IsOk());
 
-    EXPECT_TRUE(log_record.ReDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.ReDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
     Result flush_result = buffer_manager.Flush(block_id);
     ASSERT_TRUE(flush_result.IsOk()) << flush_result.Error();
 
@@ -271,6 +525,88 @@ TEST_F(LogRecordOperationWithFile, InitializedFromLogBytesThenReDoCorrectly) {
     EXPECT_EQ(int_result.Get(), expect_value);
 }
 
+TEST_F(LogRecordOperationWithFile, ReDoSkipsUpToDatePage) {
+    disk::DiskManager disk_manager(directory_path, 20);
+    dblog::LogManager log_manager(filename1, directory_path, /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                               log_manager);
+    const disk::BlockID block_id(filename0, 0);
+    const int offset = buffer::kPageHeaderSize;
+    ASSERT_TRUE(
+        disk_manager.AllocateNewBlocks(disk::BlockID(filename0, 2)).IsOk());
+    const std::vector<uint8_t> zero_value = {0, 0, 0, 0};
+    dblog::LogOperation log_record0(
+        /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
+        /*file_id=*/0, data::kTypeInt.ValueLength(), zero_value,
+        data::Int(4).Item());
+    dblog::LogOperation log_record1(
+        /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
+        /*file_id=*/0, data::kTypeInt.ValueLength(), zero_value,
+        data::Int(5).Item());
+
+    ResultV<bool> redo_result = log_record1.ReDo(buffer_manager, /*lsn=*/30);
+    ASSERT_TRUE(redo_result.IsOk()) << redo_result.Error();
+    EXPECT_TRUE(redo_result.Get());
+    redo_result = log_record0.ReDo(buffer_manager, /*lsn=*/10);
+    ASSERT_TRUE(redo_result.IsOk()) << redo_result.Error();
+    EXPECT_FALSE(redo_result.Get());
+    redo_result = log_record1.ReDo(buffer_manager, /*lsn=*/30);
+    ASSERT_TRUE(redo_result.IsOk()) << redo_result.Error();
+    EXPECT_FALSE(redo_result.Get());
+    ASSERT_TRUE(buffer_manager.Flush(block_id).IsOk());
+
+    disk::Block block;
+    ASSERT_TRUE(disk_manager.Read(block_id, block).IsOk());
+    ResultV<int> int_result = block.ReadInt(offset);
+    ASSERT_TRUE(int_result.IsOk());
+    EXPECT_EQ(int_result.Get(), 5);
+    buffer::Buffer buffer(block_id, block);
+    EXPECT_EQ(buffer.PageLogSequenceNumber(), 30);
+}
+
+TEST_F(LogRecordOperationWithFile, DeltaIsAppliedByReDoAndUnDo) {
+    disk::DiskManager disk_manager(directory_path, 20);
+    dblog::LogManager log_manager(filename1, directory_path, /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                               log_manager);
+    const disk::BlockID block_id(filename0, 0);
+    const int offset = buffer::kPageHeaderSize;
+    ASSERT_TRUE(
+        disk_manager.AllocateNewBlocks(disk::BlockID(filename0, 2)).IsOk());
+    const int previous_value = 7 + (1 << 16), new_value = 7 + (3 << 16);
+    buffer::PageGuard page;
+    ASSERT_TRUE(buffer_manager.Pin(block_id, page).IsOk());
+    ASSERT_TRUE(page.Write(offset, data::kTypeInt.ValueLength(),
+                           data::Int(previous_value).Item(),
+                           dblog::kNullLogSequenceNumber)
+                    .IsOk());
+    const std::vector<uint8_t> previous_bytes = {7, 0, 1, 0};
+    dblog::LogOperation log_record(
+        /*transaction_id=*/4, disk::DiskPosition(block_id, offset),
+        /*file_id=*/0, data::kTypeInt.ValueLength(), previous_bytes,
+        data::Int(new_value).Item(), dblog::kNullLogSequenceNumber,
+        /*delta=*/true);
+    ASSERT_TRUE(log_record.IsDelta());
+
+    // The delta changes the page from the previous value to the new value,
+    // and the compensation log record changes it back.
+    ResultV<bool> redo_result = log_record.ReDo(buffer_manager, /*lsn=*/10);
+    ASSERT_TRUE(redo_result.IsOk()) << redo_result.Error();
+    EXPECT_TRUE(redo_result.Get());
+    EXPECT_EQ(page.Block().ReadInt(offset).Get(), new_value);
+
+    const dblog::LogOperation compensation = log_record.CompensationLogRecord();
+    EXPECT_TRUE(compensation.IsDelta());
+    ASSERT_TRUE(log_record.UnDo(buffer_manager, /*lsn=*/20).IsOk());
+    EXPECT_EQ(page.Block().ReadInt(offset).Get(), previous_value);
+    redo_result = compensation.ReDo(buffer_manager, /*lsn=*/20);
+    ASSERT_TRUE(redo_result.IsOk()) << redo_result.Error();
+    EXPECT_FALSE(redo_result.Get());
+    EXPECT_EQ(page.Block().ReadInt(offset).Get(), previous_value);
+}
+
 TWO_FILE_EXISTENT_TEST(LogRecordTransactionEndWithFile, "", "");
 
 TEST_F(LogRecordTransactionEndWithFile, UnDoCorrectly) {
@@ -280,7 +616,8 @@ TEST_F(LogRecordTransactionEndWithFile, UnDoCorrectly) {
     buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
                                                log_manager);
     dblog::LogTransactionEnd log_record(4, dblog::TransactionEndType::kCommit);
-    EXPECT_TRUE(log_record.UnDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.UnDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
 }
 
 TEST_F(LogRecordTransactionEndWithFile, ReDoCorrectly) {
@@ -290,7 +627,8 @@ TEST_F(LogRecordTransactionEndWithFile, ReDoCorrectly) {
     buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
                                                log_manager);
     dblog::LogTransactionEnd log_record(4, dblog::TransactionEndType::kCommit);
-    EXPECT_TRUE(log_record.ReDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.ReDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
 }
 
 TWO_FILE_EXISTENT_TEST(LogRecordCheckpointingWithFile, "", "");
@@ -302,7 +640,8 @@ TEST_F(LogRecordCheckpointingWithFile, UnDoCorrectly) {
     buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
                                                log_manager);
     dblog::LogCheckpointing log_record;
-    EXPECT_TRUE(log_record.UnDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.UnDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
 }
 
 TEST_F(LogRecordCheckpointingWithFile, ReDoCorrectly) {
@@ -312,5 +651,6 @@ TEST_F(LogRecordCheckpointingWithFile, ReDoCorrectly) {
     buffer::SimpleBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
                                                log_manager);
     dblog::LogCheckpointing log_record;
-    EXPECT_TRUE(log_record.ReDo(buffer_manager).IsOk());
+    EXPECT_TRUE(
+        log_record.ReDo(buffer_manager, dblog::kNullLogSequenceNumber).IsOk());
 }
\ No newline at end of file
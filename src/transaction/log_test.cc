@@ -1,4 +1,6 @@
+#include "checksum.h"
 #include "data/int.h"
+#include "data/uint32.h"
 #include "log.h"
 #include "log_record.h"
 #include "macro_test.h"
@@ -6,13 +8,27 @@
 #include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
 #include <vector>
 
+// Fills the checksum field (the first 4 bytes) of a raw log record with the
+// checksum of its log body.
+std::vector<uint8_t> WithChecksum(std::vector<uint8_t> log_record_bytes) {
+    const std::vector<uint8_t> log_body(log_record_bytes.begin() + 8,
+                                        log_record_bytes.end() - 4);
+    data::WriteUint32NoFail(log_record_bytes, /*offset=*/0,
+                            dblog::ComputeChecksum(log_body));
+    return log_record_bytes;
+}
+
 TEST(LogLogBlock, InstantiateOffset) {
     using namespace dblog::internal;
     LogBlock block(32);
 
-    EXPECT_EQ(block.Offset(), 4);
+    EXPECT_EQ(block.Offset(), 8);
 }
 
 TEST(LogLogBlock, AppendSuccess) {
@@ -21,24 +37,24 @@ TEST(LogLogBlock, AppendSuccess) {
 
     std::vector<uint8_t> bytes = {'a', 'b', 'c'};
     EXPECT_TRUE(block.Append(bytes, /*bytes_offset=*/1).IsOk());
-    EXPECT_EQ(block.Offset(), 6);
+    EXPECT_EQ(block.Offset(), 10);
     std::vector<uint8_t> raw_content = block.RawBlock().Content();
-    EXPECT_EQ(raw_content[4], 'b');
-    EXPECT_EQ(raw_content[5], 'c');
+    EXPECT_EQ(raw_content[8], 'b');
+    EXPECT_EQ(raw_content[9], 'c');
 }
 
 TEST(LogLogBlock, AppendTooLongFail) {
     using namespace dblog::internal;
-    LogBlock block(6);
+    LogBlock block(10);
 
     std::vector<uint8_t> bytes = {'a', 'b', 'c', 'd'};
     auto append_result         = block.Append(bytes, /*bytes_offset=*/1);
     EXPECT_TRUE(append_result.IsError());
     EXPECT_EQ(append_result.Error(), 3);
-    EXPECT_EQ(block.Offset(), 6);
+    EXPECT_EQ(block.Offset(), 10);
     std::vector<uint8_t> raw_content = block.RawBlock().Content();
-    EXPECT_EQ(raw_content[4], 'b');
-    EXPECT_EQ(raw_content[5], 'c');
+    EXPECT_EQ(raw_content[8], 'b');
+    EXPECT_EQ(raw_content[9], 'c');
 }
 
 FILE_EXISTENT_TEST(LogFileExistentTest, "0001 block content ----");
@@ -114,6 +130,51 @@ TEST_F(LogFileExistentLogManager, FlushSuccess) {
     EXPECT_TRUE(flush_result.IsOk());
 }
 
+TEST_F(LogFileExistentLogManager, ConcurrentFlushesAreGrouped) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    const int thread_count = 4;
+    log_manager.SetGroupCommit(std::chrono::milliseconds(500), thread_count);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures = 0;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&] {
+            std::vector<uint8_t> bytes = {'a', 'b', 'c', 'd'};
+            auto write_result          = log_manager.WriteLog(bytes);
+            if (write_result.IsError() ||
+                log_manager.Flush(write_result.Get()).IsError()) {
+                failures++;
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures, 0);
+    EXPECT_LT(log_manager.SyncCount(), thread_count);
+    EXPECT_GE(log_manager.SyncCount(), 1);
+}
+
+TEST_F(LogFileExistentLogManager, FlushIsSkippedWhenAlreadyFlushed) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    std::vector<uint8_t> bytes = {'a', 'b', 'c', 'd'};
+    auto write_result0         = log_manager.WriteLog(bytes);
+    auto write_result1         = log_manager.WriteLog(bytes);
+    ASSERT_TRUE(write_result0.IsOk() && write_result1.IsOk());
+
+    ASSERT_TRUE(log_manager.Flush(write_result1.Get()).IsOk());
+    ASSERT_TRUE(log_manager.Flush(write_result0.Get()).IsOk());
+
+    EXPECT_EQ(log_manager.SyncCount(), 1);
+}
+
 FILE_EXISTENT_TEST(LogFileEmptyLogManager, "");
 
 TEST_F(LogFileEmptyLogManager, WriteAndReadLastLog) {
@@ -133,7 +194,7 @@ TEST_F(LogFileEmptyLogManager, WriteAndReadLastLog) {
         'd',
     };
 
-    auto write_result = log_manager.WriteLog(log_record_bytes);
+    auto write_result = log_manager.WriteLog(WithChecksum(log_record_bytes));
     ASSERT_TRUE(write_result.IsOk()) << write_result.Error() << '\n';
     ASSERT_TRUE(log_manager.Flush().IsOk());
 
@@ -147,6 +208,406 @@ TEST_F(LogFileEmptyLogManager, WriteAndReadLastLog) {
     EXPECT_EQ(log_body_result.Get(), log_body_bytes);
 }
 
+TEST_F(LogFileEmptyLogManager, ReadCorruptedLogFails) {
+    {
+        dblog::LogManager log_manager(/*log_filename=*/filename,
+                                      /*log_directory_name=*/directory_path,
+                                      /*block_size=*/32);
+        ASSERT_TRUE(log_manager.Init().IsOk());
+        std::vector<uint8_t> log_record_bytes = {
+            /*checksum*/ '\0',     '\0', '\0', '\0',
+            /*log body length*/ 4, '\0', '\0', '\0',
+            /*log body*/ 'a',      'b',  'c',  'd',
+            /*log body length*/ 4, '\0', '\0', '\0'};
+        ASSERT_TRUE(
+            log_manager.WriteLog(WithChecksum(log_record_bytes)).IsOk());
+        ASSERT_TRUE(log_manager.Flush().IsOk());
+    }
+
+    // Overwrites 'b' in the log body (offset 8 + 8 + 1) of the first log
+    // segment as a torn write.
+    std::fstream file(directory_path + filename + ".0",
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(17);
+    file.put('x');
+    file.close();
+
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/32);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    auto last_log_iterator_result = log_manager.LastLog();
+    ASSERT_TRUE(last_log_iterator_result.IsOk())
+        << last_log_iterator_result.Error() << '\n';
+    auto last_log_iterator = last_log_iterator_result.Get();
+    EXPECT_TRUE(last_log_iterator.LogBody().IsError());
+}
+
+TEST_F(LogFileEmptyLogManager, LogReaderOfEmptyLogIsInvalid) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/32);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+
+    auto reader_result = log_manager.NewReader();
+    ASSERT_TRUE(reader_result.IsOk()) << reader_result.Error();
+    dblog::LogReader reader = reader_result.Get();
+    EXPECT_TRUE(reader.Empty());
+    EXPECT_TRUE(reader.SeekToLast().IsOk());
+    EXPECT_FALSE(reader.Valid());
+    EXPECT_FALSE(reader.HasPrevious());
+    EXPECT_TRUE(reader.LogBody().IsError());
+    EXPECT_TRUE(reader.ViewLogBody().IsError());
+}
+
+TEST_F(LogFileEmptyLogManager, ActiveTransactionsAreUpdatedWithWrites) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/32);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+
+    const std::vector<uint8_t> bytes = {'a', 'b', 'c', 'd'};
+    ASSERT_TRUE(log_manager.WriteLog(bytes, 1, /*ends=*/false).IsOk());
+    ASSERT_TRUE(log_manager.WriteLog(bytes, 2, /*ends=*/false).IsOk());
+    ASSERT_TRUE(log_manager.WriteLog(bytes, 1, /*ends=*/false).IsOk());
+    ASSERT_TRUE(log_manager.WriteLog(bytes, 2, /*ends=*/true).IsOk());
+
+    dblog::LogSequenceNumber end_lsn;
+    auto active_transactions = log_manager.ActiveTransactions(end_lsn);
+    EXPECT_EQ(end_lsn, 16);
+    ASSERT_EQ(active_transactions.size(), 1);
+    EXPECT_EQ(active_transactions.at(1).first_lsn, 0);
+    EXPECT_EQ(active_transactions.at(1).last_lsn, 8);
+}
+
+TEST_F(LogFileEmptyLogManager, MasterRecordWriteReadCorrectly) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/32);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+
+    auto read_result = log_manager.ReadMasterRecord();
+    ASSERT_TRUE(read_result.IsOk()) << read_result.Error();
+    EXPECT_EQ(read_result.Get(), dblog::kNullLogSequenceNumber);
+
+    const dblog::LogSequenceNumber lsn = (uint64_t(1) << 33) + 5;
+    ASSERT_TRUE(log_manager.WriteMasterRecord(lsn).IsOk());
+    read_result = log_manager.ReadMasterRecord();
+    ASSERT_TRUE(read_result.IsOk()) << read_result.Error();
+    EXPECT_EQ(read_result.Get(), lsn);
+}
+
+TEST_F(LogFileEmptyLogManager, TruncateKeepsLogRecordsAfterIt) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/16);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+
+    const std::vector<uint8_t> log_body = {'a', 'b', 'c', 'd', 'e'};
+    const std::vector<uint8_t> log_record_bytes = WithChecksum(
+        {'\0', '\0', '\0', '\0', 5, '\0', '\0', '\0', 'a', 'b', 'c', 'd',
+         'e', 5, '\0', '\0', '\0'});
+    std::vector<dblog::LogSequenceNumber> lsns;
+    for (int i = 0; i < 10; i++) {
+        auto write_result = log_manager.WriteLog(log_record_bytes);
+        ASSERT_TRUE(write_result.IsOk()) << write_result.Error();
+        lsns.push_back(write_result.Get());
+    }
+    ASSERT_TRUE(log_manager.Flush().IsOk());
+
+    Result truncate_result = log_manager.Truncate(lsns[6]);
+    ASSERT_TRUE(truncate_result.IsOk()) << truncate_result.Error();
+
+    auto reader_result = log_manager.NewReader();
+    ASSERT_TRUE(reader_result.IsOk()) << reader_result.Error();
+    dblog::LogReader reader = reader_result.Get();
+    ASSERT_TRUE(reader.Seek(lsns[6]).IsOk());
+    for (int i = 6; i < 10; i++) {
+        EXPECT_EQ(reader.Position(), lsns[i]);
+        auto body = reader.LogBody();
+        ASSERT_TRUE(body.IsOk()) << body.Error();
+        EXPECT_EQ(body.Get(), log_body);
+        if (i < 9) ASSERT_TRUE(reader.Next().IsOk());
+    }
+}
+
+// Makes a raw log record whose log body is `log_body`.
+std::vector<uint8_t> LogRecordBytes(const std::vector<uint8_t> &log_body) {
+    std::vector<uint8_t> log_record_bytes(4, '\0');
+    data::WriteIntNoFail(log_record_bytes, 4, log_body.size());
+    log_record_bytes.insert(log_record_bytes.end(), log_body.begin(),
+                            log_body.end());
+    data::WriteIntNoFail(log_record_bytes, log_record_bytes.size(),
+                         log_body.size());
+    return WithChecksum(log_record_bytes);
+}
+
+TEST_F(LogFileEmptyLogManager, ConcurrentWritersFillLogStream) {
+    const int thread_count = 8, log_count = 200;
+    std::map<dblog::LogSequenceNumber, std::vector<uint8_t>> expect_logs;
+    {
+        // The log buffer is small, so the writers wait for the flusher.
+        dblog::LogManager log_manager(/*log_filename=*/filename,
+                                      /*log_directory_name=*/directory_path,
+                                      /*block_size=*/32,
+                                      /*buffer_size=*/4 * 32);
+        ASSERT_TRUE(log_manager.Init().IsOk());
+
+        std::vector<std::thread> threads;
+        std::vector<std::map<dblog::LogSequenceNumber, std::vector<uint8_t>>>
+            written_logs(thread_count);
+        std::atomic<int> failures = 0;
+        for (int t = 0; t < thread_count; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < log_count; i++) {
+                    const std::vector<uint8_t> log_body(1 + (t + i) % 40,
+                                                        uint8_t(t));
+                    auto write_result =
+                        log_manager.WriteLog(LogRecordBytes(log_body));
+                    if (write_result.IsError()) {
+                        failures++;
+                        continue;
+                    }
+                    written_logs[t][write_result.Get()] = log_body;
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQ(failures, 0);
+        ASSERT_TRUE(log_manager.Flush().IsOk());
+        for (const auto &logs : written_logs) {
+            expect_logs.insert(logs.begin(), logs.end());
+        }
+    }
+
+    // The log records are read back in the order of the log sequence numbers
+    // after the log file is opened again.
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/32);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    auto reader_result = log_manager.NewReader();
+    ASSERT_TRUE(reader_result.IsOk()) << reader_result.Error();
+    dblog::LogReader reader = reader_result.Get();
+    ASSERT_TRUE(reader.SeekToFirst().IsOk());
+    ASSERT_EQ(expect_logs.size(), thread_count * log_count);
+    for (const auto &[lsn, log_body] : expect_logs) {
+        ASSERT_TRUE(reader.Valid());
+        EXPECT_EQ(reader.Position(), lsn);
+        auto body = reader.LogBody();
+        ASSERT_TRUE(body.IsOk()) << body.Error();
+        EXPECT_EQ(body.Get(), log_body);
+
+        // The view refers to the same bytes in the window of the reader.
+        auto view = reader.ViewLogBody();
+        ASSERT_TRUE(view.IsOk()) << view.Error();
+        const std::vector<uint8_t> &window = *view.Get().bytes;
+        EXPECT_EQ(std::vector<uint8_t>(window.begin() + view.Get().begin,
+                                       window.begin() + view.Get().end),
+                  log_body);
+        if (reader.HasNext()) ASSERT_TRUE(reader.Next().IsOk());
+    }
+    EXPECT_FALSE(reader.HasNext());
+}
+
+TEST_F(LogFileEmptyLogManager, LogSegmentIsPreallocatedAndWrittenLazily) {
+    const int block_size = 32, buffer_block_count = 8, segment_block_count = 16;
+    dblog::LogManager log_manager(
+        /*log_filename=*/filename, /*log_directory_name=*/directory_path,
+        /*block_size=*/block_size,
+        /*buffer_size=*/buffer_block_count * block_size,
+        /*segment_size=*/segment_block_count * block_size);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    disk::DiskManager disk_manager(directory_path, block_size);
+    EXPECT_EQ(disk_manager.Size(filename + ".0").Get(), segment_block_count);
+
+    // The log record stays in the log buffer until it is flushed.
+    const std::vector<uint8_t> log_record_bytes =
+        LogRecordBytes({'a', 'b', 'c', 'd'});
+    ASSERT_TRUE(log_manager.WriteLog(log_record_bytes).IsOk());
+    disk::Block block;
+    ASSERT_TRUE(
+        disk_manager.Read(disk::BlockID(filename + ".0", 0), block).IsOk());
+    EXPECT_EQ(block.ReadInt(0).Get(), 0);
+    ASSERT_TRUE(log_manager.Flush().IsOk());
+    ASSERT_TRUE(
+        disk_manager.Read(disk::BlockID(filename + ".0", 0), block).IsOk());
+    EXPECT_EQ(block.ReadInt(0).Get(), 8 + log_record_bytes.size());
+
+    // The next log segment is preallocated when the log reaches it, and the
+    // log segment before it keeps its size.
+    for (int i = 0; i < 40; i++) {
+        ASSERT_TRUE(log_manager.WriteLog(log_record_bytes).IsOk());
+    }
+    ASSERT_TRUE(log_manager.Flush().IsOk());
+    EXPECT_EQ(disk_manager.Size(filename + ".0").Get(), segment_block_count);
+    EXPECT_EQ(disk_manager.Size(filename + ".1").Get(), segment_block_count);
+    ASSERT_TRUE(
+        disk_manager.Read(disk::BlockID(filename + ".1", 0), block).IsOk());
+    EXPECT_EQ(block.ReadInt(4).Get(), segment_block_count);
+
+    // The end of the log is found in the preallocated log segment.
+    dblog::LogManager reopened_log_manager(
+        /*log_filename=*/filename, /*log_directory_name=*/directory_path,
+        /*block_size=*/block_size,
+        /*buffer_size=*/buffer_block_count * block_size,
+        /*segment_size=*/segment_block_count * block_size);
+    ASSERT_TRUE(reopened_log_manager.Init().IsOk());
+    dblog::LogSequenceNumber end_lsn;
+    reopened_log_manager.ActiveTransactions(end_lsn);
+    EXPECT_EQ(end_lsn, 41 * log_record_bytes.size());
+}
+
+// Returns the filenames of the log segments of `filename` in
+// `directory_path`.
+std::set<std::string> LogSegmentFilenames(const std::string &directory_path,
+                                          const std::string &filename) {
+    std::set<std::string> filenames;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory_path)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(filename + ".", 0) == 0) filenames.insert(name);
+    }
+    return filenames;
+}
+
+TEST_F(LogFileEmptyLogManager, LogSegmentsAreReusedAfterTruncate) {
+    // A log segment has 4 blocks of 24 bytes of log records.
+    const int block_size = 32, segment_block_count = 4;
+    const auto open_log_manager = [&] {
+        return std::make_unique<dblog::LogManager>(
+            /*log_filename=*/filename, /*log_directory_name=*/directory_path,
+            /*block_size=*/block_size, /*buffer_size=*/4 * block_size,
+            /*segment_size=*/segment_block_count * block_size);
+    };
+    const std::vector<uint8_t> log_body = {'a', 'b', 'c', 'd'};
+    const std::vector<uint8_t> log_record_bytes = LogRecordBytes(log_body);
+    std::vector<dblog::LogSequenceNumber> lsns;
+
+    auto log_manager = open_log_manager();
+    ASSERT_TRUE(log_manager->Init().IsOk());
+    for (int i = 0; i < 100; i++) {
+        auto write_result = log_manager->WriteLog(log_record_bytes);
+        ASSERT_TRUE(write_result.IsOk()) << write_result.Error();
+        lsns.push_back(write_result.Get());
+    }
+    ASSERT_TRUE(log_manager->Flush().IsOk());
+    EXPECT_EQ(LogSegmentFilenames(directory_path, filename).size(), 17);
+
+    // The log records are read across the log segments in both directions.
+    auto last_log_result = log_manager->LastLog();
+    ASSERT_TRUE(last_log_result.IsOk()) << last_log_result.Error();
+    dblog::LogIterator iterator = last_log_result.Get();
+    int log_count = 1;
+    while (iterator.HasPrevious()) {
+        ASSERT_TRUE(iterator.Previous().IsOk());
+        auto body = iterator.LogBody();
+        ASSERT_TRUE(body.IsOk()) << body.Error();
+        EXPECT_EQ(body.Get(), log_body);
+        log_count++;
+    }
+    EXPECT_EQ(log_count, 100);
+
+    // The log segments before the one of `lsns[90]` are released. Two of
+    // them are kept as spares after the last log segment.
+    ASSERT_TRUE(log_manager->Truncate(lsns[90]).IsOk());
+    const std::set<std::string> expect_filenames = {
+        filename + ".15", filename + ".16", filename + ".17",
+        filename + ".18"};
+    EXPECT_EQ(LogSegmentFilenames(directory_path, filename), expect_filenames);
+
+    // The stale blocks in the spare log segments are not regarded as the log
+    // when the log is opened again.
+    log_manager = open_log_manager();
+    ASSERT_TRUE(log_manager->Init().IsOk());
+    dblog::LogSequenceNumber end_lsn;
+    log_manager->ActiveTransactions(end_lsn);
+    EXPECT_EQ(end_lsn, 100 * log_record_bytes.size());
+
+    // The spare log segments are written before new log segments are
+    // created.
+    for (int i = 0; i < 50; i++) {
+        auto write_result = log_manager->WriteLog(log_record_bytes);
+        ASSERT_TRUE(write_result.IsOk()) << write_result.Error();
+        lsns.push_back(write_result.Get());
+    }
+    ASSERT_TRUE(log_manager->Flush().IsOk());
+    EXPECT_EQ(LogSegmentFilenames(directory_path, filename).size(), 10);
+
+    log_manager = open_log_manager();
+    ASSERT_TRUE(log_manager->Init().IsOk());
+    auto reader_result = log_manager->NewReader(/*window_block_count=*/3);
+    ASSERT_TRUE(reader_result.IsOk()) << reader_result.Error();
+    dblog::LogReader reader = reader_result.Get();
+    ASSERT_TRUE(reader.Seek(lsns[90]).IsOk());
+    for (int i = 90; i < 150; i++) {
+        ASSERT_TRUE(reader.Valid());
+        EXPECT_EQ(reader.Position(), lsns[i]);
+        auto body = reader.LogBody();
+        ASSERT_TRUE(body.IsOk()) << body.Error();
+        EXPECT_EQ(body.Get(), log_body);
+        if (i < 149) ASSERT_TRUE(reader.Next().IsOk());
+    }
+    EXPECT_FALSE(reader.HasNext());
+}
+
+TEST_F(LogFileEmptyLogManager, WriteLogFailsWhenLogRecordExceedsBuffer) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/16,
+                                  /*buffer_size=*/2 * 16);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+
+    // A log record must fit in the log buffer without one log block.
+    EXPECT_TRUE(log_manager.WriteLog(std::vector<uint8_t>(8)).IsOk());
+    EXPECT_TRUE(log_manager.WriteLog(std::vector<uint8_t>(9)).IsError());
+}
+
+TEST_F(LogFileEmptyLogManager, FileDictionaryIsPersisted) {
+    const int block_size             = 16;
+    const std::string long_filename  = std::string(40, 'x');
+    const std::string files_filename = filename + ".files";
+    {
+        dblog::LogManager log_manager(/*log_filename=*/filename,
+                                      /*log_directory_name=*/directory_path,
+                                      /*block_size=*/block_size);
+        ASSERT_TRUE(log_manager.Init().IsOk());
+        ResultV<dblog::FileID> id0 = log_manager.Files().ID("table0");
+        ASSERT_TRUE(id0.IsOk()) << id0.Error();
+        EXPECT_EQ(id0.Get(), 0);
+        ResultV<dblog::FileID> id1 = log_manager.Files().ID(long_filename);
+        ASSERT_TRUE(id1.IsOk()) << id1.Error();
+        EXPECT_EQ(id1.Get(), 1);
+        EXPECT_EQ(log_manager.Files().ID("table0").Get(), 0);
+        EXPECT_EQ(log_manager.Files().Filename(2), nullptr);
+    }
+
+    // An entry occupies its own blocks; "table0" in 1 block, and the long
+    // filename in 3 blocks. An entry which is not entirely written is
+    // ignored, and its blocks are overwritten by the next entry.
+    disk::DiskManager disk_manager(directory_path, block_size);
+    ASSERT_EQ(disk_manager.Size(files_filename).Get(), 4);
+    disk::Block torn_block(block_size);
+    ASSERT_TRUE(torn_block.WriteInt(/*offset=*/4, /*value=*/100).IsOk());
+    ASSERT_TRUE(disk_manager.AllocateNewBlocks(disk::BlockID(files_filename, 4))
+                    .IsOk());
+    ASSERT_TRUE(
+        disk_manager.Write(disk::BlockID(files_filename, 4), torn_block)
+            .IsOk());
+
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/block_size);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    ASSERT_NE(log_manager.Files().Filename(1), nullptr);
+    EXPECT_EQ(*log_manager.Files().Filename(1), long_filename);
+    EXPECT_EQ(log_manager.Files().Filename(2), nullptr);
+    EXPECT_EQ(log_manager.Files().ID("table1").Get(), 2);
+    EXPECT_EQ(disk_manager.Size(files_filename).Get(), 5);
+}
+
 TEST_F(LogFileEmptyLogManager, WriteAndReadTooLongLastLog) {
     dblog::LogManager log_manager(/*log_filename=*/filename,
                                   /*log_directory_name=*/directory_path,
@@ -162,7 +623,7 @@ TEST_F(LogFileEmptyLogManager, WriteAndReadTooLongLastLog) {
         'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
     };
 
-    auto write_result = log_manager.WriteLog(log_record_bytes);
+    auto write_result = log_manager.WriteLog(WithChecksum(log_record_bytes));
     ASSERT_TRUE(write_result.IsOk()) << write_result.Error() << '\n';
     ASSERT_TRUE(log_manager.Flush().IsOk());
 
@@ -194,18 +655,18 @@ class LogFileInitialized : public ::testing::Test {
             'c',  'd',  'e',  'f',  'g', 'h',  'i',  'j',  'k', 'l',
             'm',  'n',  'o',  'p',  'q', 'r',  's',  't',  'u', 'v',
             'w',  'x',  'y',  'z',  26,  '\0', '\0', '\0'};
-        log_manager.WriteLog(log_record_bytes1);
+        log_manager.WriteLog(WithChecksum(log_record_bytes1));
 
         std::vector<uint8_t> log_record_bytes2 = {'\0', '\0', '\0', '\0', 1,
                                                   '\0', '\0', '\0', 'a',  1,
                                                   '\0', '\0', '\0'};
-        log_manager.WriteLog(log_record_bytes2);
+        log_manager.WriteLog(WithChecksum(log_record_bytes2));
 
         std::vector<uint8_t> log_record_bytes3 = {
             '\0', '\0', '\0', '\0', 13,   '\0', '\0', '\0', 'a',
             'b',  'c',  'd',  'e',  'f',  'g',  'h',  'i',  'j',
             'k',  'l',  'm',  13,   '\0', '\0', '\0'};
-        log_manager.WriteLog(log_record_bytes3);
+        log_manager.WriteLog(WithChecksum(log_record_bytes3));
 
         log_manager.Flush();
     }
@@ -322,3 +783,90 @@ TEST_F(LogFileInitialized, LogIteratorNext) {
     EXPECT_TRUE(has_next.IsOk());
     EXPECT_FALSE(has_next.Get());
 }
+
+TEST_F(LogFileInitialized, LogReaderReadsBackwardAndForward) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/block_size);
+    auto result = log_manager.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error() << '\n';
+
+    const std::vector<std::vector<uint8_t>> expect_logs = {
+        {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+         'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'},
+        {'a'},
+        {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm'}};
+
+    // The window smaller than a log record has to be extended.
+    for (const int window_block_count : {1, 64}) {
+        auto reader_result = log_manager.NewReader(window_block_count);
+        ASSERT_TRUE(reader_result.IsOk()) << reader_result.Error();
+        dblog::LogReader reader = reader_result.Get();
+        EXPECT_FALSE(reader.Empty());
+
+        result = reader.SeekToLast();
+        ASSERT_TRUE(result.IsOk()) << result.Error() << '\n';
+        for (int i = expect_logs.size() - 1; i >= 0; i--) {
+            ASSERT_TRUE(reader.Valid());
+            auto log_body = reader.LogBody();
+            ASSERT_TRUE(log_body.IsOk()) << log_body.Error() << '\n';
+            EXPECT_EQ(log_body.Get(), expect_logs[i]);
+            EXPECT_EQ(reader.HasPrevious(), i > 0);
+            if (i > 0) ASSERT_TRUE(reader.Previous().IsOk());
+        }
+        EXPECT_TRUE(reader.Previous().IsError());
+
+        for (int i = 0; i < expect_logs.size(); i++) {
+            auto log_body = reader.LogBody();
+            ASSERT_TRUE(log_body.IsOk()) << log_body.Error() << '\n';
+            EXPECT_EQ(log_body.Get(), expect_logs[i]);
+            EXPECT_EQ(reader.HasNext(), i + 1 < expect_logs.size());
+            if (i + 1 < expect_logs.size()) ASSERT_TRUE(reader.Next().IsOk());
+        }
+        EXPECT_TRUE(reader.Next().IsError());
+
+        result = reader.SeekToFirst();
+        ASSERT_TRUE(result.IsOk()) << result.Error() << '\n';
+        EXPECT_EQ(reader.Position(), 0);
+        EXPECT_EQ(reader.LogBody().Get(), expect_logs[0]);
+    }
+}
+
+TEST_F(LogFileInitialized, LogReaderSeeksToLogSequenceNumber) {
+    dblog::LogManager log_manager(/*log_filename=*/filename,
+                                  /*log_directory_name=*/directory_path,
+                                  /*block_size=*/block_size);
+    auto result = log_manager.Init();
+    ASSERT_TRUE(result.IsOk()) << result.Error() << '\n';
+
+    // The log record which is not flushed is read from the current block.
+    const std::vector<uint8_t> appended_log       = {'x', 'y', 'z'};
+    const std::vector<uint8_t> appended_log_bytes = {
+        '\0', '\0', '\0', '\0', 3, '\0', '\0', '\0', 'x',
+        'y',  'z',  3,    '\0', '\0', '\0'};
+    auto write_result =
+        log_manager.WriteLog(WithChecksum(appended_log_bytes));
+    ASSERT_TRUE(write_result.IsOk()) << write_result.Error() << '\n';
+
+    // The log sequence number is the position in the log stream, which
+    // follows the three log records written in the fixture.
+    EXPECT_EQ(write_result.Get(), (26 + 12) + (1 + 12) + (13 + 12));
+
+    auto reader_result = log_manager.NewReader(/*window_block_count=*/2);
+    ASSERT_TRUE(reader_result.IsOk()) << reader_result.Error();
+    dblog::LogReader reader = reader_result.Get();
+    result = reader.SeekToLast();
+    ASSERT_TRUE(result.IsOk()) << result.Error() << '\n';
+    EXPECT_EQ(reader.Position(), write_result.Get());
+    auto log_body = reader.LogBody();
+    ASSERT_TRUE(log_body.IsOk()) << log_body.Error() << '\n';
+    EXPECT_EQ(log_body.Get(), appended_log);
+
+    // A log record can be read directly from its log sequence number.
+    result = reader.Seek(/*lsn=*/26 + 12);
+    ASSERT_TRUE(result.IsOk()) << result.Error() << '\n';
+    log_body = reader.LogBody();
+    ASSERT_TRUE(log_body.IsOk()) << log_body.Error() << '\n';
+    EXPECT_EQ(log_body.Get(), std::vector<uint8_t>{'a'});
+    EXPECT_TRUE(reader.Seek(/*lsn=*/1000).IsError());
+}
@@ -20,7 +20,7 @@ class TransactionTest : public ::testing::Test {
           buffer_manager(/*buffer_size=*/16, data_disk_manager, log_manager),
           lock_table(/*wait_time_sec=*/0.1),
           transaction_for_check(data_disk_manager, buffer_manager, log_manager,
-                                lock_table) {
+                                lock_table, version_store, free_space_map) {
 
         if (!std::filesystem::exists(data_directory_path)) {
             std::filesystem::create_directories(data_directory_path);
@@ -62,6 +62,8 @@ class TransactionTest : public ::testing::Test {
     dblog::LogManager log_manager;
     buffer::SimpleBufferManager buffer_manager;
     dbconcurrency::LockTable lock_table;
+    dbconcurrency::VersionStore version_store;
+    disk::FreeSpaceMap free_space_map;
 
     transaction::Transaction transaction_for_check;
 };
@@ -0,0 +1,74 @@
+#include "page_cleaner.h"
+#include "debug.h"
+
+namespace buffer {
+
+PageCleaner::PageCleaner(BufferManager &buffer_manager,
+                         const double clean_ratio, const int batch_size,
+                         const std::chrono::milliseconds interval)
+    : buffer_manager_(buffer_manager), clean_ratio_(clean_ratio),
+      batch_size_(batch_size), interval_(interval) {}
+
+PageCleaner::~PageCleaner() { Stop(); }
+
+void PageCleaner::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_   = std::thread(&PageCleaner::Run, this);
+}
+
+void PageCleaner::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) return;
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    thread_.join();
+}
+
+void PageCleaner::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        woken_ = true;
+    }
+    condition_.notify_all();
+}
+
+ResultV<int> PageCleaner::CleanOnce() {
+    ResultV<int> clean_result =
+        buffer_manager_.CleanBuffers(clean_ratio_, batch_size_);
+    if (clean_result.IsError()) {
+        error_count_++;
+        return clean_result +
+               Error("buffer::PageCleaner::CleanOnce() failed to clean "
+                     "buffers.");
+    }
+    written_count_ += clean_result.Get();
+    return clean_result;
+}
+
+void PageCleaner::Run() {
+    while (true) {
+        ResultV<int> clean_result = CleanOnce();
+        if (clean_result.IsError()) {
+            DEBUG(clean_result.Error());
+        }
+
+        // A full batch implies that more buffers may have to be cleaned, so
+        // the next batch is started immediately.
+        const bool full_batch =
+            clean_result.IsOk() && clean_result.Get() >= batch_size_;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!full_batch) {
+            condition_.wait_for(lock, interval_,
+                                [this] { return stopping_ || woken_; });
+        }
+        woken_ = false;
+        if (stopping_) return;
+    }
+}
+
+} // namespace buffer
@@ -0,0 +1,72 @@
+#ifndef _TRANSACTION_PAGE_CLEANER_H
+#define _TRANSACTION_PAGE_CLEANER_H
+
+#include "buffer.h"
+#include "result.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace buffer {
+
+// PageCleaner writes dirty buffers of a BufferManager to disk in the
+// background, so that a fraction of the buffer pool is always clean and
+// evictions rarely have to write the victim. The cleaner wakes up every
+// `interval`, and writes up to `batch_size` dirty buffers in the order of the
+// block ids. The WAL rule is kept since the buffers are written by
+// `BufferManager::WriteBuffer()`, which flushes the log first.
+class PageCleaner {
+  public:
+    // `clean_ratio` is the fraction of the buffer pool kept clean.
+    PageCleaner(BufferManager &buffer_manager, const double clean_ratio = 0.25,
+                const int batch_size                 = 32,
+                const std::chrono::milliseconds interval =
+                    std::chrono::milliseconds(10));
+    PageCleaner(const PageCleaner &other)            = delete;
+    PageCleaner &operator=(const PageCleaner &other) = delete;
+
+    // Stops the background thread.
+    ~PageCleaner();
+
+    // Starts the background thread. Does nothing if it has already started.
+    void Start();
+
+    // Stops the background thread and waits for it to finish.
+    void Stop();
+
+    // Wakes up the background thread before `interval` passes.
+    void Wake();
+
+    // Cleans one batch of buffers in the calling thread. Returns the number of
+    // written buffers.
+    ResultV<int> CleanOnce();
+
+    // Returns the number of buffers written by this cleaner.
+    inline size_t WrittenCount() const { return written_count_; }
+
+    // Returns the number of batches which failed to be written.
+    inline size_t ErrorCount() const { return error_count_; }
+
+  private:
+    // The main loop of the background thread.
+    void Run();
+
+    BufferManager &buffer_manager_;
+    const double clean_ratio_;
+    const int batch_size_;
+    const std::chrono::milliseconds interval_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_ = false, woken_ = false;
+
+    std::atomic<size_t> written_count_ = 0;
+    std::atomic<size_t> error_count_   = 0;
+};
+
+} // namespace buffer
+
+#endif // _TRANSACTION_PAGE_CLEANER_H
@@ -0,0 +1,125 @@
+#include "page_cleaner.h"
+#include "buffer.h"
+#include "disk.h"
+#include "log.h"
+#include "macro_test.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+TWO_FILE_EXISTENT_TEST(PageCleanerTest, "abcdefghij", "");
+
+// Writes `content`[i] to the block i of `filename` for each i.
+Result WriteBlocks(buffer::BufferManager &buffer_manager,
+                   const std::string &filename, const std::string &content) {
+    for (int i = 0; i < content.size(); i++) {
+        const char bytes[2] = {content[i], 0};
+        FIRST_TRY(buffer_manager.Write(disk::BlockID(filename, i),
+                                       disk::Block(1, bytes), /*lsn=*/0));
+    }
+    return Ok();
+}
+
+TEST_F(PageCleanerTest, CleanOnceKeepsCleanRatio) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager);
+    ASSERT_TRUE(WriteBlocks(buffer_manager, filename0, "ABCD").IsOk());
+    buffer::PageCleaner page_cleaner(buffer_manager, /*clean_ratio=*/0.5,
+                                     /*batch_size=*/32);
+
+    auto clean_result = page_cleaner.CleanOnce();
+
+    ASSERT_TRUE(clean_result.IsOk()) << clean_result.Error();
+    EXPECT_EQ(clean_result.Get(), 2);
+    EXPECT_EQ(buffer_manager.DirtyBufferCount(), 2);
+
+    // The written blocks are the first ones in the order of the block ids.
+    std::ifstream file(directory_path + filename0, std::ios::binary);
+    std::string content;
+    std::getline(file, content);
+    EXPECT_EQ(content, "ABcdefghij");
+
+    clean_result = page_cleaner.CleanOnce();
+    ASSERT_TRUE(clean_result.IsOk()) << clean_result.Error();
+    EXPECT_EQ(clean_result.Get(), 0);
+}
+
+TEST_F(PageCleanerTest, CleanOnceWritesAtMostBatchSize) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager);
+    ASSERT_TRUE(WriteBlocks(buffer_manager, filename0, "ABCD").IsOk());
+    buffer::PageCleaner page_cleaner(buffer_manager, /*clean_ratio=*/1.0,
+                                     /*batch_size=*/1);
+
+    auto clean_result = page_cleaner.CleanOnce();
+
+    ASSERT_TRUE(clean_result.IsOk()) << clean_result.Error();
+    EXPECT_EQ(clean_result.Get(), 1);
+    EXPECT_EQ(buffer_manager.DirtyBufferCount(), 3);
+    EXPECT_EQ(page_cleaner.WrittenCount(), 1);
+}
+
+TEST_F(PageCleanerTest, CleanOnceSkipsPinnedBuffers) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/2, disk_manager,
+                                            log_manager);
+    ASSERT_TRUE(WriteBlocks(buffer_manager, filename0, "AB").IsOk());
+    buffer::PageGuard page;
+    ASSERT_TRUE(buffer_manager.Pin(disk::BlockID(filename0, 0), page).IsOk());
+    buffer::PageCleaner page_cleaner(buffer_manager, /*clean_ratio=*/1.0);
+
+    auto clean_result = page_cleaner.CleanOnce();
+
+    ASSERT_TRUE(clean_result.IsOk()) << clean_result.Error();
+    EXPECT_EQ(clean_result.Get(), 1);
+    EXPECT_EQ(buffer_manager.DirtyBufferCount(), 1);
+}
+
+TEST_F(PageCleanerTest, BackgroundThreadCleansBuffersBeforeEviction) {
+    disk::DiskManager disk_manager(directory_path, /*block_size=*/1);
+    dblog::LogManager log_manager(filename1, directory_path,
+                                  /*block_size=*/20);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager);
+    buffer::PageCleaner page_cleaner(buffer_manager, /*clean_ratio=*/1.0,
+                                     /*batch_size=*/32,
+                                     std::chrono::milliseconds(1));
+    page_cleaner.Start();
+    ASSERT_TRUE(WriteBlocks(buffer_manager, filename0, "ABCD").IsOk());
+    page_cleaner.Wake();
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (buffer_manager.DirtyBufferCount() > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    page_cleaner.Stop();
+
+    EXPECT_EQ(buffer_manager.DirtyBufferCount(), 0);
+    EXPECT_EQ(page_cleaner.ErrorCount(), 0);
+
+    // Every buffer is clean, so the evictions do not write.
+    disk::Block read_block;
+    for (int i = 4; i < 8; i++) {
+        ASSERT_TRUE(
+            buffer_manager.Read(disk::BlockID(filename0, i), read_block)
+                .IsOk());
+    }
+    EXPECT_EQ(buffer_manager.DirtyEvictionCount(), 0);
+}
@@ -1,4 +1,12 @@
 #include "recovery.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
 
 namespace recovery {
 
@@ -7,8 +15,17 @@ RecoveryManager::RecoveryManager(dblog::LogManager &log_manger)
 
 ResultV<dblog::LogSequenceNumber>
 RecoveryManager::WriteLog(const dblog::LogRecord &log_record) {
+    const std::vector<uint8_t> log_record_bytes =
+        dblog::LogRecordWithHeader(log_record);
+
+    // The log records of transactions are written with the transaction id to
+    // keep the active transaction table for checkpoints.
     ResultV<dblog::LogSequenceNumber> write_result =
-        log_manager_.WriteLog(dblog::LogRecordWithHeader(log_record));
+        log_record.Type() == dblog::LogType::kCheckpointing
+            ? log_manager_.WriteLog(log_record_bytes)
+            : log_manager_.WriteLog(
+                  log_record_bytes, log_record.GetTransactionID(),
+                  log_record.Type() == dblog::LogType::kTransactionEnd);
     if (write_result.IsError())
         return write_result + Error("recovery::RecoveryManager::WriteLog() "
                                     "failed to write log.");
@@ -23,56 +40,76 @@ Result RecoveryManager::Commit(const dblog::TransactionID transaction_id) {
         return commit_write_result + Error("recovery::RecoveryManager::Commit()"
                                            " failed to write commit record.");
 
-    Result flush_result = log_manager_.Flush();
+    // Only the log records up to the commit record have to be flushed, so
+    // that concurrent commits share one flush of the log file.
+    Result flush_result = log_manager_.Flush(commit_write_result.Get());
     if (flush_result.IsError())
         return flush_result + Error("recovery::RecoveryManager::Commit() "
                                     "failed to flush logs.");
     return Ok();
 }
 
+// Decodes the log record which `log_reader` points to into `log_record`,
+// which refers to the window of `log_reader`. The file ids are resolved by
+// `files`.
+Result ReadCurrentLogRecord(dblog::LogReader &log_reader,
+                            const dblog::FileDictionary &files,
+                            dblog::LogRecordView &log_record) {
+    ResultV<dblog::LogBodyView> log_body_result = log_reader.ViewLogBody();
+    if (log_body_result.IsError()) {
+        return log_body_result + Error("recovery::ReadCurrentLogRecord() "
+                                       "failed to read the log body bytes.");
+    }
+    Result decode_result = log_record.Decode(log_body_result.Get(), files);
+    if (decode_result.IsError()) {
+        return decode_result + Error("recovery::ReadCurrentLogRecord() "
+                                     "failed to decode the log record.");
+    }
+    return Ok();
+}
+
 Result RecoveryManager::Rollback(const dblog::TransactionID transaction_id,
+                                 const dblog::LogSequenceNumber last_lsn,
                                  buffer::BufferManager &buffer_manager) {
-    ResultV<dblog::LogIterator> log_iter_result = log_manager_.LastLog();
-    if (log_iter_result.IsError()) {
-        return log_iter_result + Error("dblog::RecoveryManager::Rollback() "
-                                       "failed to read the last log.");
+    // Only the log records of the transaction are read by following the chain
+    // of the previous log sequence numbers.
+    ResultV<dblog::LogReader> log_reader_result = log_manager_.NewReader();
+    if (log_reader_result.IsError()) {
+        return log_reader_result +
+               Error("recovery::RecoveryManager::Rollback() failed to read "
+                     "the log.");
     }
-    dblog::LogIterator log_iter = log_iter_result.MoveValue();
+    dblog::LogReader log_reader  = log_reader_result.Get();
+    dblog::LogSequenceNumber lsn = last_lsn;
 
-    while (true) {
-        ResultV<std::vector<uint8_t>> log_body_result = log_iter.LogBody();
-        if (log_body_result.IsError()) {
-            return log_body_result +
-                   Error("dblog::RecoveryManager::Rollback() "
-                         "failed to read the log body bytes.");
+    // The log records are decoded in place and the compensation log records
+    // are written with one buffer, so that nothing is allocated per record.
+    dblog::LogRecordView log_record;
+    std::vector<uint8_t> compensation_bytes;
+    while (lsn != dblog::kNullLogSequenceNumber) {
+        Result seek_result = log_reader.Seek(lsn);
+        if (seek_result.IsError()) {
+            return seek_result + Error("recovery::RecoveryManager::Rollback() "
+                                       "failed to seek the log record.");
         }
-        ResultV<std::unique_ptr<dblog::LogRecord>> log_record_result =
-            dblog::ReadLogRecord(log_body_result.Get());
-        if (log_record_result.IsError()) {
-            return log_record_result +
-                   Error("dblog::RecoveryManager::Rollback("
-                         ") failed to read the log record.");
+        Result read_result =
+            ReadCurrentLogRecord(log_reader, log_manager_.Files(), log_record);
+        if (read_result.IsError()) {
+            return read_result + Error("recovery::RecoveryManager::Rollback() "
+                                       "failed to read the log record.");
         }
-        std::unique_ptr<dblog::LogRecord> log_record =
-            log_record_result.MoveValue();
 
-        if (log_record->Type() != dblog::LogType::kCheckpointing &&
-            log_record->GetTransactionID() == transaction_id) {
-            if (log_record->Type() == dblog::LogType::kTransactionBegin) {
-                break;
-            }
-            Result undo_result = log_record->UnDo(buffer_manager);
-            if (undo_result.IsError())
-                return undo_result + Error("dblog::RecoveryManager::Rollback() "
-                                           "failed to do undo operation.");
-        }
-
-        if (!log_iter.HasPrevious()) break;
-        Result previous_result = log_iter.Previous();
-        if (previous_result.IsError()) {
-            return previous_result + Error("dblog::RecoveryManager::Rollback() "
-                                           "failed to read the previous log.");
+        if (log_record.Type() != dblog::LogType::kOperation ||
+            log_record.GetTransactionID() != transaction_id) {
+            return Error("recovery::RecoveryManager::Rollback() the log "
+                         "record is not an operation of the transaction.");
         }
+        ResultV<dblog::LogSequenceNumber> undo_result =
+            UnDoLogRecord(log_record, buffer_manager, compensation_bytes);
+        if (undo_result.IsError())
+            return undo_result + Error("recovery::RecoveryManager::Rollback() "
+                                       "failed to do undo operation.");
+        lsn = undo_result.Get();
     }
 
     ResultV<dblog::LogSequenceNumber> rollback_write_result =
@@ -85,136 +122,503 @@ Result RecoveryManager::Rollback(const dblog::TransactionID transaction_id,
     return Ok();
 }
 
-Result RecoveryManager::Recover(buffer::BufferManager &buffer_manager) const {
-    ResultV<dblog::LogIterator> log_iter_result = log_manager_.LastLog();
-    if (log_iter_result.IsError()) {
-        return log_iter_result + Error("recovery::RecoveryManager::Recover() "
-                                       "failed to read the last log.");
+ResultV<dblog::LogSequenceNumber>
+RecoveryManager::UnDoLogRecord(const dblog::LogRecordView &operation,
+                               buffer::BufferManager &buffer_manager,
+                               std::vector<uint8_t> &compensation_bytes) {
+    if (operation.IsCompensation())
+        return Ok(operation.GetPreviousLogSequenceNumber());
+
+    // Other transactions may modify the other records of the block, so the
+    // block is latched until the undo logged here is applied.
+    buffer::PageGuard page;
+    Result pin_result = buffer_manager.Pin(operation.BlockID(), page);
+    if (pin_result.IsError()) {
+        return pin_result + Error("recovery::RecoveryManager::"
+                                  "UnDoLogRecord() failed to pin the block.");
     }
-    dblog::LogIterator log_iter = log_iter_result.MoveValue();
-    std::set<dblog::TransactionID> committed, rollbacked;
+    std::lock_guard<std::mutex> update_latch(page.UpdateLatch());
 
-    Result undo_result =
-        UnDoStage(log_iter, committed, rollbacked, buffer_manager);
+    // The compensation log record is written before the page is modified, so
+    // that the undo is redone if the system crashes after that.
+    operation.CompensationLogRecordWithHeader(compensation_bytes);
+    ResultV<dblog::LogSequenceNumber> write_result =
+        log_manager_.WriteLog(compensation_bytes, operation.GetTransactionID(),
+                              /*ends_transaction=*/false);
+    if (write_result.IsError()) {
+        return write_result + Error("recovery::RecoveryManager::"
+                                    "UnDoLogRecord() failed to write a "
+                                    "compensation log record.");
+    }
+    Result undo_result = operation.UnDo(buffer_manager, write_result.Get());
     if (undo_result.IsError()) {
-        return undo_result +
-               Error("recovery::RecoveryManager::Recover() failed to undo.");
+        return undo_result + Error("recovery::RecoveryManager::"
+                                   "UnDoLogRecord() failed to undo.");
+    }
+    return Ok(operation.GetPreviousLogSequenceNumber());
+}
+
+Result RecoveryManager::Checkpoint(buffer::BufferManager &buffer_manager) {
+    // The active transaction table is taken before the dirty page table, so a
+    // modification before `begin_lsn` is either in a dirty page or in an
+    // active transaction, or already written to disk.
+    dblog::LogSequenceNumber begin_lsn;
+    const std::map<dblog::TransactionID, dblog::ActiveTransaction>
+        active_transactions = log_manager_.ActiveTransactions(begin_lsn);
+    const std::vector<buffer::DirtyPage> dirty_pages =
+        buffer_manager.DirtyPageTable();
+    const dblog::LogCheckpointing checkpoint(begin_lsn, active_transactions,
+                                             dirty_pages);
+
+    ResultV<dblog::LogSequenceNumber> write_result = this->WriteLog(checkpoint);
+    if (write_result.IsError()) {
+        return write_result + Error("recovery::RecoveryManager::Checkpoint() "
+                                    "failed to write checkpoint record.");
+    }
+    Result flush_result = log_manager_.Flush(write_result.Get());
+    if (flush_result.IsError()) {
+        return flush_result + Error("recovery::RecoveryManager::Checkpoint() "
+                                    "failed to flush logs.");
+    }
+    Result master_result = log_manager_.WriteMasterRecord(write_result.Get());
+    if (master_result.IsError()) {
+        return master_result + Error("recovery::RecoveryManager::Checkpoint() "
+                                     "failed to write the master record.");
+    }
+
+    Result truncate_result =
+        log_manager_.Truncate(checkpoint.RedoLogSequenceNumber());
+    if (truncate_result.IsError()) {
+        return truncate_result + Error("recovery::RecoveryManager::"
+                                       "Checkpoint() failed to truncate logs.");
+    }
+    return Ok();
+}
+
+Result RecoveryManager::Recover(buffer::BufferManager &buffer_manager,
+                                RecoveryStatistics *statistics) {
+    ResultV<dblog::LogReader> log_reader_result = log_manager_.NewReader();
+    if (log_reader_result.IsError()) {
+        return log_reader_result + Error("recovery::RecoveryManager::Recover() "
+                                         "failed to read the log.");
+    }
+    dblog::LogReader log_reader = log_reader_result.Get();
+    if (log_reader.Empty()) return Ok();
+
+    RecoveryState state;
+    Result analysis_result = AnalysisStage(log_reader, state);
+    if (analysis_result.IsError()) {
+        return analysis_result + Error("recovery::RecoveryManager::Recover() "
+                                       "failed to analyze logs.");
     }
 
+    RecoveryStatistics local_statistics;
+    if (statistics == nullptr) statistics = &local_statistics;
     Result redo_result =
-        ReDoStage(log_iter, committed, rollbacked, buffer_manager);
+        ReDoStage(log_reader, state, buffer_manager, *statistics);
     if (redo_result.IsError()) {
         return redo_result +
                Error("recovery::RecoveryManager::Recover() failed to redo.");
     }
 
+    Result undo_result =
+        UnDoStage(log_reader, state, buffer_manager, *statistics);
+    if (undo_result.IsError()) {
+        return undo_result +
+               Error("recovery::RecoveryManager::Recover() failed to undo.");
+    }
+
     return Ok();
 }
 
-Result RecoveryManager::UnDoStage(dblog::LogIterator &log_iter,
-                                  std::set<dblog::TransactionID> &committed,
-                                  std::set<dblog::TransactionID> &rollbacked,
-                                  buffer::BufferManager &buffer_manager) const {
-
-    auto already_committed_or_rollbacked =
-        [&committed, &rollbacked](dblog::TransactionID transaction_id) -> bool {
-        return committed.count(transaction_id) ||
-               rollbacked.count(transaction_id);
-    };
+Result RecoveryManager::AnalysisStage(dblog::LogReader &log_reader,
+                                      RecoveryState &state) const {
+    ResultV<dblog::LogSequenceNumber> master_result =
+        log_manager_.ReadMasterRecord();
+    if (master_result.IsError()) {
+        return master_result + Error("recovery::RecoveryManager::"
+                                     "AnalysisStage() failed to read the "
+                                     "master record.");
+    }
 
-    while (true) {
-        ResultV<std::vector<uint8_t>> log_body_result = log_iter.LogBody();
+    // The pages which are not in the dirty page table of the checkpoint have
+    // all the modifications before `begin_lsn` on disk.
+    dblog::LogSequenceNumber begin_lsn = 0;
+    if (master_result.Get() != dblog::kNullLogSequenceNumber) {
+        Result seek_result = log_reader.Seek(master_result.Get());
+        if (seek_result.IsError()) {
+            return seek_result + Error("recovery::RecoveryManager::"
+                                       "AnalysisStage() failed to seek the "
+                                       "checkpoint record.");
+        }
+        // The checkpoint record is read once, so its tables are decoded to
+        // an owned log record.
+        ResultV<std::vector<uint8_t>> log_body_result = log_reader.LogBody();
         if (log_body_result.IsError()) {
-            return log_body_result +
-                   Error("recovery::RecoveryManager::UnDoStage() "
-                         "failed to read the log body bytes.");
+            return log_body_result + Error("recovery::RecoveryManager::"
+                                           "AnalysisStage() failed to read "
+                                           "the checkpoint record.");
         }
         ResultV<std::unique_ptr<dblog::LogRecord>> log_record_result =
-            dblog::ReadLogRecord(log_body_result.Get());
+            dblog::ReadLogRecord(log_body_result.Get(), log_manager_.Files());
         if (log_record_result.IsError()) {
-            return log_record_result +
-                   Error("recovery::RecoveryManager::UnDoStage("
-                         ") failed to read the log record.");
-        }
-        std::unique_ptr<dblog::LogRecord> log_record =
-            log_record_result.MoveValue();
-
-        if (log_record->Type() == dblog::LogType::kTransactionEnd) {
-            switch (log_record->GetTransactionEndType()) {
-            case dblog::TransactionEndType::kCommit:
-                committed.insert(log_record->GetTransactionID());
-                break;
-            case dblog::TransactionEndType::kRollback:
-                rollbacked.insert(log_record->GetTransactionID());
-                break;
-            }
-        } else if (log_record->Type() == dblog::LogType::kOperation &&
-                   !already_committed_or_rollbacked(
-                       log_record->GetTransactionID())) {
-            Result undo_result = log_record->UnDo(buffer_manager);
-            if (undo_result.IsError()) {
-                return undo_result + Error("recovery::RecoveryManager::"
-                                           "UnDoStage() failed to undo.");
-            }
+            return log_record_result + Error("recovery::RecoveryManager::"
+                                             "AnalysisStage() failed to read "
+                                             "the checkpoint record.");
         }
-
-        if (!log_iter.HasPrevious()) break;
-        Result previous_result = log_iter.Previous();
-        if (previous_result.IsError()) {
-            return previous_result +
-                   Error("recovery::RecoveryManager::UnDoStage() "
-                         "failed to read the previous log.");
+        if (log_record_result.Get()->Type() !=
+            dblog::LogType::kCheckpointing) {
+            return Error("recovery::RecoveryManager::AnalysisStage() the "
+                         "master record does not point to a checkpoint.");
         }
+        const auto &checkpoint = static_cast<const dblog::LogCheckpointing &>(
+            *log_record_result.Get());
+        for (const auto &[transaction_id, transaction] :
+             checkpoint.ActiveTransactions()) {
+            state.losers[transaction_id] = transaction.last_lsn;
+        }
+        for (const buffer::DirtyPage &dirty_page : checkpoint.DirtyPages()) {
+            state.dirty_pages[dirty_page.block_id] = dirty_page.recovery_lsn;
+        }
+        state.redo_lsn = checkpoint.RedoLogSequenceNumber();
+        begin_lsn      = checkpoint.BeginLogSequenceNumber();
     }
 
+    Result seek_result = log_reader.Seek(state.redo_lsn);
+    if (seek_result.IsError()) {
+        return seek_result + Error("recovery::RecoveryManager::AnalysisStage() "
+                                   "failed to seek the redo point.");
+    }
+    dblog::LogRecordView log_record;
+    while (true) {
+        Result read_result =
+            ReadCurrentLogRecord(log_reader, log_manager_.Files(), log_record);
+        if (read_result.IsError()) {
+            return read_result + Error("recovery::RecoveryManager::"
+                                       "AnalysisStage() failed to read a log "
+                                       "record.");
+        }
+        const dblog::TransactionID transaction_id =
+            log_record.GetTransactionID();
+        const dblog::LogSequenceNumber lsn = log_reader.Position();
+
+        if (log_record.Type() == dblog::LogType::kOperation) {
+            auto [it, inserted] = state.losers.try_emplace(transaction_id, lsn);
+            it->second          = std::max(it->second, lsn);
+            if (lsn >= begin_lsn)
+                state.dirty_pages.try_emplace(log_record.BlockID(), lsn);
+        } else if (log_record.Type() == dblog::LogType::kTransactionEnd) {
+            state.losers.erase(transaction_id);
+        }
+
+        if (!log_reader.HasNext()) break;
+        Result next_result = log_reader.Next();
+        if (next_result.IsError()) {
+            return next_result + Error("recovery::RecoveryManager::"
+                                       "AnalysisStage() failed to read the "
+                                       "next log.");
+        }
+    }
     return Ok();
 }
 
-Result RecoveryManager::ReDoStage(dblog::LogIterator &log_iter,
-                                  std::set<dblog::TransactionID> &committed,
-                                  std::set<dblog::TransactionID> &rollbacked,
-                                  buffer::BufferManager &buffer_manager) const {
-    while (true) {
-        ResultV<std::vector<uint8_t>> log_body_result = log_iter.LogBody();
-        if (log_body_result.IsError()) {
-            return log_body_result +
-                   Error("recovery::RecoveryManager::ReDoStage() "
-                         "failed to read the log body bytes.");
+// ReDoWorkers redoes log records of operations on worker threads. The log
+// records are assigned to the workers by the hash of their pages, and each
+// worker redoes its log records in the order in which they are added. Thus the
+// log records of a page are redone in the order of the log, while different
+// pages are redone in parallel. With one thread, the log records are redone on
+// the calling thread.
+//
+// The queue of a worker is a ring of slots into which the log bodies are
+// copied. The memory of the slots is reused, so that no memory is allocated
+// per log record once the slots have grown.
+class ReDoWorkers {
+  public:
+    ReDoWorkers(buffer::BufferManager &buffer_manager,
+                const dblog::FileDictionary &files, const int thread_count)
+        : buffer_manager_(buffer_manager), files_(files),
+          workers_(thread_count > 1 ? thread_count : 0) {
+        for (Worker &worker : workers_) {
+            worker.slots.resize(kQueueCapacity);
+            worker.thread = std::thread([this, &worker] { Run(worker); });
         }
-        ResultV<std::unique_ptr<dblog::LogRecord>> log_record_result =
-            dblog::ReadLogRecord(log_body_result.Get());
-        if (log_record_result.IsError()) {
-            return log_record_result +
-                   Error("recovery::RecoveryManager::ReDoStage("
-                         ") failed to read the log record.");
-        }
-        std::unique_ptr<dblog::LogRecord> log_record =
-            log_record_result.MoveValue();
-
-        if (log_record->Type() == dblog::LogType::kOperation &&
-            committed.count(log_record->GetTransactionID())) {
-            Result redo_result = log_record->ReDo(buffer_manager);
-            if (redo_result.IsError()) {
-                return redo_result +
-                       Error("recovery::RecoveryManager::"
-                             "ReDoStage() failed to redo a record.");
+    }
+
+    ~ReDoWorkers() { Join(); }
+
+    // Adds the operation `operation` of `lsn`. The log body of `operation` is
+    // copied, so that the view can be reused after this method returns. This
+    // method blocks while the queue of the worker is full. Returns an error if
+    // redo has failed.
+    Result Add(const dblog::LogSequenceNumber lsn,
+               const dblog::LogRecordView &operation) {
+        if (workers_.empty()) {
+            ReDo(statistics_, lsn, operation);
+            return result_;
+        }
+
+        const size_t worker_index =
+            std::hash<disk::BlockID>()(operation.BlockID()) % workers_.size();
+        Worker &worker = workers_[worker_index];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.not_full.wait(
+            lock, [&] { return worker.count < kQueueCapacity || failed_; });
+        if (failed_) {
+            lock.unlock();
+            std::lock_guard<std::mutex> result_lock(result_mutex_);
+            return result_;
+        }
+        Slot &slot =
+            worker.slots[(worker.head + worker.count) % kQueueCapacity];
+        const dblog::LogBodyView &log_body = operation.LogBody();
+        slot.lsn                           = lsn;
+        slot.log_body.assign(log_body.bytes->begin() + log_body.begin,
+                             log_body.bytes->begin() + log_body.end);
+        worker.count++;
+        worker.not_empty.notify_one();
+        return Ok();
+    }
+
+    // Waits until all the added log records are redone, and adds the numbers
+    // of the redone and skipped log records to `statistics`. Returns the first
+    // error of the workers.
+    Result Finish(RecoveryStatistics &statistics) {
+        Join();
+        statistics.redo_count += statistics_.redo_count;
+        statistics.redo_skip_count += statistics_.redo_skip_count;
+        for (const Worker &worker : workers_) {
+            statistics.redo_count += worker.statistics.redo_count;
+            statistics.redo_skip_count += worker.statistics.redo_skip_count;
+        }
+        return result_;
+    }
+
+  private:
+    // The maximum number of log records waiting in the queue of a worker.
+    static constexpr size_t kQueueCapacity = 1024;
+
+    struct Slot {
+        dblog::LogSequenceNumber lsn = 0;
+        std::vector<uint8_t> log_body;
+    };
+
+    struct Worker {
+        std::thread thread;
+
+        // The log records in the queue are `count` slots from `head`.
+        std::vector<Slot> slots;
+        size_t head = 0, count = 0;
+
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable not_empty, not_full;
+        RecoveryStatistics statistics;
+    };
+
+    // Closes the queues and joins the workers.
+    void Join() {
+        for (Worker &worker : workers_) {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.closed = true;
+            worker.not_empty.notify_one();
+        }
+        for (Worker &worker : workers_) {
+            if (worker.thread.joinable()) worker.thread.join();
+        }
+    }
+
+    void Run(Worker &worker) {
+        // The log body in the slot is swapped with `log_body`, so that the slot
+        // is released before the log record is redone without copying it.
+        std::vector<uint8_t> log_body;
+        dblog::LogRecordView operation;
+        while (true) {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.not_empty.wait(
+                lock, [&] { return worker.count > 0 || worker.closed; });
+            if (worker.count == 0) return;
+            Slot &slot                         = worker.slots[worker.head];
+            const dblog::LogSequenceNumber lsn = slot.lsn;
+            log_body.swap(slot.log_body);
+            worker.head = (worker.head + 1) % kQueueCapacity;
+            worker.count--;
+            worker.not_full.notify_one();
+            lock.unlock();
+
+            // After a failure, the log records are dropped so that `Add()`
+            // never waits forever.
+            if (failed_) continue;
+            Result decode_result = operation.Decode(
+                dblog::LogBodyView{&log_body, 0, int(log_body.size())}, files_);
+            if (decode_result.IsError()) {
+                Fail(decode_result + Error("recovery::ReDoWorkers::Run() "
+                                           "failed to decode a record."));
+                continue;
             }
+            ReDo(worker.statistics, lsn, operation);
         }
+    }
 
-        ResultV<bool> has_next_result = log_iter.HasNext();
-        if (has_next_result.IsError()) {
-            return has_next_result + Error("recovery::RecoveryManager::"
-                                           "ReDoStage() failed to check if the "
-                                           "next record exists.");
+    void ReDo(RecoveryStatistics &statistics,
+              const dblog::LogSequenceNumber lsn,
+              const dblog::LogRecordView &operation) {
+        ResultV<bool> redo_result = operation.ReDo(buffer_manager_, lsn);
+        if (redo_result.IsError()) {
+            Fail(redo_result +
+                 Error("recovery::ReDoWorkers::ReDo() failed to redo a "
+                       "record."));
+            return;
         }
-        if (!has_next_result.Get()) break;
-        Result next_result = log_iter.Next();
+        if (redo_result.Get())
+            statistics.redo_count++;
+        else
+            statistics.redo_skip_count++;
+    }
+
+    // Records the first error and wakes up `Add()` waiting for a full queue.
+    void Fail(const Result &result) {
+        {
+            std::lock_guard<std::mutex> lock(result_mutex_);
+            if (result_.IsOk()) result_ = result;
+        }
+        failed_ = true;
+        for (Worker &worker : workers_) {
+            std::lock_guard<std::mutex> worker_lock(worker.mutex);
+            worker.not_full.notify_all();
+        }
+    }
+
+    buffer::BufferManager &buffer_manager_;
+    const dblog::FileDictionary &files_;
+    std::vector<Worker> workers_;
+    RecoveryStatistics statistics_;
+    std::atomic<bool> failed_ = false;
+    Result result_            = Ok();
+    std::mutex result_mutex_;
+};
+
+Result RecoveryManager::ReDoStage(dblog::LogReader &log_reader,
+                                  const RecoveryState &state,
+                                  buffer::BufferManager &buffer_manager,
+                                  RecoveryStatistics &statistics) const {
+    Result seek_result = log_reader.Seek(state.redo_lsn);
+    if (seek_result.IsError()) {
+        return seek_result + Error("recovery::RecoveryManager::ReDoStage() "
+                                   "failed to seek the redo point.");
+    }
+
+    // All the operations, including those of the transactions which did not
+    // end and the compensation log records, are redone to repeat the history.
+    ReDoWorkers workers(buffer_manager, log_manager_.Files(),
+                        redo_thread_count_);
+    dblog::LogRecordView log_record;
+    while (true) {
+        Result read_result =
+            ReadCurrentLogRecord(log_reader, log_manager_.Files(), log_record);
+        if (read_result.IsError()) {
+            return read_result + Error("recovery::RecoveryManager::"
+                                       "ReDoStage() failed to read the log "
+                                       "record.");
+        }
+        const dblog::LogSequenceNumber lsn = log_reader.Position();
+
+        if (log_record.Type() == dblog::LogType::kOperation) {
+            // The page is not read when the dirty page table shows that the
+            // page on disk has the modification.
+            auto it = state.dirty_pages.find(log_record.BlockID());
+            if (it != state.dirty_pages.end() && it->second <= lsn) {
+                Result add_result = workers.Add(lsn, log_record);
+                if (add_result.IsError()) {
+                    return add_result + Error("recovery::RecoveryManager::"
+                                              "ReDoStage() failed to redo a "
+                                              "record.");
+                }
+            } else {
+                statistics.redo_skip_count++;
+            }
+        }
+
+        if (!log_reader.HasNext()) break;
+        Result next_result = log_reader.Next();
         if (next_result.IsError()) {
             return next_result + Error("recovery::RecoveryManager::ReDoStage() "
                                        "failed to read the next log.");
         }
     }
 
+    Result finish_result = workers.Finish(statistics);
+    if (finish_result.IsError()) {
+        return finish_result + Error("recovery::RecoveryManager::ReDoStage() "
+                                     "failed to redo records.");
+    }
+    return Ok();
+}
+
+Result RecoveryManager::UnDoStage(dblog::LogReader &log_reader,
+                                  const RecoveryState &state,
+                                  buffer::BufferManager &buffer_manager,
+                                  RecoveryStatistics &statistics) {
+    // The operations of the transactions which did not end are undone in the
+    // reverse order of the log, following their previous log sequence
+    // numbers. A transaction ends with a rollback record when all of its
+    // operations are undone.
+    std::set<std::pair<dblog::LogSequenceNumber, dblog::TransactionID>>
+        to_undo;
+    std::vector<dblog::TransactionID> rolled_back;
+    for (const auto &[transaction_id, last_lsn] : state.losers) {
+        if (last_lsn != dblog::kNullLogSequenceNumber)
+            to_undo.emplace(last_lsn, transaction_id);
+        else
+            rolled_back.push_back(transaction_id);
+    }
+
+    dblog::LogRecordView log_record;
+    std::vector<uint8_t> compensation_bytes;
+    while (!to_undo.empty()) {
+        const auto [lsn, transaction_id] = *to_undo.rbegin();
+        to_undo.erase(std::prev(to_undo.end()));
+
+        Result seek_result = log_reader.Seek(lsn);
+        if (seek_result.IsError()) {
+            return seek_result + Error("recovery::RecoveryManager::UnDoStage() "
+                                       "failed to seek the log record.");
+        }
+        Result read_result =
+            ReadCurrentLogRecord(log_reader, log_manager_.Files(), log_record);
+        if (read_result.IsError()) {
+            return read_result + Error("recovery::RecoveryManager::"
+                                       "UnDoStage() failed to read the log "
+                                       "record.");
+        }
+        if (log_record.Type() != dblog::LogType::kOperation ||
+            log_record.GetTransactionID() != transaction_id) {
+            return Error("recovery::RecoveryManager::UnDoStage() the log "
+                         "record is not an operation of the transaction.");
+        }
+
+        ResultV<dblog::LogSequenceNumber> undo_result =
+            UnDoLogRecord(log_record, buffer_manager, compensation_bytes);
+        if (undo_result.IsError()) {
+            return undo_result + Error("recovery::RecoveryManager::"
+                                       "UnDoStage() failed to undo.");
+        }
+        if (!log_record.IsCompensation()) statistics.undo_count++;
+        if (undo_result.Get() != dblog::kNullLogSequenceNumber)
+            to_undo.emplace(undo_result.Get(), transaction_id);
+        else
+            rolled_back.push_back(transaction_id);
+    }
+
+    for (const dblog::TransactionID transaction_id : rolled_back) {
+        ResultV<dblog::LogSequenceNumber> write_result =
+            this->WriteLog(dblog::LogTransactionEnd(
+                transaction_id, dblog::TransactionEndType::kRollback));
+        if (write_result.IsError()) {
+            return write_result + Error("recovery::RecoveryManager::"
+                                        "UnDoStage() failed to write a "
+                                        "rollback record.");
+        }
+    }
     return Ok();
 }
-} // namespace recovery
\ No newline at end of file
+} // namespace recovery
@@ -5,12 +5,24 @@
 #include "log.h"
 #include "log_record.h"
 #include "result.h"
+#include <algorithm>
+#include <map>
 #include <set>
 
 namespace recovery {
 
 using namespace result;
 
+// The numbers of the log records processed by recovery.
+struct RecoveryStatistics {
+    // The operations which are redone, and which are skipped because the
+    // pages already have them.
+    size_t redo_count = 0, redo_skip_count = 0;
+
+    // The operations of the unfinished transactions which are undone.
+    size_t undo_count = 0;
+};
+
 // Recovery manager manages log files by using dblog::LogManager and do commit,
 // rollback, and recover operations using log records.
 class RecoveryManager {
@@ -23,26 +35,86 @@ class RecoveryManager {
     ResultV<dblog::LogSequenceNumber>
     WriteLog(const dblog::LogRecord &log_record);
 
+    // Returns the id of the file `filename` in the file dictionary of the log,
+    // which the operation log records have instead of the filename.
+    inline ResultV<dblog::FileID> FileID(const std::string &filename) {
+        return log_manager_.Files().ID(filename);
+    }
+
     // Commits the transaction whose id is `transaction_id`.
     Result Commit(const dblog::TransactionID transaction_id);
 
-    // Rollbacks the transaction whose id is `transaction_id`.
+    // Rollbacks the transaction whose id is `transaction_id`. `last_lsn` is
+    // the log sequence number of the last operation of the transaction, from
+    // which the operations are undone along their previous log sequence
+    // numbers. A compensation log record is written for each undone
+    // operation.
     Result Rollback(const dblog::TransactionID transaction_id,
+                    const dblog::LogSequenceNumber last_lsn,
                     buffer::BufferManager &buffer_manager);
 
-    // Recover records from logs.
-    Result Recover(buffer::BufferManager &buffer_manager) const;
+    // Writes a fuzzy checkpoint. The active transaction table and the dirty
+    // page table are written to the log without stopping the other
+    // transactions or flushing the dirty pages, and the master record points
+    // to the checkpoint. Then the log blocks which recovery never reads are
+    // released.
+    Result Checkpoint(buffer::BufferManager &buffer_manager);
+
+    // Sets the number of threads which redo the log records in recovery. The
+    // log records are partitioned by their pages, so the log records of a
+    // page are redone in the order of the log while different pages are
+    // redone in parallel. By default, redo runs on the calling thread.
+    inline void SetReDoThreadCount(const int thread_count) {
+        redo_thread_count_ = std::max(1, thread_count);
+    }
+
+    // Recover records from logs. The log records are read from the last
+    // checkpoint (or the head of the log when there is no checkpoint). The
+    // analysis stage finds the transactions which did not end and the dirty
+    // pages, the redo stage repeats the history by redoing the operations
+    // which the pages do not have yet, and the undo stage rolls back the
+    // transactions which did not end. If `statistics` is not null, the
+    // numbers of the redone, skipped and undone log records are written to
+    // it.
+    Result Recover(buffer::BufferManager &buffer_manager,
+                   RecoveryStatistics *statistics = nullptr);
 
   private:
-    Result UnDoStage(dblog::LogIterator &log_iter,
-                     std::set<dblog::TransactionID> &committed,
-                     std::set<dblog::TransactionID> &rollbacked,
-                     buffer::BufferManager &buffer_manager) const;
-    Result ReDoStage(dblog::LogIterator &log_iter,
-                     std::set<dblog::TransactionID> &committed,
-                     std::set<dblog::TransactionID> &rollbacked,
-                     buffer::BufferManager &buffer_manager) const;
+    // The state of recovery which is built by the analysis stage.
+    struct RecoveryState {
+        // The log records from `redo_lsn` are read by the redo stage.
+        dblog::LogSequenceNumber redo_lsn = 0;
+
+        // The log sequence numbers of the last log records of the
+        // transactions which did not end.
+        std::map<dblog::TransactionID, dblog::LogSequenceNumber> losers;
+
+        // The pages which may not have the modifications in the log, with
+        // the log sequence numbers of the first modifications which they may
+        // not have.
+        std::map<disk::BlockID, dblog::LogSequenceNumber> dirty_pages;
+    };
+
+    Result AnalysisStage(dblog::LogReader &log_reader,
+                         RecoveryState &state) const;
+    Result ReDoStage(dblog::LogReader &log_reader, const RecoveryState &state,
+                     buffer::BufferManager &buffer_manager,
+                     RecoveryStatistics &statistics) const;
+    Result UnDoStage(dblog::LogReader &log_reader, const RecoveryState &state,
+                     buffer::BufferManager &buffer_manager,
+                     RecoveryStatistics &statistics);
+
+    // Undoes the operation `operation`. A compensation log record is written
+    // with `compensation_bytes` as the buffer and applied to the page. If
+    // `operation` is a compensation log record, nothing is undone. Returns the
+    // log sequence number of the log record to undo next.
+    ResultV<dblog::LogSequenceNumber>
+    UnDoLogRecord(const dblog::LogRecordView &operation,
+                  buffer::BufferManager &buffer_manager,
+                  std::vector<uint8_t> &compensation_bytes);
+
     dblog::LogManager &log_manager_;
+    int redo_thread_count_ = 1;
 };
 
 } // namespace recovery
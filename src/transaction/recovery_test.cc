@@ -4,9 +4,11 @@
 #include "log_record.h"
 #include "macro_test.h"
 #include "recovery.h"
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <thread>
 
 FILE_EXISTENT_TEST(RecoveryManagerTest, "");
 
@@ -46,6 +48,8 @@ TWO_FILE_EXISTENT_TEST(RecoveryManagerTwoFileTest, "", "");
 
 TEST_F(RecoveryManagerTwoFileTest, RollbackSuccessWithVariousBlockSize) {
     for (int block_size : {12, 128}) {
+        // The log file written with the other block size is cleared.
+        std::ofstream(directory_path + filename0, std::ios::trunc).close();
         dblog::LogManager log_manager(/*log_filename=*/filename0,
                                       /*log_directory_path=*/directory_path,
                                       /*block_size=*/block_size);
@@ -60,6 +64,7 @@ TEST_F(RecoveryManagerTwoFileTest, RollbackSuccessWithVariousBlockSize) {
                 .AllocateNewBlocks(disk::BlockID(filename1, /*block_index=*/9))
                 .IsOk());
         dblog::TransactionID transaction_id = 5;
+        const dblog::FileID file_id         = manager.FileID(filename1).Get();
 
         dblog::LogTransactionBegin log0(transaction_id);
         ResultV<dblog::LogSequenceNumber> write_result = manager.WriteLog(log0);
@@ -69,20 +74,30 @@ TEST_F(RecoveryManagerTwoFileTest, RollbackSuccessWithVariousBlockSize) {
                                    dummy_value1   = {2, 0, 0, 0};
         const data::DataItem dummy_value0         = data::Int(7).Item(),
                              dummy_value2         = data::Int(5).Item();
-        disk::DiskPosition position1(
-            disk::DiskPosition(disk::BlockID(filename1, 4), 3));
-        dblog::LogOperation log1(transaction_id, position1,
+        disk::DiskPosition position1(disk::DiskPosition(
+            disk::BlockID(filename1, 4), buffer::kPageHeaderSize));
+        dblog::LogOperation log1(transaction_id, position1, file_id,
                                  data::kTypeInt.ValueLength(), previous_value,
                                  dummy_value0);
-        ASSERT_TRUE(manager.WriteLog(log1).IsOk());
-        disk::DiskPosition position2 =
-            disk::DiskPosition(disk::BlockID(filename1, 8), 3);
-        dblog::LogOperation log2(0, position2, data::kTypeInt.ValueLength(),
-                                 dummy_value1, dummy_value2);
+        ResultV<dblog::LogSequenceNumber> lsn1 = manager.WriteLog(log1);
+        ASSERT_TRUE(lsn1.IsOk());
+        disk::DiskPosition position2 = disk::DiskPosition(
+            disk::BlockID(filename1, 8), buffer::kPageHeaderSize);
+        dblog::LogOperation log2(0, position2, file_id,
+                                 data::kTypeInt.ValueLength(), dummy_value1,
+                                 dummy_value2);
         ASSERT_TRUE(manager.WriteLog(log2).IsOk());
 
+        // The second operation of the transaction is chained to the first one
+        // over the operation of the other transaction.
+        dblog::LogOperation log3(transaction_id, position1, file_id,
+                                 data::kTypeInt.ValueLength(), dummy_value1,
+                                 dummy_value2, /*previous_lsn=*/lsn1.Get());
+        ResultV<dblog::LogSequenceNumber> lsn3 = manager.WriteLog(log3);
+        ASSERT_TRUE(lsn3.IsOk());
+
         Result rollback_result =
-            manager.Rollback(transaction_id, buffer_manager);
+            manager.Rollback(transaction_id, lsn3.Get(), buffer_manager);
         EXPECT_TRUE(rollback_result.IsOk()) << rollback_result.Error();
         EXPECT_TRUE(buffer_manager.FlushAll().IsOk());
 
@@ -118,6 +133,7 @@ TEST_F(RecoveryManagerTwoFileTest, RecoverSuccess) {
             .IsOk());
     dblog::TransactionID rollbacked_transaction_id = 5,
                          committed_transaction_id  = 6;
+    const dblog::FileID file_id = manager.FileID(filename1).Get();
 
     dblog::LogTransactionBegin log0(rollbacked_transaction_id);
     ASSERT_TRUE(manager.WriteLog(log0).IsOk());
@@ -132,25 +148,26 @@ TEST_F(RecoveryManagerTwoFileTest, RecoverSuccess) {
                          expect_item1       = data::Int(expect_value1).Item(),
                          expect_item2       = data::Int(expect_value2).Item(),
                          dummy_item         = data::Int(0).Item();
-    disk::DiskPosition position0(
-        disk::DiskPosition(disk::BlockID(filename1, 4), 3));
-    dblog::LogOperation log2(committed_transaction_id, position0,
+    disk::DiskPosition position0(disk::DiskPosition(
+        disk::BlockID(filename1, 4), buffer::kPageHeaderSize));
+    dblog::LogOperation log2(committed_transaction_id, position0, file_id,
                              data::kTypeInt.ValueLength(), dummy_data,
                              expect_item0);
     ASSERT_TRUE(manager.WriteLog(log2).IsOk());
-    dblog::LogOperation log3(rollbacked_transaction_id, position0,
+    dblog::LogOperation log3(rollbacked_transaction_id, position0, file_id,
                              data::kTypeInt.ValueLength(), expect_data0,
                              dummy_item);
-    ASSERT_TRUE(manager.WriteLog(log3).IsOk());
-    disk::DiskPosition position1 =
-        disk::DiskPosition(disk::BlockID(filename1, 8), 3);
-    dblog::LogOperation log4(rollbacked_transaction_id, position1,
+    ResultV<dblog::LogSequenceNumber> lsn3 = manager.WriteLog(log3);
+    ASSERT_TRUE(lsn3.IsOk());
+    disk::DiskPosition position1 = disk::DiskPosition(
+        disk::BlockID(filename1, 8), buffer::kPageHeaderSize);
+    dblog::LogOperation log4(rollbacked_transaction_id, position1, file_id,
                              data::kTypeInt.ValueLength(), expect_data1,
-                             dummy_item);
+                             dummy_item, /*previous_lsn=*/lsn3.Get());
     ASSERT_TRUE(manager.WriteLog(log4).IsOk());
-    disk::DiskPosition position2 =
-        disk::DiskPosition(disk::BlockID(filename1, 0), 3);
-    dblog::LogOperation log5(committed_transaction_id, position2,
+    disk::DiskPosition position2 = disk::DiskPosition(
+        disk::BlockID(filename1, 0), buffer::kPageHeaderSize);
+    dblog::LogOperation log5(committed_transaction_id, position2, file_id,
                              data::kTypeInt.ValueLength(), dummy_data,
                              expect_item2);
     ASSERT_TRUE(manager.WriteLog(log5).IsOk());
@@ -179,4 +196,296 @@ TEST_F(RecoveryManagerTwoFileTest, RecoverSuccess) {
     value = block.ReadInt(position2.Offset());
     EXPECT_TRUE(value.IsOk());
     EXPECT_EQ(value.Get(), expect_value2);
-}
\ No newline at end of file
+}
+// Writes `item` to `position` by the transaction `transaction_id` as a
+// transaction does, and returns the log sequence number of the operation.
+dblog::LogSequenceNumber
+WriteItem(recovery::RecoveryManager &manager,
+          buffer::BufferManager &buffer_manager,
+          const dblog::TransactionID transaction_id,
+          const disk::DiskPosition &position, const data::DataItem &item,
+          const dblog::LogSequenceNumber previous_lsn) {
+    buffer::PageGuard page;
+    EXPECT_TRUE(buffer_manager.Pin(position.BlockID(), page).IsOk());
+    std::vector<uint8_t> previous_item_bytes;
+    EXPECT_TRUE(page.Block()
+                    .ReadBytes(position.Offset(), data::kTypeInt.ValueLength(),
+                               previous_item_bytes)
+                    .IsOk());
+    ResultV<dblog::FileID> file_id =
+        manager.FileID(position.BlockID().Filename());
+    EXPECT_TRUE(file_id.IsOk());
+    ResultV<dblog::LogSequenceNumber> lsn = manager.WriteLog(
+        dblog::LogOperation(transaction_id, position, file_id.Get(),
+                            data::kTypeInt.ValueLength(), previous_item_bytes,
+                            item, previous_lsn));
+    EXPECT_TRUE(lsn.IsOk());
+    EXPECT_TRUE(page.Write(position.Offset(), data::kTypeInt.ValueLength(),
+                           item, lsn.Get())
+                    .IsOk());
+    return lsn.Get();
+}
+
+TEST_F(RecoveryManagerTwoFileTest, RecoverFromCheckpoint) {
+    const int block_size = 12;
+    dblog::LogManager log_manager(/*log_filename=*/filename0,
+                                  /*log_directory_path=*/directory_path,
+                                  /*block_size=*/block_size);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    recovery::RecoveryManager manager(log_manager);
+    disk::DiskManager disk_manager(/*directory_name=*/directory_path,
+                                   /*block_size=*/block_size);
+    ASSERT_TRUE(
+        disk_manager
+            .AllocateNewBlocks(disk::BlockID(filename1, /*block_index=*/9))
+            .IsOk());
+    const disk::DiskPosition position0(disk::BlockID(filename1, 1),
+                                       buffer::kPageHeaderSize),
+        position1(disk::BlockID(filename1, 4), buffer::kPageHeaderSize),
+        position2(disk::BlockID(filename1, 7), buffer::kPageHeaderSize);
+
+    {
+        buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4,
+                                                disk_manager, log_manager);
+
+        // The transaction 1 commits and its page is written to disk before
+        // the checkpoint.
+        WriteItem(manager, buffer_manager, 1, position0, data::Int(7).Item(),
+                  dblog::kNullLogSequenceNumber);
+        ASSERT_TRUE(manager.Commit(1).IsOk());
+
+        // The transaction 2 is active at the checkpoint, and its page is
+        // written to disk.
+        WriteItem(manager, buffer_manager, 2, position1, data::Int(9).Item(),
+                  dblog::kNullLogSequenceNumber);
+        ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+        // The page of the transaction 3 is dirty at the checkpoint.
+        const dblog::LogSequenceNumber lsn3 =
+            WriteItem(manager, buffer_manager, 3, position2,
+                      data::Int(5).Item(), dblog::kNullLogSequenceNumber);
+        ASSERT_TRUE(manager.Checkpoint(buffer_manager).IsOk());
+        WriteItem(manager, buffer_manager, 3, position2, data::Int(6).Item(),
+                  lsn3);
+        ASSERT_TRUE(manager.Commit(3).IsOk());
+
+        // Crashes without writing the page of the transaction 3.
+    }
+
+    // The log records before the checkpoint except those of the transaction
+    // 2 are not needed; recovery succeeds even if they are broken.
+    ResultV<dblog::LogSequenceNumber> checkpoint_lsn =
+        log_manager.ReadMasterRecord();
+    ASSERT_TRUE(checkpoint_lsn.IsOk());
+    ASSERT_NE(checkpoint_lsn.Get(), dblog::kNullLogSequenceNumber);
+    ASSERT_TRUE(
+        disk_manager.Write(disk::BlockID(filename0, 0), disk::Block(block_size))
+            .IsOk());
+
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager);
+    Result recover_result = manager.Recover(buffer_manager);
+    ASSERT_TRUE(recover_result.IsOk()) << recover_result.Error();
+    ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+    const std::vector<std::pair<disk::DiskPosition, int>> expects = {
+        {position0, 7}, {position1, 0}, {position2, 6}};
+    for (const auto &[position, expect_value] : expects) {
+        disk::Block block(block_size);
+        ASSERT_TRUE(disk_manager.Read(position.BlockID(), block).IsOk());
+        ResultV<int> value = block.ReadInt(position.Offset());
+        ASSERT_TRUE(value.IsOk());
+        EXPECT_EQ(value.Get(), expect_value);
+    }
+}
+
+TEST_F(RecoveryManagerTwoFileTest, CheckpointWaitsForLoggedModification) {
+    const int block_size = 12;
+    dblog::LogManager log_manager(/*log_filename=*/filename0,
+                                  /*log_directory_path=*/directory_path,
+                                  /*block_size=*/block_size);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    recovery::RecoveryManager manager(log_manager);
+    disk::DiskManager disk_manager(/*directory_name=*/directory_path,
+                                   /*block_size=*/block_size);
+    ASSERT_TRUE(
+        disk_manager
+            .AllocateNewBlocks(disk::BlockID(filename1, /*block_index=*/9))
+            .IsOk());
+    const disk::DiskPosition position(disk::BlockID(filename1, 3),
+                                      buffer::kPageHeaderSize);
+
+    {
+        buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4,
+                                                disk_manager, log_manager);
+
+        // The checkpoint begins after the log record of the modification is
+        // written, but before the clean page is modified.
+        buffer::PageGuard page;
+        ASSERT_TRUE(buffer_manager.Pin(position.BlockID(), page).IsOk());
+        std::thread checkpoint;
+        {
+            std::lock_guard<std::mutex> update_latch(page.UpdateLatch());
+            const std::vector<uint8_t> previous_item_bytes(
+                data::kTypeInt.ValueLength());
+            ResultV<dblog::LogSequenceNumber> lsn =
+                manager.WriteLog(dblog::LogOperation(
+                    /*transaction_id=*/1, position,
+                    manager.FileID(filename1).Get(),
+                    data::kTypeInt.ValueLength(), previous_item_bytes,
+                    data::Int(7).Item()));
+            ASSERT_TRUE(lsn.IsOk());
+            checkpoint = std::thread([&] {
+                EXPECT_TRUE(manager.Checkpoint(buffer_manager).IsOk());
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            EXPECT_TRUE(page.Write(position.Offset(),
+                                   data::kTypeInt.ValueLength(),
+                                   data::Int(7).Item(), lsn.Get())
+                            .IsOk());
+        }
+        checkpoint.join();
+        page.Release();
+        ASSERT_TRUE(manager.Commit(1).IsOk());
+
+        // Crashes without writing the page.
+    }
+
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager);
+    Result recover_result = manager.Recover(buffer_manager);
+    ASSERT_TRUE(recover_result.IsOk()) << recover_result.Error();
+    ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+    disk::Block block(block_size);
+    ASSERT_TRUE(disk_manager.Read(position.BlockID(), block).IsOk());
+    ResultV<int> value = block.ReadInt(position.Offset());
+    ASSERT_TRUE(value.IsOk());
+    EXPECT_EQ(value.Get(), 7);
+}
+
+TEST_F(RecoveryManagerTwoFileTest, RecoverSkipsPagesWhichAreUpToDate) {
+    const int block_size = 12;
+    dblog::LogManager log_manager(/*log_filename=*/filename0,
+                                  /*log_directory_path=*/directory_path,
+                                  /*block_size=*/block_size);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    recovery::RecoveryManager manager(log_manager);
+    disk::DiskManager disk_manager(/*directory_name=*/directory_path,
+                                   /*block_size=*/block_size);
+    ASSERT_TRUE(
+        disk_manager
+            .AllocateNewBlocks(disk::BlockID(filename1, /*block_index=*/9))
+            .IsOk());
+    const disk::DiskPosition position0(disk::BlockID(filename1, 1),
+                                       buffer::kPageHeaderSize),
+        position1(disk::BlockID(filename1, 4), buffer::kPageHeaderSize),
+        position2(disk::BlockID(filename1, 7), buffer::kPageHeaderSize);
+
+    {
+        buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4,
+                                                disk_manager, log_manager);
+
+        // The page of the transaction 1 is written to disk with its page log
+        // sequence number.
+        WriteItem(manager, buffer_manager, 1, position0, data::Int(7).Item(),
+                  dblog::kNullLogSequenceNumber);
+        ASSERT_TRUE(manager.Commit(1).IsOk());
+        ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+        // The transaction 2 rolls back, and the transaction 3 does not end.
+        const dblog::LogSequenceNumber lsn2 =
+            WriteItem(manager, buffer_manager, 2, position1,
+                      data::Int(9).Item(), dblog::kNullLogSequenceNumber);
+        ASSERT_TRUE(manager.Rollback(2, lsn2, buffer_manager).IsOk());
+        WriteItem(manager, buffer_manager, 3, position2, data::Int(5).Item(),
+                  dblog::kNullLogSequenceNumber);
+        ASSERT_TRUE(log_manager.Flush().IsOk());
+
+        // Crashes without writing the pages of the transactions 2 and 3.
+    }
+
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/4, disk_manager,
+                                            log_manager);
+    recovery::RecoveryStatistics statistics;
+    Result recover_result = manager.Recover(buffer_manager, &statistics);
+    ASSERT_TRUE(recover_result.IsOk()) << recover_result.Error();
+    ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+    // The operation and the compensation log record of the transaction 2 and
+    // the operation of the transaction 3 are redone, and the transaction 3 is
+    // undone.
+    EXPECT_EQ(statistics.redo_count, 3);
+    EXPECT_EQ(statistics.redo_skip_count, 1);
+    EXPECT_EQ(statistics.undo_count, 1);
+    const std::vector<std::pair<disk::DiskPosition, int>> expects = {
+        {position0, 7}, {position1, 0}, {position2, 0}};
+    for (const auto &[position, expect_value] : expects) {
+        disk::Block block(block_size);
+        ASSERT_TRUE(disk_manager.Read(position.BlockID(), block).IsOk());
+        ResultV<int> value = block.ReadInt(position.Offset());
+        ASSERT_TRUE(value.IsOk());
+        EXPECT_EQ(value.Get(), expect_value);
+    }
+
+    // All the pages are up to date and every transaction has ended.
+    recovery::RecoveryStatistics statistics_again;
+    recover_result = manager.Recover(buffer_manager, &statistics_again);
+    ASSERT_TRUE(recover_result.IsOk()) << recover_result.Error();
+    EXPECT_EQ(statistics_again.redo_count, 0);
+    EXPECT_EQ(statistics_again.undo_count, 0);
+}
+
+TEST_F(RecoveryManagerTwoFileTest, ParallelReDoKeepsOrderOfEachPage) {
+    const int block_size = 64, block_count = 16;
+    dblog::LogManager log_manager(/*log_filename=*/filename0,
+                                  /*log_directory_path=*/directory_path,
+                                  /*block_size=*/block_size);
+    ASSERT_TRUE(log_manager.Init().IsOk());
+    recovery::RecoveryManager manager(log_manager);
+    disk::DiskManager disk_manager(/*directory_name=*/directory_path,
+                                   /*block_size=*/block_size);
+    ASSERT_TRUE(disk_manager
+                    .AllocateNewBlocks(disk::BlockID(
+                        filename1, /*block_index=*/block_count - 1))
+                    .IsOk());
+
+    // Each page is modified many times by the committed transactions, and
+    // the last value of each page is `block index` * 100 + 99.
+    {
+        buffer::LRUBufferManager buffer_manager(/*buffer_size=*/block_count,
+                                                disk_manager, log_manager);
+        dblog::TransactionID transaction_id = 0;
+        for (int round = 0; round < 100; round++) {
+            for (int index = 0; index < block_count; index++) {
+                const disk::DiskPosition position(
+                    disk::BlockID(filename1, index), buffer::kPageHeaderSize);
+                WriteItem(manager, buffer_manager, transaction_id, position,
+                          data::Int(index * 100 + round).Item(),
+                          dblog::kNullLogSequenceNumber);
+                ASSERT_TRUE(manager.Commit(transaction_id++).IsOk());
+            }
+        }
+
+        // Crashes without writing the pages.
+    }
+
+    buffer::LRUBufferManager buffer_manager(/*buffer_size=*/block_count,
+                                            disk_manager, log_manager,
+                                            /*shard_count=*/4);
+    manager.SetReDoThreadCount(4);
+    recovery::RecoveryStatistics statistics;
+    Result recover_result = manager.Recover(buffer_manager, &statistics);
+    ASSERT_TRUE(recover_result.IsOk()) << recover_result.Error();
+    EXPECT_EQ(statistics.redo_count, 100 * block_count);
+    ASSERT_TRUE(buffer_manager.FlushAll().IsOk());
+
+    for (int index = 0; index < block_count; index++) {
+        disk::Block block(block_size);
+        ASSERT_TRUE(
+            disk_manager.Read(disk::BlockID(filename1, index), block).IsOk());
+        ResultV<int> value = block.ReadInt(buffer::kPageHeaderSize);
+        ASSERT_TRUE(value.IsOk());
+        EXPECT_EQ(value.Get(), index * 100 + 99);
+    }
+}
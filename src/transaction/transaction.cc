@@ -3,22 +3,43 @@
 #include "data/char.h"
 #include "data/int.h"
 #include "debug.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 namespace transaction {
 
 dblog::TransactionID NextTransactionID() {
-    static dblog::TransactionID transaction_id = 0;
+    // The transaction ids identify the owners of locks, so they must be unique
+    // even when transactions begin concurrently.
+    static std::atomic<dblog::TransactionID> transaction_id = 0;
     return transaction_id++;
 }
 
 Transaction::Transaction(disk::DiskManager &disk_manager,
                          buffer::BufferManager &buffer_manager,
                          dblog::LogManager &log_manager,
-                         dbconcurrency::LockTable &lock_table)
+                         dbconcurrency::LockTable &lock_table,
+                         dbconcurrency::VersionStore &version_store,
+                         disk::FreeSpaceMap &free_space_map)
     : transaction_id_(NextTransactionID()), disk_manager_(disk_manager),
       buffer_manager_(buffer_manager),
-      concurrent_manager_(dbconcurrency::ConcurrentManager(lock_table)),
-      recovery_manager_(recovery::RecoveryManager(log_manager)) {}
+      concurrent_manager_(
+          dbconcurrency::ConcurrentManager(lock_table, transaction_id_)),
+      recovery_manager_(recovery::RecoveryManager(log_manager)),
+      version_store_(version_store), free_space_map_(free_space_map) {}
+
+void Transaction::BeginSnapshot() {
+    is_snapshot_ = true;
+    snapshot_    = version_store_.BeginSnapshot();
+}
+
+// Returns the position in the block on disk of `position`, whose offset is
+// relative to the content after the page header.
+inline disk::DiskPosition PagePosition(const disk::DiskPosition &position) {
+    return disk::DiskPosition(position.BlockID(),
+                              buffer::kPageHeaderSize + position.Offset());
+}
 
 #define ROLLBACK(result_name)                                                  \
     {                                                                          \
@@ -30,11 +51,121 @@ Transaction::Transaction(disk::DiskManager &disk_manager,
 
 Result Transaction::Write(const disk::DiskPosition &position, const int length,
                           const data::DataItem &item) {
+    return Write(position.BlockID(), position, length, item);
+}
+
+Result Transaction::Read(const disk::DiskPosition &position, const int length,
+                         data::DataItem &item) {
+    return Read(position.BlockID(), position, length, item);
+}
+
+Result Transaction::WriteRecord(const int slot,
+                                const disk::DiskPosition &position,
+                                const int length, const data::DataItem &item) {
+    return Write(dbconcurrency::LockID(position.BlockID(), slot), position,
+                 length, item);
+}
+
+Result Transaction::ReadRecord(const int slot,
+                               const disk::DiskPosition &position,
+                               const int length, data::DataItem &item) {
+    return Read(dbconcurrency::LockID(position.BlockID(), slot), position,
+                length, item);
+}
+
+Result Transaction::WriteRecordBits(const int slot,
+                                    const disk::DiskPosition &position,
+                                    const uint8_t mask, const bool value) {
+    // The bits set again are no longer cleared on commit.
+    if (value) {
+        bits_cleared_on_commit_.erase(
+            std::remove_if(bits_cleared_on_commit_.begin(),
+                           bits_cleared_on_commit_.end(),
+                           [&](const RecordBits &bits) {
+                               return bits.Matches(slot, position);
+                           }),
+            bits_cleared_on_commit_.end());
+    }
+    return Write(dbconcurrency::LockID(position.BlockID(), slot), position,
+                 data::kTypeByte.ValueLength(), data::Byte(mask).Item(),
+                 value ? WriteMode::kSetBits : WriteMode::kClearBits);
+}
+
+Result Transaction::ClearRecordBitsOnCommit(const int slot,
+                                            const disk::DiskPosition &position,
+                                            const uint8_t mask) {
+    if (is_snapshot_)
+        return Error("transaction::Transaction::ClearRecordBitsOnCommit() a "
+                     "snapshot cannot write.");
+
+    Result lock_result = concurrent_manager_.WriteLock(
+        dbconcurrency::LockID(position.BlockID(), slot));
+    if (lock_result.IsError()) {
+        ROLLBACK(lock_result);
+        return lock_result + Error("transaction::Transaction::"
+                                   "ClearRecordBitsOnCommit() failed to lock "
+                                   "the record.");
+    }
+    bits_cleared_on_commit_.push_back(RecordBits{slot, position, mask});
+    return Ok();
+}
+
+ResultV<uint8_t>
+Transaction::ReadRecordBits(const int slot, const disk::DiskPosition &position,
+                            const bool for_update) {
+    data::DataItem item;
+    FIRST_TRY(Read(dbconcurrency::LockID(position.BlockID(), slot), position,
+                   data::kTypeByte.ValueLength(), item, /*latched=*/true,
+                   for_update));
+    uint8_t byte = data::ReadByte(item);
+    for (const RecordBits &bits : bits_cleared_on_commit_) {
+        if (bits.Matches(slot, position)) byte &= ~bits.mask;
+    }
+    return Ok(byte);
+}
+
+Result Transaction::ReadWithoutLock(const disk::DiskPosition &position,
+                                    const int length, data::DataItem &item) {
+    if (is_snapshot_) return ReadSnapshot(position, length, item);
+
+    buffer::PageGuard page;
+    Result read_result = buffer_manager_.Pin(position.BlockID(), page);
+    if (read_result.IsError()) {
+        ROLLBACK(read_result);
+        return read_result + Error("transaction::Transaction::"
+                                   "ReadWithoutLock() failed to pin the "
+                                   "block.");
+    }
+
+    {
+        std::lock_guard<std::mutex> update_latch(page.UpdateLatch());
+        read_result =
+            page.Block().Read(PagePosition(position).Offset(), length, item);
+    }
+    if (read_result.IsError()) {
+        ROLLBACK(read_result);
+        return read_result + Error("transaction::Transaction::"
+                                   "ReadWithoutLock() failed to read the "
+                                   "data.");
+    }
+    return Ok();
+}
+
+Result Transaction::Write(const dbconcurrency::LockID &lock_id,
+                          const disk::DiskPosition &position, const int length,
+                          const data::DataItem &item, const WriteMode mode) {
     DEBUG("transaction::Transaction::Write() called with position: ("
           "block_index: "
           << position.BlockID().BlockIndex()
           << ", offset: " << position.Offset() << "), length: " << length);
-    Result lock_result = concurrent_manager_.WriteLock(position.BlockID());
+    if (is_snapshot_) {
+        Result snapshot_error =
+            Error("transaction::Transaction::Write() a snapshot cannot write.");
+        ROLLBACK(snapshot_error);
+        return snapshot_error;
+    }
+
+    Result lock_result = concurrent_manager_.WriteLock(lock_id);
     if (lock_result.IsError()) {
         ROLLBACK(lock_result);
         return lock_result + Error("transaction::Transaction::"
@@ -43,20 +174,35 @@ Result Transaction::Write(const disk::DiskPosition &position, const int length,
     }
     DEBUG("transaction::Transaction::Write() locked the block");
 
-    disk::Block block;
-    Result result = buffer_manager_.Read(position.BlockID(), block);
+    buffer::PageGuard page;
+    Result result = buffer_manager_.Pin(position.BlockID(), page);
     if (result.IsError()) {
         ROLLBACK(result);
         return result + Error("transaction::Transaction::"
-                              "Write() failed to read "
+                              "Write() failed to pin "
                               "the block.");
     }
-    DEBUG("transaction::Transaction::Write() read the block");
+    DEBUG("transaction::Transaction::Write() pinned the block");
 
+    ResultV<dblog::FileID> file_id =
+        recovery_manager_.FileID(position.BlockID().Filename());
+    if (file_id.IsError()) {
+        ROLLBACK(file_id);
+        return file_id + Error("transaction::Transaction::"
+                               "Write() failed to get the file id.");
+    }
+
+    // Other transactions may modify the other records of the block, so the
+    // block is latched until the modification logged here is applied. The
+    // latch is released before a rollback, which latches the blocks it undoes.
+    std::unique_lock<std::mutex> update_latch(page.UpdateLatch());
+
+    const disk::DiskPosition page_position = PagePosition(position);
     std::vector<uint8_t> previous_item_bytes;
-    Result previous_data =
-        block.ReadBytes(position.Offset(), length, previous_item_bytes);
+    Result previous_data = page.Block().ReadBytes(page_position.Offset(),
+                                                  length, previous_item_bytes);
     if (previous_data.IsError()) {
+        update_latch.unlock();
         ROLLBACK(previous_data);
         return previous_data + Error("transaction::Transaction::"
                                      "Write() failed "
@@ -64,19 +210,52 @@ Result Transaction::Write(const disk::DiskPosition &position, const int length,
     }
     DEBUG("transaction::Transaction::Write() read the previous data");
 
+    // The bits are applied to the byte read with the latch held, because the
+    // other bits of the byte may be written by other transactions.
+    data::DataItem bits_item;
+    if (mode != WriteMode::kOverwrite) {
+        const uint8_t mask = data::ReadByte(item);
+        const uint8_t bits = mode == WriteMode::kSetBits
+                                 ? previous_item_bytes[0] | mask
+                                 : previous_item_bytes[0] & ~mask;
+        bits_item          = data::Byte(bits).Item();
+    }
+    const data::DataItem &new_item =
+        mode == WriteMode::kOverwrite ? item : bits_item;
+
+    std::vector<uint8_t> new_item_bytes(length);
+    Result new_data = data::Write(new_item, new_item_bytes, 0, length);
+    if (new_data.IsError()) {
+        update_latch.unlock();
+        ROLLBACK(new_data);
+        return new_data + Error("transaction::Transaction::"
+                                "Write() failed "
+                                "to encode the new data.");
+    }
+
+    // The snapshots which do not see this transaction read the previous data.
+    version_store_.AddVersion(transaction_id_, position, previous_item_bytes,
+                              new_item_bytes);
+
+    // The previous data is read from the page, so the images can be a delta.
     ResultV<dblog::LogSequenceNumber> lsn_result =
         recovery_manager_.WriteLog(dblog::LogOperation(
-            transaction_id_, position, length, previous_item_bytes, item));
+            transaction_id_, page_position, file_id.Get(), length,
+            previous_item_bytes, new_item, last_lsn_, /*delta=*/true));
     if (lsn_result.IsError()) {
+        update_latch.unlock();
         ROLLBACK(lsn_result);
         return lsn_result + Error("transaction::Transaction::"
                                   "Write() failed to "
                                   "write a log record.");
     }
+    last_lsn_ = lsn_result.Get();
     DEBUG("transaction::Transaction::Write() wrote the log record");
 
-    Result write_result = block.Write(position.Offset(), length, item);
+    Result write_result =
+        page.Write(page_position.Offset(), length, new_item, lsn_result.Get());
     if (write_result.IsError()) {
+        update_latch.unlock();
         ROLLBACK(write_result);
         return write_result + Error("transaction::Transaction::"
                                     "Write() failed "
@@ -84,26 +263,21 @@ Result Transaction::Write(const disk::DiskPosition &position, const int length,
     }
     DEBUG("transaction::Transaction::Write() wrote the data");
 
-    write_result =
-        buffer_manager_.Write(position.BlockID(), block, lsn_result.Get());
-    if (write_result.IsError()) {
-        ROLLBACK(write_result);
-        return write_result + Error("transaction::Transaction::"
-                                    "Write() failed "
-                                    "to write the block.");
-    }
-    DEBUG("transaction::Transaction::Write() wrote the block");
-
     return Ok();
 }
 
-Result Transaction::Read(const disk::DiskPosition &position, const int length,
-                         data::DataItem &item) {
+Result Transaction::Read(const dbconcurrency::LockID &lock_id,
+                         const disk::DiskPosition &position, const int length,
+                         data::DataItem &item, const bool latched,
+                         const bool for_update) {
     DEBUG("transaction::Transaction::Read() called with position: ("
           "block_index: "
           << position.BlockID().BlockIndex()
           << ", offset: " << position.Offset() << "), length: " << length);
-    Result lock_result = concurrent_manager_.ReadLock(position.BlockID());
+    if (is_snapshot_) return ReadSnapshot(position, length, item);
+
+    Result lock_result = for_update ? concurrent_manager_.WriteLock(lock_id)
+                                    : concurrent_manager_.ReadLock(lock_id);
     if (lock_result.IsError()) {
         ROLLBACK(lock_result);
         return lock_result + Error("transaction::Transaction::ReadByte() "
@@ -111,16 +285,22 @@ Result Transaction::Read(const disk::DiskPosition &position, const int length,
     }
     DEBUG("transaction::Transaction::Read() locked the block");
 
-    disk::Block block;
-    Result read_result = buffer_manager_.Read(position.BlockID(), block);
+    buffer::PageGuard page;
+    Result read_result = buffer_manager_.Pin(position.BlockID(), page);
     if (read_result.IsError()) {
         ROLLBACK(read_result);
         return read_result + Error("transaction::Transaction::ReadByte() "
-                                   "failed to read the block.");
+                                   "failed to pin the block.");
     }
-    DEBUG("transaction::Transaction::Read() read the block");
+    DEBUG("transaction::Transaction::Read() pinned the block");
 
-    read_result = block.Read(position.Offset(), length, item);
+    {
+        std::unique_lock<std::mutex> update_latch(page.UpdateLatch(),
+                                                  std::defer_lock);
+        if (latched) update_latch.lock();
+        read_result =
+            page.Block().Read(PagePosition(position).Offset(), length, item);
+    }
     if (read_result.IsError()) {
         ROLLBACK(read_result);
         return read_result + Error("transaction::Transaction::ReadByte() "
@@ -131,6 +311,40 @@ Result Transaction::Read(const disk::DiskPosition &position, const int length,
     return Ok();
 }
 
+Result Transaction::ReadSnapshot(const disk::DiskPosition &position,
+                                 const int length, data::DataItem &item) {
+    buffer::PageGuard page;
+    Result read_result = buffer_manager_.Pin(position.BlockID(), page);
+    if (read_result.IsError()) {
+        ROLLBACK(read_result);
+        return read_result + Error("transaction::Transaction::ReadSnapshot() "
+                                   "failed to pin the block.");
+    }
+
+    // The latch makes the bytes and the versions consistent, since a writer
+    // adds the version before it modifies the block with the latch held.
+    std::vector<uint8_t> bytes;
+    {
+        std::lock_guard<std::mutex> update_latch(page.UpdateLatch());
+        read_result = page.Block().ReadBytes(PagePosition(position).Offset(),
+                                             length, bytes);
+    }
+    if (read_result.IsError()) {
+        ROLLBACK(read_result);
+        return read_result + Error("transaction::Transaction::ReadSnapshot() "
+                                   "failed to read the bytes.");
+    }
+    version_store_.ReadSnapshot(snapshot_, position, bytes);
+
+    read_result = data::Read(item, bytes, 0, length);
+    if (read_result.IsError()) {
+        ROLLBACK(read_result);
+        return read_result + Error("transaction::Transaction::ReadSnapshot() "
+                                   "failed to read the item.");
+    }
+    return Ok();
+}
+
 ResultV<int> Transaction::ReadInt(const disk::DiskPosition &position) {
     data::DataItem item;
     FIRST_TRY(Read(position, data::kTypeInt.ValueLength(), item));
@@ -138,6 +352,27 @@ ResultV<int> Transaction::ReadInt(const disk::DiskPosition &position) {
 }
 
 Result Transaction::Commit() {
+    if (is_snapshot_) {
+        version_store_.EndSnapshot(snapshot_);
+        is_snapshot_ = false;
+        return Ok();
+    }
+
+    // The bits are cleared right before the commit record is written, while
+    // the records are still locked. `Write()` rolls back on failure.
+    std::vector<RecordBits> cleared_bits;
+    cleared_bits.swap(bits_cleared_on_commit_);
+    for (const RecordBits &bits : cleared_bits) {
+        Result clear_result =
+            Write(dbconcurrency::LockID(bits.position.BlockID(), bits.slot),
+                  bits.position, data::kTypeByte.ValueLength(),
+                  data::Byte(bits.mask).Item(), WriteMode::kClearBits);
+        if (clear_result.IsError()) {
+            return clear_result + Error("transaction::Transaction::Commit() "
+                                        "failed to clear the bits.");
+        }
+    }
+
     Result commit_result = recovery_manager_.Commit(transaction_id_);
     if (commit_result.IsError()) {
         ROLLBACK(commit_result);
@@ -146,34 +381,49 @@ Result Transaction::Commit() {
                      "commit the transaction.");
     }
 
+    // The commit is visible to the snapshots before other transactions can
+    // lock the modified data.
+    version_store_.Commit(transaction_id_);
     concurrent_manager_.Release();
+    last_lsn_ = dblog::kNullLogSequenceNumber;
+
+    // The blocks have free space now that the bits are cleared.
+    for (const RecordBits &bits : cleared_bits) {
+        const disk::BlockID &block_id = bits.position.BlockID();
+        free_space_map_.Add(block_id.Filename(), block_id.BlockIndex(),
+                            block_id.BlockIndex());
+    }
     return Ok();
 }
 
 Result Transaction::Rollback() {
+    if (is_snapshot_) {
+        version_store_.EndSnapshot(snapshot_);
+        is_snapshot_ = false;
+        return Ok();
+    }
+
     Result rollback_result =
-        recovery_manager_.Rollback(transaction_id_, buffer_manager_);
+        recovery_manager_.Rollback(transaction_id_, last_lsn_, buffer_manager_);
 
-    // Rollback method must release locks whenever it is called.
+    // Rollback method must release locks whenever it is called. The versions
+    // are no longer needed since the modifications are undone.
+    version_store_.Rollback(transaction_id_);
     concurrent_manager_.Release();
+    bits_cleared_on_commit_.clear();
 
     if (rollback_result.IsError()) {
         return rollback_result + Error("transaction::Transaction::Rollback() "
                                        "failed to rollback the transaction.");
     }
+
+    // The operations are undone, so the next operation must not be chained
+    // to them; otherwise a later rollback would undo them again.
+    last_lsn_ = dblog::kNullLogSequenceNumber;
     return Ok();
 }
 
 ResultV<size_t> Transaction::Size(const std::string &filename) {
-    disk::BlockID eof_block_id = disk::EndOfFileBlockID(filename);
-    Result lock_result         = concurrent_manager_.ReadLock(eof_block_id);
-    if (lock_result.IsError()) {
-        ROLLBACK(lock_result);
-        return lock_result + Error("transaction::Transaction::"
-                                   "Size() failed to "
-                                   "lock the end of file block.");
-    }
-
     ResultV<size_t> size_result = disk_manager_.Size(filename);
     if (size_result.IsError()) {
         ROLLBACK(size_result);
@@ -181,29 +431,20 @@ ResultV<size_t> Transaction::Size(const std::string &filename) {
                Error("transaction::Transaction::"
                      "Size() failed to get the size of the file.");
     }
-
     return size_result;
 }
 
-Result Transaction::AllocateNewBlocks(const disk::BlockID &block_id) {
-    disk::BlockID eof_block_id = disk::EndOfFileBlockID(block_id.Filename());
-    Result lock_result         = concurrent_manager_.WriteLock(eof_block_id);
-    if (lock_result.IsError()) {
-        ROLLBACK(lock_result);
-        return lock_result +
-               Error("transaction::Transaction::AllocateNewBlocks() "
-                     "failed to lock the end of file block.");
-    }
-
-    Result allocate_result = disk_manager_.AllocateNewBlocks(block_id);
-    if (allocate_result.IsError()) {
-        ROLLBACK(allocate_result);
-        return allocate_result +
-               Error("transaction::Transaction::AllocateNewBlocks() "
-                     "failed to allocate new blocks.");
+ResultV<int> Transaction::AppendNewBlocks(const std::string &filename,
+                                          const int block_count) {
+    ResultV<int> first_block_index =
+        disk_manager_.AppendBlocks(filename, block_count);
+    if (first_block_index.IsError()) {
+        ROLLBACK(first_block_index);
+        return first_block_index +
+               Error("transaction::Transaction::AppendNewBlocks() "
+                     "failed to append new blocks.");
     }
-
-    return Ok();
+    return first_block_index;
 }
 
 } // namespace transaction
\ No newline at end of file
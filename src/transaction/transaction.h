@@ -4,9 +4,12 @@
 #include "buffer.h"
 #include "concurrency.h"
 #include "data/data.h"
+#include "free_space.h"
 #include "log.h"
 #include "recovery.h"
 #include "result.h"
+#include "version.h"
+#include <vector>
 
 namespace transaction {
 
@@ -16,44 +19,180 @@ dblog::TransactionID NextTransactionID();
 // Transaction manages the data and the log records.
 // If one methods fails (returns Error), the transaction rolls back itself.
 // Thus, rollback is not user's responsibility even if the method fails.
+//
+// A transaction can be a read-only snapshot, which reads the data committed
+// when the snapshot began, without locks. Its reads never wait for writers,
+// and writers never wait for it.
 class Transaction {
   public:
     Transaction(disk::DiskManager &disk_manager,
                 buffer::BufferManager &buffer_manager,
                 dblog::LogManager &log_manager,
-                dbconcurrency::LockTable &lock_table);
+                dbconcurrency::LockTable &lock_table,
+                dbconcurrency::VersionStore &version_store,
+                disk::FreeSpaceMap &free_space_map);
 
-    // Blocksize of the disk.
-    inline int BlockSize() const { return disk_manager_.BlockSize(); }
+    // Makes the transaction a read-only snapshot of the data committed at
+    // this moment. This method must be called before the transaction reads
+    // or writes anything. A snapshot fails to write data.
+    void BeginSnapshot();
 
-    // Writes `item` of `type` to `position`.
+    // Returns true if the transaction is a read-only snapshot.
+    inline bool IsSnapshot() const { return is_snapshot_; }
+
+    // The size of the content of a block, which is the block size of the disk
+    // without the page header. The offsets of the positions passed to this
+    // transaction are relative to the beginning of the content.
+    inline int BlockSize() const {
+        return disk_manager_.BlockSize() - buffer::kPageHeaderSize;
+    }
+
+    // Writes `item` of `type` to `position`. The whole block is locked.
     Result Write(const disk::DiskPosition &position, const int length,
                  const data::DataItem &item);
 
+    // Reads `item` from `position`. The whole block is locked.
     Result Read(const disk::DiskPosition &position, const int length,
                 data::DataItem &item);
 
+    // Writes `item` to `position` in the record in `slot` of the block. Only
+    // the record is locked for write, so that other transactions can access
+    // the other records of the block.
+    Result WriteRecord(const int slot, const disk::DiskPosition &position,
+                       const int length, const data::DataItem &item);
+
+    // Reads `item` from `position` in the record in `slot` of the block. Only
+    // the record is locked for read.
+    Result ReadRecord(const int slot, const disk::DiskPosition &position,
+                      const int length, data::DataItem &item);
+
+    // Sets the bits of `mask` in the byte at `position` for the record in
+    // `slot` of the block, or clears them if `value` is false. Only the record
+    // is locked for write, so the other bits of the byte, which belong to the
+    // other records, may be written by other transactions at the same time.
+    // The change is logged as a delta, so undoing it keeps those bits.
+    Result WriteRecordBits(const int slot, const disk::DiskPosition &position,
+                           const uint8_t mask, const bool value);
+
+    // Clears the bits of `mask` in the byte at `position` for the record in
+    // `slot` of the block when the transaction commits. The record is locked
+    // for write at once, but the bits are kept set until the commit, so that
+    // the readers which find records by the bits without locks still find the
+    // record and wait for its lock. For this transaction, `ReadRecordBits()`
+    // returns the bits cleared from now on.
+    Result ClearRecordBitsOnCommit(const int slot,
+                                   const disk::DiskPosition &position,
+                                   const uint8_t mask);
+
+    // Reads the byte at `position` which has the bits of the record in `slot`
+    // of the block. Only the record is locked for read, and the byte is read
+    // with the update latch of the block held, because the other bits may be
+    // written at the same time. If `for_update` is true, the record is locked
+    // for write instead, so that a later `WriteRecordBits()` does not need to
+    // convert the lock, which deadlocks when two transactions read the bits
+    // of the same record before writing them.
+    ResultV<uint8_t> ReadRecordBits(const int slot,
+                                    const disk::DiskPosition &position,
+                                    const bool for_update = false);
+
+    // Reads `item` from `position` without locking it, with only the update
+    // latch of the block held. The data may have been modified by the
+    // transactions which are not committed yet, so it must be checked with
+    // a locked read before it is used. A snapshot reads it as it does
+    // everything else.
+    Result ReadWithoutLock(const disk::DiskPosition &position,
+                           const int length, data::DataItem &item);
+
     // Reads int from `position`.
     ResultV<int> ReadInt(const disk::DiskPosition &position);
 
-    // Commits the transaction.
+    // Commits the transaction. The bits passed to `ClearRecordBitsOnCommit()`
+    // are cleared before the commit record is written, and their blocks are
+    // added to the free-space map after the commit.
     Result Commit();
 
     // Rollbacks the transaction.
     Result Rollback();
 
-    // Returns the size of the file.
+    // Returns the size of the file. The size is not locked, so the file may
+    // be extended by other transactions after this.
     ResultV<size_t> Size(const std::string &filename);
 
-    // Allocates new blocks for the file.
-    Result AllocateNewBlocks(const disk::BlockID &block_id);
+    // Returns the free-space map shared with the other transactions, which
+    // tracks the blocks which may have free space.
+    inline disk::FreeSpaceMap &FreeSpace() { return free_space_map_; }
+
+    // Appends `block_count` new blocks to the end of the file, and returns the
+    // index of the first appended block. The extension is a short system
+    // operation which is not locked for the transaction and not undone by a
+    // rollback, so that the other transactions can scan and extend the file
+    // before the transaction ends.
+    ResultV<int> AppendNewBlocks(const std::string &filename,
+                                 const int block_count);
 
   private:
+    // The bits of a record which are cleared when the transaction commits.
+    struct RecordBits {
+        int slot;
+        disk::DiskPosition position;
+        uint8_t mask;
+
+        // Returns true if these are the bits of the record in `slot` at
+        // `position`.
+        inline bool Matches(const int other_slot,
+                            const disk::DiskPosition &other_position) const {
+            return slot == other_slot &&
+                   position.BlockID() == other_position.BlockID() &&
+                   position.Offset() == other_position.Offset();
+        }
+    };
+
+    // How `Write()` applies the item to the data on the page.
+    enum class WriteMode {
+        // The item overwrites the data.
+        kOverwrite = 0,
+        // The item is a mask of one byte, whose bits are set in the data.
+        kSetBits = 1,
+        // The item is a mask of one byte, whose bits are cleared in the data.
+        kClearBits = 2,
+    };
+
+    // Writes `item` to `position` with `lock_id` locked for write, which is
+    // the block of `position` or a record in it.
+    Result Write(const dbconcurrency::LockID &lock_id,
+                 const disk::DiskPosition &position, const int length,
+                 const data::DataItem &item,
+                 const WriteMode mode = WriteMode::kOverwrite);
+
+    // Reads `item` from `position` with `lock_id` locked for read, or for
+    // write if `for_update` is true. If `latched` is true, the item is read
+    // with the update latch of the block held.
+    Result Read(const dbconcurrency::LockID &lock_id,
+                const disk::DiskPosition &position, const int length,
+                data::DataItem &item, const bool latched = false,
+                const bool for_update = false);
+
+    // Reads `item` from `position` as seen by the snapshot.
+    Result ReadSnapshot(const disk::DiskPosition &position, const int length,
+                        data::DataItem &item);
+
     dblog::TransactionID transaction_id_;
+
+    // The log sequence number of the last operation of this transaction.
+    dblog::LogSequenceNumber last_lsn_ = dblog::kNullLogSequenceNumber;
     disk::DiskManager &disk_manager_;
     buffer::BufferManager &buffer_manager_;
     dbconcurrency::ConcurrentManager concurrent_manager_;
     recovery::RecoveryManager recovery_manager_;
+    dbconcurrency::VersionStore &version_store_;
+    disk::FreeSpaceMap &free_space_map_;
+
+    // The bits passed to `ClearRecordBitsOnCommit()`, which are discarded
+    // when the transaction ends.
+    std::vector<RecordBits> bits_cleared_on_commit_;
+
+    bool is_snapshot_ = false;
+    dbconcurrency::CommitTimestamp snapshot_;
 };
 
 } // namespace transaction
@@ -15,9 +15,12 @@
                        buffer::BufferManager &buffer_manager,                  \
                        dblog::LogManager &log_manager,                         \
                        dbconcurrency::LockTable &lock_table,                   \
+                       dbconcurrency::VersionStore &version_store,             \
+                       disk::FreeSpaceMap &free_space_map,                     \
                        const std::string data_filename) {                      \
         transaction::Transaction transaction(disk_manager, buffer_manager,     \
-                                             log_manager, lock_table);         \
+                                             log_manager, lock_table,          \
+                                             version_store, free_space_map);   \
         content                                                                \
     }
 
@@ -44,10 +47,12 @@ TRANSACTION_FUNCTION(func1, {
 TEST_F(TransactionTest, random) {
     std::thread thread0(func0, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread1(func1, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     thread0.join();
     thread1.join();
 
@@ -249,16 +254,20 @@ TEST_F(TransactionTest, AtomicityTest) {
     // checks if the written data is not written.
     std::thread thread1(AtomicityTestFunc1, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread2(AtomicityTestFunc2, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread3(AtomicityTestFunc3, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread4(AtomicityTestFunc4, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
 
     thread1.join();
     thread2.join();
@@ -388,16 +397,20 @@ TEST_F(TransactionTest, IsolationTest) {
     // all written data is the same.
     std::thread thread1(IsolationTestFunc1, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread2(IsolationTestFunc2, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread3(IsolationTestFunc3, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
     std::thread thread4(IsolationTestFunc4, std::ref(data_disk_manager),
                         std::ref(buffer_manager), std::ref(log_manager),
-                        std::ref(lock_table), data_filename);
+                        std::ref(lock_table), std::ref(version_store),
+                        std::ref(free_space_map), data_filename);
 
     thread1.join();
     thread2.join();
@@ -418,4 +431,154 @@ TEST_F(TransactionTest, IsolationTest) {
     }
 }
 
+TEST_F(TransactionTest, RecordsOfBlockAreWrittenConcurrently) {
+    // Two transactions write different records of a block at the same time,
+    // while a write of the whole block conflicts with them.
+    transaction::Transaction transaction0(data_disk_manager, buffer_manager,
+                                          log_manager, lock_table,
+                                          version_store, free_space_map);
+    transaction::Transaction transaction1(data_disk_manager, buffer_manager,
+                                          log_manager, lock_table,
+                                          version_store, free_space_map);
+    const disk::BlockID block_id(data_filename, 1);
+    Result result = transaction0.WriteRecord(
+        /*slot=*/0, disk::DiskPosition(block_id, 0),
+        data::kTypeInt.ValueLength(), data::Int(3).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = transaction1.WriteRecord(
+        /*slot=*/1, disk::DiskPosition(block_id, 6),
+        data::kTypeInt.ValueLength(), data::Int(4).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    transaction::Transaction transaction2(data_disk_manager, buffer_manager,
+                                          log_manager, lock_table,
+                                          version_store, free_space_map);
+    EXPECT_TRUE(transaction2
+                    .Write(disk::DiskPosition(block_id, 12),
+                           data::kTypeInt.ValueLength(), data::Int(5).Item())
+                    .IsError());
+
+    // The rollback of one transaction undoes only its record.
+    result = transaction0.Rollback();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = transaction1.Commit();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    ResultV<int> value =
+        transaction_for_check.ReadInt(disk::DiskPosition(block_id, 0));
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 0);
+    value = transaction_for_check.ReadInt(disk::DiskPosition(block_id, 6));
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 4);
+}
+
+TEST_F(TransactionTest, RollbackTwiceUndoesOnlyNewOperations) {
+    const disk::DiskPosition position0(disk::BlockID(data_filename, 3), 0);
+    const disk::DiskPosition position1(disk::BlockID(data_filename, 3), 6);
+    transaction::Transaction transaction(data_disk_manager, buffer_manager,
+                                         log_manager, lock_table,
+                                         version_store, free_space_map);
+    Result result = transaction.Write(position0, data::kTypeInt.ValueLength(),
+                                      data::Int(1).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = transaction.Rollback();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // Another transaction commits a value after the rollback released the
+    // locks.
+    transaction::Transaction other(data_disk_manager, buffer_manager,
+                                   log_manager, lock_table, version_store,
+                                   free_space_map);
+    result = other.Write(position0, data::kTypeInt.ValueLength(),
+                         data::Int(5).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = other.Commit();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // The second rollback undoes only the write after the first one.
+    result = transaction.Write(position1, data::kTypeInt.ValueLength(),
+                               data::Int(2).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = transaction.Rollback();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    ResultV<int> value = transaction_for_check.ReadInt(position0);
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 5);
+    value = transaction_for_check.ReadInt(position1);
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 0);
+}
+
+TEST_F(TransactionTest, RollbackAfterCommitKeepsCommittedOperations) {
+    const disk::DiskPosition position(disk::BlockID(data_filename, 4), 0);
+    transaction::Transaction transaction(data_disk_manager, buffer_manager,
+                                         log_manager, lock_table,
+                                         version_store, free_space_map);
+    Result result = transaction.Write(position, data::kTypeInt.ValueLength(),
+                                      data::Int(1).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = transaction.Commit();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // The rollback undoes only the write after the commit.
+    result = transaction.Write(position, data::kTypeInt.ValueLength(),
+                               data::Int(2).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = transaction.Rollback();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    ResultV<int> value = transaction_for_check.ReadInt(position);
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 1);
+}
+
+TEST_F(TransactionTest, SnapshotReadsWithoutWaitingForWriters) {
+    const disk::DiskPosition position(disk::BlockID(data_filename, 2), 0);
+    transaction::Transaction writer(data_disk_manager, buffer_manager,
+                                    log_manager, lock_table, version_store,
+                                    free_space_map);
+    Result result = writer.Write(position, data::kTypeInt.ValueLength(),
+                                 data::Int(1).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    result = writer.Commit();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+
+    // The writer holds the write lock, but the snapshot reads the committed
+    // value at once.
+    result = writer.Write(position, data::kTypeInt.ValueLength(),
+                          data::Int(2).Item());
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    transaction::Transaction snapshot(data_disk_manager, buffer_manager,
+                                      log_manager, lock_table, version_store,
+                                      free_space_map);
+    snapshot.BeginSnapshot();
+    ResultV<int> value = snapshot.ReadInt(position);
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 1);
+
+    // The snapshot keeps reading the value when it began.
+    result = writer.Commit();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    value = snapshot.ReadInt(position);
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 1);
+    EXPECT_TRUE(snapshot
+                    .Write(position, data::kTypeInt.ValueLength(),
+                           data::Int(3).Item())
+                    .IsError());
+
+    transaction::Transaction new_snapshot(data_disk_manager, buffer_manager,
+                                          log_manager, lock_table,
+                                          version_store, free_space_map);
+    new_snapshot.BeginSnapshot();
+    value = new_snapshot.ReadInt(position);
+    ASSERT_TRUE(value.IsOk()) << value.Error();
+    EXPECT_EQ(value.Get(), 2);
+    result = new_snapshot.Commit();
+    ASSERT_TRUE(result.IsOk()) << result.Error();
+    EXPECT_EQ(version_store.VersionCount(), 0);
+}
+
 // D: Tests if the transactions are durable.
\ No newline at end of file
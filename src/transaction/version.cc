@@ -0,0 +1,119 @@
+#include "version.h"
+#include <algorithm>
+#include <utility>
+
+namespace dbconcurrency {
+
+void VersionStore::AddVersion(const dblog::TransactionID transaction_id,
+                              const disk::DiskPosition &position,
+                              const std::vector<uint8_t> &before_image,
+                              const std::vector<uint8_t> &after_image) {
+    std::vector<uint8_t> changed_bits(before_image.size());
+    for (size_t i = 0; i < changed_bits.size(); i++) {
+        changed_bits[i] = before_image[i] ^ after_image[i];
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    versions_[position.BlockID()].push_back(
+        Version{transaction_id, position.Offset(), before_image,
+                std::move(changed_bits)});
+    modified_blocks_[transaction_id].insert(position.BlockID());
+    version_count_++;
+}
+
+void VersionStore::Commit(const dblog::TransactionID transaction_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (modified_blocks_.count(transaction_id) == 0) return;
+    last_commit_timestamp_++;
+    commit_timestamps_[transaction_id] = last_commit_timestamp_;
+    commits_.emplace_back(last_commit_timestamp_, transaction_id);
+    CollectGarbage();
+}
+
+void VersionStore::Rollback(const dblog::TransactionID transaction_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Discard(transaction_id);
+}
+
+CommitTimestamp VersionStore::BeginSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshots_.insert(last_commit_timestamp_);
+    return last_commit_timestamp_;
+}
+
+void VersionStore::EndSnapshot(const CommitTimestamp snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = snapshots_.find(snapshot);
+    if (it != snapshots_.end()) snapshots_.erase(it);
+    CollectGarbage();
+}
+
+void VersionStore::ReadSnapshot(const CommitTimestamp snapshot,
+                                const disk::DiskPosition &position,
+                                std::vector<uint8_t> &bytes) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = versions_.find(position.BlockID());
+    if (it == versions_.end()) return;
+
+    const int begin = position.Offset();
+    const int end   = begin + static_cast<int>(bytes.size());
+    for (auto version = it->second.rbegin(); version != it->second.rend();
+         version++) {
+        const int version_end =
+            version->offset + static_cast<int>(version->before_image.size());
+        if (version_end <= begin || end <= version->offset) continue;
+        if (IsVisible(version->transaction_id, snapshot)) continue;
+
+        const int overlap_begin = std::max(begin, version->offset);
+        const int overlap_end   = std::min(end, version_end);
+        for (int i = overlap_begin; i < overlap_end; i++) {
+            const uint8_t before  = version->before_image[i - version->offset];
+            const uint8_t changed = version->changed_bits[i - version->offset];
+            uint8_t &byte         = bytes[i - begin];
+            byte                  = (byte & ~changed) | (before & changed);
+        }
+    }
+}
+
+size_t VersionStore::VersionCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_count_;
+}
+
+bool VersionStore::IsVisible(const dblog::TransactionID transaction_id,
+                             const CommitTimestamp snapshot) const {
+    auto it = commit_timestamps_.find(transaction_id);
+    return it != commit_timestamps_.end() && it->second <= snapshot;
+}
+
+void VersionStore::Discard(const dblog::TransactionID transaction_id) {
+    auto it = modified_blocks_.find(transaction_id);
+    if (it == modified_blocks_.end()) return;
+    for (const disk::BlockID &block_id : it->second) {
+        std::vector<Version> &versions = versions_[block_id];
+        const size_t size_before       = versions.size();
+        versions.erase(std::remove_if(versions.begin(), versions.end(),
+                                      [&](const Version &version) {
+                                          return version.transaction_id ==
+                                                 transaction_id;
+                                      }),
+                       versions.end());
+        version_count_ -= size_before - versions.size();
+        if (versions.empty()) versions_.erase(block_id);
+    }
+    modified_blocks_.erase(it);
+    commit_timestamps_.erase(transaction_id);
+}
+
+void VersionStore::CollectGarbage() {
+    // A snapshot sees the transactions committed at or before its timestamp,
+    // so the oldest snapshot sees every transaction the others see.
+    const CommitTimestamp oldest_snapshot =
+        snapshots_.empty() ? last_commit_timestamp_ : *snapshots_.begin();
+    while (!commits_.empty() && commits_.front().first <= oldest_snapshot) {
+        Discard(commits_.front().second);
+        commits_.pop_front();
+    }
+}
+
+} // namespace dbconcurrency
@@ -0,0 +1,117 @@
+#ifndef _TRANSACTION_VERSION_H
+#define _TRANSACTION_VERSION_H
+
+#include "disk.h"
+#include "log.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dbconcurrency {
+
+// The commit timestamp orders the commits of the transactions. A snapshot
+// taken at a timestamp sees the transactions committed at or before it.
+using CommitTimestamp = uint64_t;
+
+// VersionStore keeps the older versions of the data modified by transactions,
+// so that a snapshot reads the data committed when it began without locks.
+// All these class methods are thread-safe.
+//
+// A transaction modifying data puts the before-image of the modification,
+// which it also writes to the log operation, and the bits it changes into the
+// store before it modifies the block. A snapshot reads the latest bytes of the
+// block and rolls the changed bits back to the before-images of the
+// transactions it does not see, from the newest to the oldest. The
+// transactions holding write locks never modify the same bits at the same
+// time, so the modifications of the transactions a snapshot does not see
+// always come after the modifications of the ones it sees. Only the changed
+// bits are rolled back, because the transactions may modify the other bits of
+// the same bytes for their own records, e.g. the occupancy bitmap of a page.
+//
+// The versions of a committed transaction are discarded once every snapshot
+// sees the transaction, and those of a rolled back transaction after it is
+// undone.
+class VersionStore {
+  public:
+    // Keeps `before_image` and `after_image`, the bytes of `position` before
+    // and after the transaction `transaction_id` modifies them. This method
+    // must be called before the block is modified, while the update latch of
+    // the block is held.
+    void AddVersion(const dblog::TransactionID transaction_id,
+                    const disk::DiskPosition &position,
+                    const std::vector<uint8_t> &before_image,
+                    const std::vector<uint8_t> &after_image);
+
+    // Gives the transaction the next commit timestamp, which makes its
+    // modifications visible to the snapshots beginning after this. This method
+    // must be called before the transaction releases its locks.
+    void Commit(const dblog::TransactionID transaction_id);
+
+    // Discards the versions of the transaction. This method must be called
+    // after the modifications of the transaction are undone.
+    void Rollback(const dblog::TransactionID transaction_id);
+
+    // Begins a snapshot, and returns its timestamp.
+    CommitTimestamp BeginSnapshot();
+
+    // Ends the snapshot of `snapshot`.
+    void EndSnapshot(const CommitTimestamp snapshot);
+
+    // Rolls `bytes`, which are read from `position` in the latest state of
+    // the block, back to the bytes seen by the snapshot of `snapshot`. The
+    // bytes must be read while the update latch of the block is held.
+    void ReadSnapshot(const CommitTimestamp snapshot,
+                      const disk::DiskPosition &position,
+                      std::vector<uint8_t> &bytes) const;
+
+    // Returns the number of the kept versions.
+    size_t VersionCount() const;
+
+  private:
+    struct Version {
+        dblog::TransactionID transaction_id;
+        int offset;
+        std::vector<uint8_t> before_image;
+
+        // The bits changed by the modification, which are rolled back.
+        std::vector<uint8_t> changed_bits;
+    };
+
+    // Returns true if the snapshot of `snapshot` sees the modifications of
+    // the transaction `transaction_id`. The mutex must be held.
+    bool IsVisible(const dblog::TransactionID transaction_id,
+                   const CommitTimestamp snapshot) const;
+
+    // Discards the versions of the transaction. The mutex must be held.
+    void Discard(const dblog::TransactionID transaction_id);
+
+    // Discards the versions of the committed transactions seen by every
+    // snapshot. The mutex must be held.
+    void CollectGarbage();
+
+    mutable std::mutex mutex_;
+
+    // The versions of each block in the order of the modifications.
+    std::unordered_map<disk::BlockID, std::vector<Version>> versions_;
+
+    // The blocks modified by the transactions whose versions are kept.
+    std::map<dblog::TransactionID, std::set<disk::BlockID>> modified_blocks_;
+
+    // The commit timestamps of the committed transactions whose versions are
+    // kept, and the same transactions in the order of the commits.
+    std::map<dblog::TransactionID, CommitTimestamp> commit_timestamps_;
+    std::deque<std::pair<CommitTimestamp, dblog::TransactionID>> commits_;
+
+    std::multiset<CommitTimestamp> snapshots_;
+    CommitTimestamp last_commit_timestamp_ = 0;
+    size_t version_count_                  = 0;
+};
+
+} // namespace dbconcurrency
+
+#endif
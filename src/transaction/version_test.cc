@@ -0,0 +1,100 @@
+#include "version.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+const disk::BlockID block0("a.txt", 0), block1("a.txt", 1);
+
+TEST(VersionStore, SnapshotDoesNotSeeUncommittedTransaction) {
+    dbconcurrency::VersionStore version_store;
+    const dbconcurrency::CommitTimestamp snapshot =
+        version_store.BeginSnapshot();
+
+    // The transaction 1 writes {4, 5} over {1, 2} at the offset 2.
+    version_store.AddVersion(1, disk::DiskPosition(block0, 2), {1, 2}, {4, 5});
+    std::vector<uint8_t> bytes = {0, 0, 4, 5, 0};
+    version_store.ReadSnapshot(snapshot, disk::DiskPosition(block0, 0), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({0, 0, 1, 2, 0}));
+
+    // Only the overlapping bytes are rolled back.
+    bytes = {5, 9};
+    version_store.ReadSnapshot(snapshot, disk::DiskPosition(block0, 3), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({2, 9}));
+
+    // The other blocks are not affected.
+    bytes = {4, 5};
+    version_store.ReadSnapshot(snapshot, disk::DiskPosition(block1, 2), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({4, 5}));
+    version_store.EndSnapshot(snapshot);
+}
+
+TEST(VersionStore, SnapshotSeesTransactionsCommittedBefore) {
+    dbconcurrency::VersionStore version_store;
+    version_store.AddVersion(1, disk::DiskPosition(block0, 0), {1}, {2});
+    const dbconcurrency::CommitTimestamp before =
+        version_store.BeginSnapshot();
+    version_store.Commit(1);
+    const dbconcurrency::CommitTimestamp after = version_store.BeginSnapshot();
+
+    // The transaction 2 writes 3 over 2, which the transaction 1 wrote over 1.
+    version_store.AddVersion(2, disk::DiskPosition(block0, 0), {2}, {3});
+    std::vector<uint8_t> bytes = {3};
+    version_store.ReadSnapshot(before, disk::DiskPosition(block0, 0), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({1}));
+    bytes = {3};
+    version_store.ReadSnapshot(after, disk::DiskPosition(block0, 0), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({2}));
+
+    version_store.Commit(2);
+    bytes = {3};
+    version_store.ReadSnapshot(after, disk::DiskPosition(block0, 0), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({2}));
+    version_store.EndSnapshot(before);
+    version_store.EndSnapshot(after);
+}
+
+TEST(VersionStore, VersionsAreDiscardedWhenNoSnapshotNeedsThem) {
+    dbconcurrency::VersionStore version_store;
+
+    // Without snapshots, the versions are discarded at the commit.
+    version_store.AddVersion(1, disk::DiskPosition(block0, 0), {1}, {2});
+    version_store.AddVersion(1, disk::DiskPosition(block1, 0), {1}, {2});
+    EXPECT_EQ(version_store.VersionCount(), 2);
+    version_store.Commit(1);
+    EXPECT_EQ(version_store.VersionCount(), 0);
+
+    // A snapshot keeps the versions of the transactions committed after it.
+    const dbconcurrency::CommitTimestamp snapshot =
+        version_store.BeginSnapshot();
+    version_store.AddVersion(2, disk::DiskPosition(block0, 0), {2}, {3});
+    version_store.Commit(2);
+    EXPECT_EQ(version_store.VersionCount(), 1);
+    version_store.EndSnapshot(snapshot);
+    EXPECT_EQ(version_store.VersionCount(), 0);
+
+    // The versions of a rolled back transaction are discarded.
+    version_store.AddVersion(3, disk::DiskPosition(block0, 0), {3}, {4});
+    version_store.Rollback(3);
+    EXPECT_EQ(version_store.VersionCount(), 0);
+}
+
+TEST(VersionStore, SnapshotRollsBackOnlyChangedBits) {
+    dbconcurrency::VersionStore version_store;
+
+    // The transaction 1 sets the bit 1, and then the transaction 2 sets the
+    // bit 0 of the same byte and commits.
+    version_store.AddVersion(1, disk::DiskPosition(block0, 0), {0b00},
+                             {0b10});
+    version_store.AddVersion(2, disk::DiskPosition(block0, 0), {0b10},
+                             {0b11});
+    version_store.Commit(2);
+    const dbconcurrency::CommitTimestamp snapshot =
+        version_store.BeginSnapshot();
+
+    // The snapshot sees the bit set by the transaction 2, though the
+    // transaction 1 modified the byte before it.
+    std::vector<uint8_t> bytes = {0b11};
+    version_store.ReadSnapshot(snapshot, disk::DiskPosition(block0, 0), bytes);
+    EXPECT_EQ(bytes, std::vector<uint8_t>({0b01}));
+    version_store.EndSnapshot(snapshot);
+    version_store.Rollback(1);
+}